@@ -23,6 +23,7 @@
 #include <cstdio>
 #include <vector>
 #include <cmath>
+#include <random>
 
 namespace {
 
@@ -89,30 +90,9 @@ MeshBuffers makeTriangleBase() {
     return tri;
 }
 
-void bakeMesh(const MeshBuffers& base, const glm::mat4& model, MeshBuffers& baked) {
-    glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-    baked.positions.resize(base.positions.size());
-    baked.normals.resize(base.normals.size());
-    baked.indices = base.indices;
-    baked.color = base.color;
-
-    for (size_t i = 0; i < base.positions.size(); i += 3) {
-        glm::vec4 pos(base.positions[i + 0], base.positions[i + 1], base.positions[i + 2], 1.0f);
-        glm::vec3 normal(base.normals[i + 0], base.normals[i + 1], base.normals[i + 2]);
-
-        glm::vec4 worldPos = model * pos;
-        glm::vec3 worldNormal = glm::normalize(normalMat * normal);
-
-        baked.positions[i + 0] = worldPos.x;
-        baked.positions[i + 1] = worldPos.y;
-        baked.positions[i + 2] = worldPos.z;
-        baked.normals[i + 0] = worldNormal.x;
-        baked.normals[i + 1] = worldNormal.y;
-        baked.normals[i + 2] = worldNormal.z;
-    }
-}
-
-gfx::MeshSource toMeshSource(const MeshBuffers& mesh) {
+// Rigid shapes: the arrays never change after creation (version 1), only the transform,
+// so syncs after the first upload nothing
+gfx::MeshSource toMeshSource(const MeshBuffers& mesh, const glm::mat4& model = glm::mat4(1.0f)) {
     gfx::MeshSource src{};
     src.positions = mesh.positions.data();
     src.normals = mesh.normals.data();
@@ -120,6 +100,10 @@ gfx::MeshSource toMeshSource(const MeshBuffers& mesh) {
     src.vertexCount = static_cast<int>(mesh.positions.size() / 3);
     src.indexCount = static_cast<int>(mesh.indices.size());
     src.color = mesh.color;
+    src.model = model;
+    src.positionsVersion = 1;
+    src.normalsVersion = 1;
+    src.indicesVersion = 1;
     return src;
 }
 
@@ -237,6 +221,14 @@ void renderLightingUI(gfx::RenderSettings& settings) {
         if (settings.shadowEnabled) {
             ImGui::SliderFloat("Shadow Bias", &settings.shadowBias, 0.001f, 0.02f, "%.4f");
             ImGui::SliderFloat("Shadow Softness", &settings.shadowSoftness, 1.0f, 4.0f, "%.0f");
+            ImGui::SliderInt("Cascades", &settings.shadowCascades, 1, Shadow::MAX_CASCADES);
+            ImGui::SliderFloat("Cascade Split Lambda", &settings.shadowSplitLambda, 0.0f, 1.0f, "%.2f");
+            ImGui::SliderFloat("Shadow Distance", &settings.shadowDistance, 20.0f, 250.0f, "%.0f");
+            ImGui::Checkbox("Single-Pass Layered Shadows", &settings.shadowLayered);
+            ImGui::Checkbox("Cache Shadow Maps", &settings.shadowCaching);
+            if (settings.shadowCaching) {
+                ImGui::Checkbox("Split Static/Dynamic Casters", &settings.shadowDynamicSplit);
+            }
         }
         ImGui::Separator();
         ImGui::Text("Screen-Space AO");
@@ -282,6 +274,7 @@ void renderLightingUI(gfx::RenderSettings& settings) {
                 ImGui::SliderFloat3("Position", light.position, -200.0f, 200.0f, "%.1f");
                 ImGui::ColorEdit3("Color", light.diffuse);
                 ImGui::SliderFloat("Intensity", &light.intensity, 0.0f, 3.0f, "%.2f");
+                ImGui::SliderFloat("Range", &light.range, 1.0f, 400.0f, "%.0f");
                 ImGui::Checkbox("Cast Shadow", &light.castsShadow);
                 if (ImGui::Button("Remove")) {
                     removeIndex = static_cast<int>(i);
@@ -401,8 +394,25 @@ int main() {
     MeshBuffers triBase = makeTriangleBase();
     triBase.color = glm::vec3(1.0f, 0.6f, 0.2f);
 
-    MeshBuffers cubeMesh;
-    MeshBuffers triMesh;
+    // Scatter props: one rock shape, uploaded once and drawn for every instance
+    MeshBuffers rockBase = makeCubeBase();
+    rockBase.color = glm::vec3(0.55f, 0.5f, 0.45f);
+    const gfx::InstancedMeshHandle rocks = engine.createInstancedMesh(toMeshSource(rockBase));
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> spread(-38.0f, 38.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<gfx::InstanceData> scatter(3000);
+        for (gfx::InstanceData& rock : scatter) {
+            const glm::vec3 size = glm::vec3(0.3f + 0.5f * unit(rng)) * glm::vec3(1.0f, 0.5f + unit(rng), 1.0f);
+            rock.model = glm::translate(glm::mat4(1.0f), glm::vec3(spread(rng), 0.5f * size.y, spread(rng)));
+            rock.model = glm::rotate(rock.model, 6.2831853f * unit(rng), glm::vec3(0.0f, 1.0f, 0.0f));
+            rock.model = glm::scale(rock.model, size);
+            const float shade = 0.8f + 0.4f * unit(rng);
+            rock.color = glm::vec4(shade, shade, shade, 1.0f);
+        }
+        engine.setInstances(rocks, scatter.data(), static_cast<int>(scatter.size()));
+    }
 
     float orbitRadius = 12.0f;
     float orbitHeight = 6.0f;
@@ -446,24 +456,28 @@ int main() {
         glm::mat4 cubeModel = glm::translate(glm::mat4(1.0f), glm::vec3(-10.0f, 3.0f, 0.0f));
         cubeModel = glm::rotate(cubeModel, 0.35f * t, glm::vec3(0.0f, 1.0f, 0.0f));
         cubeModel = glm::scale(cubeModel, glm::vec3(6.0f, 4.0f, 6.0f));
-        bakeMesh(cubeBase, cubeModel, cubeMesh);
 
         glm::vec3 orbitPos = glm::vec3(std::cos(t) * orbitRadius, orbitHeight, std::sin(t) * orbitRadius);
         glm::mat4 triModel = glm::translate(glm::mat4(1.0f), orbitPos);
         triModel = glm::rotate(triModel, t * 2.0f, glm::vec3(0.0f, 1.0f, 0.0f));
         triModel = glm::scale(triModel, glm::vec3(4.0f));
-        bakeMesh(triBase, triModel, triMesh);
 
         std::vector<gfx::MeshSource> meshes;
         meshes.reserve(2);
-        meshes.push_back(toMeshSource(cubeMesh));
-        meshes.push_back(toMeshSource(triMesh));
+        meshes.push_back(toMeshSource(cubeBase, cubeModel));
+        meshes.push_back(toMeshSource(triBase, triModel));
         engine.syncMeshes(meshes);
 
         // Keep renderer toggles in sync
         Shadow::setEnabled(settings.shadowEnabled);
         Shadow::setBias(settings.shadowBias);
         Shadow::setSoftness(settings.shadowSoftness);
+        Shadow::setCascadeCount(settings.shadowCascades);
+        Shadow::setCascadeSplitLambda(settings.shadowSplitLambda);
+        Shadow::setCascadeDistance(settings.shadowDistance);
+        Shadow::setLayeredRendering(settings.shadowLayered);
+        Shadow::setCaching(settings.shadowCaching);
+        Shadow::setDynamicSplit(settings.shadowCaching && settings.shadowDynamicSplit);
         SSAO::setEnabled(settings.ssaoEnabled);
         if (settings.ssaoEnabled) {
             SSAO::setRadius(settings.ssaoRadius);
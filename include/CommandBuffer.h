@@ -0,0 +1,87 @@
+#pragma once
+/// @file CommandBuffer.h
+/// @brief Linear buffer of recorded bind, uniform-write and draw commands. Recording
+/// touches no GL state, so worker threads can each fill their own buffer; the GL thread
+/// then replays the buffers in order.
+
+#include <ShaderLib.h>
+#include <UniformBlocks.h>
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace gfx {
+
+class CommandBuffer {
+public:
+    /// Forget the recorded commands (keeps the allocation for the next frame)
+    void clear() { m_data.clear(); }
+    bool empty() const { return m_data.empty(); }
+    size_t bytes() const { return m_data.size(); }
+
+    void useProgram(ShaderLib::ProgramWrapper* program);
+    void bindFrame(UniformBlocks::FrameSlot slot);
+    /// glPolygonMode for GL_FRONT_AND_BACK
+    void polygonMode(GLenum mode);
+    /// Make block the staged draw block and commit it. Recorded by pointer, so block
+    /// must stay alive and unchanged until replay.
+    void writeDrawBlock(const FlockingShaders::DrawBlock* block);
+
+    void bindVertexArray(GLuint vao);
+    /// GL_TRIANGLES from the bound VAO
+    void drawArrays(GLsizei vertexCount);
+    void drawElements(GLsizei indexCount, GLenum indexType, const void* offset, GLint baseVertex = 0);
+    /// glDrawElementsInstanced(BaseVertex); per-instance attributes come from the bound VAO
+    void drawElementsInstanced(GLsizei indexCount, GLenum indexType, const void* offset, GLsizei instanceCount,
+                               GLint baseVertex = 0);
+    /// One glMultiDrawElementsBaseVertex; counts and offsets are copied into the buffer
+    void multiDrawElements(GLenum indexType, const GLsizei* counts, const void* const* offsets, GLsizei drawCount,
+                           GLint baseVertex);
+
+    /// Call fn(args) when replayed, for state without a dedicated command (e.g. the
+    /// shadow program's loose uniforms). args is copied into the buffer.
+    template <typename T>
+    void invoke(void (*fn)(const T&), const T& args) {
+        static_assert(std::is_trivially_copyable<T>::value, "invoke arguments are copied bytewise");
+        using Fn = void (*)(const T&);
+        const Thunk thunk = &invokeThunk<T>;
+        unsigned char* out = append(Invoke, sizeof(Thunk) + sizeof(Fn) + sizeof(T));
+        std::memcpy(out, &thunk, sizeof(Thunk));
+        std::memcpy(out + sizeof(Thunk), &fn, sizeof(Fn));
+        std::memcpy(out + sizeof(Thunk) + sizeof(Fn), &args, sizeof(T));
+    }
+
+    /// Issue the recorded commands on the current context (GL thread only)
+    void replay() const;
+
+private:
+    enum Op : uint32_t {
+        UseProgram, BindFrame, PolygonMode, WriteDrawBlock,
+        BindVertexArray, DrawArrays, DrawElements, DrawElementsInstanced, MultiDrawElements, Invoke
+    };
+    using Thunk = void (*)(const unsigned char* payload);
+
+    template <typename T>
+    static void invokeThunk(const unsigned char* payload) {
+        using Fn = void (*)(const T&);
+        Fn fn;
+        std::memcpy(&fn, payload, sizeof(Fn));
+        alignas(T) unsigned char args[sizeof(T)];
+        std::memcpy(args, payload + sizeof(Fn), sizeof(T));
+        fn(*reinterpret_cast<const T*>(args));
+    }
+
+    /// Reserve a command and return its payload
+    unsigned char* append(Op op, size_t payloadBytes);
+    template <typename T>
+    void appendValue(Op op, const T& value) {
+        std::memcpy(append(op, sizeof(T)), &value, sizeof(T));
+    }
+
+    std::vector<unsigned char> m_data;
+};
+
+} // namespace gfx
@@ -7,6 +7,8 @@
 #include <Vector.h>
 #include <string>
 
+namespace gfx { class RenderQueue; }
+
 /// @brief Floor obstacle for cloth collision visualization
 class Floor {
 public:
@@ -18,7 +20,9 @@ public:
   void setFloorWireframe(bool setEnable);
   const Vector &getPosition();
   
-  void draw(const std::string &_shaderName, TransformStack &_transform, Camera *_cam) const;
+  /// Queue the floor with its material and transforms staged in its draw block
+  void submit(gfx::RenderQueue &_queue, const std::string &_shaderName, TransformStack &_transform,
+              Camera *_cam) const;
 
   Vector m_position;
   bool m_floorWireframe;
@@ -0,0 +1,70 @@
+#pragma once
+/// @file GLState.h
+/// @brief Shadow copy of the render context's binding and fixed-function state. Calls
+/// that would not change anything are dropped and counted.
+///
+/// Everything that binds or toggles tracked state on the render context goes through
+/// here, otherwise the cache goes stale. UploadService's worker context keeps its own
+/// raw calls. Objects must be deleted with the delete* functions below so a reused
+/// name is never mistaken for a live binding.
+
+#include <glad/gl.h>
+#include <cstdint>
+
+namespace GLState {
+
+/// Counters since the last resetStats()
+struct Stats {
+    uint64_t issued = 0;   ///< GL calls made
+    uint64_t skipped = 0;  ///< calls dropped because the state already matched
+};
+
+/// Detect direct state access and forget all cached state (call with a current context)
+void init();
+
+/// Forget all cached state so the next call of each kind goes through. Use after code
+/// outside the engine may have changed the context.
+void invalidate();
+
+/// True when ARB_direct_state_access is available (buffer edits skip bind-to-edit)
+bool hasDSA();
+
+void useProgram(GLuint program);
+void bindVertexArray(GLuint vao);
+
+/// GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO and is always passed through
+void bindBuffer(GLenum target, GLuint buffer);
+/// Also sets the generic binding of target, as GL does
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+/// Update part of an existing buffer's storage: glNamedBufferSubData with DSA, otherwise
+/// through GL_COPY_WRITE_BUFFER so no VAO or generic binding is disturbed
+void bufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+/// (Re)allocate a buffer's storage through GL_COPY_WRITE_BUFFER (also valid for fresh names)
+void bufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+
+/// Bind texture to target on unit (leaves unit active, so it can be edited afterwards)
+void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+/// GL_FRAMEBUFFER sets both the draw and read bindings
+void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+/// glPolygonMode for GL_FRONT_AND_BACK
+void polygonMode(GLenum mode);
+void setCullFace(bool enabled);
+void cullFace(GLenum face);
+void setDepthTest(bool enabled);
+void depthFunc(GLenum func);
+void depthMask(bool write);
+
+/// Delete objects and clear every cached binding that refers to them
+void deleteBuffers(GLsizei count, const GLuint* buffers);
+void deleteVertexArrays(GLsizei count, const GLuint* arrays);
+void deleteTextures(GLsizei count, const GLuint* textures);
+void deleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+
+const Stats& stats();
+void resetStats();
+
+} // namespace GLState
@@ -0,0 +1,109 @@
+#pragma once
+/// @file GeometryArena.h
+/// @brief Pooled vertex/index storage: one VBO + EBO + VAO shared by many meshes
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace gfx {
+
+/// First-fit free-list allocator over [0, capacity) in abstract units.
+/// Adjacent free ranges are coalesced on release.
+class RangeAllocator {
+public:
+    static constexpr size_t INVALID = ~size_t(0);
+
+    void reset(size_t capacity);
+    /// Extend the range; new space is appended to the free list
+    void grow(size_t newCapacity);
+    /// Returns the offset, or INVALID when no free range is large enough
+    size_t allocate(size_t size);
+    void release(size_t offset, size_t size);
+
+    size_t capacity() const { return m_capacity; }
+    size_t freeTotal() const { return m_freeTotal; }
+    size_t largestFree() const;
+
+private:
+    std::map<size_t, size_t> m_free;  // offset -> size
+    size_t m_capacity = 0;
+    size_t m_freeTotal = 0;
+};
+
+/// Sub-allocates mesh vertex and index ranges from a single pair of buffers so a
+/// whole list of meshes draws with one VAO bind and glDrawElementsBaseVertex.
+/// Buffers grow geometrically (contents copied GPU-side); defragment() compacts
+/// live blocks to the front. Handles stay valid across both.
+class GeometryArena {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID_HANDLE = ~Handle(0);
+    /// Sets vertex attribute pointers for the bound GL_ARRAY_BUFFER
+    using AttributeSetup = void (*)();
+
+    struct Block {
+        size_t firstVertex = 0;
+        size_t vertexCount = 0;
+        size_t firstIndex = 0;
+        size_t indexCount = 0;
+        bool live = false;
+    };
+
+    GeometryArena() = default;
+    ~GeometryArena();
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    bool create(size_t vertexStride, AttributeSetup setupAttributes,
+                size_t vertexCapacity, size_t indexCapacity);
+    void destroy();
+
+    Handle allocate(size_t vertexCount, size_t indexCount);
+    void release(Handle handle);
+    /// Reallocate one stream of a block; previous contents of that stream are dropped
+    void resizeVertices(Handle handle, size_t vertexCount);
+    void resizeIndices(Handle handle, size_t indexCount);
+
+    /// Write vertices [first, first + count) of the block
+    void uploadVertices(Handle handle, size_t first, size_t count, const void* data);
+    void uploadIndices(Handle handle, const uint32_t* indices, size_t count);
+
+    /// Move every live block to the front of fresh buffers
+    void defragment();
+    /// 1 - largest free range / total free space (0 when nothing is free)
+    float fragmentation() const;
+
+    const Block& block(Handle handle) const { return m_blocks[handle]; }
+    /// Byte offset of the block's first index, for glDrawElementsBaseVertex
+    const void* indexOffset(Handle handle) const {
+        return reinterpret_cast<const void*>(m_blocks[handle].firstIndex * sizeof(uint32_t));
+    }
+
+    GLuint vao() const { return m_vao; }
+    GLuint vertexBuffer() const { return m_vbo; }
+    GLuint indexBuffer() const { return m_ebo; }
+    size_t vertexStride() const { return m_stride; }
+    bool isCreated() const { return m_vao != 0; }
+
+private:
+    size_t allocateVertices(size_t count);
+    size_t allocateIndices(size_t count);
+    void growVertices(size_t minCapacity);
+    void growIndices(size_t minCapacity);
+    void bindBuffers();
+
+    GLuint m_vao = 0;
+    GLuint m_vbo = 0;
+    GLuint m_ebo = 0;
+    size_t m_stride = 0;
+    AttributeSetup m_setupAttributes = nullptr;
+    RangeAllocator m_vertexAlloc;
+    RangeAllocator m_indexAlloc;
+    std::vector<Block> m_blocks;
+    std::vector<Handle> m_freeHandles;
+};
+
+} // namespace gfx
@@ -6,6 +6,8 @@
 #include <unordered_map>
 #include <glm/glm.hpp>
 
+namespace gfx { class CommandBuffer; }
+
 namespace FlockingGraphics {
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -17,10 +19,14 @@ struct Geometry {
     unsigned int EBO = 0;
     size_t indexCount = 0;
     size_t vertexCount = 0;
+    unsigned int indexType = 0;   ///< GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, set with EBO
     
     ~Geometry();
     void bind() const;
-    void render() const;
+    /// Draw instances copies (instanced when more than one)
+    void render(int instances = 1) const;
+    /// Record what render() issues, for replay on the GL thread
+    void record(gfx::CommandBuffer& cmd) const;
     void cleanup();
 };
 
@@ -48,6 +54,11 @@ public:
     std::shared_ptr<Geometry> createCube(float size = 1.0f);
     std::shared_ptr<Geometry> createBoundingBox();
     
+    // Run MeshOptimizer (weld, vertex-cache/overdraw order, fetch remap) on geometry
+    // created from now on; already cached shapes keep their layout
+    void setOptimizeMeshes(bool enabled) { m_optimizeMeshes = enabled; }
+    bool isOptimizeMeshes() const { return m_optimizeMeshes; }
+    
     // Management
     void clear();
     size_t getGeometryCount() const;
@@ -58,6 +69,7 @@ private:
     ~GeometryFactory() = default;
     
     std::unordered_map<std::string, std::shared_ptr<Geometry>> m_geometries;
+    bool m_optimizeMeshes = false;
     
     // Helper methods
     void createVAO(Geometry* geometry, const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
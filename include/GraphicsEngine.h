@@ -3,6 +3,8 @@
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
+#include <limits>
+#include <mutex>
 #include <vector>
 #include <string>
 
@@ -10,6 +12,16 @@
 #include "RenderSettings.h"
 #include "Floor.h"
 #include "SphereObstacle.h"
+#include "GeometryArena.h"
+#include "IndirectBatch.h"
+#include "LightClusters.h"
+#include "Meshlets.h"
+#include "CommandBuffer.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
+#include "SlotMap.h"
+#include "StreamRingBuffer.h"
+#include "UploadService.h"
 
 class Camera;
 class TransformStack;
@@ -25,16 +37,132 @@ struct GpuMesh {
     int triangleCount = 0;
     size_t vertexCapacityBytes = 0;
     size_t indexCapacityBytes = 0;
+    GLenum indexType = GL_UNSIGNED_INT;   // GL_UNSIGNED_SHORT when every index fits in 16 bits
+    // Separate attribute streams: VBO holds positions only, normals/UVs get their own buffers
+    bool separateStreams = false;
+    GLuint normalVBO = 0;
+    GLuint uvVBO = 0;
+    size_t normalCapacityBytes = 0;
+    size_t uvCapacityBytes = 0;
+    // Packed 16-byte vertices (VertexPacking.h): positions decode as q * scale + bias
+    bool packed = false;
+    glm::vec3 posDequantScale{1.0f};
+    glm::vec3 posDequantBias{0.0f};
+    // Pooled geometry: vertices/indices live in a shared arena block instead of VBO/EBO
+    GeometryArena* arena = nullptr;
+    GeometryArena::Handle arenaHandle = GeometryArena::INVALID_HANDLE;
+    // Streaming: vertices live in the engine's ring buffer instead of VBO
+    bool streamed = false;
+    GLuint streamBuffer = 0;   // ring buffer the VAO attributes currently point at
+    int streamRegion = -1;     // ring region written this frame
+    GLint baseVertex = 0;      // first vertex of this mesh inside the bound vertex buffer
+    size_t streamOffset = 0;   // byte offset of this mesh inside the ring buffer
+    // Background upload in flight: these buffers replace VBO/EBO once the ticket completes
+    uint64_t pendingUpload = 0;
+    GLuint pendingVBO = 0;
+    GLuint pendingEBO = 0;
+    size_t pendingVertexBytes = 0;
+    size_t pendingIndexBytes = 0;
+    GLenum pendingIndexType = GL_UNSIGNED_INT;
+    int pendingTriangleCount = -1;   // -1: the pending upload leaves the topology alone
+    // Change tracking: what the buffers currently hold (see MeshSource versions)
+    const float* sourcePositions = nullptr;
+    const uint32_t* sourceIndices = nullptr;
+    uint64_t positionsVersion = 0;
+    uint64_t normalsVersion = 0;
+    uint64_t uvsVersion = 0;
+    uint64_t indicesVersion = 0;
+    int indexCount = 0;
+    bool hasUVs = false;
+    // Meshlet culling: clusters over the EBO, which then holds indices in meshlet order
+    Meshlets::ClusterSet clusters;
+    glm::mat4 model{1.0f};   // MeshSource::model of the last sync
+    // Object-space bounds of the uploaded positions (shadow cascade fitting)
+    glm::vec3 boundsMin{0.0f};
+    glm::vec3 boundsMax{0.0f};
+    uint64_t boundsVersion = 0;   // positionsVersion the bounds cover; 0 rescans on the next upload
+};
+
+// Generational ID of a mesh created with Engine::createMesh
+using MeshHandle = SlotMap<GpuMesh>::Handle;
+
+// One instance of an instanced mesh, laid out as the per-instance vertex stream
+struct InstanceData {
+    glm::mat4 model{1.0f};
+    glm::vec4 color{1.0f};   // multiplies the mesh colour
+};
+
+// Base mesh drawn once per instance with glDrawElementsInstanced
+struct InstancedMesh {
+    GLuint VAO = 0;
+    GLuint VBO = 0;
+    GLuint EBO = 0;
+    GLuint instanceVBO = 0;
+    bool ownsGeometry = true;   // false: VBO/EBO are borrowed (light gizmo sphere)
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t instanceCapacityBytes = 0;
+    int instanceCount = 0;
+    uint64_t instancesVersion = 0;   // bumped by every instance upload (shadow cache key)
+    glm::vec3 color{0.8f};      // from MeshSource::color
+    glm::vec3 center{0.0f};     // mean instance position, for the queue's depth sort
+    glm::vec3 baseMin{0.0f};    // object-space bounds of the base mesh
+    glm::vec3 baseMax{0.0f};
+    glm::vec3 boundsMin{0.0f};  // world bounds of every instance
+    glm::vec3 boundsMax{0.0f};
+    bool castsShadow = true;
+};
+
+// Generational ID of an instanced mesh created with Engine::createInstancedMesh
+using InstancedMeshHandle = SlotMap<InstancedMesh>::Handle;
+
+// Half-open range of vertices [begin, end) whose attributes changed
+struct VertexRange {
+    int begin = 0;
+    int end = 0;
 };
 
 struct MeshSource {
     const float* positions = nullptr;
-    const float* normals = nullptr;
+    const float* normals = nullptr;   // may be null with indices: normals are generated
     const float* uvs = nullptr;
     const uint32_t* indices = nullptr;
     int vertexCount = 0;
     int indexCount = 0;
     glm::vec3 color{0.8f, 0.8f, 0.8f};
+    // Object-to-world transform, applied in the vertex shaders of every pass. The arrays
+    // stay in object space, so moving a rigid mesh only changes this matrix and, with
+    // tracked versions, uploads nothing.
+    glm::mat4 model{1.0f};
+
+    // Optional change tracking. Bump a version whenever that array changes; a version
+    // of 0 means "untracked" and forces a re-upload every sync. indicesVersion is the
+    // topology version: the EBO is only rewritten when it (or indexCount) changes.
+    uint64_t positionsVersion = 0;
+    uint64_t normalsVersion = 0;
+    uint64_t uvsVersion = 0;
+    uint64_t indicesVersion = 0;
+    // Optional list of vertex ranges touched since the last sync. When set (and the
+    // vertex count is unchanged) only these ranges are re-uploaded.
+    const VertexRange* dirtyRanges = nullptr;
+    int dirtyRangeCount = 0;
+};
+
+// Meshlet culling results, accumulated over every pass until resetMeshletStats()
+struct MeshletStats {
+    size_t meshletsTested = 0;
+    size_t trianglesTested = 0;
+    size_t trianglesDrawn = 0;
+    int multiDraws = 0;
+};
+
+// Per-sync upload traffic, accumulated until resetUploadStats()
+struct UploadStats {
+    size_t vertexBytes = 0;
+    size_t indexBytes = 0;
+    size_t copiedBytes = 0;   // GPU-side copies (unchanged streamed meshes)
+    int meshesUploaded = 0;
+    int meshesSkipped = 0;
 };
 
 class Engine {
@@ -46,9 +174,30 @@ public:
     // Upload primary meshes (e.g., cloth) with per-mesh colors
     void syncPrimaryMeshes(const std::vector<MeshSource>& meshes,
                            std::vector<glm::vec3>& meshColors);
-    // Upload auxiliary meshes (colliders/props)
+    // Upload auxiliary meshes (colliders/props). Entries are matched to last sync's by
+    // positions array, so reordering or removing meshes keeps the others' buffers.
     void syncMeshes(const std::vector<MeshSource>& meshes);
 
+    // Handle-based auxiliary meshes, drawn with the synced ones. A handle stays valid
+    // until destroyMesh no matter what else is created or removed; stale handles are
+    // ignored. Destroyed meshes return their GL buffers to a pool for later creations.
+    MeshHandle createMesh(const MeshSource& src);
+    bool updateMesh(MeshHandle handle, const MeshSource& src);
+    void destroyMesh(MeshHandle handle);
+    bool isMeshAlive(MeshHandle handle) const { return m_meshes.contains(handle); }
+    // GPU state of a mesh (buffers, layout, bounds); null for stale handles
+    const GpuMesh* mesh(MeshHandle handle) const { return m_meshes.get(handle); }
+
+    // Instanced meshes for repeated props: the base mesh is uploaded once (normals are
+    // generated when null; indices are required), then every instance given to
+    // setInstances is drawn with one glDrawElementsInstanced per pass. They draw and cast
+    // shadows with the other auxiliary meshes. base.model is unused: instances carry their
+    // own transforms. Returns an invalid handle on bad input.
+    InstancedMeshHandle createInstancedMesh(const MeshSource& base, bool castsShadow = true);
+    // Replace the instance list; the instance buffer only grows. False for stale handles.
+    bool setInstances(InstancedMeshHandle handle, const InstanceData* instances, int count);
+    void destroyInstancedMesh(InstancedMeshHandle handle);
+
     // Render full scene (shadows + SSAO + main pass + particles)
     void renderScene(Camera* camera,
                      Floor* floor,
@@ -60,13 +209,198 @@ public:
 
     void cleanup(Renderer::ClothRenderData& renderData);
 
+    // Stream primary meshes through a persistently mapped triple-buffered ring
+    // (requires ARB_buffer_storage; falls back to glBufferSubData otherwise)
+    void setPrimaryStreaming(bool enabled) { m_streamPrimary = enabled; }
+    bool isPrimaryStreaming() const { return m_streamPrimary && StreamRingBuffer::isSupported(); }
+
+    // Upload positions/normals/UVs straight from the MeshSource arrays into one buffer
+    // per attribute instead of interleaving them first. Only streams whose version
+    // changed are re-uploaded. Primary streaming takes precedence when both are on.
+    void setSeparateAttributeStreams(bool enabled) { m_separateStreams = enabled; }
+    bool isSeparateAttributeStreams() const { return m_separateStreams; }
+
+    // Store static-path meshes as 16-byte packed vertices (quantized positions,
+    // octahedral normals, half UVs) decoded in the vertex shaders. Takes precedence
+    // over separate attribute streams; streamed primary meshes stay full precision.
+    void setVertexCompression(bool enabled) { m_compressVertices = enabled; }
+    bool isVertexCompression() const { return m_compressVertices; }
+
+    // Sub-allocate static-path meshes (interleaved or packed) from shared per-format
+    // arenas so each mesh list draws with a single VAO bind. Separate attribute
+    // streams and streamed primary meshes keep their own buffers.
+    void setPooledGeometry(bool enabled) { m_pooledGeometry = enabled; }
+    bool isPooledGeometry() const { return m_pooledGeometry; }
+    // Compact the pooled arenas (moves blocks GPU-side; meshes keep their handles)
+    void defragmentGeometry();
+
+    // Submit each pooled mesh list with one glMultiDrawElementsIndirect per arena and
+    // pass (per-draw material/model in an SSBO, SANDBOX_MDI shader variants). Needs
+    // pooled geometry and GL 4.3-level support; otherwise meshes draw one by one.
+    void setIndirectDraw(bool enabled) { m_indirectDraw = enabled; }
+    bool isIndirectDraw() const {
+        return m_indirectDraw && m_pooledGeometry && IndirectBatch::isSupported();
+    }
+
+    // Hand full uploads of new, large static-path meshes (interleaved layout) to a worker
+    // thread with a shared GL context. Such a mesh keeps drawing its previous buffers
+    // until the copy's fence signals, normally by the next frame. Enabling starts the
+    // service on the calling (main) thread's current context.
+    void setAsyncUploads(bool enabled);
+    bool isAsyncUploads() const { return m_asyncUploads && m_uploads.isRunning(); }
+    // Shared upload queue for callers that manage their own buffers (any thread)
+    UploadService& uploadService() { return m_uploads; }
+
+    // Generate normals for sources that leave MeshSource::normals null on the GPU: a
+    // compute pass over the uploaded positions and indices (needs compute shaders and
+    // SSBOs). Packed and pooled meshes, and contexts without compute, fall back to the
+    // SIMD/multithreaded CPU kernel, which is also used whenever this is off.
+    void setGpuNormals(bool enabled) { m_gpuNormals = enabled; }
+    bool isGpuNormals() const;
+
+    // Extra lights are assigned to a view-space froxel grid every frame, and Phong and
+    // SilkPBR shade each fragment with its cluster's lights only. This moves the
+    // assignment from the SIMD/multithreaded CPU path to a compute pass (falls back to
+    // the CPU without compute shaders).
+    void setGpuLightClusters(bool enabled) { m_gpuLightClusters = enabled; }
+    bool isGpuLightClusters() const;
+
+    // Upload new topology in MeshOptimizer order (Tipsify vertex-cache order, then
+    // overdraw-sorted clusters). Only triangle order changes, so vertex arrays, dirty
+    // ranges and the caller's index array are untouched; the reorder runs on topology
+    // changes only. Welding and fetch remapping change vertex order and are left to the
+    // offline API (MeshOptimizer::optimize) for static imports.
+    void setMeshOptimization(bool enabled) { m_optimizeMeshes = enabled; }
+    bool isMeshOptimization() const { return m_optimizeMeshes; }
+
+    // Split meshes of 4096 or more triangles into meshlets (64 vertices / 124 triangles)
+    // whose bounding spheres and normal cones are refit on every position change. Each
+    // pass then culls them against its frustum on the CPU and draws what is left with
+    // one glMultiDrawElementsBaseVertex. Pooled meshes in indirect batches still draw
+    // whole. Toggling re-uploads topology on the next sync; with mesh optimization on,
+    // meshlet order replaces the global reorder.
+    void setMeshletCulling(bool enabled);
+    bool isMeshletCulling() const { return m_meshletCulling; }
+    // Also drop meshlets that face entirely away from the camera. Only correct for
+    // single-sided rendering: with GL_CULL_FACE off (the default) cloth backs are visible.
+    void setMeshletConeCulling(bool enabled) { m_meshletConeCulling = enabled; }
+    bool isMeshletConeCulling() const { return m_meshletConeCulling; }
+    const MeshletStats& meshletStats() const { return m_meshletStats; }
+    void resetMeshletStats() { m_meshletStats = MeshletStats{}; }
+
+    const UploadStats& uploadStats() const { return m_uploadStats; }
+    void resetUploadStats() { m_uploadStats = UploadStats{}; }
+
+    // Item count and state switches of the last scene pass
+    const RenderQueue::Stats& renderQueueStats() const { return m_renderQueue.stats(); }
+    // Pass culling and transient target counters of the last frame
+    const RenderGraph::Stats& renderGraphStats() const { return m_renderGraph.stats(); }
+    // Light assignment counters of the last frame
+    const LightClusters::Stats& lightClusterStats() const { return LightClusters::stats(); }
+
 private:
+    static constexpr size_t MESH_POOL_BUCKETS = 40;
+    static constexpr size_t MAX_POOLED_MESHES = 64;
+    static constexpr int MESHLET_MIN_TRIANGLES = 4096;
+
     std::vector<GpuMesh> m_primaryMeshes;
-    std::vector<GpuMesh> m_genericMeshes;
-    std::vector<glm::vec3> m_genericColors;
+    std::vector<const float*> m_primarySources;   // positions each primary mesh last synced
+    SlotMap<GpuMesh> m_meshes;
+    std::vector<glm::vec3> m_meshColors;           // parallel to m_meshes.values()
+    std::vector<MeshHandle> m_syncedHandles;       // syncMeshes entries, in call order
+    std::vector<const float*> m_syncedSources;
+    SlotMap<InstancedMesh> m_instancedMeshes;
+    InstancedMesh m_gizmoInstances;                // light markers over the particle sphere's buffers
+    // Sphere m_gizmoInstances was built over; held so its buffers (and GL names) stay live
+    std::shared_ptr<const FlockingGraphics::Geometry> m_gizmoGeometry;
+    std::vector<InstanceData> m_gizmoData;
+    // Released meshes keep their VAO/buffers, bucketed by floor(log2(vertex capacity))
+    std::vector<GpuMesh> m_meshPool[MESH_POOL_BUCKETS];
+    size_t m_pooledMeshCount = 0;
+
+    bool m_streamPrimary = false;
+    bool m_separateStreams = false;
+    bool m_compressVertices = false;
+    bool m_pooledGeometry = false;
+    GeometryArena m_interleavedArena;
+    GeometryArena m_packedArena;
+    bool m_indirectDraw = false;
+    IndirectBatch m_primaryBatches[2];   // [0] interleaved arena, [1] packed arena
+    IndirectBatch m_genericBatches[2];
+    StreamRingBuffer m_primaryStream;
+    bool m_asyncUploads = false;
+    UploadService m_uploads;
+    // Buffers dropped while a background copy may still write them; freed once it completes
+    struct RetiredBuffer {
+        UploadService::Ticket ticket;
+        GLuint buffer;
+    };
+    std::vector<RetiredBuffer> m_retiredBuffers;
+    bool m_gpuNormals = false;
+    bool m_gpuLightClusters = false;
+    bool m_normalsDispatched = false;   // compute writes not yet made visible to vertex fetch
+    std::vector<float> m_generatedNormals;
+    std::vector<float> m_zeroNormals;
+    bool m_optimizeMeshes = false;
+    std::vector<uint32_t> m_optimizedIndices;
+    bool m_meshletCulling = false;
+    bool m_meshletConeCulling = false;
+    MeshletStats m_meshletStats;
+    std::mutex m_meshletStatsMutex;
+    UploadStats m_uploadStats;
+    RenderQueue m_renderQueue;
+    std::vector<CommandBuffer> m_shadowCommands;   // one per shadow pass recorded this frame
+    uint64_t m_shadowFrame = 0;                    // frame counter, for untracked shadow casters
+    // Split shadow cache: padded, grid-snapped box the primary meshes are fitted with, kept
+    // while they stay inside so their motion does not move the cached cascades
+    glm::vec3 m_dynamicCasterMin{std::numeric_limits<float>::max()};
+    glm::vec3 m_dynamicCasterMax{-std::numeric_limits<float>::max()};
+    RenderGraph m_renderGraph;
+    // Invoke payload for recordIndirectBatches
+    struct BatchList {
+        const Engine* engine;
+        const IndirectBatch (*batches)[2];
+    };
+    // Camera culling state read by queued mesh draws (pulled back by each mesh's model)
+    glm::mat4 m_viewProj{1.0f};
+    glm::vec3 m_viewEye{0.0f};
 
-    void ensurePrimaryMeshes(size_t count, std::vector<glm::vec3>& meshColors);
-    void ensureGenericMeshes(size_t count);
+    static size_t meshPoolBucket(size_t capacityBytes);
+    GpuMesh acquireGpuMesh(size_t vertexBytes);
+    void recycleGpuMesh(GpuMesh mesh);
+    bool streamPrimaryMeshes(const std::vector<MeshSource>& meshes);
+    void uploadMesh(GpuMesh& mesh, const MeshSource& input);
+    const uint32_t* orderTopology(GpuMesh& mesh, const MeshSource& src);
+    // Thread-safe: recorded from the command-buffer workers
+    void recordMeshCulled(const GpuMesh& mesh, const Meshlets::Frustum& frustum, const glm::vec3* eye,
+                          CommandBuffer& cmd);
+    void recordSceneMesh(const GpuMesh& mesh, CommandBuffer& cmd);
+    // Shadow cache key of a caster set: primary meshes, and/or the auxiliary meshes,
+    // instanced props and sphere. Differs whenever what they rasterize may have changed.
+    uint64_t shadowCasterKey(bool primary, bool statics, SphereObstacle* sphere,
+                             const gfx::RenderSettings& params) const;
+    // World bounds of a caster set (as in shadowCasterKey) that casts into the main
+    // light's cascades; min > max when nothing does
+    void shadowCasterBounds(bool primary, bool statics, SphereObstacle* sphere,
+                            const gfx::RenderSettings& params, glm::vec3& outMin, glm::vec3& outMax) const;
+    // Replays drawIndirectBatches; shadowPass wraps it in the shadow multi-draw program
+    void recordIndirectBatches(CommandBuffer& cmd, const IndirectBatch (&batches)[2], bool shadowPass) const;
+    void uploadMeshInterleaved(GpuMesh& mesh, const MeshSource& src, bool wasStreamed, bool gpuNormals);
+    void uploadMeshStreams(GpuMesh& mesh, const MeshSource& src);
+    void uploadMeshPacked(GpuMesh& mesh, const MeshSource& src);
+    // Move the mesh into the arena of the current vertex format (no-op when already there)
+    void enterArena(GpuMesh& mesh);
+    void uploadMeshPooled(GpuMesh& mesh, const MeshSource& src);
+    // src with generated normals; layoutChanged: the upload path re-uploads every vertex
+    MeshSource withGeneratedNormals(const GpuMesh& mesh, const MeshSource& src, bool onGpu, bool interleaved,
+                                    bool layoutChanged);
+    void generateNormalsGpu(const GpuMesh& mesh, const MeshSource& src);
+    bool uploadMeshAsync(GpuMesh& mesh, const MeshSource& src, bool indexChanged);
+    void cancelAsyncUpload(GpuMesh& mesh);
+    void completeAsyncUploads();
+    void buildIndirectBatches(const std::vector<GpuMesh>& meshes, const std::vector<glm::vec3>& colors,
+                              IndirectBatch (&batches)[2]);
+    void drawIndirectBatches(const IndirectBatch (&batches)[2]) const;
 };
 
 } // namespace gfx
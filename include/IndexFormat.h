@@ -0,0 +1,22 @@
+#pragma once
+/// @file IndexFormat.h
+/// @brief 16-bit index detection and SIMD narrowing for small meshes
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace IndexFormat {
+
+/// True when every index is below 65536, i.e. the list can be stored as uint16_t
+bool fitsUint16(const uint32_t* indices, size_t count);
+
+/// Convert count indices (all < 65536) to uint16_t
+void narrow(uint16_t* dst, const uint32_t* src, size_t count);
+
+/// Narrow into out, padded with a zero to an even count so the buffer size stays a
+/// multiple of 4 bytes (compute passes read 16-bit index buffers as uint pairs).
+/// Returns the byte size to upload.
+size_t narrowPadded(std::vector<uint16_t>& out, const uint32_t* src, size_t count);
+
+} // namespace IndexFormat
@@ -0,0 +1,67 @@
+#pragma once
+/// @file IndirectBatch.h
+/// @brief Multi-draw-indirect batch: one glMultiDrawElementsIndirect per mesh list
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace gfx {
+
+/// Layout fixed by the GL spec for glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/// Per-draw data read by the SANDBOX_MDI shader variants (std430 DrawData, binding 0)
+struct BatchDrawData {
+    glm::mat4 model{1.0f};
+    glm::mat4 normalModel{1.0f};           // inverse-transpose of model
+    glm::vec4 ambient{0.0f};
+    glm::vec4 diffuse{0.0f};
+    glm::vec4 specular{0.0f};
+    glm::vec4 params{0.0f};                // rgb: subsurface colour, a: shininess
+    glm::vec4 posScale{1.0f, 1.0f, 1.0f, 0.0f};  // packed decode; w = 1 for octahedral normals
+    glm::vec4 posBias{0.0f};
+};
+static_assert(sizeof(BatchDrawData) == 224, "BatchDrawData must match the std430 DrawData layout");
+
+/// Collects draws that share one VAO and index buffer, then submits them in one call.
+/// The command buffer and draw-data SSBO are re-specified (orphaned) on every upload().
+class IndirectBatch {
+public:
+    static constexpr GLuint DRAW_DATA_BINDING = 0;
+
+    /// Needs ARB_multi_draw_indirect, ARB_shader_draw_parameters and SSBOs
+    static bool isSupported();
+
+    IndirectBatch() = default;
+    ~IndirectBatch();
+    IndirectBatch(const IndirectBatch&) = delete;
+    IndirectBatch& operator=(const IndirectBatch&) = delete;
+
+    void clear();
+    /// indexCount/firstIndex are in indices, baseVertex in vertices
+    void add(GLuint indexCount, GLuint firstIndex, GLint baseVertex, const BatchDrawData& data);
+    /// Copy commands and draw data to the GPU; call once after the last add()
+    void upload();
+    /// Bind the draw-data SSBO and issue the multi-draw with the given VAO
+    void draw(GLuint vao) const;
+    void destroy();
+
+    size_t size() const { return m_commands.size(); }
+    bool empty() const { return m_commands.empty(); }
+
+private:
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<BatchDrawData> m_drawData;
+    GLuint m_commandBuffer = 0;
+    GLuint m_drawDataBuffer = 0;
+    size_t m_uploadedCount = 0;
+};
+
+} // namespace gfx
@@ -0,0 +1,63 @@
+#pragma once
+/// @file LightClusters.h
+/// @brief Clustered forward lighting: extra lights are assigned to a view-space froxel
+/// grid (SIMD/multithreaded CPU path or compute-shader path), and the lit shaders loop
+/// only over the lights listed for their fragment's cluster
+
+#include <RenderSettings.h>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace LightClusters {
+
+/// Screen tiles across and down, and depth slices (logarithmic between near and far)
+constexpr int CLUSTERS_X = 16;
+constexpr int CLUSTERS_Y = 9;
+constexpr int CLUSTERS_Z = 24;
+constexpr int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+/// Lights listed per cluster at most; further lights reaching it are dropped
+constexpr int MAX_LIGHTS_PER_CLUSTER = 128;
+
+/// SSBO bindings of ClusterLightBuffer, ClusterGridBuffer and ClusterIndexBuffer in the
+/// lit shaders (after IndirectBatch's per-draw data at 0)
+constexpr GLuint LIGHT_BINDING = 6;
+constexpr GLuint GRID_BINDING = 7;
+constexpr GLuint INDEX_BINDING = 8;
+
+/// Counters of the last update()
+struct Stats {
+    int lights = 0;            ///< enabled extra lights
+    int listedLights = 0;      ///< cluster list entries (CPU path only)
+    int occupiedClusters = 0;  ///< clusters with at least one light (CPU path only)
+    int maxPerCluster = 0;     ///< longest list (CPU path only)
+    bool gpu = false;
+};
+
+/// True when the context has SSBOs; the lit shaders use the cluster lists exactly then
+/// and fall back to the first FRAME_EXTRA_LIGHTS frame block lights otherwise
+bool isSupported();
+
+/// True when compute shaders are available and the assignment shader built (compiled
+/// on first call)
+bool gpuAvailable();
+
+/// Assign the enabled lights to the clusters of this view and bind the three buffers.
+/// width and height are the viewport in pixels. useGpu selects the compute path when
+/// gpuAvailable(); otherwise the grid is built on the CPU and uploaded. GL thread only.
+void update(const std::vector<gfx::ExtraLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+            float nearPlane, float farPlane, int width, int height, bool useGpu);
+
+/// The CPU assignment alone, without GL: ranges gets an (offset, count) pair per
+/// cluster into indices, whose entries index the enabled lights (enabled, range > 0) in
+/// input order. Cluster (x, y, z) is entry (z * CLUSTERS_Y + y) * CLUSTERS_X + x, with x
+/// and y the NDC tile and z the depth slice. Not thread-safe with update().
+void assign(const std::vector<gfx::ExtraLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+            float nearPlane, float farPlane, std::vector<uint32_t>& ranges, std::vector<uint32_t>& indices);
+
+const Stats& stats();
+
+void cleanup();
+
+} // namespace LightClusters
@@ -0,0 +1,86 @@
+#pragma once
+/// @file MeshOptimizer.h
+/// @brief Offline index/vertex reordering: vertex-cache (Tipsify), overdraw clusters,
+/// fetch remapping and welding of duplicate vertices
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MeshOptimizer {
+
+/// Post-transform cache size the reorder targets; 16 is a safe lower bound for
+/// current GPUs (larger real caches only hit more often)
+constexpr unsigned kCacheSize = 16;
+
+/// remap entry of a vertex no triangle references
+constexpr uint32_t kUnused = 0xFFFFFFFFu;
+
+/// One float attribute array: vertex i is data[i * stride .. i * stride + components)
+struct AttributeStream {
+    const float* data = nullptr;
+    size_t components = 3;
+    size_t stride = 3;
+};
+
+/// Results of simulating a FIFO post-transform cache
+struct VertexCacheStats {
+    size_t transformed = 0;   ///< vertex shader invocations
+    float acmr = 0.0f;        ///< average cache miss ratio: transformed / triangles (0.5 .. 3)
+    float atvr = 0.0f;        ///< transformed / referenced vertices (1 is optimal)
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned cacheSize = kCacheSize);
+
+/// Tipsify (Sander et al. 2007): reorder triangles so consecutive ones reuse cached
+/// vertices. Linear time. dst may not alias indices.
+void optimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         unsigned cacheSize = kCacheSize);
+
+/// Reorder the clusters of a cache-optimized list so outward-facing, outer ones draw
+/// first and occlude the rest. A cluster ends where the cache restarts (a triangle
+/// with three misses), so the ACMR is kept. positions use stride floats per vertex.
+/// dst may not alias indices.
+void optimizeOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                      const float* positions, size_t vertexCount, size_t positionStride = 3,
+                      unsigned cacheSize = kCacheSize);
+
+/// Both of the above: the triangle order the engine uploads for optimized meshes
+void optimizeIndexOrder(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                        const float* positions, size_t vertexCount, size_t positionStride = 3);
+
+/// Map vertices with bitwise identical attributes to one index, numbered in order of
+/// first occurrence. Returns the unique vertex count.
+size_t generateWeldRemap(uint32_t* remap, const AttributeStream* streams, size_t streamCount,
+                         size_t vertexCount);
+
+/// Number vertices in order of first use by the index list, so vertex fetch walks
+/// memory forward. Unreferenced vertices map to kUnused. Returns the used vertex count.
+size_t generateFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+/// dst[i] = remap[indices[i]]; dst may alias indices
+void remapIndices(uint32_t* dst, const uint32_t* indices, size_t indexCount, const uint32_t* remap);
+
+/// Scatter vertex i of src to slot remap[i] of dst (components floats each); skips
+/// kUnused. dst may not alias src.
+void remapVertices(float* dst, const float* src, size_t vertexCount, size_t components,
+                   const uint32_t* remap);
+
+/// Separate-array mesh in MeshSource layout (normals/uvs may be empty)
+struct Mesh {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> uvs;
+    std::vector<uint32_t> indices;
+};
+
+/// Full pipeline: weld, vertex-cache order, overdraw order, fetch remap. Vertex order
+/// changes, so only run it on geometry whose arrays are not edited by index afterwards.
+void optimize(Mesh& mesh);
+
+/// The same pipeline for an interleaved array with floatsPerVertex floats per vertex
+/// and the position in the first three
+void optimizeInterleaved(std::vector<float>& vertices, size_t floatsPerVertex, std::vector<uint32_t>& indices);
+
+} // namespace MeshOptimizer
@@ -0,0 +1,72 @@
+#pragma once
+/// @file Meshlets.h
+/// @brief Meshlet clustering with bounding spheres and normal cones for CPU culling
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Meshlets {
+
+constexpr uint32_t kMaxVertices = 64;
+constexpr uint32_t kMaxTriangles = 124;
+
+/// A run of triangles in the meshlet-ordered index list plus the unique vertices they use
+struct Meshlet {
+    uint32_t firstIndex = 0;
+    uint32_t triangleCount = 0;
+    uint32_t firstVertex = 0;      ///< into ClusterSet::vertices
+    uint32_t vertexCount = 0;      ///< 0 for the trailing run of out-of-range triangles (never culled)
+    uint32_t firstTriangle = 0;    ///< into ClusterSet::triangles, 3 entries per triangle
+};
+
+/// Culling volume of one meshlet. Every triangle normal lies within the cone's half angle
+/// of coneAxis; coneCos <= 0 disables the backface test (normals spread 90 degrees or more).
+struct Bounds {
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+    glm::vec3 coneAxis{0.0f, 0.0f, 1.0f};
+    float coneCos = -1.0f;
+    float coneSin = 0.0f;
+};
+
+struct ClusterSet {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;   ///< each meshlet's vertex indices, back to back
+    std::vector<uint8_t> triangles;   ///< corners as offsets into the meshlet's vertices (for refit)
+    std::vector<Bounds> bounds;       ///< parallel to meshlets
+    // Positions the bounds were last fitted to (see refit)
+    const float* sourcePositions = nullptr;
+    uint64_t positionsVersion = 0;
+
+    bool empty() const { return meshlets.empty(); }
+    void clear();
+};
+
+/// Group triangles into meshlets of at most kMaxVertices / kMaxTriangles, growing each
+/// from its neighbours so clusters stay compact. Writes the index list in meshlet order
+/// to ordered (indexCount entries, may not alias indices); bounds are left for refit.
+void build(ClusterSet& set, uint32_t* ordered, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+/// Refit every meshlet's sphere and cone to positions. Skipped when the same positions
+/// array and a nonzero unchanged version were fitted last time. Large sets run in parallel.
+void refit(ClusterSet& set, const float* positions, size_t vertexCount, uint64_t positionsVersion);
+
+/// Normalized planes (xyz normal pointing inside, w distance) of a view-projection matrix
+struct Frustum {
+    glm::vec4 planes[6];
+};
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+struct IndexRange {
+    uint32_t firstIndex = 0;
+    uint32_t count = 0;
+};
+
+/// Append the index ranges of meshlets that intersect the frustum and, when eye is set,
+/// are not entirely back-facing from it. Neighbouring visible meshlets merge into one
+/// range. Returns the number of triangles kept.
+size_t cull(const ClusterSet& set, const Frustum& frustum, const glm::vec3* eye, std::vector<IndexRange>& out);
+
+} // namespace Meshlets
@@ -0,0 +1,20 @@
+#pragma once
+/// @file ParallelFor.h
+/// @brief Small persistent worker pool for splitting CPU-side mesh work into ranges
+
+#include <functional>
+
+namespace Parallel {
+
+/// Number of background workers (the calling thread also takes chunks)
+int workerCount();
+
+/// Run fn(begin, end) over [0, count) in chunks of at least minChunk items.
+/// Runs inline when the range is small or no workers are available. Blocks until
+/// every chunk has finished. Not reentrant: do not call from inside fn.
+void forRange(int count, int minChunk, const std::function<void(int, int)>& fn);
+
+/// Stop and join the workers (restarted lazily by the next forRange)
+void shutdown();
+
+} // namespace Parallel
@@ -0,0 +1,39 @@
+#pragma once
+/// @file RadixSort.h
+/// @brief Stable LSD radix sort of entries by a 64-bit key
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+/// Sort entries (any type with a uint64_t `key` member) ascending by key on 8-bit
+/// digits. Stable, so equal keys keep their input order. Digits shared by every key
+/// (e.g. unused high bits) cost one counting pass and no scatter. scratch is only
+/// working space and can be kept across calls to avoid reallocating.
+template <typename Entry>
+void radixSortByKey(std::vector<Entry>& entries, std::vector<Entry>& scratch) {
+    const size_t count = entries.size();
+    if (count < 2) return;
+    scratch.resize(count);
+    Entry* src = entries.data();
+    Entry* dst = scratch.data();
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (size_t i = 0; i < count; ++i) ++offsets[(src[i].key >> shift) & 0xff];
+        if (offsets[(src[0].key >> shift) & 0xff] == count) continue;
+        size_t total = 0;
+        for (size_t& offset : offsets) {
+            const size_t n = offset;
+            offset = total;
+            total += n;
+        }
+        for (size_t i = 0; i < count; ++i) dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+        std::swap(src, dst);
+    }
+    if (src != entries.data()) entries.swap(scratch);
+}
+
+} // namespace gfx
@@ -0,0 +1,184 @@
+#pragma once
+/// @file RenderGraph.h
+/// @brief Per-frame pass graph: passes declare the targets they read and write, the graph
+/// culls passes whose results nobody consumes, places transient targets in pooled
+/// textures (targets with disjoint lifetimes share one), binds framebuffers and issues
+/// the memory barriers the declared accesses need.
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace gfx {
+
+/// Transient 2D target or 2D array. width, height, format and layers decide which
+/// textures can be shared; sampling state is reapplied whenever a texture changes hands.
+struct TextureDesc {
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLenum format = GL_RGBA8;        ///< sized internal format
+    GLsizei layers = 0;              ///< 0: GL_TEXTURE_2D, otherwise a GL_TEXTURE_2D_ARRAY of this many layers
+    GLenum filter = GL_NEAREST;
+    GLenum wrap = GL_CLAMP_TO_EDGE;  ///< GL_CLAMP_TO_BORDER uses a white border
+    bool depthCompare = false;       ///< GL_COMPARE_REF_TO_TEXTURE with GL_LEQUAL (shadow samplers)
+};
+
+class RenderGraph {
+public:
+    using Resource = int;
+    static constexpr Resource kNone = -1;
+
+    /// Declares a pass's resources; only valid inside the setup callback of addPass
+    class Builder {
+    public:
+        /// Sampled by the pass
+        void read(Resource resource);
+        /// Rendered to: colour formats become colour attachments in call order, depth
+        /// formats the depth attachment. The backbuffer can only be written alone.
+        /// Arrays are attached layered: geometry picks its layer through gl_Layer.
+        void write(Resource resource);
+        /// Rendered to, one layer of an array target only
+        void writeLayer(Resource resource, int layer);
+        /// Written with image stores; later readers get a memory barrier
+        void writeStorage(Resource resource);
+
+    private:
+        friend class RenderGraph;
+        Builder(RenderGraph& graph, size_t pass) : m_graph(graph), m_pass(pass) {}
+        RenderGraph& m_graph;
+        size_t m_pass;
+    };
+
+    using SetupFn = std::function<void(Builder&)>;
+    /// Runs on the GL thread with the pass's framebuffer bound and the viewport set;
+    /// texture() resolves the declared resources
+    using ExecuteFn = std::function<void(const RenderGraph&)>;
+
+    struct Stats {
+        int passes = 0;
+        int culledPasses = 0;
+        int transientTargets = 0;
+        int textures = 0;          ///< pooled textures alive after the frame
+        int aliasedTargets = 0;    ///< targets placed in a texture another target used earlier this frame
+        int barriers = 0;
+        size_t textureBytes = 0;   ///< memory held by the pool
+    };
+
+    RenderGraph() = default;
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+    ~RenderGraph() = default;   // GL objects need a context: call destroy()
+
+    /// Default framebuffer size, for passes that write the backbuffer
+    void setBackbufferSize(GLsizei width, GLsizei height);
+    GLsizei backbufferWidth() const { return m_backbufferWidth; }
+    GLsizei backbufferHeight() const { return m_backbufferHeight; }
+
+    /// Drop last frame's passes and resources
+    void reset();
+    /// The default framebuffer; passes that write it are never culled
+    Resource backbuffer() const { return m_backbuffer; }
+    /// Declare a transient target for this frame. It gets a texture only if a surviving
+    /// pass uses it, and its contents are undefined until a pass writes it.
+    Resource createTexture(const char* name, const TextureDesc& desc);
+    /// Use a texture the caller owns and keeps across frames (e.g. a cache). Its contents
+    /// persist, so passes may read it without any pass writing it this frame. The graph
+    /// neither pools nor resamples it: desc only describes it. Call forgetTexture before
+    /// deleting it.
+    Resource importTexture(const char* name, GLuint texture, const TextureDesc& desc);
+
+    void addPass(const char* name, const SetupFn& setup, ExecuteFn execute);
+
+    /// Cull, compute lifetimes and place transient targets; false on an invalid graph
+    bool compile();
+    /// Run the surviving passes in the order they were added. Leaves the default
+    /// framebuffer bound.
+    void execute();
+
+    /// GL texture of a resource during execute()
+    GLuint texture(Resource resource) const;
+
+    /// Drop the cached framebuffers that attach an imported texture about to be deleted
+    void forgetTexture(GLuint texture);
+
+    /// Free the pooled textures and framebuffers
+    void destroy();
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    enum Access : uint8_t { Read, Attachment, Storage };
+
+    struct Use {
+        Resource resource;
+        Access access;
+        int layer = -1;            ///< attached layer of an array target, -1 for all
+    };
+    struct Pass {
+        std::string name;
+        std::vector<Use> uses;
+        ExecuteFn execute;
+        bool alive = false;
+        bool writesBackbuffer = false;
+        GLuint framebuffer = 0;
+        GLbitfield barrier = 0;
+    };
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        int firstPass = -1;
+        int lastPass = -1;
+        int texture = -1;          ///< index into m_textures
+        GLuint imported = 0;       ///< caller-owned texture, never placed in the pool
+        bool needed = false;
+        bool storageWritten = false;
+    };
+    struct PooledTexture {
+        GLuint name = 0;
+        GLsizei width = 0;
+        GLsizei height = 0;
+        GLenum format = 0;
+        GLsizei layers = 0;
+        int busyUntil = -1;        ///< last pass of the target placed in it this frame
+        bool usedThisFrame = false;
+        int idleFrames = 0;
+        // Sampling state last applied, so handing over to an equal target costs nothing
+        GLenum filter = 0;
+        GLenum wrap = 0;
+        bool depthCompare = false;
+    };
+    struct AttachmentSlot {
+        GLuint texture = 0;
+        int layer = -1;            ///< attached layer of an array, -1 for all
+        bool array = false;
+        GLenum format = 0;
+    };
+    struct CachedFramebuffer {
+        GLuint name = 0;
+        AttachmentSlot attachments[5];///< colour 0..3, then depth
+        bool usedThisFrame = false;
+        int idleFrames = 0;
+    };
+
+    void use(size_t pass, Resource resource, Access access, int layer = -1);
+    int acquireTexture(const TextureDesc& desc, int firstPass, int lastPass);
+    GLuint acquireFramebuffer(const AttachmentSlot (&attachments)[5]);
+    void releaseFramebuffersOf(GLuint texture);
+    void applySampling(PooledTexture& texture, const TextureDesc& desc);
+    void releaseIdle();
+
+    std::vector<Pass> m_passes;
+    std::vector<ResourceNode> m_resources;
+    std::vector<PooledTexture> m_textures;
+    std::vector<CachedFramebuffer> m_framebuffers;
+    Resource m_backbuffer = kNone;
+    GLsizei m_backbufferWidth = 0;
+    GLsizei m_backbufferHeight = 0;
+    bool m_compiled = false;
+    Stats m_stats;
+};
+
+} // namespace gfx
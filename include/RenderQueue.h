@@ -0,0 +1,84 @@
+#pragma once
+/// @file RenderQueue.h
+/// @brief Sort-key render queue: draws are submitted in any order, radix-sorted by a
+/// 64-bit key and issued with state changes only between items that differ
+
+#include <CommandBuffer.h>
+#include <ShaderLib.h>
+#include <UniformBlocks.h>
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace gfx {
+
+/// Key layout, most significant first:
+///   63..60  pass
+///   59..48  program (GL name, low 12 bits)
+///   47..44  state (frame variant, wireframe)
+///   43..20  view depth, front to back
+///   19..0   material hash
+/// Depth sits above material: materials live in the per-draw block, which is committed
+/// for every draw anyway, while front-to-back order lets early-Z reject hidden fragments.
+class RenderQueue {
+public:
+    enum Pass : uint8_t {
+        Opaque = 0,
+        Gizmo = 1,   ///< light markers, lit by the gizmo frame variant
+    };
+
+    /// Records the draw call(s) after the program, frame, polygon mode and draw block.
+    /// Runs on a worker thread: record only, no GL calls.
+    using DrawFn = std::function<void(CommandBuffer&)>;
+
+    struct Stats {
+        size_t items = 0;
+        size_t programChanges = 0;
+        size_t stateChanges = 0;   ///< frame variant or polygon mode switches
+        size_t commandBytes = 0;
+        int recordChunks = 0;      ///< command buffers recorded in parallel
+    };
+
+    /// Drop last frame's items; depth is measured along view and normalised by farPlane
+    void begin(const glm::mat4& view, float farPlane);
+
+    /// Queue a draw with a snapshot of the staged draw block (UniformBlocks::draw())
+    void submit(Pass pass, ShaderLib::ProgramWrapper* program, const glm::vec3& worldCenter, DrawFn draw,
+                GLenum polygonMode = GL_FILL, UniformBlocks::FrameSlot frame = UniformBlocks::SceneFrame);
+
+    /// Sort, record the items into per-thread command buffers and replay them in order
+    /// on the calling (GL) thread. Leaves GL_FILL and the scene frame bound.
+    void execute();
+
+    size_t size() const { return m_items.size(); }
+    /// Counters of the last execute()
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Item {
+        ShaderLib::ProgramWrapper* program;
+        GLenum polygonMode;
+        UniformBlocks::FrameSlot frame;
+        FlockingShaders::DrawBlock block;
+        DrawFn draw;
+    };
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    void record(size_t first, size_t last, CommandBuffer& out) const;
+
+    std::vector<Item> m_items;
+    std::vector<SortEntry> m_entries;
+    std::vector<SortEntry> m_scratch;
+    std::vector<CommandBuffer> m_buffers;
+    glm::mat4 m_view{1.0f};
+    float m_invFar = 0.0f;
+    Stats m_stats;
+};
+
+} // namespace gfx
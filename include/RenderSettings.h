@@ -10,6 +10,7 @@ struct ExtraLight {
     float position[3] = {0.0f, 0.0f, 0.0f};
     float diffuse[3] = {1.0f, 1.0f, 1.0f};
     float intensity = 1.0f;
+    float range = 100.0f;   // world units; the light fades to nothing here and is culled beyond
 };
 
 struct RenderSettings {
@@ -55,6 +56,12 @@ struct RenderSettings {
     bool shadowEnabled = true;
     float shadowBias = 0.005f;
     float shadowSoftness = 2.0f;
+    bool shadowLayered = true;     // all shadow lights in one layered pass
+    int shadowCascades = 4;        // main light cascades (1-4)
+    float shadowSplitLambda = 0.75f; // cascade splits: 0 uniform, 1 logarithmic
+    float shadowDistance = 200.0f; // view distance the cascades cover
+    bool shadowCaching = true;     // redraw a light's map only when it or its casters change
+    bool shadowDynamicSplit = false; // cloth in a per-frame layer beside the cached casters
 
     // SSAO
     bool ssaoEnabled = true;
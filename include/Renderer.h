@@ -15,7 +15,7 @@ class TransformStack;
 namespace FlockingGraphics {
     struct Geometry;
 }
-namespace gfx { struct RenderSettings; }
+namespace gfx { struct RenderSettings; class RenderQueue; }
 
 // --- Scene rendering ---
 namespace Renderer {
@@ -34,15 +34,16 @@ struct ClothRenderData {
 // Initialize OpenGL state
 void initGL();
 
-// Setup shader uniforms for lighting (and shadows)
+// Fill and upload the frame uniform block (camera, lights, shadows, fabric) and bind
+// the shadow maps; once per frame, after the shadow passes
 void setupLighting(Camera* camera, const gfx::RenderSettings& settings);
 
-// Load model/view/projection matrices to shader
+// Stage the model/view/projection matrices in the draw block and commit it
 void loadMatricesToShader(const TransformStack& stack, Camera* camera);
 void loadMatricesToShader(const std::string& shaderName, const TransformStack& stack, Camera* camera);
 
-// Render only floor and sphere (cloth is rendered by main.cpp using cloth:: API)
-void renderFloorAndSphere(Floor* floor, SphereObstacle* sphere,
+// Queue the floor and sphere (meshes are queued by gfx::Engine::renderScene)
+void submitFloorAndSphere(gfx::RenderQueue& queue, Floor* floor, SphereObstacle* sphere,
                           Camera* camera, TransformStack& transformStack,
                           const gfx::RenderSettings& settings);
 
@@ -2,6 +2,8 @@
 /// @file SSAORenderer.h
 /// @brief Screen-Space Ambient Occlusion post-process renderer
 
+#include <RenderGraph.h>
+
 class Camera;
 
 namespace SSAO {
@@ -12,17 +14,17 @@ bool init(int width, int height);
 /// Cleanup SSAO resources
 void cleanup();
 
-/// Resize framebuffers when window size changes
+/// Set the size of the scene and occlusion targets when window size changes
 void resize(int width, int height);
 
-/// Begin scene rendering (binds scene FBO)
-void beginScenePass();
-
-/// End scene rendering and run SSAO
-void endScenePass();
+/// Render graph targets the scene pass draws into when SSAO is enabled
+gfx::TextureDesc sceneColorDesc();
+gfx::TextureDesc sceneDepthDesc();
 
-/// Render final composite to screen
-void renderComposite(Camera* camera);
+/// Add the occlusion, blur and composite passes: read the scene targets and write the
+/// composited image to output
+void addPasses(gfx::RenderGraph& graph, Camera* camera, gfx::RenderGraph::Resource sceneColor,
+               gfx::RenderGraph::Resource sceneDepth, gfx::RenderGraph::Resource output);
 
 /// Set SSAO parameters
 void setRadius(float radius);
@@ -30,7 +32,7 @@ void setBias(float bias);
 void setIntensity(float intensity);
 void setEnabled(bool enabled);
 
-/// Get current state
+/// Get current state (isEnabled is false until init succeeds)
 bool isEnabled();
 float getRadius();
 float getBias();
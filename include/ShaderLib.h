@@ -1,10 +1,12 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <memory>
 #include <set>
+#include <vector>
 
 class ShaderLib {
 public:
@@ -26,19 +28,73 @@ public:
     void createShaderProgram(const std::string& name);
     void attachShader(const std::string& name, int type);
     void loadShaderSource(const std::string& name, const std::string& filename);
+    /// Load a source and insert preprocessor defines right after its #version line
+    void loadShaderSource(const std::string& name, const std::string& filename, const std::string& defines);
+    
+    /**
+     * @brief Insert lines (e.g. "#define SANDBOX_MDI 1\n") after the #version directive
+     * @return The patched source (unchanged when defines is empty)
+     */
+    static std::string injectDefines(const std::string& source, const std::string& defines);
     void compileShader(const std::string& name);
     void attachShaderToProgram(const std::string& program, const std::string& shader);
     void bindAttribute(const std::string& program, int index, const std::string& name);
     void linkProgramObject(const std::string& name);
     void use(const std::string& name);
     
+    /// FNV-1a hash of a uniform name, usable at compile time
+    static constexpr uint32_t hashUniformName(const char* name) {
+        uint32_t hash = 2166136261u;
+        for (; *name; ++name) hash = (hash ^ static_cast<uint8_t>(*name)) * 16777619u;
+        return hash;
+    }
+
+    /// Value layouts a uniform can be set with (samplers and bools use Int)
+    enum class UniformKind : uint8_t { Float, Vec2, Vec3, Vec4, Mat3, Mat4, Int, UInt };
+
+    template <typename T> struct UniformTraits;
+
+    /**
+     * @brief Typed uniform handle: the name is hashed when the handle is constructed,
+     * so a constexpr handle costs nothing per set. Array uniforms are addressed by
+     * their base name ("lightSpaceMatrices") plus an element index.
+     */
+    template <typename T>
+    struct Uniform {
+        constexpr explicit Uniform(const char* uniformName)
+            : name(uniformName), hash(hashUniformName(uniformName)) {}
+        using ValueType = T;
+        const char* name;
+        uint32_t hash;
+    };
+
+    /// Uniform upload counters across all programs since the last reset
+    struct UniformStats {
+        uint64_t uploads = 0;     ///< glUniform* calls issued
+        uint64_t skipped = 0;     ///< sets dropped because the program already held the value
+        uint64_t unresolved = 0;  ///< sets of names the program does not use (or of the wrong type)
+    };
+    static const UniformStats& uniformStats();
+    static void resetUniformStats();
+
     /**
      * @brief Wrapper class for shader programs to provide operator[] access
+     *
+     * After linking, reflect() reads every active uniform with glGetActiveUniform into
+     * a table keyed by name hash, with a copy of each value. Setters look names up in
+     * that table instead of calling glGetUniformLocation, and skip the upload when the
+     * value equals the copy. Uniforms must only be changed through the wrapper (or
+     * invalidateUniforms() called afterwards), and the program must be current.
      */
     class ProgramWrapper {
     public:
         explicit ProgramWrapper(unsigned int programId);
         void use();
+
+        /// Rebuild the uniform table from the linked program
+        void reflect();
+        /// Forget the value copies so the next set of each uniform uploads
+        void invalidateUniforms();
         
         // Uniform setters
         void setUniform(const std::string& name, const glm::mat4& value);
@@ -47,12 +103,46 @@ public:
         void setUniform(const std::string& name, const glm::vec3& value);
         void setUniform(const std::string& name, float value);
         void setUniform(const std::string& name, int value);
+
+        /// Set element index of a uniform (0 for non-arrays)
+        template <typename T>
+        void set(const Uniform<T>& uniform, const typename Uniform<T>::ValueType& value, int index = 0) {
+            store(uniform.hash, UniformTraits<T>::kind, &value, index, 1);
+        }
+        /// Set count consecutive array elements starting at first
+        template <typename T>
+        void setArray(const Uniform<T>& uniform, const typename Uniform<T>::ValueType* values, int count,
+                      int first = 0) {
+            store(uniform.hash, UniformTraits<T>::kind, values, first, count);
+        }
+        /// Whether the linked program uses the uniform
+        template <typename T>
+        bool has(const Uniform<T>& uniform) const { return find(uniform.hash) != nullptr; }
         
         unsigned int getProgramId() const { return m_programId; }
         
     private:
+        // One array element (or plain uniform) and the value the program holds
+        struct Slot {
+            int location = -1;
+            bool known = false;
+            float value[16] = {};
+        };
+        // Name hash -> run of slots; array elements also get their own "name[i]" entry
+        struct Entry {
+            uint32_t hash = 0;
+            uint32_t firstSlot = 0;
+            uint32_t count = 0;
+            UniformKind kind = UniformKind::Float;
+            mutable bool warned = false;
+        };
+
         unsigned int m_programId;
-        int getUniformLocation(const std::string& name);
+        std::vector<Entry> m_entries;  // sorted by hash
+        std::vector<Slot> m_slots;
+
+        const Entry* find(uint32_t hash) const;
+        void store(uint32_t hash, UniformKind kind, const void* data, int first, int count);
     };
     
     /**
@@ -115,5 +205,19 @@ private:
     unsigned int glShaderType(int type);
     bool checkShaderCompilation(unsigned int shaderId, const std::string& name);
     bool checkProgramLinking(unsigned int programId, const std::string& name);
+    /// Read a shader and expand its includes
     bool loadShaderFromFile(const std::string& filename, std::string& source);
+    bool readShaderFile(const std::string& filename, std::string& source);
+    /// Replace each `#include "file"` line with that file's source (searched like the
+    /// shaders themselves), so declarations shared by several shaders have one copy
+    bool expandIncludes(std::string& source, const std::string& filename, int depth);
 };
+
+template <> struct ShaderLib::UniformTraits<float> { static constexpr UniformKind kind = UniformKind::Float; };
+template <> struct ShaderLib::UniformTraits<glm::vec2> { static constexpr UniformKind kind = UniformKind::Vec2; };
+template <> struct ShaderLib::UniformTraits<glm::vec3> { static constexpr UniformKind kind = UniformKind::Vec3; };
+template <> struct ShaderLib::UniformTraits<glm::vec4> { static constexpr UniformKind kind = UniformKind::Vec4; };
+template <> struct ShaderLib::UniformTraits<glm::mat3> { static constexpr UniformKind kind = UniformKind::Mat3; };
+template <> struct ShaderLib::UniformTraits<glm::mat4> { static constexpr UniformKind kind = UniformKind::Mat4; };
+template <> struct ShaderLib::UniformTraits<int> { static constexpr UniformKind kind = UniformKind::Int; };
+template <> struct ShaderLib::UniformTraits<unsigned int> { static constexpr UniformKind kind = UniformKind::UInt; };
@@ -0,0 +1,40 @@
+#pragma once
+/// @file ShaderUniforms.h
+/// @brief Typed uniform handles for the loose (non-block) uniforms still set from C++:
+/// the Shadow programs and the Lighting:: setters for caller-owned programs. Phong, Silk
+/// and SilkPBR read their data from the uniform blocks in UniformBlocks.h.
+/// Hashed at compile time; see ShaderLib::ProgramWrapper::set.
+
+#include <ShaderLib.h>
+
+namespace Uniforms {
+
+template <typename T>
+using Handle = ShaderLib::Uniform<T>;
+
+// Shadow.vs transform and packed-vertex decode
+inline constexpr Handle<glm::mat4> kModel{"model"};
+inline constexpr Handle<glm::vec3> kPosDequantScale{"posDequantScale"};
+inline constexpr Handle<glm::vec3> kPosDequantBias{"posDequantBias"};
+
+// Main light (Lighting::setLightUniforms)
+inline constexpr Handle<glm::vec4> kLightPosition{"light.position"};
+inline constexpr Handle<glm::vec4> kLightAmbient{"light.ambient"};
+inline constexpr Handle<glm::vec4> kLightDiffuse{"light.diffuse"};
+inline constexpr Handle<glm::vec4> kLightSpecular{"light.specular"};
+inline constexpr Handle<float> kLightConstantAttenuation{"light.constantAttenuation"};
+inline constexpr Handle<float> kLightLinearAttenuation{"light.linearAttenuation"};
+inline constexpr Handle<float> kLightQuadraticAttenuation{"light.quadraticAttenuation"};
+
+// Shadows (Lighting::setShadowUniforms, Shadow.vs)
+inline constexpr Handle<int> kShadowEnabled{"shadowEnabled"};
+inline constexpr Handle<float> kShadowBias{"shadowBias"};
+inline constexpr Handle<float> kShadowSoftness{"shadowSoftness"};
+inline constexpr Handle<float> kShadowMapSize{"shadowMapSize"};
+inline constexpr Handle<float> kShadowStrength{"shadowStrength"};
+inline constexpr Handle<glm::mat4> kLightSpaceMatrix{"lightSpaceMatrix"};
+inline constexpr Handle<glm::mat4> kLightSpaceMatrices{"lightSpaceMatrices"};  // [MAX_SHADOW_LAYERS], layered pass
+inline constexpr Handle<int> kShadowMaps{"shadowMaps"};                   // array texture, a layer per light
+inline constexpr Handle<int> kShadowLayerCount{"shadowLayerCount"};       // Shadow.vs, layered variant
+
+} // namespace Uniforms
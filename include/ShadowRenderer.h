@@ -2,7 +2,9 @@
 /// @file ShadowRenderer.h
 /// @brief Shadow mapping renderer for directional/point light shadows with multi-light support
 
+#include <RenderGraph.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 
 class Camera;
 class Light;
@@ -11,24 +13,119 @@ namespace Shadow {
 
 /// Maximum number of shadow-casting lights
 constexpr int MAX_SHADOW_LIGHTS = 4;
+/// Maximum number of cascades the main light's shadow is split into
+constexpr int MAX_CASCADES = 4;
+/// Shadow map array layers: the main light's cascades, then one per extra shadow light
+constexpr int MAX_SHADOW_LAYERS = MAX_CASCADES + MAX_SHADOW_LIGHTS - 1;
 
 /// Initialize shadow system
-bool init(int shadowMapSize = 4096);
+bool init(int shadowMapSize = 2048);
 
 /// Cleanup shadow resources
 void cleanup();
 
-/// Begin shadow pass for a specific light index
-void beginShadowPass(int lightIndex, Light* light, const glm::vec3& sceneCenter, float sceneRadius);
+/// Compute and store the light space matrix of a shadow light without touching GL, so
+/// casters can be culled and recorded before the pass begins. lightIndex is the layer
+/// of the shadow map array the light renders to.
+void setupShadowLight(int lightIndex, Light* light, const glm::vec3& sceneCenter, float sceneRadius);
 
-/// End shadow pass
+/// Cascaded shadow maps for the main light, shining from light towards target: the view
+/// range up to getCascadeDistance() is split into getCascadeCount() slices (practical
+/// split), and each slice gets an orthographic projection fitted to its bounding sphere,
+/// texel-snapped so it does not shimmer as the camera moves. The depth range reaches
+/// back only as far as the casters in [casterMin, casterMax] (world space; an empty box
+/// when min > max), and a cascade whose casters fit in a smaller square uses that
+/// instead. Writes layers 0..n-1 and returns n. No GL calls.
+int setupCascades(Light* light, const glm::vec3& target, const glm::mat4& view, const glm::mat4& projection,
+                  float nearPlane, float farPlane, const glm::vec3& casterMin, const glm::vec3& casterMax);
+
+/// Cascades used by setupCascades (clamped to 1..MAX_CASCADES)
+void setCascadeCount(int count);
+int getCascadeCount();
+/// Blend between uniform (0) and logarithmic (1) split distances
+void setCascadeSplitLambda(float lambda);
+float getCascadeSplitLambda();
+/// View distance the cascades cover at most (the camera's far plane when nearer);
+/// fragments beyond it are unshadowed
+void setCascadeDistance(float distance);
+float getCascadeDistance();
+/// Cascades written by the last setupCascades, and the view depth where cascade i ends
+int activeCascades();
+float getCascadeSplit(int cascade);
+
+/// Begin shadow pass for a light set up with setupShadowLight. The caller binds the
+/// light's layer of the shadow map array (a render graph target described by mapDesc()) first.
+void beginShadowPass(int lightIndex);
+
+/// Begin one pass that renders layers 0..lightCount-1 at once. The caller binds the whole
+/// array layered; casters draw lightCount instances per object (instanced casters with
+/// their attribute divisor at lightCount) and each instance lands in layer
+/// gl_InstanceID % lightCount. False when the layered program is unavailable.
+bool beginLayeredShadowPass(int lightCount);
+
+/// End shadow pass (either kind)
 void endShadowPass();
 
-/// Get the light space matrix for shadow sampling (for specific light)
+/// Prefer one layered pass over a pass per light (on by default)
+void setLayeredRendering(bool enabled);
+bool isLayeredRendering();
+
+/// Build the layered program (or its instanced form) on first call; false when it is
+/// unavailable
+bool hasLayeredProgram(bool instanced = false);
+
+/// True when the vertex shader writes gl_Layer (ARB_shader_viewport_layer_array or
+/// AMD_vertex_shader_layer); otherwise the layered programs add a geometry shader
+bool layersFromVertexShader();
+
+/// Get the light space matrix of a shadow map layer, for sampling
 glm::mat4 getLightSpaceMatrix(int lightIndex);
 
-/// Get shadow map texture ID (for specific light)
-unsigned int getShadowMapTexture(int lightIndex);
+/// Get this frame's shadow map array texture ID (the main light's cascades first, then a
+/// layer per extra shadow light)
+unsigned int getShadowMapArray();
+
+/// Publish this frame's shadow map array, for lighting setup to bind
+void setShadowMapArray(unsigned int texture);
+
+/// Render graph target holding the shadow maps: a depth array with one layer per light,
+/// compare mode, white border
+gfx::TextureDesc mapDesc(int layers);
+
+/// Shadow map caching: casters render into a persistent array whose layers are redrawn
+/// only when their light or the casters changed (on by default)
+void setCaching(bool enabled);
+bool isCaching();
+
+/// Split the cache: static casters stay in the cached array, dynamic ones are redrawn
+/// every frame into a second array, and the lit shaders keep the darker of the two
+void setDynamicSplit(bool enabled);
+bool isDynamicSplit();
+
+/// Persistent depth array backing the cache (MAX_SHADOW_LAYERS layers, sampled like
+/// mapDesc()), allocated on first call. GL thread only.
+unsigned int cacheArray();
+
+/// True when the cached layer of a light no longer matches its light space matrix (from
+/// setupShadowLight) and casterKey. Records the new key, so the caller must redraw the
+/// layer this frame.
+bool claimStaleLayer(int lightIndex, uint64_t casterKey);
+
+/// Mark the cached layers from firstLayer on stale
+void invalidateCache(int firstLayer = 0);
+
+/// Layers redrawn into the cache by the last frame's claims, and layers served from it
+struct CacheStats {
+    int redrawn = 0;
+    int reused = 0;
+};
+const CacheStats& cacheStats();
+/// Start counting a new frame's claims
+void resetCacheStats();
+
+/// This frame's dynamic-caster array (0 unless the cache is split), for lighting setup
+unsigned int getDynamicMapArray();
+void setDynamicMapArray(unsigned int texture);
 
 /// Get shadow shader program (for setting model matrix)
 unsigned int getShadowProgram();
@@ -36,6 +133,27 @@ unsigned int getShadowProgram();
 /// Set model matrix for current object being rendered
 void setModelMatrix(const glm::mat4& model);
 
+/// Set position dequantization for packed vertices (scale 1, bias 0 for float vertices)
+void setPositionDecode(const glm::vec3& scale, const glm::vec3& bias);
+
+/// Build the multi-draw-indirect variant on first call; false when it is unavailable
+bool hasIndirectProgram();
+
+/// Switch the current pass to the multi-draw-indirect program (per-draw data from the
+/// SSBO at binding 0). Returns false when the variant is unavailable or the pass is layered.
+bool useIndirectProgram(const glm::mat4& model);
+
+/// Build the instanced variant (per-instance model matrix at attribute 3) on first call;
+/// false when it is unavailable
+bool hasInstancedProgram();
+
+/// Switch the current pass to the instanced program (its layered form inside a layered
+/// pass). Returns false when the variant is unavailable.
+bool useInstancedProgram(const glm::mat4& model);
+
+/// Switch back to the regular shadow program after indirect or instanced draws
+void useStandardProgram();
+
 /// Set shadow parameters
 void setSoftness(float softness);     // PCF filter radius
 void setBias(float bias);             // Depth bias
@@ -0,0 +1,118 @@
+#pragma once
+/// @file SlotMap.h
+/// @brief Generational handles over densely packed values
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+/// Values live in one contiguous array so they can be iterated (and drawn) directly;
+/// handles go through a slot table that survives removals. Erasing moves the last value
+/// into the hole and bumps the slot generation, so stale handles stop resolving instead
+/// of aliasing whatever reuses the slot.
+template <typename T>
+class SlotMap {
+public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+    struct Handle {
+        uint32_t index = INVALID_INDEX;
+        uint32_t generation = 0;
+
+        bool operator==(const Handle& other) const {
+            return index == other.index && generation == other.generation;
+        }
+        bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+    Handle insert(T value) {
+        uint32_t slot;
+        if (!m_freeSlots.empty()) {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(m_slots.size());
+            m_slots.push_back(Slot{});
+        }
+        m_slots[slot].dense = static_cast<uint32_t>(m_values.size());
+        m_values.push_back(std::move(value));
+        m_denseToSlot.push_back(slot);
+        return Handle{slot, m_slots[slot].generation};
+    }
+
+    bool contains(Handle handle) const {
+        return handle.index < m_slots.size() &&
+               m_slots[handle.index].generation == handle.generation &&
+               m_slots[handle.index].dense != INVALID_INDEX;
+    }
+
+    T* get(Handle handle) {
+        return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr;
+    }
+    const T* get(Handle handle) const {
+        return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr;
+    }
+
+    /// Position of the value in values(); only valid until the next erase
+    size_t denseIndex(Handle handle) const {
+        return contains(handle) ? m_slots[handle.index].dense : INVALID_INDEX;
+    }
+
+    /// Remove and return the value. The last value moves into its dense position.
+    T erase(Handle handle) {
+        const uint32_t dense = m_slots[handle.index].dense;
+        T removed = std::move(m_values[dense]);
+
+        const uint32_t last = static_cast<uint32_t>(m_values.size() - 1);
+        if (dense != last) {
+            m_values[dense] = std::move(m_values[last]);
+            m_denseToSlot[dense] = m_denseToSlot[last];
+            m_slots[m_denseToSlot[dense]].dense = dense;
+        }
+        m_values.pop_back();
+        m_denseToSlot.pop_back();
+
+        Slot& slot = m_slots[handle.index];
+        slot.dense = INVALID_INDEX;
+        ++slot.generation;
+        m_freeSlots.push_back(handle.index);
+        return removed;
+    }
+
+    std::vector<T>& values() { return m_values; }
+    const std::vector<T>& values() const { return m_values; }
+    size_t size() const { return m_values.size(); }
+    bool empty() const { return m_values.empty(); }
+
+    /// Handle of the value at a dense position
+    Handle handleAt(size_t dense) const {
+        const uint32_t slot = m_denseToSlot[dense];
+        return Handle{slot, m_slots[slot].generation};
+    }
+
+    void clear() {
+        for (uint32_t slot : m_denseToSlot) {
+            m_slots[slot].dense = INVALID_INDEX;
+            ++m_slots[slot].generation;
+            m_freeSlots.push_back(slot);
+        }
+        m_values.clear();
+        m_denseToSlot.clear();
+    }
+
+private:
+    struct Slot {
+        uint32_t dense = INVALID_INDEX;
+        uint32_t generation = 1;   // never 0, so a default Handle never resolves
+    };
+
+    std::vector<T> m_values;
+    std::vector<uint32_t> m_denseToSlot;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+};
+
+} // namespace gfx
@@ -5,9 +5,12 @@
 #include <ShaderLib.h>
 #include <TransformStack.h>
 #include <Vector.h>
+#include <cstdint>
 #include <vector>
 // #include <glad/gl.h>
 
+namespace gfx { class CommandBuffer; class RenderQueue; }
+
 /// @file sphereobstacle.h
 /// @brief the obstacle class. We create the sphere that will collide with the
 /// cloth.
@@ -62,12 +65,20 @@ public:
   /// @brief variable to store the color of the sphere.
   Colour m_colour;
   //---------------------------------------------------------------------------------------------
-  /// @brief the draw method of the obstacle sphere.
-  void draw(const std::string &_shaderName, TransformStack &_transform,
-            Camera *_cam) const;
+  /// @brief queue the obstacle sphere with its material and transforms.
+  void submit(gfx::RenderQueue &_queue, const std::string &_shaderName,
+              TransformStack &_transform, Camera *_cam) const;
   //---------------------------------------------------------------------------------------------
   /// @brief Render sphere geometry only (for shadow pass, no shader setup)
-  void renderGeometryOnly() const;
+  /// @param _instances copies to draw, one per layer in a layered shadow pass
+  void renderGeometryOnly(int _instances = 1) const;
+  //---------------------------------------------------------------------------------------------
+  /// @brief Record what renderGeometryOnly issues, for replay on the GL thread
+  void recordGeometryOnly(gfx::CommandBuffer &_cmd) const;
+  //---------------------------------------------------------------------------------------------
+  /// @brief Changes whenever the shape renderGeometryOnly draws changes (deformation
+  /// switched on or off, or animated); 0 for the undeformed sphere. For shadow caching.
+  uint64_t shapeVersion() const;
   //---------------------------------------------------------------------------------------------
   /// @brief a variable to store the value for the wireframe option.
   bool m_sphereWireframe;
@@ -97,8 +108,10 @@ private:
   std::vector<float> m_deformedNormals;
   std::vector<unsigned int> m_indices;
   unsigned int m_vao, m_vbo, m_nbo, m_ebo;
+  unsigned int m_indexType;   // GL_UNSIGNED_SHORT when the sphere fits 16-bit indices
   int m_sphereSegments;
   bool m_bufferInitialized;
+  uint64_t m_shapeVersion;    // bumped by every generateDeformedSphere
 };
 
 #endif // SPHEREOBSTACLE_H
@@ -0,0 +1,60 @@
+#pragma once
+/// @file StreamRingBuffer.h
+/// @brief Persistently mapped, fence-guarded ring buffer for per-frame vertex streaming
+
+#include <glad/gl.h>
+#include <cstddef>
+
+namespace gfx {
+
+/// Triple-buffered GL buffer mapped once with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT.
+/// The CPU writes frame N+1 into one region while the GPU still reads frame N from another;
+/// each region is guarded by a fence placed after the last draw that reads it.
+class StreamRingBuffer {
+public:
+    static constexpr int REGION_COUNT = 3;
+
+    /// True when the context exposes ARB_buffer_storage (persistent mapping)
+    static bool isSupported();
+
+    StreamRingBuffer() = default;
+    ~StreamRingBuffer();
+    StreamRingBuffer(const StreamRingBuffer&) = delete;
+    StreamRingBuffer& operator=(const StreamRingBuffer&) = delete;
+
+    /// Allocate REGION_COUNT regions of regionBytes each and map them persistently
+    bool create(GLenum target, size_t regionBytes);
+
+    /// Release the buffer (waits for outstanding fences first)
+    void destroy();
+
+    /// Advance to the next region, blocking only if the GPU is still reading it
+    void beginFrame();
+
+    /// Fence the current region; call after the last draw that reads it
+    void endFrame();
+
+    /// Sub-allocate from the current region. Returns nullptr when the region is full.
+    /// outOffset receives the absolute byte offset inside the GL buffer.
+    void* allocate(size_t bytes, size_t alignment, size_t& outOffset);
+
+    GLuint buffer() const { return m_buffer; }
+    size_t regionBytes() const { return m_regionBytes; }
+    int currentRegion() const { return m_region; }
+    bool isCreated() const { return m_buffer != 0; }
+    bool inFrame() const { return m_inFrame; }
+
+private:
+    void waitForRegion(int region);
+
+    GLuint m_buffer = 0;
+    GLenum m_target = GL_ARRAY_BUFFER;
+    unsigned char* m_mapped = nullptr;
+    size_t m_regionBytes = 0;
+    size_t m_regionUsed = 0;
+    int m_region = REGION_COUNT - 1;
+    bool m_inFrame = false;
+    GLsync m_fences[REGION_COUNT] = {};
+};
+
+} // namespace gfx
@@ -54,9 +54,55 @@ struct CameraBlock {
     glm::mat4 projMatrix;   // 64 bytes
 };
 
+constexpr int FRAME_SHADOW_LIGHTS = 4;   // matches Shadow::MAX_SHADOW_LIGHTS
+constexpr int FRAME_SHADOW_LAYERS = 7;   // matches Shadow::MAX_SHADOW_LAYERS
+constexpr int FRAME_CASCADES      = 4;   // matches Shadow::MAX_CASCADES
+constexpr int FRAME_EXTRA_LIGHTS  = 8;   // MAX_LIGHTS in the fragment shaders (non-clustered fallback)
+
+/// Data constant for a frame, shared by every lit program (FrameBlock in shaders/UniformBlocks.glsl)
+struct FrameBlock {
+    CameraBlock camera;
+    LightBlock light;                                     // position in view space
+    glm::vec4 lightWorldPos;                              // xyz
+    glm::mat4 lightSpaceMatrices[FRAME_SHADOW_LAYERS];    // main light cascades, then extra shadow lights
+    glm::vec4 lightIntensities;                           // one per shadow light
+    glm::vec4 shadowParams;                               // bias, softness, map size, strength
+    glm::vec4 cascadeSplits;                              // view depth where each cascade ends
+    glm::ivec4 shadowLayout;                              // x: main light cascade count, yzw unused
+    glm::ivec4 lightCounts;                               // shadows enabled, shadow lights, extra lights, dynamic shadow layer
+    glm::vec4 extraLightPositions[FRAME_EXTRA_LIGHTS];    // xyz, w: range
+    glm::vec4 extraLightColors[FRAME_EXTRA_LIGHTS];       // rgb, a: intensity
+    glm::vec4 checkerColor1;                              // rgb, a: checker scale (0 = off)
+    glm::vec4 checkerColor2;
+    glm::vec4 fabricParams;                               // roughness, metallic, anisotropy, sheen intensity
+    glm::vec4 fabricParams2;                              // anisotropy U, anisotropy V, weave scale, time
+    glm::vec4 sheenColor;                                 // rgb, a: subsurface amount
+};
+
+/// Data that changes per draw (DrawBlock in shaders/UniformBlocks.glsl), written to a ring buffer
+struct DrawBlock {
+    glm::mat4 MVP{1.0f};
+    glm::mat4 MV{1.0f};
+    glm::mat4 M{1.0f};
+    glm::vec4 normalMatrix[3] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};  // std140 mat3 columns
+    MaterialBlock material{};
+    glm::vec4 posDequantScale{1.0f, 1.0f, 1.0f, 0.0f};    // w: octahedral normals
+    glm::vec4 posDequantBias{0.0f, 0.0f, 0.0f, 1.0f};     // w: normalize normals
+    glm::vec4 aoGroundColor{1.0f, 1.0f, 1.0f, 0.0f};      // a: AO strength
+    glm::vec4 subsurfaceColor{0.0f};                      // rgb (Silk shaders)
+};
+
+static_assert(sizeof(CameraBlock) == 160, "CameraBlock must match std140");
+static_assert(sizeof(LightBlock) == 80, "LightBlock must match std140");
+static_assert(sizeof(MaterialBlock) == 64, "MaterialBlock must match std140");
+static_assert(sizeof(FrameBlock) == 1120, "FrameBlock must match std140");
+static_assert(sizeof(DrawBlock) == 368, "DrawBlock must match std140");
+
 // UBO binding points for shader uniform blocks
 constexpr int MATRIX_BINDING_POINT   = 0;
 constexpr int MATERIAL_BINDING_POINT = 1;
 constexpr int LIGHT_BINDING_POINT    = 2;
 constexpr int LIGHTING_BINDING_POINT = 3;
+constexpr int FRAME_BINDING_POINT    = 4;
+constexpr int DRAW_BINDING_POINT     = 5;
 } // namespace FlockingShaders
@@ -0,0 +1,46 @@
+#pragma once
+/// @file UniformBlocks.h
+/// @brief Shared std140 uniform buffers for the lit programs: a per-frame block uploaded
+/// once per frame and per-draw blocks sub-allocated from a ring and bound with
+/// glBindBufferRange. Layouts and binding points are in UBOStructures.h.
+
+#include <UBOStructures.h>
+
+namespace UniformBlocks {
+
+/// Frame block variants uploaded together; the gizmo variant lights the light markers
+enum FrameSlot { SceneFrame = 0, GizmoFrame = 1, FRAME_SLOT_COUNT = 2 };
+
+/// Create the buffers (call with a current GL context)
+bool init();
+
+/// Release the buffers
+void cleanup();
+
+/// Advance the per-draw ring to a region the GPU has finished reading
+void beginFrame();
+
+/// Fence this frame's per-draw region; call after the last draw that reads it
+void endFrame();
+
+/// Frame data staged for the next uploadFrame
+FlockingShaders::FrameBlock& frame(FrameSlot slot = SceneFrame);
+
+/// Upload every frame variant with one buffer update and bind the scene variant
+void uploadFrame();
+
+/// Bind a variant written by the last uploadFrame
+void bindFrame(FrameSlot slot);
+
+/// Per-draw data staged for the next commitDraw. Fields keep their values between
+/// draws, so callers only change what differs (like plain uniforms).
+FlockingShaders::DrawBlock& draw();
+
+/// Set MVP, MV, M and the normal matrix of the staged draw block
+void setTransforms(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+
+/// Copy the staged draw block into the ring and bind it for the next draw call.
+/// Does nothing when it equals the block already bound.
+void commitDraw();
+
+} // namespace UniformBlocks
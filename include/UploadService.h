@@ -0,0 +1,100 @@
+#pragma once
+/// @file UploadService.h
+/// @brief Background buffer uploads on a shared GL context with fence handoff
+
+#include <glad/gl.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+
+namespace gfx {
+
+/// Owns a hidden GLFW window whose context shares objects with the render context and a
+/// worker thread that keeps it current. Each job is written into a staging buffer, copied
+/// into its destination buffers with glCopyBufferSubData and fenced. The render thread
+/// polls those fences once per frame without blocking; a destination may be used (after
+/// rebinding it, as GL requires for objects changed by another context) once its ticket
+/// is complete.
+class UploadService {
+public:
+    using Ticket = uint64_t;
+
+    /// One destination range. The buffer must already have storage covering
+    /// [offset, offset + bytes.size()) and must not be deleted before the job completes.
+    struct Copy {
+        GLuint buffer = 0;
+        size_t offset = 0;
+        std::vector<unsigned char> bytes;
+    };
+
+    UploadService() = default;
+    ~UploadService();
+    UploadService(const UploadService&) = delete;
+    UploadService& operator=(const UploadService&) = delete;
+
+    /// Create the shared context and start the worker. Must be called on the main thread
+    /// (GLFW creates windows there only) while shareWith's context is current.
+    bool start(GLFWwindow* shareWith);
+
+    /// Finish queued jobs, join the worker and destroy the shared context (main thread)
+    void stop();
+
+    bool isRunning() const { return m_window != nullptr; }
+
+    /// Queue a job; safe from any thread. Returns 0 when the service is not running.
+    /// Destination buffers created or resized on another context need a glFlush there
+    /// first, or the worker may not see their storage.
+    Ticket submit(std::vector<Copy> copies);
+    Ticket submit(GLuint buffer, size_t offset, const void* data, size_t bytes);
+
+    /// Render thread: retire every job whose fence has signalled. Never blocks.
+    void poll();
+
+    /// True once poll() has seen the ticket's fence signal. Jobs run in submission
+    /// order, so completing a ticket also completes every earlier one.
+    bool isComplete(Ticket ticket) const { return ticket <= m_completed.load(); }
+
+    /// Jobs submitted but not yet retired by poll()
+    size_t pendingJobs() const;
+
+private:
+    struct Job {
+        Ticket ticket = 0;
+        std::vector<Copy> copies;
+    };
+    struct Finished {
+        Ticket ticket = 0;
+        GLsync fence = nullptr;
+    };
+    struct Staging {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;   // last copy that reads this staging buffer
+    };
+
+    static constexpr size_t MAX_STAGING_BUFFERS = 4;
+
+    void workerLoop();
+    void runJob(Job& job);
+    Staging& acquireStaging(size_t bytes);
+
+    GLFWwindow* m_window = nullptr;
+    std::thread m_worker;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Job> m_jobs;
+    std::deque<Finished> m_finished;
+    std::vector<Staging> m_staging;   // worker thread only
+    Ticket m_nextTicket = 1;
+    std::atomic<Ticket> m_completed{0};
+    bool m_stopping = false;
+};
+
+} // namespace gfx
@@ -0,0 +1,34 @@
+#pragma once
+/// @file VertexInterleave.h
+/// @brief Packs separate position/normal/UV arrays into the 8-float vertex layout
+
+namespace VertexInterleave {
+
+/// Kernel implementations, fastest last
+enum class Path {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+/// Fastest path supported by this CPU (detected once)
+Path bestPath();
+
+/// Path used by interleave(); defaults to bestPath()
+Path activePath();
+
+/// Force a path (clamped to bestPath()), mainly for profiling and comparison
+void setActivePath(Path path);
+
+const char* pathName(Path path);
+
+/// Write count vertices as {pos.xyz, normal.xyz, uv.xy} to dst (count * 8 floats).
+/// uvs may be null (written as zero). dst is only written, never read, so it may
+/// point at write-combined mapped memory. Large inputs are split across workers.
+void interleave(float* dst, const float* positions, const float* normals, const float* uvs, int count);
+
+/// Single-threaded run of a specific path (reference/comparison use)
+void interleaveWith(Path path, float* dst, const float* positions, const float* normals,
+                    const float* uvs, int count);
+
+} // namespace VertexInterleave
@@ -0,0 +1,52 @@
+#pragma once
+/// @file VertexNormals.h
+/// @brief Area-weighted smooth vertex normals: SIMD/multithreaded CPU path and compute-shader path
+
+#include <glad/gl.h>
+#include <cstdint>
+
+namespace VertexNormals {
+
+/// Smooth normals for an indexed triangle list. Each vertex gets the normalized sum of
+/// the unnormalized cross products of its faces, so larger faces weigh more. Vertices
+/// without faces get +Y. Large meshes are split across workers.
+void compute(float* normals, const float* positions, int vertexCount,
+             const uint32_t* indices, int indexCount);
+
+/// Fixed-point factor for the GPU scatter: maps the typical face cross-product length
+/// (sampled from about 64 faces) to 2^16, far from int32 overflow after summing.
+float fixedPointScale(const float* positions, int vertexCount, const uint32_t* indices, int indexCount);
+
+/// Where the compute pass reads positions and writes normals. Bases and strides count
+/// floats; the two buffers may be the same (interleaved layouts). Indices are relative
+/// to vertex 0 of the view; 16-bit index buffers must be padded to a multiple of 4 bytes.
+struct GpuMeshView {
+    GLuint positionBuffer = 0;
+    GLuint positionBase = 0;
+    GLuint positionStride = 3;
+    GLuint normalBuffer = 0;
+    GLuint normalBase = 0;
+    GLuint normalStride = 3;
+    GLuint indexBuffer = 0;
+    GLuint firstIndex = 0;
+    bool shortIndices = false;   // GL_UNSIGNED_SHORT index buffer
+    int indexCount = 0;
+    int vertexCount = 0;
+    float fixedScale = 1.0f;
+};
+
+/// True when compute shaders and SSBOs are available and the shaders built (compiled
+/// on first call)
+bool gpuAvailable();
+
+/// Accumulate face normals into a fixed-point scratch SSBO with atomics, then normalize
+/// them into the view's normal slots. Only valid when gpuAvailable().
+void computeGpu(const GpuMeshView& view);
+
+/// Make normals written by computeGpu visible to vertex fetch and buffer copies; call
+/// once after the last dispatch and before drawing
+void finishGpu();
+
+void cleanupGpu();
+
+} // namespace VertexNormals
@@ -0,0 +1,35 @@
+#pragma once
+/// @file VertexPacking.h
+/// @brief 16-byte packed vertex: AABB-quantized positions, octahedral normals, half UVs
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace VertexPacking {
+
+/// GPU layout, bound as:
+///   location 0: 3 x GL_UNSIGNED_SHORT normalized (position in [0,1] across the AABB)
+///   location 2: 2 x GL_SHORT normalized (octahedral normal)
+///   location 1: 2 x GL_HALF_FLOAT (UV)
+struct PackedVertex {
+    uint16_t position[4];   // xyz + padding
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+/// Axis-aligned bounds of count xyz positions
+void computeBounds(const float* positions, int count, glm::vec3& outMin, glm::vec3& outMax);
+
+/// Shader-side dequantization: position = q * scale + bias, q in [0,1]
+glm::vec3 dequantScale(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+/// Octahedral encode of a (not necessarily unit) normal into two snorm16 values
+void encodeOctNormal(const float* n, int16_t out[2]);
+
+/// Encode count vertices into dst against the given bounds. uvs may be null.
+/// Large inputs are split across workers.
+void pack(PackedVertex* dst, const float* positions, const float* normals, const float* uvs, int count,
+          const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+} // namespace VertexPacking
@@ -1,4 +1,32 @@
 #version 460 core
+// Extra lights come from per-cluster lists when SSBOs are available (LightClusters.h),
+// otherwise from the first MAX_LIGHTS frame block lights
+#extension GL_ARB_shader_storage_buffer_object : enable
+#ifdef GL_ARB_shader_storage_buffer_object
+#define SANDBOX_CLUSTERED_LIGHTS 1
+#endif
+#ifdef SANDBOX_MDI
+// Multi-draw-indirect variant: material comes from the per-draw buffer (see IndirectBatch.h)
+#extension GL_ARB_shader_storage_buffer_object : require
+struct DrawData
+{
+  mat4 model;
+  mat4 normalModel;   // inverse-transpose of model
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  vec4 params;        // rgb: subsurface colour, a: shininess
+  vec4 posScale;      // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posBias;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer { DrawData draws[]; };
+flat in int drawID;
+#endif
+#ifdef SANDBOX_INSTANCED
+// Instanced variant: the instance colour tints the draw block material
+flat in vec4 instanceTint;
+#endif
+#include "UniformBlocks.glsl"
 
 /// @brief[in] the vertex normal
 in vec3 fragmentNormal;
@@ -11,32 +39,34 @@ in vec4 fragPosLightSpace;
 /// @brief World position for multi-shadow calculation
 in vec3 worldPos;
 
-// Multi-shadow support
-const int MAX_SHADOW_LIGHTS = 4;
-uniform sampler2DShadow shadowMaps[MAX_SHADOW_LIGHTS];
-uniform mat4 lightSpaceMatrices[MAX_SHADOW_LIGHTS];
-uniform float lightIntensities[MAX_SHADOW_LIGHTS];
-uniform int numShadowLights;
-
-// Extra light array (no shadows)
-const int MAX_LIGHTS = 8;
-uniform int numLights;
-uniform vec3 lightPositions[MAX_LIGHTS];
-uniform vec3 lightColors[MAX_LIGHTS];
-uniform float lightIntensitiesExtra[MAX_LIGHTS];
+// Shadow maps: one depth array with a layer per shadow light (texture unit 5, bound by
+// Renderer::setupLighting); layer 0 doubles as the legacy single map
+layout(binding = 5) uniform sampler2DArrayShadow shadowMaps;
+// Casters redrawn every frame when Shadow::setDynamicSplit is on (unit 6); their
+// depth is combined with the cached static layer at sample time
+layout(binding = 6) uniform sampler2DArrayShadow shadowMapsDynamic;
 
-// Shadow parameters
-uniform sampler2DShadow shadowMap;
-uniform float shadowBias;
-uniform float shadowSoftness;
-uniform float shadowStrength;
-uniform int shadowEnabled;
-uniform float shadowMapSize;
+// Block fields under the names the lighting code uses, set by loadUniformBlocks
+int numShadowLights;
+int numLights;
+float shadowBias;
+float shadowSoftness;
+float shadowStrength;
+int shadowEnabled;
+int shadowSplit;
+int shadowCascades;
+float shadowMapSize;
+float checkerScale;    // Checker pattern scale (0 = disabled)
+vec3 checkerColor1;    // Primary checker color
+vec3 checkerColor2;    // Secondary checker color
 
-// Checker pattern parameters
-uniform float checkerScale;    // Checker pattern scale (0 = disabled)
-uniform vec3 checkerColor1;    // Primary checker color
-uniform vec3 checkerColor2;    // Secondary checker color
+// Lit fraction of one shadow map tap: a fragment is lit only if both layers agree
+float sampleShadow(vec4 coord)
+{
+    float lit = texture(shadowMaps, coord);
+    if (shadowSplit != 0) lit = min(lit, texture(shadowMapsDynamic, coord));
+    return lit;
+}
 
 // PCF shadow calculation
 float calculateShadow(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
@@ -66,8 +96,8 @@ float calculateShadow(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
     for (int x = -2; x <= 2; ++x) {
         for (int y = -2; y <= 2; ++y) {
             vec2 offset = vec2(x, y) * texelSize * radius;
-            vec3 sampleCoord = vec3(projCoords.xy + offset, currentDepth);
-            shadow += texture(shadowMap, sampleCoord);
+            vec4 sampleCoord = vec4(projCoords.xy + offset, 0.0, currentDepth);
+            shadow += sampleShadow(sampleCoord);
         }
     }
     
@@ -79,7 +109,7 @@ float calculateShadow(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
 }
 
 // Calculate shadow for a specific shadow map (multi-shadow)
-float calculateShadowForMap(sampler2DShadow sMap, vec4 lsPos, vec3 normal, vec3 lightDir)
+float calculateShadowForMap(int layer, vec4 lsPos, vec3 normal, vec3 lightDir)
 {
     vec3 projCoords = lsPos.xyz / lsPos.w;
     projCoords = projCoords * 0.5 + 0.5;
@@ -97,8 +127,8 @@ float calculateShadowForMap(sampler2DShadow sMap, vec4 lsPos, vec3 normal, vec3
     for (int x = -2; x <= 2; ++x) {
         for (int y = -2; y <= 2; ++y) {
             vec2 offset = vec2(x, y) * texelSize * radius;
-            vec3 sampleCoord = vec3(projCoords.xy + offset, currentDepth);
-            shadow += texture(sMap, sampleCoord);
+            vec4 sampleCoord = vec4(projCoords.xy + offset, float(layer), currentDepth);
+            shadow += sampleShadow(sampleCoord);
         }
     }
     shadow /= 25.0;
@@ -106,6 +136,16 @@ float calculateShadowForMap(sampler2DShadow sMap, vec4 lsPos, vec3 normal, vec3
     return shadow;
 }
 
+// Main light cascade covering this fragment (by view depth), -1 beyond the last one
+int shadowCascade()
+{
+    float depth = -(camera.viewMatrix * vec4(worldPos, 1.0)).z;
+    for (int c = 0; c < shadowCascades && c < MAX_CASCADES; ++c) {
+        if (depth < cascadeSplits[c]) return c;
+    }
+    return -1;
+}
+
 // Calculate combined shadow from all shadow maps with intensity weighting
 float calculateMultiShadow(vec3 normal, vec3 lightDir)
 {
@@ -117,8 +157,11 @@ float calculateMultiShadow(vec3 normal, vec3 lightDir)
     vec4 wPos = vec4(worldPos, 1.0);
     
     for (int i = 0; i < numShadowLights && i < MAX_SHADOW_LIGHTS; ++i) {
-        vec4 lsPos = lightSpaceMatrices[i] * wPos;
-        float rawShadow = calculateShadowForMap(shadowMaps[i], lsPos, normal, lightDir);
+        // The main light reads the cascade covering this fragment; the extra shadow
+        // lights' layers follow the cascades
+        int layer = i == 0 ? shadowCascade() : shadowCascades + i - 1;
+        float rawShadow = 1.0;
+        if (layer >= 0) rawShadow = calculateShadowForMap(layer, lightSpaceMatrices[layer] * wPos, normal, lightDir);
         float intensity = lightIntensities[i];
         
         // Weight shadow contribution by intensity
@@ -144,38 +187,13 @@ vec3 checkerPattern(vec2 uv, float scale, vec3 color1, vec3 color2)
     return mix(color1, color2, pattern);
 }
 
-/// @brief material structure
-struct Materials
-{
-  vec4 ambient;
-  vec4 diffuse;
-  vec4 specular;
-  float shininess;
-};
-
-// @brief light structure
-struct Lights
-{
-    vec4 position;
-    vec3 direction;
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    float spotCosCutoff;
-    float spotCosInnerCutoff;
-    float spotExponent;
-    float constantAttenuation;
-    float linearAttenuation;
-    float quadraticAttenuation;
-};
-// @param material passed from our program
-uniform Materials material;
-
-uniform Lights light;
+// @param material from the draw block (tinted per instance when instanced), or the
+// per-draw buffer for multi-draw
+Materials material;
 
 // Ambient occlusion parameters
-uniform float aoStrength;      // 0 = off, 0.5 = subtle, 1.0 = strong
-uniform vec3 aoGroundColor;    // Color tint for ground occlusion
+float aoStrength;      // 0 = off, 0.5 = subtle, 1.0 = strong
+vec3 aoGroundColor;    // Color tint for ground occlusion
 
 in vec3 lightDir;
 // out the blinn half vector
@@ -234,27 +252,105 @@ vec4 pointLight()
 return ambient + diffuse + specular;
 }
 
+#ifdef SANDBOX_CLUSTERED_LIGHTS
+struct ClusterLight
+{
+  vec4 positionRange;   // world xyz, w: range
+  vec4 colorIntensity;  // rgb, a: intensity
+};
+layout(std430, binding = 6) readonly buffer ClusterLightBuffer { ClusterLight clusterLights[]; };
+layout(std430, binding = 7) readonly buffer ClusterGridBuffer
+{
+  vec4 clusterParams;   // tiles per pixel x/y, depth slice scale and bias
+  uvec4 clusterDims;    // clusters x/y/z, light count
+  uvec2 clusterRanges[];
+};
+layout(std430, binding = 8) readonly buffer ClusterIndexBuffer
+{
+  uint clusterIndexCount;
+  uint clusterLightIndices[];
+};
+
+// First list entry and light count of this fragment's cluster
+uvec2 clusterLightRange()
+{
+    float depth = max(-(camera.viewMatrix * vec4(worldPos, 1.0)).z, 1e-4);
+    vec3 cell = vec3(gl_FragCoord.xy * clusterParams.xy, log(depth) * clusterParams.z + clusterParams.w);
+    uvec3 c = uvec3(clamp(cell, vec3(0.0), vec3(clusterDims.xyz - uvec3(1u))));
+    return clusterRanges[(c.z * clusterDims.y + c.y) * clusterDims.x + c.x];
+}
+#endif
+
+// Falls smoothly to zero at a light's range, so culling the light beyond it is invisible
+float rangeWindow(float dist, float range)
+{
+    float x = dist / max(range, 1e-4);
+    x = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return x * x;
+}
+
+vec3 extraLight(vec3 N, vec3 V, vec4 positionRange, vec4 colorIntensity)
+{
+    vec3 L = positionRange.xyz - worldPos;
+    float dist = length(L);
+    if (dist > 0.0001) L /= dist;
+    float diff = max(dot(N, L), 0.0);
+    vec3 H = normalize(L + V);
+    float spec = pow(max(dot(N, H), 0.0), material.shininess);
+    float intensity = colorIntensity.a * rangeWindow(dist, positionRange.w);
+    vec3 color = colorIntensity.rgb;
+    return (material.diffuse.rgb * color * diff + material.specular.rgb * color * spec) * intensity;
+}
+
 vec3 extraLights(vec3 N, vec3 V)
 {
     vec3 accum = vec3(0.0);
+#ifdef SANDBOX_CLUSTERED_LIGHTS
+    uvec2 range = clusterLightRange();
+    for (uint i = 0u; i < range.y; ++i) {
+        ClusterLight l = clusterLights[clusterLightIndices[range.x + i]];
+        accum += extraLight(N, V, l.positionRange, l.colorIntensity);
+    }
+#else
     int count = numLights;
     if (count > MAX_LIGHTS) count = MAX_LIGHTS;
     for (int i = 0; i < count; ++i) {
-        vec3 L = lightPositions[i] - worldPos;
-        float dist = length(L);
-        if (dist > 0.0001) L /= dist;
-        float diff = max(dot(N, L), 0.0);
-        vec3 H = normalize(L + V);
-        float spec = pow(max(dot(N, H), 0.0), material.shininess);
-        float intensity = lightIntensitiesExtra[i];
-        vec3 color = lightColors[i];
-        accum += (material.diffuse.rgb * color * diff + material.specular.rgb * color * spec) * intensity;
+        accum += extraLight(N, V, extraLightPositions[i], extraLightColors[i]);
     }
+#endif
     return accum;
 }
 
+void loadUniformBlocks()
+{
+#ifdef SANDBOX_MDI
+    material = Materials(draws[drawID].ambient, draws[drawID].diffuse, draws[drawID].specular, draws[drawID].params.a);
+#elif defined(SANDBOX_INSTANCED)
+    material = drawMaterial;
+    material.ambient *= instanceTint;
+    material.diffuse *= instanceTint;
+#else
+    material = drawMaterial;
+#endif
+    shadowEnabled = lightCounts.x;
+    shadowSplit = lightCounts.w;
+    shadowCascades = shadowLayout.x;
+    numShadowLights = lightCounts.y;
+    numLights = lightCounts.z;
+    shadowBias = shadowParams.x;
+    shadowSoftness = shadowParams.y;
+    shadowMapSize = shadowParams.z;
+    shadowStrength = shadowParams.w;
+    checkerScale = checkerParams1.a;
+    checkerColor1 = checkerParams1.rgb;
+    checkerColor2 = checkerParams2.rgb;
+    aoStrength = aoParams.a;
+    aoGroundColor = aoParams.rgb;
+}
+
 void main ()
 {
+    loadUniformBlocks();
     // Compute ambient occlusion
     vec3 N = normalize(fragmentNormal);
     vec3 V = normalize(eyeDirection);
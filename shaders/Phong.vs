@@ -1,8 +1,29 @@
 #version 460 core
-/// @brief flag to indicate if model has unit normals if not normalize
-uniform bool Normalize;
-// the eye position of the camera
-uniform vec3 viewerPos;
+#ifdef SANDBOX_MDI
+// Multi-draw-indirect variant: per-draw data indexed by gl_DrawIDARB (see IndirectBatch.h)
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_ARB_shader_storage_buffer_object : require
+struct DrawData
+{
+  mat4 model;
+  mat4 normalModel;   // inverse-transpose of model
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  vec4 params;        // rgb: subsurface colour, a: shininess
+  vec4 posScale;      // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posBias;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer { DrawData draws[]; };
+flat out int drawID;
+#endif
+#ifdef SANDBOX_INSTANCED
+// Instanced variant: per-instance model matrix and colour (see gfx::InstanceData)
+in mat4 instanceModel;
+in vec4 instanceColor;
+flat out vec4 instanceTint;
+#endif
+#include "UniformBlocks.glsl"
 /// @brief the current fragment normal for the vert being processed
 out vec3 fragmentNormal;
 /// @brief the vertex passed in
@@ -14,33 +35,6 @@ in vec2 inUV;
 /// @brief world position for multi-shadow calculation
 out vec3 worldPos;
 
-struct Materials
-{
-  vec4 ambient;
-  vec4 diffuse;
-  vec4 specular;
-  float shininess;
-};
-
-
-struct Lights
-{
-    vec4 position;
-    vec3 direction;
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    float spotCosCutoff;
-    float spotCosInnerCutoff;
-    float spotExponent;
-    float constantAttenuation;
-    float linearAttenuation;
-    float quadraticAttenuation;
-};
-// our material
-uniform Materials material;
-// array of lights
-uniform Lights light;
 // direction of the lights used for shading
 out vec3 lightDir;
 // out the blinn half vector
@@ -50,33 +44,65 @@ out vec3 vPosition;
 out vec2 fragUV;
 out vec4 fragPosLightSpace;
 
-uniform mat4 MV;
-uniform mat4 MVP;
-uniform mat3 normalMatrix;
-uniform mat4 M;
-uniform mat4 lightSpaceMatrix;
-
+vec3 decodeOctNormal(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
 
 void main()
 {
+#ifdef SANDBOX_MDI
+drawID = gl_DrawIDARB;
+DrawData drawData = draws[drawID];
+mat4 drawM = M * drawData.model;
+mat4 drawMV = MV * drawData.model;
+mat4 drawMVP = MVP * drawData.model;
+mat3 drawNormalMatrix = normalMatrix * mat3(drawData.normalModel);
+vec3 vert = inVert * drawData.posScale.xyz + drawData.posBias.xyz;
+vec3 normal = drawData.posScale.w > 0.5 ? decodeOctNormal(inNormal.xy) : inNormal;
+#elif defined(SANDBOX_INSTANCED)
+instanceTint = instanceColor;
+// Cofactor matrix: the inverse transpose up to scale (instanced draws always normalize)
+mat3 instanceNormal = mat3(cross(instanceModel[1].xyz, instanceModel[2].xyz),
+                           cross(instanceModel[2].xyz, instanceModel[0].xyz),
+                           cross(instanceModel[0].xyz, instanceModel[1].xyz));
+mat4 drawM = M * instanceModel;
+mat4 drawMV = MV * instanceModel;
+mat4 drawMVP = MVP * instanceModel;
+mat3 drawNormalMatrix = normalMatrix * instanceNormal;
+vec3 vert = inVert * posDequantScale.xyz + posDequantBias.xyz;
+vec3 normal = posDequantScale.w > 0.5 ? decodeOctNormal(inNormal.xy) : inNormal;
+#else
+mat4 drawM = M;
+mat4 drawMV = MV;
+mat4 drawMVP = MVP;
+mat3 drawNormalMatrix = normalMatrix;
+vec3 vert = inVert * posDequantScale.xyz + posDequantBias.xyz;
+vec3 normal = posDequantScale.w > 0.5 ? decodeOctNormal(inNormal.xy) : inNormal;
+#endif
+
 // calculate the fragments surface normal
-fragmentNormal = (normalMatrix*inNormal);
+fragmentNormal = (drawNormalMatrix*normal);
 
 
-if (Normalize == true)
+if (posDequantBias.w > 0.5)
 {
  fragmentNormal = normalize(fragmentNormal);
 }
 // calculate the vertex position
-gl_Position = MVP*vec4(inVert,1.0);
+gl_Position = drawMVP*vec4(vert,1.0);
 
-vec4 worldPosition = M * vec4(inVert, 1.0);
+vec4 worldPosition = drawM * vec4(vert, 1.0);
 worldPos = worldPosition.xyz;
-eyeDirection = normalize(viewerPos - worldPosition.xyz);
+eyeDirection = normalize(camera.position - worldPosition.xyz);
 // Get vertex position in eye coordinates
 // Transform the vertex to eye co-ordinates for frag shader
 /// @brief the vertex in eye co-ordinates  homogeneous
-vec4 eyeCord=MV*vec4(inVert,1);
+vec4 eyeCord=drawMV*vec4(vert,1);
 
 vPosition = eyeCord.xyz / eyeCord.w;;
 
@@ -90,5 +116,5 @@ halfVector = normalize(eyeDirection + lightDir);
 fragUV = inUV;
 
 // Calculate position in light space for shadow mapping
-fragPosLightSpace = lightSpaceMatrix * worldPosition;
+fragPosLightSpace = lightSpaceMatrices[0] * worldPosition;
 }
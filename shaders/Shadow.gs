@@ -0,0 +1,20 @@
+#version 150
+
+/// @file Shadow.gs
+/// @brief Layered shadow pass fallback for contexts without vertex shader gl_Layer:
+/// passes each triangle through to the layer Shadow.vs picked for its instance
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+flat in int vertexLayer[];
+
+void main()
+{
+    for (int i = 0; i < 3; ++i) {
+        gl_Layer = vertexLayer[0];
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -1,4 +1,38 @@
 #version 150
+#ifdef SANDBOX_LAYERED
+// Layered variant (compiled as GLSL 4.20): every shadow layer in one submission. Each
+// object is drawn once per layer; instance i goes to layer i % shadowLayerCount, written
+// here when the context allows gl_Layer in vertex shaders, otherwise by Shadow.gs.
+#ifdef SANDBOX_VS_LAYER
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#else
+flat out int vertexLayer;
+#endif
+uniform mat4 lightSpaceMatrices[7];   // Shadow::MAX_SHADOW_LAYERS
+uniform int shadowLayerCount;
+#endif
+#ifdef SANDBOX_MDI
+// Multi-draw-indirect variant (compiled as GLSL 4.20): per-draw model from gl_DrawIDARB
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_ARB_shader_storage_buffer_object : require
+struct DrawData
+{
+  mat4 model;
+  mat4 normalModel;   // inverse-transpose of model
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  vec4 params;        // rgb: subsurface colour, a: shininess
+  vec4 posScale;      // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posBias;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer { DrawData draws[]; };
+#endif
+#ifdef SANDBOX_INSTANCED
+// Instanced variant: per-instance model matrix (see gfx::InstanceData)
+in mat4 instanceModel;
+#endif
 
 /// @file Shadow.vs
 /// @brief Vertex shader for shadow map depth pass
@@ -7,8 +41,30 @@ in vec3 inVert;
 
 uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
+/// @brief packed-vertex position decode (identity for float vertices)
+uniform vec3 posDequantScale = vec3(1.0);
+uniform vec3 posDequantBias = vec3(0.0);
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(inVert, 1.0);
+#ifdef SANDBOX_LAYERED
+    int layer = gl_InstanceID % shadowLayerCount;
+    mat4 lightSpace = lightSpaceMatrices[layer];
+#ifdef SANDBOX_VS_LAYER
+    gl_Layer = layer;
+#else
+    vertexLayer = layer;
+#endif
+#else
+    mat4 lightSpace = lightSpaceMatrix;
+#endif
+#ifdef SANDBOX_MDI
+    DrawData drawData = draws[gl_DrawIDARB];
+    vec3 vert = inVert * drawData.posScale.xyz + drawData.posBias.xyz;
+    gl_Position = lightSpace * model * drawData.model * vec4(vert, 1.0);
+#elif defined(SANDBOX_INSTANCED)
+    gl_Position = lightSpace * model * instanceModel * vec4(inVert * posDequantScale + posDequantBias, 1.0);
+#else
+    gl_Position = lightSpace * model * vec4(inVert * posDequantScale + posDequantBias, 1.0);
+#endif
 }
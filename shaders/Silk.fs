@@ -1,4 +1,22 @@
 #version 460 core
+#ifdef SANDBOX_MDI
+// Multi-draw-indirect variant: material comes from the per-draw buffer (see IndirectBatch.h)
+#extension GL_ARB_shader_storage_buffer_object : require
+struct DrawData
+{
+  mat4 model;
+  mat4 normalModel;   // inverse-transpose of model
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  vec4 params;        // rgb: subsurface colour, a: shininess
+  vec4 posScale;      // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posBias;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer { DrawData draws[]; };
+flat in int drawID;
+#endif
+#include "UniformBlocks.glsl"
 /// @brief Silk/fabric fragment shader with anisotropic specular, SSS, and multi-shadow support
 
 /// @brief the vertex normal
@@ -18,65 +36,50 @@ in vec2 fragUV;
 in vec4 fragPosLightSpace;
 in vec3 worldPos;
 
-// Multi-shadow support
-const int MAX_SHADOW_LIGHTS = 4;
-uniform sampler2DShadow shadowMaps[MAX_SHADOW_LIGHTS];
-uniform mat4 lightSpaceMatrices[MAX_SHADOW_LIGHTS];
-uniform float lightIntensities[MAX_SHADOW_LIGHTS];
-uniform int numShadowLights;
-uniform float shadowMapSize;
-
-// Shadow map (legacy)
-uniform sampler2DShadow shadowMap;
-uniform float shadowBias;
-uniform float shadowSoftness;
-uniform int shadowEnabled;
-
-/// @brief material structure
-struct Materials
-{
-  vec4 ambient;
-  vec4 diffuse;
-  vec4 specular;
-  float shininess;
-};
+// Shadow maps: one depth array with a layer per shadow light (texture unit 5, bound by
+// Renderer::setupLighting); layer 0 doubles as the legacy single map
+layout(binding = 5) uniform sampler2DArrayShadow shadowMaps;
+// Casters redrawn every frame when Shadow::setDynamicSplit is on (unit 6); their
+// depth is combined with the cached static layer at sample time
+layout(binding = 6) uniform sampler2DArrayShadow shadowMapsDynamic;
 
-/// @brief light structure
-struct Lights
-{
-    vec4 position;
-    vec3 direction;
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    float spotCosCutoff;
-    float spotCosInnerCutoff;
-    float spotExponent;
-    float constantAttenuation;
-    float linearAttenuation;
-    float quadraticAttenuation;
-};
+// Block fields under the names the lighting code uses, set by loadUniformBlocks
+int numShadowLights;
+float shadowMapSize;
+float shadowBias;
+float shadowSoftness;
+int shadowEnabled;
+int shadowSplit;
+int shadowCascades;
 
-uniform Materials material;
-uniform Lights light;
+// Material from the draw block, or the per-draw buffer for multi-draw
+Materials material;
 
 // Silk-specific parameters
-uniform float anisotropyU;     // Anisotropy along warp (U) direction
-uniform float anisotropyV;     // Anisotropy along weft (V) direction
-uniform float sheenIntensity;  // Silk sheen/rim light intensity
-uniform float subsurfaceAmount;// SSS approximation amount
-uniform vec3 subsurfaceColor;  // SSS color tint
-uniform float weaveScale;      // Weave pattern scale
-uniform float time;            // For subtle animation
+float anisotropyU;     // Anisotropy along warp (U) direction
+float anisotropyV;     // Anisotropy along weft (V) direction
+float sheenIntensity;  // Silk sheen/rim light intensity
+float subsurfaceAmount;// SSS approximation amount
+vec3 subsurfaceColor;  // SSS color tint
+float weaveScale;      // Weave pattern scale
+float time;            // For subtle animation
 
 // Checker pattern parameters
-uniform float checkerScale;    // Checker pattern scale (0 = disabled)
-uniform vec3 checkerColor1;    // Primary checker color
-uniform vec3 checkerColor2;    // Secondary checker color
+float checkerScale;    // Checker pattern scale (0 = disabled)
+vec3 checkerColor1;    // Primary checker color
+vec3 checkerColor2;    // Secondary checker color
 
 // Ambient occlusion parameters
-uniform float aoStrength;      // 0 = off, 0.5 = subtle, 1.0 = strong
-uniform vec3 aoGroundColor;    // Color tint for ground occlusion
+float aoStrength;      // 0 = off, 0.5 = subtle, 1.0 = strong
+vec3 aoGroundColor;    // Color tint for ground occlusion
+
+// Lit fraction of one shadow map tap: a fragment is lit only if both layers agree
+float sampleShadow(vec4 coord)
+{
+    float lit = texture(shadowMaps, coord);
+    if (shadowSplit != 0) lit = min(lit, texture(shadowMapsDynamic, coord));
+    return lit;
+}
 
 // PCF shadow calculation
 float calculateShadow(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
@@ -106,8 +109,8 @@ float calculateShadow(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
     
     for (int x = -samples; x <= samples; ++x) {
         for (int y = -samples; y <= samples; ++y) {
-            vec3 sampleCoord = vec3(projCoords.xy + vec2(x, y) * texelSize, currentDepth);
-            shadow += texture(shadowMap, sampleCoord);
+            vec4 sampleCoord = vec4(projCoords.xy + vec2(x, y) * texelSize, 0.0, currentDepth);
+            shadow += sampleShadow(sampleCoord);
         }
     }
     
@@ -118,7 +121,7 @@ float calculateShadow(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
 }
 
 // Calculate shadow for a specific shadow map
-float calculateShadowForMap(sampler2DShadow sMap, vec4 lsPos, vec3 normal, vec3 lightDir)
+float calculateShadowForMap(int layer, vec4 lsPos, vec3 normal, vec3 lightDir)
 {
     vec3 projCoords = lsPos.xyz / lsPos.w;
     projCoords = projCoords * 0.5 + 0.5;
@@ -136,14 +139,24 @@ float calculateShadowForMap(sampler2DShadow sMap, vec4 lsPos, vec3 normal, vec3
     
     for (int x = -2; x <= 2; ++x) {
         for (int y = -2; y <= 2; ++y) {
-            vec3 sampleCoord = vec3(projCoords.xy + vec2(x, y) * texelSize, currentDepth);
-            shadow += texture(sMap, sampleCoord);
+            vec4 sampleCoord = vec4(projCoords.xy + vec2(x, y) * texelSize, float(layer), currentDepth);
+            shadow += sampleShadow(sampleCoord);
         }
     }
     shadow /= 25.0;
     return shadow;
 }
 
+// Main light cascade covering this fragment (by view depth), -1 beyond the last one
+int shadowCascade()
+{
+    float depth = -(camera.viewMatrix * vec4(worldPos, 1.0)).z;
+    for (int c = 0; c < shadowCascades && c < MAX_CASCADES; ++c) {
+        if (depth < cascadeSplits[c]) return c;
+    }
+    return -1;
+}
+
 // Calculate combined shadow from all shadow maps with intensity weighting
 float calculateMultiShadow(vec3 normal, vec3 lightDir)
 {
@@ -155,8 +168,11 @@ float calculateMultiShadow(vec3 normal, vec3 lightDir)
     vec4 wPos = vec4(worldPos, 1.0);
     
     for (int i = 0; i < numShadowLights && i < MAX_SHADOW_LIGHTS; ++i) {
-        vec4 lsPos = lightSpaceMatrices[i] * wPos;
-        float rawShadow = calculateShadowForMap(shadowMaps[i], lsPos, normal, lightDir);
+        // The main light reads the cascade covering this fragment; the extra shadow
+        // lights' layers follow the cascades
+        int layer = i == 0 ? shadowCascade() : shadowCascades + i - 1;
+        float rawShadow = 1.0;
+        if (layer >= 0) rawShadow = calculateShadowForMap(layer, lightSpaceMatrices[layer] * wPos, normal, lightDir);
         float intensity = lightIntensities[i];
         
         float shadowContrib = (1.0 - rawShadow) * intensity;
@@ -310,8 +326,38 @@ vec4 silkLighting()
     return vec4(finalColor, material.diffuse.a);
 }
 
+void loadUniformBlocks()
+{
+#ifdef SANDBOX_MDI
+    material = Materials(draws[drawID].ambient, draws[drawID].diffuse, draws[drawID].specular, draws[drawID].params.a);
+    subsurfaceColor = draws[drawID].params.rgb;
+#else
+    material = drawMaterial;
+    subsurfaceColor = drawSubsurfaceColor.rgb;
+#endif
+    shadowEnabled = lightCounts.x;
+    shadowSplit = lightCounts.w;
+    shadowCascades = shadowLayout.x;
+    numShadowLights = lightCounts.y;
+    shadowBias = shadowParams.x;
+    shadowSoftness = shadowParams.y;
+    shadowMapSize = shadowParams.z;
+    anisotropyU = fabricParams2.x;
+    anisotropyV = fabricParams2.y;
+    weaveScale = fabricParams2.z;
+    time = fabricParams2.w;
+    sheenIntensity = fabricParams.w;
+    subsurfaceAmount = sheenParams.a;
+    checkerScale = checkerParams1.a;
+    checkerColor1 = checkerParams1.rgb;
+    checkerColor2 = checkerParams2.rgb;
+    aoStrength = aoParams.a;
+    aoGroundColor = aoParams.rgb;
+}
+
 void main()
 {
+    loadUniformBlocks();
     vec4 lit = silkLighting();
     
     // Apply ambient occlusion
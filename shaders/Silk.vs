@@ -1,10 +1,25 @@
 #version 460 core
+#ifdef SANDBOX_MDI
+// Multi-draw-indirect variant: per-draw data indexed by gl_DrawIDARB (see IndirectBatch.h)
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_ARB_shader_storage_buffer_object : require
+struct DrawData
+{
+  mat4 model;
+  mat4 normalModel;   // inverse-transpose of model
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  vec4 params;        // rgb: subsurface colour, a: shininess
+  vec4 posScale;      // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posBias;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer { DrawData draws[]; };
+flat out int drawID;
+#endif
 /// @brief Silk/fabric vertex shader with tangent calculation for anisotropic lighting
 
-/// @brief flag to indicate if model has unit normals if not normalize
-uniform bool Normalize;
-/// @brief the eye position of the camera
-uniform vec3 viewerPos;
+#include "UniformBlocks.glsl"
 /// @brief the current fragment normal
 out vec3 fragmentNormal;
 /// @brief tangent for anisotropic lighting (along U)
@@ -20,32 +35,6 @@ in vec3 inNormal;
 /// @brief the in uv
 in vec2 inUV;
 
-struct Materials
-{
-  vec4 ambient;
-  vec4 diffuse;
-  vec4 specular;
-  float shininess;
-};
-
-struct Lights
-{
-    vec4 position;
-    vec3 direction;
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    float spotCosCutoff;
-    float spotCosInnerCutoff;
-    float spotExponent;
-    float constantAttenuation;
-    float linearAttenuation;
-    float quadraticAttenuation;
-};
-
-uniform Materials material;
-uniform Lights light;
-
 out vec3 lightDir;
 out vec3 halfVector;
 out vec3 eyeDirection;
@@ -53,18 +42,39 @@ out vec3 vPosition;
 out vec2 fragUV;
 out vec4 fragPosLightSpace;
 
-uniform mat4 MV;
-uniform mat4 MVP;
-uniform mat3 normalMatrix;
-uniform mat4 M;
-uniform mat4 lightSpaceMatrix;
+vec3 decodeOctNormal(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
 
 void main()
 {
+#ifdef SANDBOX_MDI
+    drawID = gl_DrawIDARB;
+    DrawData drawData = draws[drawID];
+    mat4 drawM = M * drawData.model;
+    mat4 drawMV = MV * drawData.model;
+    mat4 drawMVP = MVP * drawData.model;
+    mat3 drawNormalMatrix = normalMatrix * mat3(drawData.normalModel);
+    vec3 vert = inVert * drawData.posScale.xyz + drawData.posBias.xyz;
+    vec3 normal = drawData.posScale.w > 0.5 ? decodeOctNormal(inNormal.xy) : inNormal;
+#else
+    mat4 drawM = M;
+    mat4 drawMV = MV;
+    mat4 drawMVP = MVP;
+    mat3 drawNormalMatrix = normalMatrix;
+    vec3 vert = inVert * posDequantScale.xyz + posDequantBias.xyz;
+    vec3 normal = posDequantScale.w > 0.5 ? decodeOctNormal(inNormal.xy) : inNormal;
+#endif
+
     // Calculate the fragment's surface normal
-    fragmentNormal = normalMatrix * inNormal;
+    fragmentNormal = drawNormalMatrix * normal;
     
-    if (Normalize)
+    if (posDequantBias.w > 0.5)
     {
         fragmentNormal = normalize(fragmentNormal);
     }
@@ -72,25 +82,25 @@ void main()
     // Generate tangent and bitangent for anisotropic shading
     // For cloth, we use screen-space derivatives approximation
     // In production, these would come from vertex attributes
-    vec3 worldNormal = normalize((M * vec4(inNormal, 0.0)).xyz);
+    vec3 worldNormal = normalize((drawM * vec4(normal, 0.0)).xyz);
     
     // Create tangent frame - for cloth, tangent follows U direction (warp threads)
     vec3 up = abs(worldNormal.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
-    fragmentTangent = normalize(normalMatrix * normalize(cross(up, inNormal)));
+    fragmentTangent = normalize(drawNormalMatrix * normalize(cross(up, normal)));
     fragmentBitangent = normalize(cross(fragmentNormal, fragmentTangent));
     
     // Pass UV coordinates for weave pattern
     fragUV = inUV;
     
     // Calculate the vertex position
-    gl_Position = MVP * vec4(inVert, 1.0);
+    gl_Position = drawMVP * vec4(vert, 1.0);
     
-    vec4 worldPosition = M * vec4(inVert, 1.0);
+    vec4 worldPosition = drawM * vec4(vert, 1.0);
     worldPos = worldPosition.xyz;
-    eyeDirection = normalize(viewerPos - worldPosition.xyz);
+    eyeDirection = normalize(camera.position - worldPosition.xyz);
     
     // Get vertex position in eye coordinates
-    vec4 eyeCord = MV * vec4(inVert, 1.0);
+    vec4 eyeCord = drawMV * vec4(vert, 1.0);
     vPosition = eyeCord.xyz / eyeCord.w;
     
     // Light direction
@@ -100,5 +110,5 @@ void main()
     halfVector = normalize(eyeDirection + lightDir);
     
     // Calculate position in light space for shadow mapping
-    fragPosLightSpace = lightSpaceMatrix * worldPosition;
+    fragPosLightSpace = lightSpaceMatrices[0] * worldPosition;
 }
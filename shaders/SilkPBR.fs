@@ -1,4 +1,28 @@
 #version 460 core
+// Extra lights come from per-cluster lists when SSBOs are available (LightClusters.h),
+// otherwise from the first MAX_LIGHTS frame block lights
+#extension GL_ARB_shader_storage_buffer_object : enable
+#ifdef GL_ARB_shader_storage_buffer_object
+#define SANDBOX_CLUSTERED_LIGHTS 1
+#endif
+#ifdef SANDBOX_MDI
+// Multi-draw-indirect variant: material comes from the per-draw buffer (see IndirectBatch.h)
+#extension GL_ARB_shader_storage_buffer_object : require
+struct DrawData
+{
+  mat4 model;
+  mat4 normalModel;   // inverse-transpose of model
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  vec4 params;        // rgb: subsurface colour, a: shininess
+  vec4 posScale;      // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posBias;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer { DrawData draws[]; };
+flat in int drawID;
+#endif
+#include "UniformBlocks.glsl"
 // Inputs from vertex shader
 in vec3 fragmentNormal;
 in vec3 fragmentTangent;
@@ -10,67 +34,49 @@ in vec3 eyeDirection;
 
 out vec4 fragColour;
 
-// Multi-shadow support
-const int MAX_SHADOW_LIGHTS = 4;
-const int MAX_LIGHTS = 8;
-uniform sampler2DShadow shadowMaps[MAX_SHADOW_LIGHTS];
-uniform mat4 lightSpaceMatrices[MAX_SHADOW_LIGHTS];
-uniform float lightIntensities[MAX_SHADOW_LIGHTS];
-uniform int numShadowLights;
-uniform float shadowMapSize;
-uniform float shadowBias;
-uniform float shadowSoftness;
-uniform int shadowEnabled;
-
-// Material
-struct Material {
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    float shininess;
-};
-uniform Material material;
-
-// Main light
-struct Light {
-    vec4 position;
-    vec3 direction;
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    float constantAttenuation;
-    float linearAttenuation;
-    float quadraticAttenuation;
-};
-uniform Light light;
+// Shadow maps: one depth array with a layer per shadow light (texture unit 5, bound by
+// Renderer::setupLighting); layer 0 doubles as the legacy single map
+layout(binding = 5) uniform sampler2DArrayShadow shadowMaps;
+// Casters redrawn every frame when Shadow::setDynamicSplit is on (unit 6); their
+// depth is combined with the cached static layer at sample time
+layout(binding = 6) uniform sampler2DArrayShadow shadowMapsDynamic;
+
+// Block fields under the names the lighting code uses, set by loadUniformBlocks
+int numShadowLights;
+float shadowMapSize;
+float shadowBias;
+float shadowSoftness;
+int shadowEnabled;
+int shadowSplit;
+int shadowCascades;
 
-// Additional lights array
-uniform int numLights;
-uniform vec3 lightPositions[MAX_LIGHTS];
-uniform vec3 lightColors[MAX_LIGHTS];
-uniform float lightIntensitiesExtra[MAX_LIGHTS];
+// Material from the draw block, or the per-draw buffer for multi-draw
+Materials material;
+
+// Additional lights
+int numLights;
 
 // PBR parameters
-uniform float roughness;        // 0.0 = smooth, 1.0 = rough
-uniform float metallic;         // 0.0 = dielectric, 1.0 = metal (typically 0 for fabric)
-uniform float anisotropy;       // -1.0 to 1.0 anisotropic stretch
-uniform float sheenIntensity;   // Sheen layer strength
-uniform vec3 sheenColor;        // Sheen tint
-uniform float subsurfaceAmount; // SSS strength
-uniform vec3 subsurfaceColor;   // SSS color
-uniform float weaveScale;       // Micro-detail weave pattern
+float roughness;        // 0.0 = smooth, 1.0 = rough
+float metallic;         // 0.0 = dielectric, 1.0 = metal (typically 0 for fabric)
+float anisotropy;       // -1.0 to 1.0 anisotropic stretch
+float sheenIntensity;   // Sheen layer strength
+vec3 sheenColor;        // Sheen tint
+float subsurfaceAmount; // SSS strength
+vec3 subsurfaceColor;   // SSS color
+float weaveScale;       // Micro-detail weave pattern
 
 // Checker pattern
-uniform float checkerScale;
-uniform vec3 checkerColor1;
-uniform vec3 checkerColor2;
+float checkerScale;
+vec3 checkerColor1;
+vec3 checkerColor2;
 
 // AO
-uniform float aoStrength;
-uniform vec3 aoGroundColor;
+float aoStrength;
+vec3 aoGroundColor;
 
-uniform vec3 viewerPos;
-uniform vec3 lightWorldPos;  // Light position in world space for PBR calculations
+vec3 viewerPos;
+vec3 lightWorldPos;  // Light position in world space for PBR calculations
 
 const float PI = 3.14159265359;
 
@@ -203,7 +209,15 @@ float computeAO(vec3 N, vec3 V) {
 // Shadow Functions
 // ============================================================================
 
-float calculateShadowForMap(sampler2DShadow sMap, vec4 lsPos, vec3 normal, vec3 lightDir) {
+// Lit fraction of one shadow map tap: a fragment is lit only if both layers agree
+float sampleShadow(vec4 coord)
+{
+    float lit = texture(shadowMaps, coord);
+    if (shadowSplit != 0) lit = min(lit, texture(shadowMapsDynamic, coord));
+    return lit;
+}
+
+float calculateShadowForMap(int layer, vec4 lsPos, vec3 normal, vec3 lightDir) {
     vec3 projCoords = lsPos.xyz / lsPos.w;
     projCoords = projCoords * 0.5 + 0.5;
     
@@ -220,13 +234,23 @@ float calculateShadowForMap(sampler2DShadow sMap, vec4 lsPos, vec3 normal, vec3
     
     for (int x = -2; x <= 2; ++x) {
         for (int y = -2; y <= 2; ++y) {
-            vec3 sampleCoord = vec3(projCoords.xy + vec2(x, y) * texelSize * shadowSoftness, currentDepth);
-            shadow += texture(sMap, sampleCoord);
+            vec4 sampleCoord = vec4(projCoords.xy + vec2(x, y) * texelSize * shadowSoftness, float(layer), currentDepth);
+            shadow += sampleShadow(sampleCoord);
         }
     }
     return shadow / 25.0;
 }
 
+// Main light cascade covering this fragment (by view depth), -1 beyond the last one
+int shadowCascade()
+{
+    float depth = -(camera.viewMatrix * vec4(worldPos, 1.0)).z;
+    for (int c = 0; c < shadowCascades && c < MAX_CASCADES; ++c) {
+        if (depth < cascadeSplits[c]) return c;
+    }
+    return -1;
+}
+
 float calculateMultiShadow(vec3 normal, vec3 lightDir) {
     if (shadowEnabled == 0) return 1.0;
     if (numShadowLights <= 0) return 1.0;
@@ -236,8 +260,11 @@ float calculateMultiShadow(vec3 normal, vec3 lightDir) {
     vec4 wPos = vec4(worldPos, 1.0);
     
     for (int i = 0; i < numShadowLights && i < MAX_SHADOW_LIGHTS; ++i) {
-        vec4 lsPos = lightSpaceMatrices[i] * wPos;
-        float rawShadow = calculateShadowForMap(shadowMaps[i], lsPos, normal, lightDir);
+        // The main light reads the cascade covering this fragment; the extra shadow
+        // lights' layers follow the cascades
+        int layer = i == 0 ? shadowCascade() : shadowCascades + i - 1;
+        float rawShadow = 1.0;
+        if (layer >= 0) rawShadow = calculateShadowForMap(layer, lightSpaceMatrices[layer] * wPos, normal, lightDir);
         float intensity = lightIntensities[i];
         
         float shadowContrib = (1.0 - rawShadow) * intensity;
@@ -301,7 +328,87 @@ vec3 calculatePBR(vec3 N, vec3 V, vec3 L, vec3 H, vec3 T, vec3 B,
     return Lo;
 }
 
+#ifdef SANDBOX_CLUSTERED_LIGHTS
+struct ClusterLight
+{
+  vec4 positionRange;   // world xyz, w: range
+  vec4 colorIntensity;  // rgb, a: intensity
+};
+layout(std430, binding = 6) readonly buffer ClusterLightBuffer { ClusterLight clusterLights[]; };
+layout(std430, binding = 7) readonly buffer ClusterGridBuffer
+{
+  vec4 clusterParams;   // tiles per pixel x/y, depth slice scale and bias
+  uvec4 clusterDims;    // clusters x/y/z, light count
+  uvec2 clusterRanges[];
+};
+layout(std430, binding = 8) readonly buffer ClusterIndexBuffer
+{
+  uint clusterIndexCount;
+  uint clusterLightIndices[];
+};
+
+// First list entry and light count of this fragment's cluster
+uvec2 clusterLightRange()
+{
+    float depth = max(-(camera.viewMatrix * vec4(worldPos, 1.0)).z, 1e-4);
+    vec3 cell = vec3(gl_FragCoord.xy * clusterParams.xy, log(depth) * clusterParams.z + clusterParams.w);
+    uvec3 c = uvec3(clamp(cell, vec3(0.0), vec3(clusterDims.xyz - uvec3(1u))));
+    return clusterRanges[(c.z * clusterDims.y + c.y) * clusterDims.x + c.x];
+}
+#endif
+
+// Falls smoothly to zero at a light's range, so culling the light beyond it is invisible
+float rangeWindow(float dist, float range)
+{
+    float x = dist / max(range, 1e-4);
+    x = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return x * x;
+}
+
+vec3 extraLightPBR(vec3 N, vec3 V, vec3 T, vec3 B, vec3 albedo, float shadow,
+                   vec4 positionRange, vec4 colorIntensity)
+{
+    vec3 Li = normalize(positionRange.xyz - worldPos);
+    vec3 Hi = normalize(V + Li);
+    float dist = length(positionRange.xyz - worldPos);
+    float atten = colorIntensity.a / (1.0 + 0.01 * dist + 0.001 * dist * dist) * rangeWindow(dist, positionRange.w);
+    return calculatePBR(N, V, Li, Hi, T, B, albedo, colorIntensity.rgb * atten, shadow);
+}
+
+void loadUniformBlocks() {
+#ifdef SANDBOX_MDI
+    material = Materials(draws[drawID].ambient, draws[drawID].diffuse, draws[drawID].specular, draws[drawID].params.a);
+    subsurfaceColor = draws[drawID].params.rgb;
+#else
+    material = drawMaterial;
+    subsurfaceColor = drawSubsurfaceColor.rgb;
+#endif
+    shadowEnabled = lightCounts.x;
+    shadowSplit = lightCounts.w;
+    shadowCascades = shadowLayout.x;
+    numShadowLights = lightCounts.y;
+    numLights = lightCounts.z;
+    shadowBias = shadowParams.x;
+    shadowSoftness = shadowParams.y;
+    shadowMapSize = shadowParams.z;
+    roughness = fabricParams.x;
+    metallic = fabricParams.y;
+    anisotropy = fabricParams.z;
+    sheenIntensity = fabricParams.w;
+    weaveScale = fabricParams2.z;
+    sheenColor = sheenParams.rgb;
+    subsurfaceAmount = sheenParams.a;
+    checkerScale = checkerParams1.a;
+    checkerColor1 = checkerParams1.rgb;
+    checkerColor2 = checkerParams2.rgb;
+    aoStrength = aoParams.a;
+    aoGroundColor = aoParams.rgb;
+    viewerPos = camera.position;
+    lightWorldPos = lightWorldPosition.xyz;
+}
+
 void main() {
+    loadUniformBlocks();
     // Build TBN frame
     vec3 N = normalize(fragmentNormal);
     vec3 T = normalize(fragmentTangent);
@@ -336,19 +443,17 @@ void main() {
     vec3 Lo = calculatePBR(N, V, L, H, T, B, albedo, radiance, shadow);
     
     // Additional lights
+#ifdef SANDBOX_CLUSTERED_LIGHTS
+    uvec2 lightRange = clusterLightRange();
+    for (uint i = 0u; i < lightRange.y; ++i) {
+        ClusterLight l = clusterLights[clusterLightIndices[lightRange.x + i]];
+        Lo += extraLightPBR(N, V, T, B, albedo, shadow, l.positionRange, l.colorIntensity);
+    }
+#else
     for (int i = 0; i < numLights && i < MAX_LIGHTS; ++i) {
-        vec3 lPos = lightPositions[i];
-        vec3 lColor = lightColors[i];
-        float lIntensity = lightIntensitiesExtra[i];
-        
-        vec3 Li = normalize(lPos - worldPos);
-        vec3 Hi = normalize(V + Li);
-        float dist = length(lPos - worldPos);
-        float atten = lIntensity / (1.0 + 0.01 * dist + 0.001 * dist * dist);
-        vec3 rad = lColor * atten;
-        
-        Lo += calculatePBR(N, V, Li, Hi, T, B, albedo, rad, shadow);
+        Lo += extraLightPBR(N, V, T, B, albedo, shadow, extraLightPositions[i], extraLightColors[i]);
     }
+#endif
     
     // Ambient
     vec3 F = fresnelSchlickRoughness(max(dot(N, V), 0.0), vec3(0.04), roughness);
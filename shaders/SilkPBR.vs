@@ -1,8 +1,25 @@
 #version 460 core
+#ifdef SANDBOX_MDI
+// Multi-draw-indirect variant: per-draw data indexed by gl_DrawIDARB (see IndirectBatch.h)
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_ARB_shader_storage_buffer_object : require
+struct DrawData
+{
+  mat4 model;
+  mat4 normalModel;   // inverse-transpose of model
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  vec4 params;        // rgb: subsurface colour, a: shininess
+  vec4 posScale;      // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posBias;
+};
+layout(std430, binding = 0) readonly buffer DrawBuffer { DrawData draws[]; };
+flat out int drawID;
+#endif
 /// @brief PBR Silk/Fabric Vertex Shader
 
-uniform bool Normalize;
-uniform vec3 viewerPos;
+#include "UniformBlocks.glsl"
 
 in vec3 inVert;
 in vec3 inNormal;
@@ -16,20 +33,42 @@ out vec3 vPosition;
 out vec2 fragUV;
 out vec3 eyeDirection;
 
-uniform mat4 MV;
-uniform mat4 MVP;
-uniform mat3 normalMatrix;
-uniform mat4 M;
+vec3 decodeOctNormal(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
 
 void main() {
+#ifdef SANDBOX_MDI
+    drawID = gl_DrawIDARB;
+    DrawData drawData = draws[drawID];
+    mat4 drawM = M * drawData.model;
+    mat4 drawMV = MV * drawData.model;
+    mat4 drawMVP = MVP * drawData.model;
+    mat3 drawNormalMatrix = normalMatrix * mat3(drawData.normalModel);
+    vec3 vert = inVert * drawData.posScale.xyz + drawData.posBias.xyz;
+    vec3 normal = drawData.posScale.w > 0.5 ? decodeOctNormal(inNormal.xy) : inNormal;
+#else
+    mat4 drawM = M;
+    mat4 drawMV = MV;
+    mat4 drawMVP = MVP;
+    mat3 drawNormalMatrix = normalMatrix;
+    vec3 vert = inVert * posDequantScale.xyz + posDequantBias.xyz;
+    vec3 normal = posDequantScale.w > 0.5 ? decodeOctNormal(inNormal.xy) : inNormal;
+#endif
+
     // World position for lighting calculations
-    vec4 worldPosition = M * vec4(inVert, 1.0);
+    vec4 worldPosition = drawM * vec4(vert, 1.0);
     worldPos = worldPosition.xyz;
     
     // Transform normal to WORLD space for PBR (not view space)
-    mat3 worldNormalMatrix = mat3(transpose(inverse(M)));
-    fragmentNormal = worldNormalMatrix * inNormal;
-    if (Normalize) {
+    mat3 worldNormalMatrix = mat3(transpose(inverse(drawM)));
+    fragmentNormal = worldNormalMatrix * normal;
+    if (posDequantBias.w > 0.5) {
         fragmentNormal = normalize(fragmentNormal);
     }
     
@@ -40,15 +79,15 @@ void main() {
     fragmentBitangent = normalize(cross(worldNormal, fragmentTangent));
     
     // Eye direction in world space
-    eyeDirection = normalize(viewerPos - worldPos);
+    eyeDirection = normalize(camera.position - worldPos);
     
     // Position in eye coordinates (for compatibility)
-    vec4 eyeCord = MV * vec4(inVert, 1.0);
+    vec4 eyeCord = drawMV * vec4(vert, 1.0);
     vPosition = eyeCord.xyz / eyeCord.w;
     
     // Pass UV
     fragUV = inUV;
     
     // Final position
-    gl_Position = MVP * vec4(inVert, 1.0);
+    gl_Position = drawMVP * vec4(vert, 1.0);
 }
@@ -0,0 +1,65 @@
+// Uniform blocks shared by the lit programs (std140, see UBOStructures.h and UniformBlocks.h).
+// The one GLSL copy of the layout: Phong, Silk and SilkPBR (.vs/.fs) pull it in with
+// #include "UniformBlocks.glsl", which ShaderLib expands when it loads them.
+const int MAX_SHADOW_LIGHTS = 4;
+const int MAX_CASCADES = 4;
+const int MAX_SHADOW_LAYERS = 7;     // cascades, then one per extra shadow light
+const int MAX_LIGHTS = 8;
+struct Materials
+{
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  float shininess;
+};
+struct Lights
+{
+  vec4 position;        // view space
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+  float constantAttenuation;
+  float linearAttenuation;
+  float quadraticAttenuation;
+  float spotCosCutoff;
+};
+struct Cameras
+{
+  vec3 position;
+  float nearPlane;
+  vec3 direction;
+  float farPlane;
+  mat4 viewMatrix;
+  mat4 projMatrix;
+};
+layout(std140, binding = 4) uniform FrameBlock
+{
+  Cameras camera;
+  Lights light;
+  vec4 lightWorldPosition;
+  mat4 lightSpaceMatrices[MAX_SHADOW_LAYERS];
+  vec4 lightIntensities;                  // one per shadow light
+  vec4 shadowParams;                      // bias, softness, map size, strength
+  vec4 cascadeSplits;                     // view depth where each cascade ends
+  ivec4 shadowLayout;                     // x: main light cascade count, yzw unused
+  ivec4 lightCounts;                      // shadows enabled, shadow lights, extra lights, dynamic shadow layer
+  vec4 extraLightPositions[MAX_LIGHTS];   // w: range
+  vec4 extraLightColors[MAX_LIGHTS];      // a: intensity
+  vec4 checkerParams1;                    // rgb: colour, a: scale (0 = off)
+  vec4 checkerParams2;
+  vec4 fabricParams;                      // roughness, metallic, anisotropy, sheen intensity
+  vec4 fabricParams2;                     // anisotropy U, anisotropy V, weave scale, time
+  vec4 sheenParams;                       // rgb: sheen colour, a: subsurface amount
+};
+layout(std140, binding = 5) uniform DrawBlock
+{
+  mat4 MVP;
+  mat4 MV;
+  mat4 M;
+  mat3 normalMatrix;
+  Materials drawMaterial;
+  vec4 posDequantScale;                   // packed-vertex decode; w > 0.5: octahedral normals
+  vec4 posDequantBias;                    // w > 0.5: normalize normals
+  vec4 aoParams;                          // rgb: ground colour, a: strength
+  vec4 drawSubsurfaceColor;
+};
@@ -0,0 +1,172 @@
+/// @file CommandBuffer.cpp
+/// @brief Command recording and GL replay
+
+#include "CommandBuffer.h"
+#include "GLState.h"
+
+namespace gfx {
+
+namespace {
+    // Every command starts with this header; payloads are read back with memcpy
+    struct CommandHeader {
+        uint32_t op;
+        uint32_t payloadBytes;
+    };
+
+    struct ElementsArgs {
+        GLsizei indexCount;
+        GLenum indexType;
+        const void* offset;
+        GLint baseVertex;
+    };
+
+    struct InstancedArgs {
+        GLsizei indexCount;
+        GLenum indexType;
+        const void* offset;
+        GLsizei instanceCount;
+        GLint baseVertex;
+    };
+
+    struct MultiElementsArgs {
+        GLenum indexType;
+        GLsizei drawCount;
+        GLint baseVertex;
+    };
+
+    template <typename T>
+    T read(const unsigned char* payload) {
+        T value;
+        std::memcpy(&value, payload, sizeof(T));
+        return value;
+    }
+}
+
+unsigned char* CommandBuffer::append(Op op, size_t payloadBytes) {
+    const size_t at = m_data.size();
+    m_data.resize(at + sizeof(CommandHeader) + payloadBytes);
+    const CommandHeader header{op, static_cast<uint32_t>(payloadBytes)};
+    std::memcpy(m_data.data() + at, &header, sizeof(header));
+    return m_data.data() + at + sizeof(header);
+}
+
+void CommandBuffer::useProgram(ShaderLib::ProgramWrapper* program) {
+    appendValue(UseProgram, program);
+}
+
+void CommandBuffer::bindFrame(UniformBlocks::FrameSlot slot) {
+    appendValue(BindFrame, slot);
+}
+
+void CommandBuffer::polygonMode(GLenum mode) {
+    appendValue(PolygonMode, mode);
+}
+
+void CommandBuffer::writeDrawBlock(const FlockingShaders::DrawBlock* block) {
+    appendValue(WriteDrawBlock, block);
+}
+
+void CommandBuffer::bindVertexArray(GLuint vao) {
+    appendValue(BindVertexArray, vao);
+}
+
+void CommandBuffer::drawArrays(GLsizei vertexCount) {
+    appendValue(DrawArrays, vertexCount);
+}
+
+void CommandBuffer::drawElements(GLsizei indexCount, GLenum indexType, const void* offset, GLint baseVertex) {
+    appendValue(DrawElements, ElementsArgs{indexCount, indexType, offset, baseVertex});
+}
+
+void CommandBuffer::drawElementsInstanced(GLsizei indexCount, GLenum indexType, const void* offset,
+                                          GLsizei instanceCount, GLint baseVertex) {
+    if (instanceCount <= 0) return;
+    appendValue(DrawElementsInstanced, InstancedArgs{indexCount, indexType, offset, instanceCount, baseVertex});
+}
+
+void CommandBuffer::multiDrawElements(GLenum indexType, const GLsizei* counts, const void* const* offsets,
+                                      GLsizei drawCount, GLint baseVertex) {
+    if (drawCount <= 0) return;
+    const size_t countBytes = sizeof(GLsizei) * static_cast<size_t>(drawCount);
+    const size_t offsetBytes = sizeof(const void*) * static_cast<size_t>(drawCount);
+    unsigned char* out = append(MultiDrawElements, sizeof(MultiElementsArgs) + countBytes + offsetBytes);
+    const MultiElementsArgs args{indexType, drawCount, baseVertex};
+    std::memcpy(out, &args, sizeof(args));
+    std::memcpy(out + sizeof(args), counts, countBytes);
+    std::memcpy(out + sizeof(args) + countBytes, offsets, offsetBytes);
+}
+
+void CommandBuffer::replay() const {
+    // GL wants aligned arrays; multi-draw payloads are copied out here
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    static std::vector<GLint> baseVertices;
+
+    const unsigned char* cursor = m_data.data();
+    const unsigned char* end = cursor + m_data.size();
+    while (cursor < end) {
+        const CommandHeader header = read<CommandHeader>(cursor);
+        const unsigned char* payload = cursor + sizeof(CommandHeader);
+        cursor = payload + header.payloadBytes;
+
+        switch (header.op) {
+            case UseProgram:
+                read<ShaderLib::ProgramWrapper*>(payload)->use();
+                break;
+            case BindFrame:
+                UniformBlocks::bindFrame(read<UniformBlocks::FrameSlot>(payload));
+                break;
+            case PolygonMode:
+                GLState::polygonMode(read<GLenum>(payload));
+                break;
+            case WriteDrawBlock:
+                UniformBlocks::draw() = *read<const FlockingShaders::DrawBlock*>(payload);
+                UniformBlocks::commitDraw();
+                break;
+            case BindVertexArray:
+                GLState::bindVertexArray(read<GLuint>(payload));
+                break;
+            case DrawArrays:
+                glDrawArrays(GL_TRIANGLES, 0, read<GLsizei>(payload));
+                break;
+            case DrawElements: {
+                const ElementsArgs args = read<ElementsArgs>(payload);
+                if (args.baseVertex != 0) {
+                    glDrawElementsBaseVertex(GL_TRIANGLES, args.indexCount, args.indexType, args.offset,
+                                             args.baseVertex);
+                } else {
+                    glDrawElements(GL_TRIANGLES, args.indexCount, args.indexType, args.offset);
+                }
+                break;
+            }
+            case DrawElementsInstanced: {
+                const InstancedArgs args = read<InstancedArgs>(payload);
+                if (args.baseVertex != 0) {
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, args.indexCount, args.indexType, args.offset,
+                                                      args.instanceCount, args.baseVertex);
+                } else {
+                    glDrawElementsInstanced(GL_TRIANGLES, args.indexCount, args.indexType, args.offset,
+                                            args.instanceCount);
+                }
+                break;
+            }
+            case MultiDrawElements: {
+                const MultiElementsArgs args = read<MultiElementsArgs>(payload);
+                const size_t n = static_cast<size_t>(args.drawCount);
+                counts.resize(n);
+                offsets.resize(n);
+                baseVertices.assign(n, args.baseVertex);
+                std::memcpy(counts.data(), payload + sizeof(args), sizeof(GLsizei) * n);
+                std::memcpy(offsets.data(), payload + sizeof(args) + sizeof(GLsizei) * n, sizeof(const void*) * n);
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), args.indexType, offsets.data(),
+                                              args.drawCount, baseVertices.data());
+                break;
+            }
+            case Invoke:
+                read<Thunk>(payload)(payload + sizeof(Thunk));
+                break;
+        }
+    }
+}
+
+} // namespace gfx
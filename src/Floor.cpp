@@ -3,7 +3,9 @@
 #include <GeometryFactory.h>
 #include <Material.h>
 #include <Matrix.h>
+#include <RenderQueue.h>
 #include <ShaderLib.h>
+#include <UniformBlocks.h>
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 
@@ -22,33 +24,33 @@ Floor::Floor(float width, float length, int /*pWidth*/, int /*pLength*/, Vector
   m_color = Colour(0.5f, 0.5f, 0.5f);
 }
 
-void Floor::draw(const std::string &_shaderName, TransformStack &_transform, Camera *_cam) const {
+void Floor::submit(gfx::RenderQueue &_queue, const std::string &_shaderName, TransformStack &_transform,
+                   Camera *_cam) const {
   ShaderLib *shader = ShaderLib::instance();
   auto wrapper = (*shader)[_shaderName];
   if (!wrapper) return;
-  wrapper->use();
+  static auto planeGeometry = FlockingGraphics::GeometryFactory::instance().createCube(1.0f);
+  if (!planeGeometry) return;
+  FlockingShaders::DrawBlock& block = UniformBlocks::draw();
 
   // Set floor material - brighter ambient for visibility
-  wrapper->setUniform("material.ambient", glm::vec4(m_color.m_r * 0.6f, m_color.m_g * 0.6f, m_color.m_b * 0.6f, 1.0f));
-  wrapper->setUniform("material.diffuse", glm::vec4(m_color.m_r, m_color.m_g, m_color.m_b, 1.0f));
-  wrapper->setUniform("material.specular", glm::vec4(0.3f, 0.3f, 0.3f, 1.0f));
-  wrapper->setUniform("material.shininess", 16.0f);
+  block.material.ambient = glm::vec4(m_color.m_r * 0.6f, m_color.m_g * 0.6f, m_color.m_b * 0.6f, 1.0f);
+  block.material.diffuse = glm::vec4(m_color.m_r, m_color.m_g, m_color.m_b, 1.0f);
+  block.material.specular = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);
+  block.material.shininess = 16.0f;
   
   // Disable AO for floor (it IS the ground)
-  wrapper->setUniform("aoStrength", 0.0f);
-  wrapper->setUniform("aoGroundColor", glm::vec3(1.0f, 1.0f, 1.0f));
-
-  glPolygonMode(GL_FRONT_AND_BACK, m_floorWireframe ? GL_LINE : GL_FILL);
-
-  static auto planeGeometry = FlockingGraphics::GeometryFactory::instance().createCube(1.0f);
+  block.aoGroundColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
 
   _transform.pushTransform();
   _transform.setPosition(m_position);
   _transform.setScale(m_width, 0.1f, m_length);
-  Renderer::loadMatricesToShader(_shaderName, _transform, _cam);
-
-  if (planeGeometry) planeGeometry->render();
+  UniformBlocks::setTransforms(_transform.getCurrentTransform(), _cam->getViewMatrix(), _cam->getProjectionMatrix());
   _transform.popTransform();
+
+  const FlockingGraphics::Geometry* geometry = planeGeometry.get();
+  _queue.submit(gfx::RenderQueue::Opaque, wrapper, glm::vec3(m_position.m_x, m_position.m_y, m_position.m_z),
+                [geometry](gfx::CommandBuffer& cmd) { geometry->record(cmd); }, m_floorWireframe ? GL_LINE : GL_FILL);
 }
 
 void Floor::setPosition(Vector position) { m_position = position; }
@@ -0,0 +1,272 @@
+/// @file GLState.cpp
+/// @brief Redundant state filtering for the render context
+
+#include "GLState.h"
+
+#include <cstring>
+
+namespace GLState {
+
+namespace {
+    // Cached value that matches nothing, so the next call always goes through
+    constexpr GLuint kUnknown = ~0u;
+    constexpr GLuint kMaxTextureUnits = 16;
+    constexpr GLuint kMaxIndexedBindings = 16;
+
+    enum BufferSlot {
+        ArrayBuffer, CopyReadBuffer, CopyWriteBuffer, DrawIndirectBuffer,
+        ShaderStorageBuffer, UniformBuffer, BUFFER_SLOT_COUNT
+    };
+    enum TextureSlot { Texture2D, Texture2DArray, TEXTURE_SLOT_COUNT };
+    enum IndexedSlot { IndexedUniform, IndexedStorage, INDEXED_SLOT_COUNT };
+
+    struct IndexedBinding {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;  // 0 for glBindBufferBase
+    };
+
+    struct Cache {
+        GLuint program;
+        GLuint vao;
+        GLuint buffers[BUFFER_SLOT_COUNT];
+        IndexedBinding indexed[INDEXED_SLOT_COUNT][kMaxIndexedBindings];
+        GLuint activeUnit;
+        GLuint textures[kMaxTextureUnits][TEXTURE_SLOT_COUNT];
+        GLuint drawFramebuffer;
+        GLuint readFramebuffer;
+        GLuint polygonMode;
+        GLuint cullEnabled;   // 0, 1 or kUnknown
+        GLuint cullFace;
+        GLuint depthEnabled;
+        GLuint depthFunc;
+        GLuint depthMask;
+    };
+
+    Cache s_cache;
+    Stats s_stats;
+    bool s_dsa = false;
+
+    int bufferSlot(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER: return ArrayBuffer;
+            case GL_COPY_READ_BUFFER: return CopyReadBuffer;
+            case GL_COPY_WRITE_BUFFER: return CopyWriteBuffer;
+            case GL_DRAW_INDIRECT_BUFFER: return DrawIndirectBuffer;
+            case GL_SHADER_STORAGE_BUFFER: return ShaderStorageBuffer;
+            case GL_UNIFORM_BUFFER: return UniformBuffer;
+            default: return -1;
+        }
+    }
+
+    int textureSlot(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D: return Texture2D;
+            case GL_TEXTURE_2D_ARRAY: return Texture2DArray;
+            default: return -1;
+        }
+    }
+
+    int indexedSlot(GLenum target) {
+        switch (target) {
+            case GL_UNIFORM_BUFFER: return IndexedUniform;
+            case GL_SHADER_STORAGE_BUFFER: return IndexedStorage;
+            default: return -1;
+        }
+    }
+
+    // Record value in cached; true when the call is needed
+    bool update(GLuint& cached, GLuint value) {
+        if (cached == value) {
+            ++s_stats.skipped;
+            return false;
+        }
+        cached = value;
+        ++s_stats.issued;
+        return true;
+    }
+
+    void setCapability(GLuint& cached, GLenum capability, bool enabled) {
+        if (!update(cached, enabled ? 1u : 0u)) return;
+        if (enabled) glEnable(capability);
+        else glDisable(capability);
+    }
+
+    void activeUnit(GLuint unit) {
+        if (update(s_cache.activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // Bindings a deleted name must no longer satisfy
+    void forget(GLuint* values, size_t count, GLuint name) {
+        for (size_t i = 0; i < count; ++i) {
+            if (values[i] == name) values[i] = 0;
+        }
+    }
+}
+
+void init() {
+    s_dsa = GLAD_GL_ARB_direct_state_access != 0;
+    invalidate();
+}
+
+void invalidate() {
+    // Every field is a GLuint-sized value or built from them; all-ones reads as kUnknown
+    std::memset(&s_cache, 0xff, sizeof(s_cache));
+}
+
+bool hasDSA() {
+    return s_dsa;
+}
+
+void useProgram(GLuint program) {
+    if (update(s_cache.program, program)) glUseProgram(program);
+}
+
+void bindVertexArray(GLuint vao) {
+    if (update(s_cache.vao, vao)) glBindVertexArray(vao);
+}
+
+void bindBuffer(GLenum target, GLuint buffer) {
+    const int slot = bufferSlot(target);
+    if (slot < 0) {
+        ++s_stats.issued;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (update(s_cache.buffers[slot], buffer)) glBindBuffer(target, buffer);
+}
+
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    bindBufferRange(target, index, buffer, 0, 0);
+}
+
+void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    const int slot = indexedSlot(target);
+    if (slot >= 0 && index < kMaxIndexedBindings) {
+        IndexedBinding& cached = s_cache.indexed[slot][index];
+        if (cached.buffer == buffer && cached.offset == offset && cached.size == size) {
+            ++s_stats.skipped;
+            return;
+        }
+        cached = IndexedBinding{buffer, offset, size};
+    }
+    ++s_stats.issued;
+    if (size > 0) glBindBufferRange(target, index, buffer, offset, size);
+    else glBindBufferBase(target, index, buffer);
+    const int generic = bufferSlot(target);
+    if (generic >= 0) s_cache.buffers[generic] = buffer;
+}
+
+void bufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+    if (s_dsa) {
+        ++s_stats.issued;
+        glNamedBufferSubData(buffer, offset, size, data);
+        return;
+    }
+    bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    ++s_stats.issued;
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+void bufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage) {
+    bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    ++s_stats.issued;
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data, usage);
+}
+
+void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    const int slot = textureSlot(target);
+    activeUnit(unit);
+    if (slot < 0 || unit >= kMaxTextureUnits) {
+        ++s_stats.issued;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (update(s_cache.textures[unit][slot], texture)) glBindTexture(target, texture);
+}
+
+void bindFramebuffer(GLenum target, GLuint framebuffer) {
+    if (target == GL_FRAMEBUFFER) {
+        if (s_cache.drawFramebuffer == framebuffer && s_cache.readFramebuffer == framebuffer) {
+            ++s_stats.skipped;
+            return;
+        }
+        s_cache.drawFramebuffer = s_cache.readFramebuffer = framebuffer;
+        ++s_stats.issued;
+        glBindFramebuffer(target, framebuffer);
+        return;
+    }
+    GLuint& cached = target == GL_READ_FRAMEBUFFER ? s_cache.readFramebuffer : s_cache.drawFramebuffer;
+    if (update(cached, framebuffer)) glBindFramebuffer(target, framebuffer);
+}
+
+void polygonMode(GLenum mode) {
+    if (update(s_cache.polygonMode, mode)) glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void setCullFace(bool enabled) {
+    setCapability(s_cache.cullEnabled, GL_CULL_FACE, enabled);
+}
+
+void cullFace(GLenum face) {
+    if (update(s_cache.cullFace, face)) glCullFace(face);
+}
+
+void setDepthTest(bool enabled) {
+    setCapability(s_cache.depthEnabled, GL_DEPTH_TEST, enabled);
+}
+
+void depthFunc(GLenum func) {
+    if (update(s_cache.depthFunc, func)) glDepthFunc(func);
+}
+
+void depthMask(bool write) {
+    if (update(s_cache.depthMask, write ? 1u : 0u)) glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void deleteBuffers(GLsizei count, const GLuint* buffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (!buffers[i]) continue;
+        forget(s_cache.buffers, BUFFER_SLOT_COUNT, buffers[i]);
+        for (auto& slot : s_cache.indexed) {
+            for (IndexedBinding& binding : slot) {
+                if (binding.buffer == buffers[i]) binding = IndexedBinding{0, 0, 0};
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void deleteVertexArrays(GLsizei count, const GLuint* arrays) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (arrays[i]) forget(&s_cache.vao, 1, arrays[i]);
+    }
+    glDeleteVertexArrays(count, arrays);
+}
+
+void deleteTextures(GLsizei count, const GLuint* textures) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (!textures[i]) continue;
+        for (auto& unit : s_cache.textures) forget(unit, TEXTURE_SLOT_COUNT, textures[i]);
+    }
+    glDeleteTextures(count, textures);
+}
+
+void deleteFramebuffers(GLsizei count, const GLuint* framebuffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (!framebuffers[i]) continue;
+        forget(&s_cache.drawFramebuffer, 1, framebuffers[i]);
+        forget(&s_cache.readFramebuffer, 1, framebuffers[i]);
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+const Stats& stats() {
+    return s_stats;
+}
+
+void resetStats() {
+    s_stats = Stats{};
+}
+
+} // namespace GLState
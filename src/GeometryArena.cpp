@@ -0,0 +1,291 @@
+/// @file GeometryArena.cpp
+/// @brief Free-list sub-allocation of shared vertex/index buffers
+
+#include "GeometryArena.h"
+#include "GLState.h"
+
+#include <algorithm>
+
+namespace gfx {
+
+namespace {
+
+// Create a buffer of newBytes and copy the first copyBytes of oldBuffer into it
+GLuint reallocateBuffer(GLuint oldBuffer, size_t copyBytes, size_t newBytes) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newBytes), nullptr, GL_DYNAMIC_DRAW);
+    if (oldBuffer && copyBytes > 0) {
+        GLState::bindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(copyBytes));
+        GLState::bindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (oldBuffer) GLState::deleteBuffers(1, &oldBuffer);
+    return buffer;
+}
+
+} // anonymous namespace
+
+// ---------------------------------------------------------------------------
+// RangeAllocator
+
+void RangeAllocator::reset(size_t capacity) {
+    m_free.clear();
+    m_capacity = capacity;
+    m_freeTotal = capacity;
+    if (capacity > 0) m_free[0] = capacity;
+}
+
+void RangeAllocator::grow(size_t newCapacity) {
+    if (newCapacity <= m_capacity) return;
+    release(m_capacity, newCapacity - m_capacity);
+    m_capacity = newCapacity;
+}
+
+size_t RangeAllocator::allocate(size_t size) {
+    if (size == 0) return 0;
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->second < size) continue;
+        size_t offset = it->first;
+        size_t remaining = it->second - size;
+        m_free.erase(it);
+        if (remaining > 0) m_free[offset + size] = remaining;
+        m_freeTotal -= size;
+        return offset;
+    }
+    return INVALID;
+}
+
+void RangeAllocator::release(size_t offset, size_t size) {
+    if (size == 0) return;
+    m_freeTotal += size;
+    auto next = m_free.lower_bound(offset);
+    // Merge with the following range
+    if (next != m_free.end() && offset + size == next->first) {
+        size += next->second;
+        next = m_free.erase(next);
+    }
+    // Merge with the preceding range
+    if (next != m_free.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    m_free[offset] = size;
+}
+
+size_t RangeAllocator::largestFree() const {
+    size_t largest = 0;
+    for (const auto& range : m_free) largest = std::max(largest, range.second);
+    return largest;
+}
+
+// ---------------------------------------------------------------------------
+// GeometryArena
+
+GeometryArena::~GeometryArena() {
+    destroy();
+}
+
+bool GeometryArena::create(size_t vertexStride, AttributeSetup setupAttributes,
+                           size_t vertexCapacity, size_t indexCapacity) {
+    destroy();
+    if (vertexStride == 0 || !setupAttributes) return false;
+
+    m_stride = vertexStride;
+    m_setupAttributes = setupAttributes;
+    vertexCapacity = std::max<size_t>(vertexCapacity, 1);
+    indexCapacity = std::max<size_t>(indexCapacity, 1);
+
+    glGenVertexArrays(1, &m_vao);
+    m_vbo = reallocateBuffer(0, 0, vertexCapacity * m_stride);
+    m_ebo = reallocateBuffer(0, 0, indexCapacity * sizeof(uint32_t));
+    m_vertexAlloc.reset(vertexCapacity);
+    m_indexAlloc.reset(indexCapacity);
+    bindBuffers();
+    return true;
+}
+
+void GeometryArena::destroy() {
+    if (!m_vao) return;
+    GLState::deleteVertexArrays(1, &m_vao);
+    GLState::deleteBuffers(1, &m_vbo);
+    GLState::deleteBuffers(1, &m_ebo);
+    m_vao = m_vbo = m_ebo = 0;
+    m_blocks.clear();
+    m_freeHandles.clear();
+    m_vertexAlloc.reset(0);
+    m_indexAlloc.reset(0);
+}
+
+void GeometryArena::bindBuffers() {
+    GLState::bindVertexArray(m_vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    m_setupAttributes();
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    GLState::bindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::growVertices(size_t minCapacity) {
+    size_t capacity = std::max(minCapacity, m_vertexAlloc.capacity() * 2);
+    m_vbo = reallocateBuffer(m_vbo, m_vertexAlloc.capacity() * m_stride, capacity * m_stride);
+    m_vertexAlloc.grow(capacity);
+    bindBuffers();
+}
+
+void GeometryArena::growIndices(size_t minCapacity) {
+    size_t capacity = std::max(minCapacity, m_indexAlloc.capacity() * 2);
+    m_ebo = reallocateBuffer(m_ebo, m_indexAlloc.capacity() * sizeof(uint32_t), capacity * sizeof(uint32_t));
+    m_indexAlloc.grow(capacity);
+    bindBuffers();
+}
+
+size_t GeometryArena::allocateVertices(size_t count) {
+    size_t offset = m_vertexAlloc.allocate(count);
+    if (offset == RangeAllocator::INVALID) {
+        growVertices(m_vertexAlloc.capacity() + count);
+        offset = m_vertexAlloc.allocate(count);
+    }
+    return offset;
+}
+
+size_t GeometryArena::allocateIndices(size_t count) {
+    size_t offset = m_indexAlloc.allocate(count);
+    if (offset == RangeAllocator::INVALID) {
+        growIndices(m_indexAlloc.capacity() + count);
+        offset = m_indexAlloc.allocate(count);
+    }
+    return offset;
+}
+
+GeometryArena::Handle GeometryArena::allocate(size_t vertexCount, size_t indexCount) {
+    if (!m_vao) return INVALID_HANDLE;
+
+    Handle handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    } else {
+        handle = static_cast<Handle>(m_blocks.size());
+        m_blocks.emplace_back();
+    }
+
+    Block& b = m_blocks[handle];
+    b.live = true;
+    b.vertexCount = vertexCount;
+    b.indexCount = indexCount;
+    b.firstVertex = allocateVertices(vertexCount);
+    b.firstIndex = allocateIndices(indexCount);
+    return handle;
+}
+
+void GeometryArena::release(Handle handle) {
+    if (handle >= m_blocks.size() || !m_blocks[handle].live) return;
+    Block& b = m_blocks[handle];
+    m_vertexAlloc.release(b.firstVertex, b.vertexCount);
+    m_indexAlloc.release(b.firstIndex, b.indexCount);
+    b = Block{};
+    m_freeHandles.push_back(handle);
+}
+
+void GeometryArena::resizeVertices(Handle handle, size_t vertexCount) {
+    Block& b = m_blocks[handle];
+    if (b.vertexCount == vertexCount) return;
+    m_vertexAlloc.release(b.firstVertex, b.vertexCount);
+    b.vertexCount = vertexCount;
+    b.firstVertex = allocateVertices(vertexCount);
+}
+
+void GeometryArena::resizeIndices(Handle handle, size_t indexCount) {
+    Block& b = m_blocks[handle];
+    if (b.indexCount == indexCount) return;
+    m_indexAlloc.release(b.firstIndex, b.indexCount);
+    b.indexCount = indexCount;
+    b.firstIndex = allocateIndices(indexCount);
+}
+
+void GeometryArena::uploadVertices(Handle handle, size_t first, size_t count, const void* data) {
+    const Block& b = m_blocks[handle];
+    if (count == 0 || first + count > b.vertexCount) return;
+    GLState::bufferSubData(m_vbo, static_cast<GLintptr>((b.firstVertex + first) * m_stride),
+                           static_cast<GLsizeiptr>(count * m_stride), data);
+}
+
+void GeometryArena::uploadIndices(Handle handle, const uint32_t* indices, size_t count) {
+    const Block& b = m_blocks[handle];
+    if (count == 0 || count > b.indexCount) return;
+    GLState::bufferSubData(m_ebo, static_cast<GLintptr>(b.firstIndex * sizeof(uint32_t)),
+                           static_cast<GLsizeiptr>(count * sizeof(uint32_t)), indices);
+}
+
+void GeometryArena::defragment() {
+    if (!m_vao) return;
+
+    const size_t vertexCapacity = m_vertexAlloc.capacity();
+    const size_t indexCapacity = m_indexAlloc.capacity();
+    GLuint vbo = reallocateBuffer(0, 0, vertexCapacity * m_stride);
+    GLuint ebo = reallocateBuffer(0, 0, indexCapacity * sizeof(uint32_t));
+
+    // Pack blocks in their current order so the copies stay mostly sequential
+    std::vector<Handle> order;
+    for (Handle h = 0; h < m_blocks.size(); ++h) {
+        if (m_blocks[h].live) order.push_back(h);
+    }
+    std::sort(order.begin(), order.end(), [this](Handle a, Handle b) {
+        return m_blocks[a].firstVertex < m_blocks[b].firstVertex;
+    });
+
+    size_t vertexCursor = 0;
+    size_t indexCursor = 0;
+    for (Handle h : order) {
+        Block& b = m_blocks[h];
+        if (b.vertexCount > 0) {
+            GLState::bindBuffer(GL_COPY_READ_BUFFER, m_vbo);
+            GLState::bindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                static_cast<GLintptr>(b.firstVertex * m_stride),
+                                static_cast<GLintptr>(vertexCursor * m_stride),
+                                static_cast<GLsizeiptr>(b.vertexCount * m_stride));
+        }
+        if (b.indexCount > 0) {
+            GLState::bindBuffer(GL_COPY_READ_BUFFER, m_ebo);
+            GLState::bindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                static_cast<GLintptr>(b.firstIndex * sizeof(uint32_t)),
+                                static_cast<GLintptr>(indexCursor * sizeof(uint32_t)),
+                                static_cast<GLsizeiptr>(b.indexCount * sizeof(uint32_t)));
+        }
+        b.firstVertex = vertexCursor;
+        b.firstIndex = indexCursor;
+        vertexCursor += b.vertexCount;
+        indexCursor += b.indexCount;
+    }
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, 0);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    GLState::deleteBuffers(1, &m_vbo);
+    GLState::deleteBuffers(1, &m_ebo);
+    m_vbo = vbo;
+    m_ebo = ebo;
+
+    m_vertexAlloc.reset(vertexCapacity);
+    m_indexAlloc.reset(indexCapacity);
+    m_vertexAlloc.allocate(vertexCursor);
+    m_indexAlloc.allocate(indexCursor);
+    bindBuffers();
+}
+
+float GeometryArena::fragmentation() const {
+    auto frag = [](const RangeAllocator& alloc) {
+        if (alloc.freeTotal() == 0) return 0.0f;
+        return 1.0f - static_cast<float>(alloc.largestFree()) / static_cast<float>(alloc.freeTotal());
+    };
+    return std::max(frag(m_vertexAlloc), frag(m_indexAlloc));
+}
+
+} // namespace gfx
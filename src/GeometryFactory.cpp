@@ -1,5 +1,9 @@
 #include <glad/gl.h>
 #include "../include/GeometryFactory.h"
+#include "../include/GLState.h"
+#include "../include/CommandBuffer.h"
+#include "../include/IndexFormat.h"
+#include "../include/MeshOptimizer.h"
 #include <iostream>
 #include <cmath>
 
@@ -16,32 +20,48 @@ Geometry::~Geometry() {
 
 void Geometry::bind() const {
     if (VAO != 0) {
-        glBindVertexArray(VAO);
+        GLState::bindVertexArray(VAO);
     }
 }
 
-void Geometry::render() const {
+void Geometry::render(int instances) const {
     if (VAO != 0) {
-        glBindVertexArray(VAO);
-        if (EBO != 0) {
-            glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        GLState::bindVertexArray(VAO);
+        if (instances > 1) {
+            if (EBO != 0) {
+                glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, 0, instances);
+            } else {
+                glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instances);
+            }
+        } else if (EBO != 0) {
+            glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
         } else {
             glDrawArrays(GL_TRIANGLES, 0, vertexCount);
         }
     }
 }
 
+void Geometry::record(gfx::CommandBuffer& cmd) const {
+    if (VAO == 0) return;
+    cmd.bindVertexArray(VAO);
+    if (EBO != 0) {
+        cmd.drawElements(static_cast<GLsizei>(indexCount), indexType, nullptr);
+    } else {
+        cmd.drawArrays(static_cast<GLsizei>(vertexCount));
+    }
+}
+
 void Geometry::cleanup() {
     if (VAO != 0) {
-        glDeleteVertexArrays(1, &VAO);
+        GLState::deleteVertexArrays(1, &VAO);
         VAO = 0;
     }
     if (VBO != 0) {
-        glDeleteBuffers(1, &VBO);
+        GLState::deleteBuffers(1, &VBO);
         VBO = 0;
     }
     if (EBO != 0) {
-        glDeleteBuffers(1, &EBO);
+        GLState::deleteBuffers(1, &EBO);
         EBO = 0;
     }
 }
@@ -63,7 +83,14 @@ std::shared_ptr<Geometry> GeometryFactory::createGeometry(const std::string& nam
     
     // Create new geometry
     auto geometry = std::make_shared<Geometry>();
-    createVAO(geometry.get(), vertices, indices);
+    if (m_optimizeMeshes && !indices.empty()) {
+        std::vector<float> optimizedVertices = vertices;
+        std::vector<unsigned int> optimizedIndices = indices;
+        MeshOptimizer::optimizeInterleaved(optimizedVertices, 6, optimizedIndices);
+        createVAO(geometry.get(), optimizedVertices, optimizedIndices);
+    } else {
+        createVAO(geometry.get(), vertices, indices);
+    }
     
     // Cache it
     m_geometries[name] = geometry;
@@ -256,10 +283,10 @@ void GeometryFactory::createVAO(Geometry* geometry, const std::vector<float>& ve
     glGenVertexArrays(1, &geometry->VAO);
     glGenBuffers(1, &geometry->VBO);
     
-    glBindVertexArray(geometry->VAO);
+    GLState::bindVertexArray(geometry->VAO);
     
     // Bind and upload vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->VBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, geometry->VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
     
     // Set vertex attributes (position at 0, normal at 2 to match shader)
@@ -271,14 +298,23 @@ void GeometryFactory::createVAO(Geometry* geometry, const std::vector<float>& ve
     // Handle indices if provided
     if (!indices.empty()) {
         glGenBuffers(1, &geometry->EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->EBO);
+        // Every built-in shape stays well under 65536 vertices: store 16-bit indices
+        if (IndexFormat::fitsUint16(indices.data(), indices.size())) {
+            std::vector<uint16_t> narrowed;
+            const size_t bytes = IndexFormat::narrowPadded(narrowed, indices.data(), indices.size());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, narrowed.data(), GL_STATIC_DRAW);
+            geometry->indexType = GL_UNSIGNED_SHORT;
+        } else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            geometry->indexType = GL_UNSIGNED_INT;
+        }
         geometry->indexCount = indices.size();
     }
     
     geometry->vertexCount = vertices.size() / 6; // 6 floats per vertex (pos + normal)
     
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
 }
 
 } // namespace FlockingGraphics
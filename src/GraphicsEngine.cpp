@@ -1,15 +1,29 @@
 #include "GraphicsEngine.h"
+#include "GLState.h"
+#include "IndexFormat.h"
+#include "MeshOptimizer.h"
+#include "ParallelFor.h"
 #include "RenderSettings.h"
 #include "ShaderPathResolver.h"
 #include "SSAORenderer.h"
+#include "UniformBlocks.h"
 #include "ShadowRenderer.h"
+#include "VertexInterleave.h"
+#include "VertexNormals.h"
+#include "VertexPacking.h"
 
 #include <Camera.h>
 #include <Light.h>
 #include <ShaderLib.h>
 #include <TransformStack.h>
 #include <GeometryFactory.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h>
@@ -35,215 +49,1531 @@ glm::vec3 generateRandomClothColor() {
         default: return glm::vec3(value, p, q);
     }
 }
+
+constexpr size_t kInterleavedStride = 8 * sizeof(float);
+// Smaller meshes upload faster inline than the one-frame handoff costs
+constexpr size_t kAsyncUploadBytes = 256 * 1024;
+
+// Position at 0, UV at 1, normal at 2 (matches bindAttribute in ShaderLib)
+void setInterleavedAttributes() {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kInterleavedStride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, kInterleavedStride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, kInterleavedStride, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+}
+
+// Packed 16-byte layout, see VertexPacking::PackedVertex
+void setPackedAttributes() {
+    const GLsizei stride = sizeof(VertexPacking::PackedVertex);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, (void*)(4 * sizeof(uint16_t)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(uint16_t)));
+    glEnableVertexAttribArray(1);
+}
+
+// Pack vertices [begin, end) of src as pos/normal/uv; dst points at vertex `begin`.
+// Only writes dst, so it is safe for write-combined mapped memory.
+void interleaveVertices(float* dst, const gfx::MeshSource& src, int begin, int end) {
+    VertexInterleave::interleave(dst,
+                                 src.positions + begin * 3,
+                                 src.normals + begin * 3,
+                                 src.uvs ? src.uvs + begin * 2 : nullptr,
+                                 end - begin);
+}
+
+// Normals may be omitted when there are triangles to generate them from
+bool hasValidVertices(const gfx::MeshSource& src) {
+    return src.positions && src.vertexCount > 0 &&
+           (src.normals || (src.indices && src.indexCount >= 3));
+}
+
+// True when the buffers may no longer match src. Untracked (version 0) data is
+// always considered changed.
+bool vertexSourceChanged(const gfx::GpuMesh& mesh, const gfx::MeshSource& src) {
+    if (src.positionsVersion == 0 || src.normalsVersion == 0) return true;
+    if (src.uvs && src.uvsVersion == 0) return true;
+    return src.positions != mesh.sourcePositions ||
+           src.vertexCount != mesh.vertexCount ||
+           (src.uvs != nullptr) != mesh.hasUVs ||
+           src.positionsVersion != mesh.positionsVersion ||
+           src.normalsVersion != mesh.normalsVersion ||
+           src.uvsVersion != mesh.uvsVersion;
+}
+
+bool topologyChanged(const gfx::GpuMesh& mesh, const gfx::MeshSource& src) {
+    return src.indicesVersion == 0 ||
+           src.indicesVersion != mesh.indicesVersion ||
+           src.indices != mesh.sourceIndices ||
+           src.indexCount != mesh.indexCount;
+}
+
+void recordVertexSource(gfx::GpuMesh& mesh, const gfx::MeshSource& src) {
+    mesh.vertexCount = src.vertexCount;
+    mesh.sourcePositions = src.positions;
+    mesh.hasUVs = src.uvs != nullptr;
+    mesh.positionsVersion = src.positionsVersion;
+    mesh.normalsVersion = src.normalsVersion;
+    mesh.uvsVersion = src.uvsVersion;
+}
+
+// Bring the object-space bounds up to date with src's positions; call before
+// recordVertexSource. Unchanged positions keep their bounds, and with widen set, dirty
+// ranges only grow them over the touched vertices (conservative until the next full
+// scan). The packed paths quantize against these bounds, so they never widen them.
+void refreshBounds(gfx::GpuMesh& mesh, const gfx::MeshSource& src, bool widen) {
+    const bool samePositions = mesh.boundsVersion != 0 && src.positions == mesh.sourcePositions &&
+                               src.vertexCount == mesh.vertexCount;
+    if (samePositions && src.positionsVersion == mesh.boundsVersion) return;
+    if (samePositions && widen && src.positionsVersion != 0 && src.dirtyRanges && src.dirtyRangeCount > 0) {
+        for (int r = 0; r < src.dirtyRangeCount; ++r) {
+            const int begin = std::max(src.dirtyRanges[r].begin, 0);
+            const int end = std::min(src.dirtyRanges[r].end, src.vertexCount);
+            if (begin >= end) continue;
+            glm::vec3 lo, hi;
+            VertexPacking::computeBounds(src.positions + static_cast<size_t>(begin) * 3, end - begin, lo, hi);
+            mesh.boundsMin = glm::min(mesh.boundsMin, lo);
+            mesh.boundsMax = glm::max(mesh.boundsMax, hi);
+        }
+    } else {
+        VertexPacking::computeBounds(src.positions, src.vertexCount, mesh.boundsMin, mesh.boundsMax);
+    }
+    mesh.boundsVersion = src.positionsVersion;
+}
+
+// Forget what the buffers hold so the next sync uploads everything
+void forgetSource(gfx::GpuMesh& mesh) {
+    mesh.vertexCount = 0;
+    mesh.triangleCount = 0;
+    mesh.sourcePositions = nullptr;
+    mesh.sourceIndices = nullptr;
+    mesh.positionsVersion = mesh.normalsVersion = mesh.uvsVersion = mesh.indicesVersion = 0;
+    mesh.boundsVersion = 0;
+    mesh.indexCount = 0;
+    mesh.clusters.clear();
+}
+
+void recordTopology(gfx::GpuMesh& mesh, const gfx::MeshSource& src) {
+    mesh.sourceIndices = src.indices;
+    mesh.indexCount = src.indexCount;
+    mesh.indicesVersion = src.indicesVersion;
+}
+
+size_t interleavedBytes(const gfx::MeshSource& src) {
+    return static_cast<size_t>(std::max(src.vertexCount, 0)) * kInterleavedStride;
+}
+
+// Pair each source with a previous entry: the one that last held the same positions
+// array, else the first entry nobody claimed. -1 when nothing is left to reuse.
+std::vector<int> matchPreviousSources(const std::vector<const float*>& previous,
+                                      const std::vector<gfx::MeshSource>& sources) {
+    std::unordered_multimap<const float*, int> byPositions;
+    for (size_t i = 0; i < previous.size(); ++i) {
+        if (previous[i]) byPositions.emplace(previous[i], static_cast<int>(i));
+    }
+
+    std::vector<int> match(sources.size(), -1);
+    std::vector<bool> claimed(previous.size(), false);
+    for (size_t s = 0; s < sources.size(); ++s) {
+        if (!sources[s].positions) continue;
+        auto range = byPositions.equal_range(sources[s].positions);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (claimed[it->second]) continue;
+            match[s] = it->second;
+            claimed[it->second] = true;
+            break;
+        }
+    }
+
+    size_t next = 0;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        if (match[s] >= 0) continue;
+        while (next < claimed.size() && claimed[next]) ++next;
+        if (next == claimed.size()) break;
+        match[s] = static_cast<int>(next);
+        claimed[next] = true;
+    }
+    return match;
+}
+
+// Return a pooled mesh's block to its arena; the next upload starts from scratch
+void releaseFromArena(gfx::GpuMesh& mesh) {
+    if (!mesh.arena) return;
+    mesh.arena->release(mesh.arenaHandle);
+    mesh.arena = nullptr;
+    mesh.arenaHandle = gfx::GeometryArena::INVALID_HANDLE;
+    forgetSource(mesh);
+}
+
+// Index data as the GPU should store it: narrowed to 16 bits when every index fits,
+// which halves the EBO and the index fetch bandwidth of small meshes
+struct IndexUpload {
+    const void* data = nullptr;
+    size_t bytes = 0;
+    GLenum type = GL_UNSIGNED_INT;
+};
+
+IndexUpload prepareIndices(const gfx::MeshSource& src) {
+    thread_local std::vector<uint16_t> narrowed;
+    IndexUpload upload;
+    const size_t count = static_cast<size_t>(src.indexCount);
+    if (IndexFormat::fitsUint16(src.indices, count)) {
+        upload.bytes = IndexFormat::narrowPadded(narrowed, src.indices, count);
+        upload.data = narrowed.data();
+        upload.type = GL_UNSIGNED_SHORT;
+    } else {
+        upload.bytes = count * sizeof(uint32_t);
+        upload.data = src.indices;
+    }
+    return upload;
+}
+
+// Expects the mesh VAO to be bound. Returns the number of bytes uploaded.
+size_t uploadIndices(gfx::GpuMesh& mesh, const gfx::MeshSource& src) {
+    size_t uploaded = 0;
+    if (src.indices && src.indexCount > 0) {
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        const IndexUpload upload = prepareIndices(src);
+        if (upload.bytes > mesh.indexCapacityBytes) {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, upload.bytes, upload.data, GL_STATIC_DRAW);
+            mesh.indexCapacityBytes = upload.bytes;
+        } else {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, upload.bytes, upload.data);
+        }
+        mesh.indexType = upload.type;
+        mesh.triangleCount = src.indexCount / 3;
+        uploaded = upload.bytes;
+    } else {
+        mesh.triangleCount = 0;
+    }
+    recordTopology(mesh, src);
+    return uploaded;
+}
+
+// Point the staged draw block's packed-vertex decode at mesh, or back to identity for nullptr
+void setVertexDecode(const gfx::GpuMesh* mesh) {
+    FlockingShaders::DrawBlock& draw = UniformBlocks::draw();
+    draw.posDequantScale = glm::vec4(mesh ? mesh->posDequantScale : glm::vec3(1.0f), mesh ? 1.0f : 0.0f);
+    draw.posDequantBias = glm::vec4(mesh ? mesh->posDequantBias : glm::vec3(0.0f), draw.posDequantBias.w);
+}
+
+// Shadow program decode, recorded as a command-buffer invoke
+struct PositionDecode {
+    glm::vec3 scale{1.0f};
+    glm::vec3 bias{0.0f};
+};
+
+void setShadowDecode(const PositionDecode& decode) {
+    Shadow::setPositionDecode(decode.scale, decode.bias);
+}
+
+// FNV-1a accumulator for shadow cache keys
+struct CacheKey {
+    uint64_t value = 14695981039346656037ull;
+
+    template <typename T>
+    void add(const T& field) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&field);
+        for (size_t i = 0; i < sizeof(T); ++i) value = (value ^ bytes[i]) * 1099511628211ull;
+    }
+};
+
+// Keep [allowMin, allowMax] around the moving casters [lo, hi]; empty when there are none.
+// A fresh fit pads them by a quarter of their size and snaps outwards to a power-of-two
+// grid; the current box stays while it holds them and is at most twice a fresh fit.
+void updateCasterAllowance(glm::vec3& allowMin, glm::vec3& allowMax, const glm::vec3& lo, const glm::vec3& hi) {
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) {
+        allowMin = glm::vec3(std::numeric_limits<float>::max());
+        allowMax = glm::vec3(-std::numeric_limits<float>::max());
+        return;
+    }
+    const float extent = std::max({hi.x - lo.x, hi.y - lo.y, hi.z - lo.z, 1e-3f});
+    const float step = std::exp2(std::ceil(std::log2(extent * 0.25f)));
+    const glm::vec3 fitMin = glm::floor((lo - step) / step) * step;
+    const glm::vec3 fitMax = glm::ceil((hi + step) / step) * step;
+    const bool holds = glm::all(glm::lessThanEqual(allowMin, lo)) && glm::all(glm::greaterThanEqual(allowMax, hi));
+    const bool tight = glm::all(glm::lessThanEqual(allowMax - allowMin, (fitMax - fitMin) * 2.0f));
+    if (holds && tight) return;
+    allowMin = fitMin;
+    allowMax = fitMax;
+}
+
+// Sort position for the render queue: mean of the meshlet bound centres, or the object
+// origin without clusters, placed by the mesh's model matrix
+glm::vec3 meshCenter(const gfx::GpuMesh& mesh) {
+    const std::vector<Meshlets::Bounds>& bounds = mesh.clusters.bounds;
+    glm::vec3 center(0.0f);
+    if (!bounds.empty()) {
+        for (const Meshlets::Bounds& b : bounds) center += b.center;
+        center /= static_cast<float>(bounds.size());
+    }
+    return glm::vec3(mesh.model * glm::vec4(center, 1.0f));
+}
+
+// Swap the buffers of a completed background upload into the mesh VAO
+void adoptPendingBuffers(gfx::GpuMesh& mesh) {
+    GLState::bindVertexArray(mesh.VAO);
+    GLState::deleteBuffers(1, &mesh.VBO);
+    mesh.VBO = mesh.pendingVBO;
+    mesh.vertexCapacityBytes = mesh.pendingVertexBytes;
+    GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    setInterleavedAttributes();
+    if (mesh.pendingTriangleCount >= 0) {
+        if (mesh.pendingEBO) {
+            GLState::deleteBuffers(1, &mesh.EBO);
+            mesh.EBO = mesh.pendingEBO;
+            mesh.indexCapacityBytes = mesh.pendingIndexBytes;
+            mesh.indexType = mesh.pendingIndexType;
+            GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        }
+        mesh.triangleCount = mesh.pendingTriangleCount;
+    }
+    GLState::bindVertexArray(0);
+    mesh.pendingUpload = 0;
+    mesh.pendingVBO = mesh.pendingEBO = 0;
+    mesh.pendingTriangleCount = -1;
+}
+
+// Allocate uninitialised storage for a background upload destination
+GLuint createUploadTarget(size_t bytes) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_DYNAMIC_DRAW);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffer;
+}
+
+// Only safe once no background upload can still write the mesh's pending buffers
+void destroyGpuMesh(gfx::GpuMesh& mesh) {
+    releaseFromArena(mesh);
+    if (mesh.pendingVBO) GLState::deleteBuffers(1, &mesh.pendingVBO);
+    if (mesh.pendingEBO) GLState::deleteBuffers(1, &mesh.pendingEBO);
+    mesh.pendingUpload = 0;
+    mesh.pendingVBO = mesh.pendingEBO = 0;
+    if (!mesh.VAO) return;
+    GLState::deleteVertexArrays(1, &mesh.VAO);
+    GLState::deleteBuffers(1, &mesh.VBO);
+    GLState::deleteBuffers(1, &mesh.EBO);
+    if (mesh.normalVBO) GLState::deleteBuffers(1, &mesh.normalVBO);
+    if (mesh.uvVBO) GLState::deleteBuffers(1, &mesh.uvVBO);
+    mesh.VAO = mesh.VBO = mesh.EBO = mesh.normalVBO = mesh.uvVBO = 0;
+}
+
+// Upload one tightly packed attribute stream into its own buffer. With partial set,
+// only the dirty vertex ranges are written; otherwise buffer is left bound to
+// GL_ARRAY_BUFFER. Returns the number of bytes uploaded.
+size_t uploadStream(GLuint buffer, size_t& capacityBytes, const float* data, int components,
+                    const gfx::MeshSource& src, bool partial) {
+    const size_t vertexBytes = static_cast<size_t>(components) * sizeof(float);
+    const size_t requiredBytes = static_cast<size_t>(src.vertexCount) * vertexBytes;
+
+    if (partial && requiredBytes <= capacityBytes) {
+        size_t uploaded = 0;
+        for (int r = 0; r < src.dirtyRangeCount; ++r) {
+            int begin = std::max(src.dirtyRanges[r].begin, 0);
+            int end = std::min(src.dirtyRanges[r].end, src.vertexCount);
+            if (begin >= end) continue;
+            const size_t bytes = static_cast<size_t>(end - begin) * vertexBytes;
+            GLState::bufferSubData(buffer, static_cast<size_t>(begin) * vertexBytes, bytes,
+                                   data + static_cast<size_t>(begin) * components);
+            uploaded += bytes;
+        }
+        return uploaded;
+    }
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (requiredBytes > capacityBytes) {
+        glBufferData(GL_ARRAY_BUFFER, requiredBytes, data, GL_DYNAMIC_DRAW);
+        capacityBytes = requiredBytes;
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, requiredBytes, data);
+    }
+    return requiredBytes;
+}
+
+// Pooled meshes share one VAO, so consecutive arena draws skip the rebind at replay
+// instances > 1 draws the whole mesh that many times (one copy per layered shadow map)
+void recordMesh(const gfx::GpuMesh& mesh, gfx::CommandBuffer& cmd, GLsizei instances = 1) {
+    cmd.bindVertexArray(mesh.arena ? mesh.arena->vao() : mesh.VAO);
+    GLenum indexType = mesh.indexType;
+    const void* offset = nullptr;
+    GLint baseVertex = mesh.baseVertex;
+    if (mesh.arena) {
+        indexType = GL_UNSIGNED_INT;
+        offset = mesh.arena->indexOffset(mesh.arenaHandle);
+        baseVertex = static_cast<GLint>(mesh.arena->block(mesh.arenaHandle).firstVertex);
+    }
+    if (instances > 1) {
+        cmd.drawElementsInstanced(mesh.triangleCount * 3, indexType, offset, instances, baseVertex);
+    } else {
+        cmd.drawElements(mesh.triangleCount * 3, indexType, offset, baseVertex);
+    }
+}
+
+// Model matrix columns at 3..6 and colour at 7, advancing once per instance (matches
+// bindAttribute in ShaderLib and the shadow program). Expects the VAO to be bound.
+void setInstanceAttributes(GLuint instanceBuffer) {
+    const GLsizei stride = sizeof(gfx::InstanceData);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (GLuint column = 0; column < 4; ++column) {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(offsetof(gfx::InstanceData, model) + column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(gfx::InstanceData, color));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+}
+
+// Instanced view of a GeometryFactory shape: a VAO over its buffers (position and
+// normal, 6 floats per vertex) plus an instance stream of its own
+gfx::InstancedMesh instanceGeometry(const FlockingGraphics::Geometry& geometry) {
+    gfx::InstancedMesh mesh;
+    mesh.ownsGeometry = false;
+    mesh.castsShadow = false;
+    mesh.VBO = geometry.VBO;
+    mesh.EBO = geometry.EBO;
+    mesh.indexCount = static_cast<GLsizei>(geometry.indexCount);
+    mesh.indexType = geometry.indexType;
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.instanceVBO);
+
+    GLState::bindVertexArray(mesh.VAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    const GLsizei stride = 6 * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    setInstanceAttributes(mesh.instanceVBO);
+    GLState::bindVertexArray(0);
+    return mesh;
+}
+
+void uploadInstances(gfx::InstancedMesh& mesh, const gfx::InstanceData* instances, int count) {
+    const int n = instances ? std::max(count, 0) : 0;
+    const size_t bytes = static_cast<size_t>(n) * sizeof(gfx::InstanceData);
+    if (bytes > mesh.instanceCapacityBytes) {
+        GLState::bufferData(mesh.instanceVBO, static_cast<GLsizeiptr>(bytes), instances, GL_DYNAMIC_DRAW);
+        mesh.instanceCapacityBytes = bytes;
+    } else if (bytes > 0) {
+        GLState::bufferSubData(mesh.instanceVBO, 0, static_cast<GLsizeiptr>(bytes), instances);
+    }
+    mesh.instanceCount = n;
+    ++mesh.instancesVersion;
+
+    glm::vec3 sum(0.0f);
+    for (int i = 0; i < n; ++i) sum += glm::vec3(instances[i].model[3]);
+    mesh.center = n > 0 ? sum / static_cast<float>(n) : glm::vec3(0.0f);
+
+    // Transformed box of each instance: centre plus extents through |rotation * scale|
+    const glm::vec3 baseCenter = (mesh.baseMin + mesh.baseMax) * 0.5f;
+    const glm::vec3 baseExtent = (mesh.baseMax - mesh.baseMin) * 0.5f;
+    mesh.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    mesh.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (int i = 0; i < n; ++i) {
+        const glm::mat4& model = instances[i].model;
+        const glm::vec3 center(model * glm::vec4(baseCenter, 1.0f));
+        glm::vec3 extent(0.0f);
+        for (int axis = 0; axis < 3; ++axis) extent += glm::abs(glm::vec3(model[axis])) * baseExtent[axis];
+        mesh.boundsMin = glm::min(mesh.boundsMin, center - extent);
+        mesh.boundsMax = glm::max(mesh.boundsMax, center + extent);
+    }
+}
+
+// Free the VAO and instance buffer, and the geometry unless it is borrowed
+void releaseInstancedMesh(gfx::InstancedMesh& mesh) {
+    if (!mesh.VAO) return;
+    GLState::deleteVertexArrays(1, &mesh.VAO);
+    GLState::deleteBuffers(1, &mesh.instanceVBO);
+    if (mesh.ownsGeometry) {
+        GLState::deleteBuffers(1, &mesh.VBO);
+        GLState::deleteBuffers(1, &mesh.EBO);
+    }
+    mesh = gfx::InstancedMesh{};
+}
+
+struct InstanceDivisor {
+    GLuint vao;
+    GLuint divisor;
+};
+
+// Per-instance attribute rate of an instanced VAO, recorded as a command-buffer invoke
+void setInstanceDivisor(const InstanceDivisor& rate) {
+    GLState::bindVertexArray(rate.vao);
+    for (GLuint attribute = 3; attribute <= 7; ++attribute) glVertexAttribDivisor(attribute, rate.divisor);
+}
+
+// layers > 1 repeats every instance once per layered shadow map: the instance attributes
+// advance every layers instances while gl_InstanceID % layers picks the layer
+void recordInstances(const gfx::InstancedMesh& mesh, gfx::CommandBuffer& cmd, GLuint layers = 1) {
+    cmd.bindVertexArray(mesh.VAO);
+    if (layers > 1) cmd.invoke(&setInstanceDivisor, InstanceDivisor{mesh.VAO, layers});
+    cmd.drawElementsInstanced(mesh.indexCount, mesh.indexType, nullptr,
+                              mesh.instanceCount * static_cast<GLsizei>(layers));
+    if (layers > 1) cmd.invoke(&setInstanceDivisor, InstanceDivisor{mesh.VAO, 1});
+}
+
+// Shadow program switch around instanced casters, recorded as a command-buffer invoke
+void setShadowInstanced(const bool& instanced) {
+    if (instanced) {
+        Shadow::useInstancedProgram(glm::mat4(1.0f));
+    } else {
+        Shadow::useStandardProgram();
+    }
+}
 }  // namespace
 
 namespace gfx {
 
 bool Engine::initialize(int width, int height) {
+    GLState::init();
     Renderer::initGL();
     SSAO::init(width, height);
-    int shadowSize = 4096;
+    int shadowSize = 2048;   // per cascade / light layer
     if (const char* env = std::getenv("CS_SHADOW_SIZE")) {
         int v = std::atoi(env);
         if (v >= 512 && v <= 8192) shadowSize = v;
     }
     Shadow::init(shadowSize);
+    UniformBlocks::init();
+    m_renderGraph.setBackbufferSize(width, height);
     return true;
 }
 
 void Engine::resize(int width, int height) {
     SSAO::resize(width, height);
+    m_renderGraph.setBackbufferSize(width, height);
 }
 
 void Engine::setShaderRoot(const std::string& rootDir) {
     ShaderPath::setRoot(rootDir);
 }
 
-void Engine::ensurePrimaryMeshes(size_t count, std::vector<glm::vec3>& clothColors) {
-    while (m_primaryMeshes.size() < count) {
-        GpuMesh mesh{};
-        glGenVertexArrays(1, &mesh.VAO);
-        glGenBuffers(1, &mesh.VBO);
-        glGenBuffers(1, &mesh.EBO);
-        m_primaryMeshes.push_back(mesh);
-        clothColors.push_back(generateRandomClothColor());
-    }
+size_t Engine::meshPoolBucket(size_t capacityBytes) {
+    size_t bucket = 0;
+    while (bucket + 1 < MESH_POOL_BUCKETS && (capacityBytes >> (bucket + 1)) != 0) ++bucket;
+    return bucket;
 }
 
-void Engine::ensureGenericMeshes(size_t count) {
-    // Remove extras
-    while (m_genericMeshes.size() > count) {
-        auto& mesh = m_genericMeshes.back();
-        if (mesh.VAO) {
-            glDeleteVertexArrays(1, &mesh.VAO);
-            glDeleteBuffers(1, &mesh.VBO);
-            glDeleteBuffers(1, &mesh.EBO);
+GpuMesh Engine::acquireGpuMesh(size_t vertexBytes) {
+    // Bucket b holds capacities in [2^b, 2^(b+1)): only the first bucket needs a size check
+    const size_t first = meshPoolBucket(vertexBytes);
+    for (size_t b = first; b < MESH_POOL_BUCKETS; ++b) {
+        std::vector<GpuMesh>& bucket = m_meshPool[b];
+        for (size_t i = bucket.size(); i-- > 0;) {
+            if (bucket[i].vertexCapacityBytes < vertexBytes) continue;
+            GpuMesh mesh = bucket[i];
+            bucket[i] = bucket.back();
+            bucket.pop_back();
+            --m_pooledMeshCount;
+            return mesh;
         }
-        m_genericMeshes.pop_back();
     }
-    while (m_genericColors.size() > count) {
-        m_genericColors.pop_back();
+    // Nothing large enough: still reuse the GL objects, the upload grows the buffers
+    for (size_t b = first + 1; b-- > 0;) {
+        if (m_meshPool[b].empty()) continue;
+        GpuMesh mesh = m_meshPool[b].back();
+        m_meshPool[b].pop_back();
+        --m_pooledMeshCount;
+        return mesh;
     }
 
-    while (m_genericMeshes.size() < count) {
-        GpuMesh mesh{};
-        glGenVertexArrays(1, &mesh.VAO);
-        glGenBuffers(1, &mesh.VBO);
-        glGenBuffers(1, &mesh.EBO);
-        m_genericMeshes.push_back(mesh);
-    }
-    while (m_genericColors.size() < count) {
-        m_genericColors.emplace_back(0.8f, 0.8f, 0.8f);
+    GpuMesh mesh{};
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+    return mesh;
+}
+
+void Engine::recycleGpuMesh(GpuMesh mesh) {
+    cancelAsyncUpload(mesh);
+    releaseFromArena(mesh);
+    forgetSource(mesh);
+    // The ring may be recreated before reuse; force the next stream to re-point the VAO
+    mesh.streamBuffer = 0;
+    if (!mesh.VAO || m_pooledMeshCount >= MAX_POOLED_MESHES) {
+        destroyGpuMesh(mesh);
+        return;
     }
+    m_meshPool[meshPoolBucket(mesh.vertexCapacityBytes)].push_back(mesh);
+    ++m_pooledMeshCount;
 }
 
 void Engine::syncPrimaryMeshes(const std::vector<MeshSource>& meshes,
                                std::vector<glm::vec3>& meshColors) {
-    // Trim extras
-    while (m_primaryMeshes.size() > meshes.size()) {
-        auto& mesh = m_primaryMeshes.back();
-        if (mesh.VAO) {
-            glDeleteVertexArrays(1, &mesh.VAO);
-            glDeleteBuffers(1, &mesh.VBO);
-            glDeleteBuffers(1, &mesh.EBO);
+    completeAsyncUploads();
+
+    // Keep every source on the GpuMesh (and color) that already holds its data, so
+    // removing a mesh from the middle does not shift the others onto new buffers
+    const std::vector<int> match = matchPreviousSources(m_primarySources, meshes);
+    std::vector<GpuMesh> previous = std::move(m_primaryMeshes);
+    std::vector<glm::vec3> previousColors = std::move(meshColors);
+    std::vector<bool> reused(previous.size(), false);
+
+    m_primaryMeshes.clear();
+    meshColors.clear();
+    m_primarySources.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const int from = match[i];
+        if (from >= 0) {
+            m_primaryMeshes.push_back(std::move(previous[from]));
+            meshColors.push_back(static_cast<size_t>(from) < previousColors.size()
+                                     ? previousColors[from] : generateRandomClothColor());
+            reused[from] = true;
+        } else {
+            m_primaryMeshes.push_back(acquireGpuMesh(interleavedBytes(meshes[i])));
+            meshColors.push_back(generateRandomClothColor());
+        }
+        m_primarySources[i] = meshes[i].positions;
+    }
+    for (size_t i = 0; i < previous.size(); ++i) {
+        if (!reused[i]) recycleGpuMesh(std::move(previous[i]));
+    }
+
+    if (isPrimaryStreaming()) {
+        if (streamPrimaryMeshes(meshes)) return;
+    } else if (m_primaryStream.isCreated()) {
+        m_primaryStream.destroy();
+    }
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        uploadMesh(m_primaryMeshes[i], meshes[i]);
+    }
+}
+
+void Engine::uploadMesh(GpuMesh& mesh, const MeshSource& input) {
+    // A transform is only a uniform: it never makes the buffers stale
+    mesh.model = input.model;
+    if (!hasValidVertices(input)) {
+        forgetSource(mesh);
+        return;
+    }
+
+    // Leaving streaming mode: the ring contents are gone, re-upload into the mesh VBO
+    const bool wasStreamed = mesh.streamed;
+    if (wasStreamed) {
+        mesh.streamed = false;
+        mesh.streamBuffer = 0;
+        mesh.streamRegion = -1;
+        mesh.baseVertex = 0;
+    }
+
+    // A background upload is still in flight. Changes made meanwhile are picked up by
+    // the first sync after it lands, unless the mesh leaves the interleaved VBO path.
+    if (mesh.pendingUpload) {
+        if (wasStreamed || m_pooledGeometry || m_compressVertices || m_separateStreams) {
+            cancelAsyncUpload(mesh);
+        } else {
+            ++m_uploadStats.meshesSkipped;
+            return;
+        }
+    }
+
+    // Moving to other storage (into an arena, out of one, or between arena formats)
+    // forgets what the buffers held. Do it first so the generated normals, topology order
+    // and meshlets below are rebuilt for the new storage rather than dropped after it.
+    const bool pooled = m_pooledGeometry && !m_separateStreams;
+    if (pooled) {
+        enterArena(mesh);
+    } else {
+        releaseFromArena(mesh);
+    }
+
+    // Sources without normals: the compute pass fills them after the upload where the
+    // layout allows it, otherwise they are generated on the CPU here. A layout switch
+    // re-uploads unchanged sources, so it needs them too (arena moves forget the source).
+    const bool gpuNormals = !input.normals && !pooled && !m_compressVertices && isGpuNormals();
+    const bool layoutChanged = !pooled && (m_compressVertices ? !mesh.packed
+                                           : m_separateStreams ? !mesh.separateStreams || mesh.packed
+                                                               : wasStreamed || mesh.separateStreams || mesh.packed);
+    MeshSource src = input.normals ? input
+                                   : withGeneratedNormals(mesh, input, gpuNormals, !m_separateStreams, layoutChanged);
+
+    // New topology may upload a reordered copy of the triangles (see orderTopology). The
+    // caller's array stays the recorded source, so an unchanged topology is still recognised.
+    const bool reorder = src.indices && src.indexCount >= 3 && topologyChanged(mesh, src);
+    if (reorder) src.indices = orderTopology(mesh, src);
+
+    if (pooled) {
+        uploadMeshPooled(mesh, src);
+    } else {
+        if (m_compressVertices) {
+            uploadMeshPacked(mesh, src);
+        } else if (m_separateStreams) {
+            uploadMeshStreams(mesh, src);
+        } else {
+            uploadMeshInterleaved(mesh, src, wasStreamed, gpuNormals);
         }
-        m_primaryMeshes.pop_back();
     }
-    while (meshColors.size() > meshes.size()) meshColors.pop_back();
+    if (reorder && mesh.sourceIndices == src.indices) mesh.sourceIndices = input.indices;
+    if (!mesh.clusters.empty()) {
+        Meshlets::refit(mesh.clusters, src.positions, static_cast<size_t>(src.vertexCount), src.positionsVersion);
+    }
+}
+
+const uint32_t* Engine::orderTopology(GpuMesh& mesh, const MeshSource& src) {
+    const size_t indexCount = static_cast<size_t>(src.indexCount);
+    const bool clustered = m_meshletCulling && src.indexCount / 3 >= MESHLET_MIN_TRIANGLES;
+    if (!clustered) mesh.clusters.clear();
+    if (!clustered && !m_optimizeMeshes) return src.indices;
+
+    m_optimizedIndices.resize(indexCount);
+    if (clustered) {
+        Meshlets::build(mesh.clusters, m_optimizedIndices.data(), src.indices, indexCount,
+                        static_cast<size_t>(src.vertexCount));
+    } else {
+        MeshOptimizer::optimizeIndexOrder(m_optimizedIndices.data(), src.indices, indexCount,
+                                          src.positions, static_cast<size_t>(src.vertexCount));
+    }
+    return m_optimizedIndices.data();
+}
+
+void Engine::recordMeshCulled(const GpuMesh& mesh, const Meshlets::Frustum& frustum, const glm::vec3* eye,
+                              CommandBuffer& cmd) {
+    // Called from recording workers: scratch is per thread, stats merge under the lock
+    thread_local std::vector<Meshlets::IndexRange> ranges;
+    thread_local std::vector<GLsizei> counts;
+    thread_local std::vector<const void*> offsets;
+
+    ranges.clear();
+    const size_t kept = Meshlets::cull(mesh.clusters, frustum, eye, ranges);
+    {
+        std::lock_guard<std::mutex> lock(m_meshletStatsMutex);
+        m_meshletStats.meshletsTested += mesh.clusters.meshlets.size();
+        m_meshletStats.trianglesTested += static_cast<size_t>(mesh.triangleCount);
+        m_meshletStats.trianglesDrawn += kept;
+        if (!ranges.empty()) ++m_meshletStats.multiDraws;
+    }
+    if (ranges.empty()) return;
+
+    cmd.bindVertexArray(mesh.arena ? mesh.arena->vao() : mesh.VAO);
+    // Arena indices are 32-bit and start at the block's offset in the shared EBO
+    uintptr_t indexBase = 0;
+    GLint baseVertex = mesh.baseVertex;
+    GLenum indexType = mesh.indexType;
+    if (mesh.arena) {
+        indexBase = reinterpret_cast<uintptr_t>(mesh.arena->indexOffset(mesh.arenaHandle));
+        baseVertex = static_cast<GLint>(mesh.arena->block(mesh.arenaHandle).firstVertex);
+        indexType = GL_UNSIGNED_INT;
+    }
+    const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    counts.clear();
+    offsets.clear();
+    for (const Meshlets::IndexRange& range : ranges) {
+        counts.push_back(static_cast<GLsizei>(range.count));
+        offsets.push_back(reinterpret_cast<const void*>(indexBase + range.firstIndex * indexSize));
+    }
+    cmd.multiDrawElements(indexType, counts.data(), offsets.data(), static_cast<GLsizei>(ranges.size()), baseVertex);
+}
 
-    ensurePrimaryMeshes(meshes.size(), meshColors);
+void Engine::setMeshletCulling(bool enabled) {
+    if (enabled == m_meshletCulling) return;
+    m_meshletCulling = enabled;
+    // Forget the recorded topology so the next sync rebuilds (or drops) the clusters
+    for (std::vector<GpuMesh>* list : {&m_primaryMeshes, &m_meshes.values()}) {
+        for (GpuMesh& mesh : *list) mesh.sourceIndices = nullptr;
+    }
+}
 
+void Engine::uploadMeshInterleaved(GpuMesh& mesh, const MeshSource& src, bool wasStreamed, bool gpuNormals) {
     static std::vector<float> vertexData;
 
-    for (size_t i = 0; i < meshes.size(); ++i) {
-        const MeshSource& src = meshes[i];
-        GpuMesh& mesh = m_primaryMeshes[i];
+    // Switching layout (ring, separate streams or packed -> interleaved VBO) needs a full upload
+    const bool layoutChanged = wasStreamed || mesh.separateStreams || mesh.packed;
+    mesh.separateStreams = false;
+    mesh.packed = false;
 
-        if (!src.positions || !src.normals || src.vertexCount <= 0) {
-            mesh.vertexCount = 0;
-            mesh.triangleCount = 0;
-            continue;
+    const bool vertexChanged = layoutChanged || vertexSourceChanged(mesh, src);
+    const bool indexChanged = topologyChanged(mesh, src);
+    if (!vertexChanged && !indexChanged) {
+        ++m_uploadStats.meshesSkipped;
+        return;
+    }
+
+    const size_t requiredVertexBytes = static_cast<size_t>(src.vertexCount) * kInterleavedStride;
+    // Partial updates need the buffer to already hold this exact tracked layout
+    const bool partial = !layoutChanged && src.dirtyRanges && src.dirtyRangeCount > 0 &&
+                         mesh.positionsVersion != 0 &&
+                         mesh.sourcePositions == src.positions &&
+                         mesh.vertexCount == src.vertexCount &&
+                         mesh.hasUVs == (src.uvs != nullptr) &&
+                         requiredVertexBytes <= mesh.vertexCapacityBytes;
+
+    // New geometry (imports, resets) goes to the upload thread; per-frame edits of the
+    // same arrays stay inline so they are never a frame late
+    const bool newGeometry = src.positions != mesh.sourcePositions || src.vertexCount != mesh.vertexCount;
+    if (vertexChanged && !partial && !layoutChanged && newGeometry && !gpuNormals &&
+        requiredVertexBytes >= kAsyncUploadBytes && isAsyncUploads() &&
+        uploadMeshAsync(mesh, src, indexChanged)) {
+        return;
+    }
+
+    GLState::bindVertexArray(mesh.VAO);
+
+    if (vertexChanged) {
+        GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        if (partial) {
+            for (int r = 0; r < src.dirtyRangeCount; ++r) {
+                int begin = std::max(src.dirtyRanges[r].begin, 0);
+                int end = std::min(src.dirtyRanges[r].end, src.vertexCount);
+                if (begin >= end) continue;
+                vertexData.resize(static_cast<size_t>(end - begin) * 8);
+                interleaveVertices(vertexData.data(), src, begin, end);
+                const size_t bytes = static_cast<size_t>(end - begin) * kInterleavedStride;
+                GLState::bufferSubData(mesh.VBO, static_cast<size_t>(begin) * kInterleavedStride,
+                                       bytes, vertexData.data());
+                m_uploadStats.vertexBytes += bytes;
+            }
+        } else {
+            vertexData.resize(static_cast<size_t>(src.vertexCount) * 8);
+            interleaveVertices(vertexData.data(), src, 0, src.vertexCount);
+            if (requiredVertexBytes > mesh.vertexCapacityBytes) {
+                glBufferData(GL_ARRAY_BUFFER, requiredVertexBytes, vertexData.data(), GL_DYNAMIC_DRAW);
+                mesh.vertexCapacityBytes = requiredVertexBytes;
+            } else {
+                glBufferSubData(GL_ARRAY_BUFFER, 0, requiredVertexBytes, vertexData.data());
+            }
+            setInterleavedAttributes();
+            m_uploadStats.vertexBytes += requiredVertexBytes;
         }
+        refreshBounds(mesh, src, true);
+        recordVertexSource(mesh, src);
+    }
 
-        mesh.vertexCount = src.vertexCount;
-        mesh.triangleCount = src.indexCount / 3;
+    if (indexChanged) {
+        m_uploadStats.indexBytes += uploadIndices(mesh, src);
+    }
+
+    GLState::bindVertexArray(0);
+    // Generated normals track positions and topology, so vertexChanged covers both
+    if (gpuNormals && vertexChanged) generateNormalsGpu(mesh, src);
+    ++m_uploadStats.meshesUploaded;
+}
+
+void Engine::uploadMeshStreams(GpuMesh& mesh, const MeshSource& src) {
+    // Anything that invalidates every stream at once
+    const bool rebuild = !mesh.separateStreams || mesh.packed ||
+                         src.positions != mesh.sourcePositions ||
+                         src.vertexCount != mesh.vertexCount;
+    const bool positionsChanged = rebuild || src.positionsVersion == 0 ||
+                                  src.positionsVersion != mesh.positionsVersion;
+    const bool normalsChanged = rebuild || src.normalsVersion == 0 ||
+                                src.normalsVersion != mesh.normalsVersion;
+    const bool uvsChanged = rebuild || (src.uvs != nullptr) != mesh.hasUVs ||
+                            (src.uvs && (src.uvsVersion == 0 || src.uvsVersion != mesh.uvsVersion));
+    const bool indexChanged = topologyChanged(mesh, src);
+
+    if (!positionsChanged && !normalsChanged && !uvsChanged && !indexChanged) {
+        ++m_uploadStats.meshesSkipped;
+        return;
+    }
 
-        vertexData.assign(src.vertexCount * 8, 0.0f);
-        for (int j = 0; j < src.vertexCount; j++) {
-            int vi = j * 8;
-            int pi = j * 3;
-            int ui = j * 2;
+    // Dirty ranges only apply on top of data whose versions were tracked last sync
+    const bool partial = !rebuild && src.dirtyRanges && src.dirtyRangeCount > 0;
 
-            vertexData[vi + 0] = src.positions[pi + 0];
-            vertexData[vi + 1] = src.positions[pi + 1];
-            vertexData[vi + 2] = src.positions[pi + 2];
-            vertexData[vi + 3] = src.normals[pi + 0];
-            vertexData[vi + 4] = src.normals[pi + 1];
-            vertexData[vi + 5] = src.normals[pi + 2];
-            vertexData[vi + 6] = src.uvs ? src.uvs[ui + 0] : 0.0f;
-            vertexData[vi + 7] = src.uvs ? src.uvs[ui + 1] : 0.0f;
+    GLState::bindVertexArray(mesh.VAO);
+
+    if (positionsChanged) {
+        m_uploadStats.vertexBytes += uploadStream(mesh.VBO, mesh.vertexCapacityBytes, src.positions, 3,
+                                                  src, partial && mesh.positionsVersion != 0);
+        if (rebuild) {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+        }
+    }
+
+    if (normalsChanged) {
+        if (!mesh.normalVBO) glGenBuffers(1, &mesh.normalVBO);
+        if (src.normals) {
+            m_uploadStats.vertexBytes += uploadStream(mesh.normalVBO, mesh.normalCapacityBytes, src.normals, 3,
+                                                      src, partial && mesh.normalsVersion != 0);
+        } else {
+            // Written by the compute pass below; only make room for them
+            GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.normalVBO);
+            const size_t requiredBytes = static_cast<size_t>(src.vertexCount) * 3 * sizeof(float);
+            if (requiredBytes > mesh.normalCapacityBytes) {
+                glBufferData(GL_ARRAY_BUFFER, requiredBytes, nullptr, GL_DYNAMIC_DRAW);
+                mesh.normalCapacityBytes = requiredBytes;
+            }
         }
+        if (rebuild) {
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(2);
+        }
+    }
+
+    if (uvsChanged) {
+        if (src.uvs) {
+            if (!mesh.uvVBO) glGenBuffers(1, &mesh.uvVBO);
+            const bool uvPartial = partial && mesh.hasUVs && mesh.uvsVersion != 0;
+            m_uploadStats.vertexBytes += uploadStream(mesh.uvVBO, mesh.uvCapacityBytes, src.uvs, 2,
+                                                      src, uvPartial);
+            GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.uvVBO);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(1);
+        } else {
+            // No UVs: the disabled attribute reads the generic default (0, 0)
+            glDisableVertexAttribArray(1);
+        }
+    }
 
-        glBindVertexArray(mesh.VAO);
+    if (indexChanged) {
+        m_uploadStats.indexBytes += uploadIndices(mesh, src);
+    }
+
+    GLState::bindVertexArray(0);
+
+    mesh.separateStreams = true;
+    mesh.packed = false;
+    refreshBounds(mesh, src, true);
+    recordVertexSource(mesh, src);
+    if (normalsChanged && !src.normals) generateNormalsGpu(mesh, src);
+    ++m_uploadStats.meshesUploaded;
+}
+
+void Engine::uploadMeshPacked(GpuMesh& mesh, const MeshSource& src) {
+    static std::vector<VertexPacking::PackedVertex> packedData;
+
+    // Any position change can move the AABB, so packed meshes always re-encode in full
+    const bool vertexChanged = !mesh.packed || vertexSourceChanged(mesh, src);
+    const bool indexChanged = topologyChanged(mesh, src);
+    if (!vertexChanged && !indexChanged) {
+        ++m_uploadStats.meshesSkipped;
+        return;
+    }
+
+    GLState::bindVertexArray(mesh.VAO);
+
+    if (vertexChanged) {
+        refreshBounds(mesh, src, false);
+        const glm::vec3 boundsMin = mesh.boundsMin;
+        const glm::vec3 boundsMax = mesh.boundsMax;
+        packedData.resize(static_cast<size_t>(src.vertexCount));
+        VertexPacking::pack(packedData.data(), src.positions, src.normals, src.uvs, src.vertexCount,
+                            boundsMin, boundsMax);
 
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
-        size_t requiredVertexBytes = vertexData.size() * sizeof(float);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        const size_t requiredVertexBytes = packedData.size() * sizeof(VertexPacking::PackedVertex);
         if (requiredVertexBytes > mesh.vertexCapacityBytes) {
-            glBufferData(GL_ARRAY_BUFFER, requiredVertexBytes, vertexData.data(), GL_DYNAMIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, requiredVertexBytes, packedData.data(), GL_DYNAMIC_DRAW);
             mesh.vertexCapacityBytes = requiredVertexBytes;
         } else {
-            glBufferSubData(GL_ARRAY_BUFFER, 0, requiredVertexBytes, vertexData.data());
-        }
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        if (src.indices && src.indexCount > 0) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
-            size_t requiredIndexBytes = static_cast<size_t>(src.indexCount) * sizeof(uint32_t);
-            if (requiredIndexBytes > mesh.indexCapacityBytes) {
-                glBufferData(GL_ELEMENT_ARRAY_BUFFER, requiredIndexBytes, src.indices, GL_STATIC_DRAW);
-                mesh.indexCapacityBytes = requiredIndexBytes;
-            } else {
-                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, requiredIndexBytes, src.indices);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, requiredVertexBytes, packedData.data());
+        }
+
+        setPackedAttributes();
+
+        mesh.packed = true;
+        mesh.separateStreams = false;
+        mesh.posDequantScale = VertexPacking::dequantScale(boundsMin, boundsMax);
+        mesh.posDequantBias = boundsMin;
+        m_uploadStats.vertexBytes += requiredVertexBytes;
+        recordVertexSource(mesh, src);
+    }
+
+    if (indexChanged) {
+        m_uploadStats.indexBytes += uploadIndices(mesh, src);
+    }
+
+    GLState::bindVertexArray(0);
+    ++m_uploadStats.meshesUploaded;
+}
+
+void Engine::enterArena(GpuMesh& mesh) {
+    const bool packedFormat = m_compressVertices;
+    GeometryArena& arena = packedFormat ? m_packedArena : m_interleavedArena;
+    if (!arena.isCreated()) {
+        arena.create(packedFormat ? sizeof(VertexPacking::PackedVertex) : kInterleavedStride,
+                     packedFormat ? setPackedAttributes : setInterleavedAttributes,
+                     1u << 16, 3u << 16);
+    }
+    if (mesh.arena == &arena) return;
+
+    // From private buffers, the ring or the other format
+    releaseFromArena(mesh);
+    forgetSource(mesh);
+    mesh.separateStreams = false;
+    mesh.arenaHandle = arena.allocate(0, 0);
+    mesh.arena = &arena;
+}
+
+void Engine::uploadMeshPooled(GpuMesh& mesh, const MeshSource& src) {
+    static std::vector<float> vertexData;
+    static std::vector<VertexPacking::PackedVertex> packedData;
+
+    const bool packedFormat = m_compressVertices;
+    GeometryArena& arena = *mesh.arena;
+
+    const bool vertexChanged = vertexSourceChanged(mesh, src);
+    const bool indexChanged = topologyChanged(mesh, src);
+    if (!vertexChanged && !indexChanged) {
+        ++m_uploadStats.meshesSkipped;
+        return;
+    }
+
+    if (vertexChanged) {
+        const size_t vertexStride = arena.vertexStride();
+        const bool partial = !packedFormat && src.dirtyRanges && src.dirtyRangeCount > 0 &&
+                             mesh.positionsVersion != 0 &&
+                             mesh.sourcePositions == src.positions &&
+                             mesh.vertexCount == src.vertexCount &&
+                             mesh.hasUVs == (src.uvs != nullptr);
+        arena.resizeVertices(mesh.arenaHandle, static_cast<size_t>(src.vertexCount));
+        refreshBounds(mesh, src, !packedFormat);
+
+        if (partial) {
+            for (int r = 0; r < src.dirtyRangeCount; ++r) {
+                int begin = std::max(src.dirtyRanges[r].begin, 0);
+                int end = std::min(src.dirtyRanges[r].end, src.vertexCount);
+                if (begin >= end) continue;
+                vertexData.resize(static_cast<size_t>(end - begin) * 8);
+                interleaveVertices(vertexData.data(), src, begin, end);
+                arena.uploadVertices(mesh.arenaHandle, begin, end - begin, vertexData.data());
+                m_uploadStats.vertexBytes += static_cast<size_t>(end - begin) * vertexStride;
             }
-            mesh.triangleCount = src.indexCount / 3;
+        } else if (packedFormat) {
+            const glm::vec3 boundsMin = mesh.boundsMin;
+            const glm::vec3 boundsMax = mesh.boundsMax;
+            packedData.resize(static_cast<size_t>(src.vertexCount));
+            VertexPacking::pack(packedData.data(), src.positions, src.normals, src.uvs, src.vertexCount,
+                                boundsMin, boundsMax);
+            arena.uploadVertices(mesh.arenaHandle, 0, packedData.size(), packedData.data());
+            mesh.posDequantScale = VertexPacking::dequantScale(boundsMin, boundsMax);
+            mesh.posDequantBias = boundsMin;
+            m_uploadStats.vertexBytes += packedData.size() * vertexStride;
         } else {
-            mesh.triangleCount = 0;
+            vertexData.resize(static_cast<size_t>(src.vertexCount) * 8);
+            interleaveVertices(vertexData.data(), src, 0, src.vertexCount);
+            arena.uploadVertices(mesh.arenaHandle, 0, src.vertexCount, vertexData.data());
+            m_uploadStats.vertexBytes += static_cast<size_t>(src.vertexCount) * vertexStride;
         }
+        mesh.packed = packedFormat;
+        recordVertexSource(mesh, src);
+    }
 
-        glBindVertexArray(0);
+    if (indexChanged) {
+        const size_t indexCount = (src.indices && src.indexCount > 0) ? static_cast<size_t>(src.indexCount) : 0;
+        arena.resizeIndices(mesh.arenaHandle, indexCount);
+        if (indexCount > 0) {
+            arena.uploadIndices(mesh.arenaHandle, src.indices, indexCount);
+            m_uploadStats.indexBytes += indexCount * sizeof(uint32_t);
+        }
+        mesh.triangleCount = static_cast<int>(indexCount / 3);
+        recordTopology(mesh, src);
     }
+
+    ++m_uploadStats.meshesUploaded;
 }
 
-void Engine::syncMeshes(const std::vector<MeshSource>& meshes) {
-    ensureGenericMeshes(meshes.size());
-    static std::vector<float> vertexData;
+bool Engine::uploadMeshAsync(GpuMesh& mesh, const MeshSource& src, bool indexChanged) {
+    std::vector<UploadService::Copy> copies(1);
+    const size_t vertexBytes = static_cast<size_t>(src.vertexCount) * kInterleavedStride;
+    copies[0].bytes.resize(vertexBytes);
+    interleaveVertices(reinterpret_cast<float*>(copies[0].bytes.data()), src, 0, src.vertexCount);
+    copies[0].buffer = createUploadTarget(vertexBytes);
+
+    size_t indexBytes = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    if (indexChanged && src.indices && src.indexCount > 0) {
+        const IndexUpload upload = prepareIndices(src);
+        indexBytes = upload.bytes;
+        indexType = upload.type;
+        copies.emplace_back();
+        const unsigned char* indices = static_cast<const unsigned char*>(upload.data);
+        copies.back().bytes.assign(indices, indices + indexBytes);
+        copies.back().buffer = createUploadTarget(indexBytes);
+    }
 
-    for (size_t i = 0; i < meshes.size(); ++i) {
-        const MeshSource& src = meshes[i];
-        GpuMesh& mesh = m_genericMeshes[i];
-        m_genericColors[i] = src.color;
+    const GLuint vbo = copies[0].buffer;
+    const GLuint ebo = copies.size() > 1 ? copies[1].buffer : 0;
+    // The worker's context only sees the targets' storage once this context is flushed
+    glFlush();
+    const UploadService::Ticket ticket = m_uploads.submit(std::move(copies));
+    if (!ticket) {
+        GLState::deleteBuffers(1, &vbo);
+        if (ebo) GLState::deleteBuffers(1, &ebo);
+        return false;
+    }
 
-        if (!src.positions || !src.normals || src.vertexCount <= 0) {
-            mesh.vertexCount = 0;
-            mesh.triangleCount = 0;
+    mesh.pendingUpload = ticket;
+    mesh.pendingVBO = vbo;
+    mesh.pendingEBO = ebo;
+    mesh.pendingVertexBytes = vertexBytes;
+    mesh.pendingIndexBytes = indexBytes;
+    mesh.pendingIndexType = indexType;
+    mesh.pendingTriangleCount = indexChanged ? (indexBytes ? src.indexCount / 3 : 0) : -1;
+    refreshBounds(mesh, src, true);
+    recordVertexSource(mesh, src);
+    if (indexChanged) recordTopology(mesh, src);
+
+    m_uploadStats.vertexBytes += vertexBytes;
+    m_uploadStats.indexBytes += indexBytes;
+    ++m_uploadStats.meshesUploaded;
+    return true;
+}
+
+void Engine::cancelAsyncUpload(GpuMesh& mesh) {
+    if (!mesh.pendingUpload) return;
+    // The worker may still be copying into these; free them once the ticket completes
+    m_retiredBuffers.push_back({mesh.pendingUpload, mesh.pendingVBO});
+    if (mesh.pendingEBO) m_retiredBuffers.push_back({mesh.pendingUpload, mesh.pendingEBO});
+    mesh.pendingUpload = 0;
+    mesh.pendingVBO = mesh.pendingEBO = 0;
+    mesh.pendingTriangleCount = -1;
+    // The recorded source describes the cancelled upload, not what VBO/EBO hold
+    mesh.sourcePositions = nullptr;
+    mesh.sourceIndices = nullptr;
+    mesh.positionsVersion = mesh.normalsVersion = mesh.uvsVersion = mesh.indicesVersion = 0;
+}
+
+void Engine::completeAsyncUploads() {
+    m_uploads.poll();
+
+    for (std::vector<GpuMesh>* list : {&m_primaryMeshes, &m_meshes.values()}) {
+        for (GpuMesh& mesh : *list) {
+            if (mesh.pendingUpload && m_uploads.isComplete(mesh.pendingUpload)) {
+                adoptPendingBuffers(mesh);
+            }
+        }
+    }
+
+    auto retired = std::remove_if(m_retiredBuffers.begin(), m_retiredBuffers.end(),
+                                  [this](const RetiredBuffer& r) {
+                                      if (!m_uploads.isComplete(r.ticket)) return false;
+                                      GLState::deleteBuffers(1, &r.buffer);
+                                      return true;
+                                  });
+    m_retiredBuffers.erase(retired, m_retiredBuffers.end());
+}
+
+void Engine::setAsyncUploads(bool enabled) {
+    m_asyncUploads = enabled;
+    if (enabled && !m_uploads.isRunning() && !m_uploads.start(glfwGetCurrentContext())) {
+        std::cerr << "Engine: background uploads unavailable, uploading inline" << std::endl;
+    }
+}
+
+bool Engine::isGpuNormals() const {
+    return m_gpuNormals && VertexNormals::gpuAvailable();
+}
+
+bool Engine::isGpuLightClusters() const {
+    return m_gpuLightClusters && LightClusters::gpuAvailable();
+}
+
+MeshSource Engine::withGeneratedNormals(const GpuMesh& mesh, const MeshSource& src, bool onGpu,
+                                        bool interleaved, bool layoutChanged) {
+    MeshSource out = src;
+    // Generated normals change with positions and topology
+    out.normalsVersion = topologyChanged(mesh, src) ? 0 : src.positionsVersion;
+    // Moving one vertex changes the normals of every vertex sharing a face with it,
+    // which the caller's dirty ranges do not cover: upload the whole mesh
+    out.dirtyRanges = nullptr;
+    out.dirtyRangeCount = 0;
+    const size_t floats = static_cast<size_t>(src.vertexCount) * 3;
+    if (onGpu) {
+        // Interleaved layouts still carry the normal slot: write zeros there for the
+        // compute pass to overwrite. Separate streams skip the normal upload entirely.
+        if (interleaved) {
+            if (m_zeroNormals.size() < floats) m_zeroNormals.resize(floats, 0.0f);
+            out.normals = m_zeroNormals.data();
+        }
+        return out;
+    }
+    // The scratch is shared by every mesh: skip the kernel only when no upload follows
+    m_generatedNormals.resize(floats);
+    if (layoutChanged || vertexSourceChanged(mesh, out)) {
+        VertexNormals::compute(m_generatedNormals.data(), src.positions, src.vertexCount,
+                               src.indices, src.indexCount);
+    }
+    out.normals = m_generatedNormals.data();
+    return out;
+}
+
+void Engine::generateNormalsGpu(const GpuMesh& mesh, const MeshSource& src) {
+    VertexNormals::GpuMeshView view;
+    if (mesh.separateStreams) {
+        view.positionBuffer = mesh.VBO;
+        view.normalBuffer = mesh.normalVBO;
+    } else {
+        const GLuint buffer = mesh.streamed ? mesh.streamBuffer : mesh.VBO;
+        const GLuint base = mesh.streamed ? static_cast<GLuint>(mesh.baseVertex) * 8 : 0;
+        view.positionBuffer = view.normalBuffer = buffer;
+        view.positionBase = base;
+        view.positionStride = view.normalStride = 8;
+        view.normalBase = base + 3;
+    }
+    view.indexBuffer = mesh.EBO;
+    view.shortIndices = mesh.indexType == GL_UNSIGNED_SHORT;
+    view.indexCount = mesh.triangleCount * 3;
+    view.vertexCount = src.vertexCount;
+    view.fixedScale = VertexNormals::fixedPointScale(src.positions, src.vertexCount, src.indices, src.indexCount);
+    VertexNormals::computeGpu(view);
+    m_normalsDispatched = true;
+}
+
+void Engine::defragmentGeometry() {
+    m_interleavedArena.defragment();
+    m_packedArena.defragment();
+}
+
+bool Engine::streamPrimaryMeshes(const std::vector<MeshSource>& meshes) {
+    size_t frameBytes = 0;
+    for (const MeshSource& src : meshes) {
+        if (hasValidVertices(src)) {
+            frameBytes += static_cast<size_t>(src.vertexCount) * kInterleavedStride;
+        }
+    }
+
+    if (!m_primaryStream.isCreated() || m_primaryStream.regionBytes() < frameBytes) {
+        // Headroom so a growing cloth does not recreate the ring every frame
+        size_t regionBytes = std::max<size_t>(frameBytes + frameBytes / 2, 1u << 20);
+        regionBytes = (regionBytes + kInterleavedStride - 1) / kInterleavedStride * kInterleavedStride;
+        if (!m_primaryStream.create(GL_ARRAY_BUFFER, regionBytes)) {
+            return false;
+        }
+        // GL may hand back the same buffer name; never copy from the old contents
+        for (GpuMesh& mesh : m_primaryMeshes) mesh.streamBuffer = 0;
+    }
+
+    // Blocks only if the GPU is still reading the region from three frames ago
+    m_primaryStream.beginFrame();
+    const GLuint ring = m_primaryStream.buffer();
+    bool copyBound = false;
+
+    const bool gpuNormalsAvailable = isGpuNormals();
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        GpuMesh& mesh = m_primaryMeshes[i];
+        mesh.model = meshes[i].model;
+        cancelAsyncUpload(mesh);
+        // Before the normals and topology checks, which must see the forgotten source
+        releaseFromArena(mesh);
+        const bool gpuNormals = !meshes[i].normals && gpuNormalsAvailable;
+        const bool layoutChanged = !mesh.streamed || mesh.streamBuffer != ring;
+        const MeshSource src = meshes[i].normals
+                                   ? meshes[i]
+                                   : withGeneratedNormals(mesh, meshes[i], gpuNormals, true, layoutChanged);
+
+        size_t offset = 0;
+        float* dst = nullptr;
+        const size_t bytes = static_cast<size_t>(src.vertexCount) * kInterleavedStride;
+        if (hasValidVertices(src)) {
+            dst = static_cast<float*>(m_primaryStream.allocate(bytes, kInterleavedStride, offset));
+        }
+        if (!dst) {
+            forgetSource(mesh);
+            mesh.streamed = false;
             continue;
         }
 
-        vertexData.assign(src.vertexCount * 8, 0.0f);
-        for (int j = 0; j < src.vertexCount; ++j) {
-            int vi = j * 8;
-            int pi = j * 3;
-            int ui = j * 2;
-            vertexData[vi + 0] = src.positions[pi + 0];
-            vertexData[vi + 1] = src.positions[pi + 1];
-            vertexData[vi + 2] = src.positions[pi + 2];
-            vertexData[vi + 3] = src.normals[pi + 0];
-            vertexData[vi + 4] = src.normals[pi + 1];
-            vertexData[vi + 5] = src.normals[pi + 2];
-            vertexData[vi + 6] = (src.uvs && src.vertexCount > 0) ? src.uvs[ui + 0] : 0.0f;
-            vertexData[vi + 7] = (src.uvs && src.vertexCount > 0) ? src.uvs[ui + 1] : 0.0f;
-        }
-
-        glBindVertexArray(mesh.VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
-        size_t requiredVertexBytes = vertexData.size() * sizeof(float);
-        if (requiredVertexBytes > mesh.vertexCapacityBytes) {
-            glBufferData(GL_ARRAY_BUFFER, requiredVertexBytes, vertexData.data(), GL_DYNAMIC_DRAW);
-            mesh.vertexCapacityBytes = requiredVertexBytes;
+        // Every mesh is rewritten into the new region each frame. Unchanged data still
+        // lives in the previous region, so copy it GPU-side instead of touching the CPU.
+        const bool vertexChanged = layoutChanged || vertexSourceChanged(mesh, src);
+        if (vertexChanged) {
+            interleaveVertices(dst, src, 0, src.vertexCount);
+            m_uploadStats.vertexBytes += bytes;
+            refreshBounds(mesh, src, true);
+            recordVertexSource(mesh, src);
         } else {
-            glBufferSubData(GL_ARRAY_BUFFER, 0, requiredVertexBytes, vertexData.data());
-        }
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        if (src.indices && src.indexCount > 0) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
-            size_t requiredIndexBytes = static_cast<size_t>(src.indexCount) * sizeof(uint32_t);
-            if (requiredIndexBytes > mesh.indexCapacityBytes) {
-                glBufferData(GL_ELEMENT_ARRAY_BUFFER, requiredIndexBytes, src.indices, GL_STATIC_DRAW);
-                mesh.indexCapacityBytes = requiredIndexBytes;
-            } else {
-                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, requiredIndexBytes, src.indices);
+            if (!copyBound) {
+                GLState::bindBuffer(GL_COPY_READ_BUFFER, ring);
+                copyBound = true;
             }
-            mesh.triangleCount = src.indexCount / 3;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_READ_BUFFER,
+                                static_cast<GLintptr>(mesh.streamOffset),
+                                static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes));
+            m_uploadStats.copiedBytes += bytes;
+        }
+
+        mesh.streamed = true;
+        mesh.streamOffset = offset;
+        mesh.streamRegion = m_primaryStream.currentRegion();
+        mesh.baseVertex = static_cast<GLint>(offset / kInterleavedStride);
+
+        GLState::bindVertexArray(mesh.VAO);
+        if (mesh.streamBuffer != ring) {
+            GLState::bindBuffer(GL_ARRAY_BUFFER, ring);
+            setInterleavedAttributes();
+            mesh.streamBuffer = ring;
+            mesh.separateStreams = false;
+            mesh.packed = false;
+        }
+        if (topologyChanged(mesh, src)) {
+            MeshSource ordered = src;
+            if (src.indices && src.indexCount >= 3) ordered.indices = orderTopology(mesh, src);
+            m_uploadStats.indexBytes += uploadIndices(mesh, ordered);
+            mesh.sourceIndices = src.indices;
+        }
+        GLState::bindVertexArray(0);
+        if (!mesh.clusters.empty()) {
+            Meshlets::refit(mesh.clusters, src.positions, static_cast<size_t>(src.vertexCount),
+                            src.positionsVersion);
+        }
+        if (gpuNormals && vertexChanged) generateNormalsGpu(mesh, src);
+        if (vertexChanged) ++m_uploadStats.meshesUploaded;
+        else ++m_uploadStats.meshesSkipped;
+    }
+    if (copyBound) GLState::bindBuffer(GL_COPY_READ_BUFFER, 0);
+    return true;
+}
+
+void Engine::syncMeshes(const std::vector<MeshSource>& meshes) {
+    completeAsyncUploads();
+
+    // Same matching as the primary list, on top of the handle API
+    const std::vector<int> match = matchPreviousSources(m_syncedSources, meshes);
+    std::vector<bool> reused(m_syncedHandles.size(), false);
+    for (int from : match) {
+        if (from >= 0) reused[from] = true;
+    }
+    // Release first so new meshes can pick the freed buffers out of the pool
+    for (size_t i = 0; i < m_syncedHandles.size(); ++i) {
+        if (!reused[i]) destroyMesh(m_syncedHandles[i]);
+    }
+
+    std::vector<MeshHandle> handles(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        if (match[i] >= 0) {
+            handles[i] = m_syncedHandles[match[i]];
+            updateMesh(handles[i], meshes[i]);
         } else {
-            mesh.triangleCount = 0;
+            handles[i] = createMesh(meshes[i]);
         }
+    }
+    m_syncedHandles = std::move(handles);
+    m_syncedSources.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) m_syncedSources[i] = meshes[i].positions;
+}
+
+MeshHandle Engine::createMesh(const MeshSource& src) {
+    const MeshHandle handle = m_meshes.insert(acquireGpuMesh(interleavedBytes(src)));
+    m_meshColors.push_back(src.color);
+    uploadMesh(*m_meshes.get(handle), src);
+    return handle;
+}
+
+bool Engine::updateMesh(MeshHandle handle, const MeshSource& src) {
+    GpuMesh* mesh = m_meshes.get(handle);
+    if (!mesh) return false;
+    m_meshColors[m_meshes.denseIndex(handle)] = src.color;
+    uploadMesh(*mesh, src);
+    return true;
+}
+
+void Engine::destroyMesh(MeshHandle handle) {
+    if (!m_meshes.contains(handle)) return;
+    // Mirror the slot map's swap-with-last removal in the color array
+    const size_t dense = m_meshes.denseIndex(handle);
+    m_meshColors[dense] = m_meshColors.back();
+    m_meshColors.pop_back();
+    recycleGpuMesh(m_meshes.erase(handle));
+}
+
+InstancedMeshHandle Engine::createInstancedMesh(const MeshSource& base, bool castsShadow) {
+    if (!hasValidVertices(base) || !base.indices || base.indexCount < 3) {
+        std::cerr << "Engine: instanced mesh needs vertices and an index list" << std::endl;
+        return InstancedMeshHandle{};
+    }
+    MeshSource src = base;
+    if (!src.normals) {
+        m_generatedNormals.resize(static_cast<size_t>(src.vertexCount) * 3);
+        VertexNormals::compute(m_generatedNormals.data(), src.positions, src.vertexCount,
+                               src.indices, src.indexCount);
+        src.normals = m_generatedNormals.data();
+    }
+
+    InstancedMesh mesh;
+    mesh.color = src.color;
+    mesh.castsShadow = castsShadow;
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+    glGenBuffers(1, &mesh.instanceVBO);
+
+    GLState::bindVertexArray(mesh.VAO);
+    std::vector<float> vertices(static_cast<size_t>(src.vertexCount) * 8);
+    interleaveVertices(vertices.data(), src, 0, src.vertexCount);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, interleavedBytes(src), vertices.data(), GL_STATIC_DRAW);
+    setInterleavedAttributes();
+    const IndexUpload indices = prepareIndices(src);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.bytes, indices.data, GL_STATIC_DRAW);
+    mesh.indexType = indices.type;
+    mesh.indexCount = src.indexCount;
+    VertexPacking::computeBounds(src.positions, src.vertexCount, mesh.baseMin, mesh.baseMax);
+    setInstanceAttributes(mesh.instanceVBO);
+    GLState::bindVertexArray(0);
+
+    m_uploadStats.vertexBytes += interleavedBytes(src);
+    m_uploadStats.indexBytes += indices.bytes;
+    ++m_uploadStats.meshesUploaded;
+    return m_instancedMeshes.insert(mesh);
+}
+
+bool Engine::setInstances(InstancedMeshHandle handle, const InstanceData* instances, int count) {
+    InstancedMesh* mesh = m_instancedMeshes.get(handle);
+    if (!mesh) return false;
+    uploadInstances(*mesh, instances, count);
+    return true;
+}
 
-        mesh.vertexCount = src.vertexCount;
-        glBindVertexArray(0);
+void Engine::destroyInstancedMesh(InstancedMeshHandle handle) {
+    InstancedMesh* mesh = m_instancedMeshes.get(handle);
+    if (!mesh) return;
+    releaseInstancedMesh(*mesh);
+    m_instancedMeshes.erase(handle);
+}
+
+void Engine::recordSceneMesh(const GpuMesh& mesh, CommandBuffer& cmd) {
+    if (m_meshletCulling && !mesh.clusters.empty()) {
+        // Meshlet bounds are in object space: pull the frustum and eye back into it
+        const Meshlets::Frustum frustum = Meshlets::extractFrustum(m_viewProj * mesh.model);
+        const glm::vec3 eye(glm::inverse(mesh.model) * glm::vec4(m_viewEye, 1.0f));
+        recordMeshCulled(mesh, frustum, m_meshletConeCulling ? &eye : nullptr, cmd);
+    } else {
+        recordMesh(mesh, cmd);
+    }
+}
+
+uint64_t Engine::shadowCasterKey(bool primary, bool statics, SphereObstacle* sphere,
+                                 const gfx::RenderSettings& params) const {
+    CacheKey key;
+    auto addMeshes = [&](const std::vector<GpuMesh>& meshes) {
+        key.add(meshes.size());
+        for (const GpuMesh& mesh : meshes) {
+            // Untracked data may change every sync without notice
+            const bool tracked = mesh.positionsVersion != 0 && mesh.indicesVersion != 0;
+            key.add(tracked ? mesh.positionsVersion : m_shadowFrame);
+            key.add(mesh.indicesVersion);
+            key.add(mesh.triangleCount);
+            key.add(mesh.model);
+            key.add(mesh.posDequantScale);
+            key.add(mesh.posDequantBias);
+            key.add(mesh.pendingUpload);   // buffers swap when a background upload lands
+        }
+    };
+    key.add(primary && params.clothVisibility);
+    if (primary && params.clothVisibility) addMeshes(m_primaryMeshes);
+    if (!statics) return key.value;
+
+    key.add(params.customMeshVisibility);
+    if (params.customMeshVisibility) {
+        addMeshes(m_meshes.values());
+        for (const InstancedMesh& mesh : m_instancedMeshes.values()) {
+            if (!mesh.castsShadow) continue;
+            key.add(mesh.VAO);
+            key.add(mesh.instancesVersion);
+            key.add(mesh.instanceCount);
+        }
     }
+    const bool sphereCasts = sphere && params.sphereVisibility;
+    key.add(sphereCasts);
+    if (sphereCasts) {
+        const Vector position = sphere->getPosition();
+        key.add(position.m_x);
+        key.add(position.m_y);
+        key.add(position.m_z);
+        key.add(sphere->getRadius());
+        key.add(sphere->shapeVersion());
+    }
+    return key.value;
+}
+
+void Engine::shadowCasterBounds(bool primary, bool statics, SphereObstacle* sphere,
+                                const gfx::RenderSettings& params, glm::vec3& outMin, glm::vec3& outMax) const {
+    outMin = glm::vec3(std::numeric_limits<float>::max());
+    outMax = glm::vec3(-std::numeric_limits<float>::max());
+    auto addBox = [&](const glm::vec3& lo, const glm::vec3& hi) {
+        outMin = glm::min(outMin, lo);
+        outMax = glm::max(outMax, hi);
+    };
+    auto addMeshes = [&](const std::vector<GpuMesh>& meshes) {
+        for (const GpuMesh& mesh : meshes) {
+            if (mesh.VAO == 0 || mesh.triangleCount == 0) continue;
+            for (int c = 0; c < 8; ++c) {
+                const glm::vec3 corner((c & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                                       (c & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                                       (c & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+                const glm::vec3 p(mesh.model * glm::vec4(corner, 1.0f));
+                addBox(p, p);
+            }
+        }
+    };
+    if (primary && params.clothVisibility) addMeshes(m_primaryMeshes);
+    if (!statics) return;
+    if (params.customMeshVisibility) {
+        addMeshes(m_meshes.values());
+        for (const InstancedMesh& mesh : m_instancedMeshes.values()) {
+            if (mesh.castsShadow && mesh.instanceCount > 0) addBox(mesh.boundsMin, mesh.boundsMax);
+        }
+    }
+    if (sphere && params.sphereVisibility) {
+        const Vector position = sphere->getPosition();
+        const glm::vec3 center(position.m_x, position.m_y, position.m_z);
+        // Deformation pushes the surface out by up to its strength (a fraction of the radius)
+        const float bulge = sphere->m_deformationEnabled ? std::abs(sphere->m_deformationStrength) : 0.0f;
+        const glm::vec3 extent(sphere->getRadius() * (1.0f + bulge));
+        addBox(center - extent, center + extent);
+    }
+}
+
+void Engine::recordIndirectBatches(CommandBuffer& cmd, const IndirectBatch (&batches)[2], bool shadowPass) const {
+    const BatchList list{this, &batches};
+    if (shadowPass) {
+        cmd.invoke(+[](const BatchList& l) {
+            if (!Shadow::useIndirectProgram(glm::mat4(1.0f))) return;
+            l.engine->drawIndirectBatches(*l.batches);
+            Shadow::useStandardProgram();
+        }, list);
+    } else {
+        cmd.invoke(+[](const BatchList& l) { l.engine->drawIndirectBatches(*l.batches); }, list);
+    }
+}
+
+void Engine::buildIndirectBatches(const std::vector<GpuMesh>& meshes,
+                                  const std::vector<glm::vec3>& colors,
+                                  IndirectBatch (&batches)[2]) {
+    batches[0].clear();
+    batches[1].clear();
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const GpuMesh& mesh = meshes[i];
+        if (!mesh.arena || mesh.triangleCount == 0) continue;
+
+        // Same material values the per-mesh path sets through uniforms
+        const glm::vec3 color = (i < colors.size()) ? colors[i] : glm::vec3(0.8f, 0.2f, 0.2f);
+        BatchDrawData data;
+        data.model = mesh.model;
+        data.normalModel = glm::transpose(glm::inverse(mesh.model));
+        data.ambient = glm::vec4(color * 0.3f, 1.0f);
+        data.diffuse = glm::vec4(color, 1.0f);
+        data.specular = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+        data.params = glm::vec4(color * 0.8f, 32.0f);
+        if (mesh.packed) {
+            data.posScale = glm::vec4(mesh.posDequantScale, 1.0f);
+            data.posBias = glm::vec4(mesh.posDequantBias, 0.0f);
+        }
+
+        const GeometryArena::Block& block = mesh.arena->block(mesh.arenaHandle);
+        IndirectBatch& batch = batches[mesh.arena == &m_packedArena ? 1 : 0];
+        batch.add(static_cast<GLuint>(mesh.triangleCount * 3), static_cast<GLuint>(block.firstIndex),
+                  static_cast<GLint>(block.firstVertex), data);
+    }
+    batches[0].upload();
+    batches[1].upload();
+}
+
+void Engine::drawIndirectBatches(const IndirectBatch (&batches)[2]) const {
+    if (!batches[0].empty()) batches[0].draw(m_interleavedArena.vao());
+    if (!batches[1].empty()) batches[1].draw(m_packedArena.vao());
 }
 
 void Engine::renderScene(Camera* camera,
@@ -253,372 +1583,472 @@ void Engine::renderScene(Camera* camera,
                          const std::vector<glm::vec3>& primaryColors,
                          const gfx::RenderSettings& params,
                          TransformStack& transformStack) {
+    // The UI draws with the same context between frames
+    GLState::invalidate();
+    completeAsyncUploads();
+    if (m_normalsDispatched) {
+        VertexNormals::finishGpu();
+        m_normalsDispatched = false;
+    }
+
     // Shadow pass
     glm::vec3 lightWorldPos(params.lightPosition[0], params.lightPosition[1], params.lightPosition[2]);
-    glm::vec3 lightAmbient(params.lightAmbient[0], params.lightAmbient[1], params.lightAmbient[2]);
     glm::vec3 lightDiffuse(params.lightDiffuse[0], params.lightDiffuse[1], params.lightDiffuse[2]);
-    glm::vec3 lightSpecular(params.lightSpecular[0], params.lightSpecular[1], params.lightSpecular[2]);
     glm::vec3 sceneCenter(0.0f, 0.0f, 0.0f);
     float sceneRadius = 100.0f;
-    auto drawShadowMeshes = [](const std::vector<GpuMesh>& meshes) {
-        for (const GpuMesh& mesh : meshes) {
-            if (mesh.VAO == 0 || mesh.triangleCount == 0) continue;
-            glBindVertexArray(mesh.VAO);
-            glDrawElements(GL_TRIANGLES, mesh.triangleCount * 3, GL_UNSIGNED_INT, 0);
-            glBindVertexArray(0);
-        }
-    };
-
-    // Multi-shadow pass: render shadow map for each shadow-casting light
+    const bool indirect = isIndirectDraw();
+    if (indirect) {
+        buildIndirectBatches(m_primaryMeshes, primaryColors, m_primaryBatches);
+        buildIndirectBatches(m_meshes.values(), m_meshColors, m_genericBatches);
+    }
+    // Frame graph: shadow maps -> scene -> SSAO -> composite. Targets are pooled
+    // transients, so features that are off hold no textures.
+    m_renderGraph.reset();
+    const RenderGraph::Resource backbuffer = m_renderGraph.backbuffer();
+
+    // Multi-shadow pass: the main light's cascades, then shadow-casting extra lights, one layer each
+    RenderGraph::Resource shadowMaps = RenderGraph::kNone;
+    RenderGraph::Resource dynamicShadowMaps = RenderGraph::kNone;
+    int shadowCount = 0;
+    const bool shadowCaching = Shadow::isEnabled() && Shadow::isCaching();
+    const bool shadowSplit = shadowCaching && Shadow::isDynamicSplit();
+    ++m_shadowFrame;
     if (Shadow::isEnabled()) {
-        int shadowIndex = 0;
-        
-        // Main light shadow (always first)
+        // The main light's cascades, fitted to the view and the casters
         {
-            Light shadowLight(lightWorldPos, Colour(lightDiffuse.r, lightDiffuse.g, lightDiffuse.b, 1.0f));
-            Shadow::beginShadowPass(shadowIndex, &shadowLight, sceneCenter, sceneRadius);
-
-            // Cloth casters
-            if (!m_primaryMeshes.empty() && params.clothVisibility) {
-                glm::mat4 model = glm::mat4(1.0f);
-                Shadow::setModelMatrix(model);
-                drawShadowMeshes(m_primaryMeshes);
+            glm::vec3 casterMin, casterMax;
+            shadowCasterBounds(!shadowSplit, true, sphere, params, casterMin, casterMax);
+            if (shadowSplit) {
+                // The cascade matrices key the cached layers, so the primary meshes, drawn
+                // every frame anyway, only widen the fit by their allowance
+                glm::vec3 dynamicMin, dynamicMax;
+                shadowCasterBounds(true, false, sphere, params, dynamicMin, dynamicMax);
+                updateCasterAllowance(m_dynamicCasterMin, m_dynamicCasterMax, dynamicMin, dynamicMax);
+                casterMin = glm::min(casterMin, m_dynamicCasterMin);
+                casterMax = glm::max(casterMax, m_dynamicCasterMax);
             }
-
-            // Generic mesh casters
-            if (!m_genericMeshes.empty() && params.customMeshVisibility) {
-                glm::mat4 model = glm::mat4(1.0f);
-                Shadow::setModelMatrix(model);
-                drawShadowMeshes(m_genericMeshes);
-            }
-
-            // Sphere caster
-            if (sphere && params.sphereVisibility) {
-                Vector spherePos = sphere->getPosition();
-                glm::mat4 sphereModel = glm::translate(glm::mat4(1.0f), glm::vec3(spherePos.m_x, spherePos.m_y, spherePos.m_z));
-                sphereModel = glm::scale(sphereModel, glm::vec3(sphere->getRadius()));
-                Shadow::setModelMatrix(sphereModel);
-                sphere->renderGeometryOnly();
-            }
-
-            Shadow::endShadowPass();
-            shadowIndex++;
+            Light shadowLight(lightWorldPos, Colour(lightDiffuse.r, lightDiffuse.g, lightDiffuse.b, 1.0f));
+            shadowCount = Shadow::setupCascades(&shadowLight, sceneCenter, camera->getViewMatrix(),
+                                                camera->getProjectionMatrix(), camera->getNear(), camera->getFar(),
+                                                casterMin, casterMax);
         }
-        
-        // Additional lights from multi-light array
-        for (size_t i = 0; i < params.lights.size() && shadowIndex < Shadow::MAX_SHADOW_LIGHTS; ++i) {
+        int extraShadows = 0;
+        for (size_t i = 0; i < params.lights.size() && extraShadows < Shadow::MAX_SHADOW_LIGHTS - 1; ++i) {
             const auto& lightData = params.lights[i];
             if (!lightData.enabled || !lightData.castsShadow) continue;
-            
             glm::vec3 lPos(lightData.position[0], lightData.position[1], lightData.position[2]);
             glm::vec3 lDiff(lightData.diffuse[0], lightData.diffuse[1], lightData.diffuse[2]);
             Light shadowLight(lPos, Colour(lDiff.r, lDiff.g, lDiff.b, 1.0f));
-            Shadow::beginShadowPass(shadowIndex, &shadowLight, sceneCenter, sceneRadius);
+            Shadow::setupShadowLight(shadowCount++, &shadowLight, sceneCenter, sceneRadius);
+            ++extraShadows;
+        }
 
-            // Cloth casters
-            if (!m_primaryMeshes.empty() && params.clothVisibility) {
-                glm::mat4 model = glm::mat4(1.0f);
-                Shadow::setModelMatrix(model);
-                drawShadowMeshes(m_primaryMeshes);
+        // Shadow arrays this frame: the main one (the persistent cache when caching), and
+        // with a split cache a per-frame one for the primary meshes, which move every
+        // frame. A cached array only redraws the layers whose light or casters changed.
+        struct ShadowTarget {
+            bool primary = false;    // primary meshes (cloth)
+            bool statics = false;    // auxiliary meshes, instanced props and the sphere
+            bool layered = false;
+            bool redraw[Shadow::MAX_SHADOW_LAYERS] = {};
+        };
+        ShadowTarget targets[2];
+        const int targetCount = shadowSplit ? 2 : 1;
+        targets[0].primary = !shadowSplit;
+        targets[0].statics = true;
+        targets[1].primary = true;
+        Shadow::resetCacheStats();
+
+        // Several layers render in one layered pass: every caster is drawn once per layer
+        // with a single submission. That pass draws whole meshes, so the multi-draw and
+        // per-light meshlet culling paths only serve the pass-per-layer fallback.
+        const bool layeredAvailable = Shadow::isLayeredRendering() && Shadow::hasLayeredProgram();
+        for (int t = 0; t < targetCount; ++t) {
+            ShadowTarget& target = targets[t];
+            int redraws = 0;
+            if (t == 0 && shadowCaching) {
+                const uint64_t casterKey = shadowCasterKey(target.primary, target.statics, sphere, params);
+                for (int p = 0; p < shadowCount; ++p) {
+                    target.redraw[p] = Shadow::claimStaleLayer(p, casterKey);
+                    redraws += target.redraw[p] ? 1 : 0;
+                }
+            } else {
+                for (int p = 0; p < shadowCount; ++p) target.redraw[p] = true;
+                redraws = shadowCount;
             }
+            target.layered = redraws > 1 && layeredAvailable;
+            if (target.layered) {
+                // The layered pass redraws (and clears) every layer of the array
+                for (int p = 0; p < shadowCount; ++p) target.redraw[p] = true;
+                if (t == 0 && shadowCaching) Shadow::invalidateCache(shadowCount);
+            }
+        }
+
+        // Shadow program variants build on first use, which has to happen here on the GL thread
+        const bool indirectShadows = indirect && Shadow::hasIndirectProgram();
+        bool instancedCasters[2] = {};
+        for (int t = 0; t < targetCount; ++t) {
+            instancedCasters[t] = targets[t].statics && params.customMeshVisibility && !m_instancedMeshes.empty() &&
+                                  (targets[t].layered ? Shadow::hasLayeredProgram(true) : Shadow::hasInstancedProgram());
+        }
 
-            if (!m_genericMeshes.empty() && params.customMeshVisibility) {
-                glm::mat4 model = glm::mat4(1.0f);
-                Shadow::setModelMatrix(model);
-                drawShadowMeshes(m_genericMeshes);
+        auto recordShadowMeshes = [&](CommandBuffer& cmd, const std::vector<GpuMesh>& meshes,
+                                      const IndirectBatch (&batches)[2], const glm::mat4& lightSpace,
+                                      bool layered) {
+            const int layers = layered ? shadowCount : 1;
+            // Pooled meshes go out as one multi-draw per arena; the rest draw one by one
+            const bool shadowIndirect = !layered && indirectShadows;
+            cmd.invoke(&Shadow::setModelMatrix, glm::mat4(1.0f));
+            if (shadowIndirect) recordIndirectBatches(cmd, batches, true);
+            bool decodeActive = false;
+            glm::mat4 model(1.0f);
+            for (const GpuMesh& mesh : meshes) {
+                if (mesh.VAO == 0 || mesh.triangleCount == 0) continue;
+                if (shadowIndirect && mesh.arena) continue;
+                if (mesh.model != model) {
+                    model = mesh.model;
+                    cmd.invoke(&Shadow::setModelMatrix, model);
+                }
+                if (mesh.packed || decodeActive) {
+                    cmd.invoke(&setShadowDecode, mesh.packed ? PositionDecode{mesh.posDequantScale, mesh.posDequantBias}
+                                                             : PositionDecode{});
+                    decodeActive = mesh.packed;
+                }
+                if (!layered && m_meshletCulling && !mesh.clusters.empty()) {
+                    recordMeshCulled(mesh, Meshlets::extractFrustum(lightSpace * mesh.model), nullptr, cmd);
+                } else {
+                    recordMesh(mesh, cmd, layers);
+                }
+            }
+            if (decodeActive) cmd.invoke(&setShadowDecode, PositionDecode{});
+        };
+
+        // Instanced casters: one instanced draw per mesh under the instanced shadow program
+        auto recordShadowInstances = [&](CommandBuffer& cmd, bool layered) {
+            const GLuint layers = layered ? static_cast<GLuint>(shadowCount) : 1;
+            cmd.invoke(&setShadowInstanced, true);
+            for (const InstancedMesh& mesh : m_instancedMeshes.values()) {
+                if (mesh.castsShadow && mesh.instanceCount > 0) recordInstances(mesh, cmd, layers);
             }
+            cmd.invoke(&setShadowInstanced, false);
+        };
+
+        // One recording per pass: per layer, or one for a layered pass
+        struct ShadowJob {
+            int target;
+            int layer;   // -1: every layer, layered
+        };
+        std::vector<ShadowJob> jobs;
+        for (int t = 0; t < targetCount; ++t) {
+            if (targets[t].layered) {
+                jobs.push_back(ShadowJob{t, -1});
+                continue;
+            }
+            for (int p = 0; p < shadowCount; ++p) {
+                if (targets[t].redraw[p]) jobs.push_back(ShadowJob{t, p});
+            }
+        }
 
-            // Sphere caster
-            if (sphere && params.sphereVisibility) {
-                Vector spherePos = sphere->getPosition();
-                glm::mat4 sphereModel = glm::translate(glm::mat4(1.0f), glm::vec3(spherePos.m_x, spherePos.m_y, spherePos.m_z));
-                sphereModel = glm::scale(sphereModel, glm::vec3(sphere->getRadius()));
-                Shadow::setModelMatrix(sphereModel);
-                sphere->renderGeometryOnly();
+        // Culling and recording for every pass run in parallel; GL replays pass by pass
+        const int jobCount = static_cast<int>(jobs.size());
+        if (m_shadowCommands.size() < jobs.size()) m_shadowCommands.resize(jobs.size());
+        Parallel::forRange(jobCount, 1, [&](int begin, int end) {
+            for (int j = begin; j < end; ++j) {
+                const ShadowTarget& target = targets[jobs[j].target];
+                const bool layered = jobs[j].layer < 0;
+                CommandBuffer& cmd = m_shadowCommands[j];
+                cmd.clear();
+                const glm::mat4 lightSpace = Shadow::getLightSpaceMatrix(layered ? 0 : jobs[j].layer);
+                if (target.primary && !m_primaryMeshes.empty() && params.clothVisibility) {
+                    recordShadowMeshes(cmd, m_primaryMeshes, m_primaryBatches, lightSpace, layered);
+                }
+                if (target.statics && !m_meshes.empty() && params.customMeshVisibility) {
+                    recordShadowMeshes(cmd, m_meshes.values(), m_genericBatches, lightSpace, layered);
+                }
+                if (instancedCasters[jobs[j].target]) recordShadowInstances(cmd, layered);
             }
+        });
 
-            Shadow::endShadowPass();
-            shadowIndex++;
+        glm::mat4 sphereModel(1.0f);
+        if (sphere && params.sphereVisibility) {
+            Vector spherePos = sphere->getPosition();
+            sphereModel = glm::translate(glm::mat4(1.0f), glm::vec3(spherePos.m_x, spherePos.m_y, spherePos.m_z));
+            sphereModel = glm::scale(sphereModel, glm::vec3(sphere->getRadius()));
+        }
+        shadowMaps = shadowCaching
+            ? m_renderGraph.importTexture("shadow cache", Shadow::cacheArray(), Shadow::mapDesc(Shadow::MAX_SHADOW_LAYERS))
+            : m_renderGraph.createTexture("shadow maps", Shadow::mapDesc(shadowCount));
+        if (shadowSplit) {
+            dynamicShadowMaps = m_renderGraph.createTexture("dynamic shadow maps", Shadow::mapDesc(shadowCount));
+        }
+        for (int j = 0; j < jobCount; ++j) {
+            const ShadowJob job = jobs[j];
+            const RenderGraph::Resource target = job.target == 0 ? shadowMaps : dynamicShadowMaps;
+            const bool drawSphere = targets[job.target].statics && sphere && params.sphereVisibility;
+            m_renderGraph.addPass(job.layer < 0 ? "shadow (layered)" : "shadow",
+                [target, job](RenderGraph::Builder& builder) {
+                    if (job.layer < 0) {
+                        builder.write(target);
+                    } else {
+                        builder.writeLayer(target, job.layer);
+                    }
+                },
+                [&, j, job, drawSphere, sphereModel](const RenderGraph&) {
+                    if (job.layer < 0) {
+                        if (!Shadow::beginLayeredShadowPass(shadowCount)) return;
+                    } else {
+                        Shadow::beginShadowPass(job.layer);
+                    }
+                    m_shadowCommands[j].replay();
+                    // Sphere caster: a single draw whose geometry may still be created lazily
+                    if (drawSphere) {
+                        Shadow::setModelMatrix(sphereModel);
+                        sphere->renderGeometryOnly(job.layer < 0 ? shadowCount : 1);
+                    }
+                    Shadow::endShadowPass();
+                });
         }
     }
 
-    // Scene pass to SSAO buffer
-    SSAO::beginScenePass();
-    glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    // Everything lit goes through the queue, sorted by program, state and depth
+    const glm::mat4 view = camera->getViewMatrix();
+    const glm::mat4 proj = camera->getProjectionMatrix();
+    m_renderQueue.begin(view, camera->getFar());
+    m_viewProj = proj * view;
+    m_viewEye = camera->getEye();
 
-    // Floor + sphere
-    Renderer::renderFloorAndSphere(floor, sphere, camera, transformStack, params);
+    // Every extra light, into per-cluster lists the lit shaders walk
+    LightClusters::update(params.lights, view, proj, camera->getNear(), camera->getFar(),
+                          m_renderGraph.backbufferWidth(), m_renderGraph.backbufferHeight(), m_gpuLightClusters);
 
-    // Light gizmo (visible position marker)
-    {
-        ShaderLib* shader = ShaderLib::instance();
-        ShaderLib::ProgramWrapper* phong = (*shader)["Phong"];
-        if (phong) {
-            phong->use();
-            glm::mat4 view = camera->getViewMatrix();
-            glm::mat4 proj = camera->getProjectionMatrix();
-            glm::vec3 gizmoColor(1.5f, 1.3f, 0.0f); // bright yellow marker
-
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), lightWorldPos);
-            model = glm::scale(model, glm::vec3(3.5f)); // larger gizmo
-
-            phong->setUniform("MVP", proj * view * model);
-            phong->setUniform("M", model);
-            phong->setUniform("MV", view * model);
-            phong->setUniform("normalMatrix", glm::mat3(glm::transpose(glm::inverse(view * model))));
-
-            // Overpower lighting to keep gizmo visible
-            glm::vec3 gizmoLightColor(6.0f, 6.0f, 6.0f); // overpower lighting to keep gizmo visible
-            phong->setUniform("light.position", view * glm::vec4(lightWorldPos, 1.0f));
-            phong->setUniform("light.ambient", glm::vec4(gizmoLightColor, 1.0f));
-            phong->setUniform("light.diffuse", glm::vec4(gizmoLightColor, 1.0f));
-            phong->setUniform("light.specular", glm::vec4(gizmoLightColor, 1.0f));
-            phong->setUniform("light.constantAttenuation", 1.0f);
-            phong->setUniform("light.linearAttenuation", 0.0f);
-            phong->setUniform("light.quadraticAttenuation", 0.0f);
-            phong->setUniform("viewerPos", camera->getEye());
-            phong->setUniform("Normalize", false);
-
-            GLuint programId = phong->getProgramId();
-            glUniform1i(glGetUniformLocation(programId, "shadowEnabled"), 0); // gizmo unshadowed
-
-            // Boost material to stay bright
-            phong->setUniform("material.ambient", glm::vec4(gizmoColor * 6.0f, 1.0f));
-            phong->setUniform("material.diffuse", glm::vec4(gizmoColor * 6.0f, 1.0f));
-            phong->setUniform("material.specular", glm::vec4(2.5f, 2.5f, 2.0f, 1.0f));
-            phong->setUniform("material.shininess", 2.0f);
-
-            if (!renderData.particleSphere) {
-                renderData.particleSphere = FlockingGraphics::GeometryFactory::instance().createSphere(1.0f, 12);
-            }
-            renderData.particleSphere->render();
-            
-            // Render additional light gizmos
-            for (size_t li = 0; li < params.lights.size(); ++li) {
-                const auto& lightData = params.lights[li];
-                if (!lightData.enabled) continue;
-                
-                glm::vec3 lPos(lightData.position[0], lightData.position[1], lightData.position[2]);
-                glm::vec3 lColor(lightData.diffuse[0], lightData.diffuse[1], lightData.diffuse[2]);
-                
-                glm::mat4 lModel = glm::translate(glm::mat4(1.0f), lPos);
-                lModel = glm::scale(lModel, glm::vec3(lightData.castsShadow ? 4.0f : 2.5f));
-                
-                phong->setUniform("MVP", proj * view * lModel);
-                phong->setUniform("M", lModel);
-                phong->setUniform("MV", view * lModel);
-                phong->setUniform("normalMatrix", glm::mat3(glm::transpose(glm::inverse(view * lModel))));
-                
-                // Use light's own color for gizmo
-                glm::vec3 gizmoCol = lColor * 4.0f * lightData.intensity;
-                phong->setUniform("material.ambient", glm::vec4(gizmoCol, 1.0f));
-                phong->setUniform("material.diffuse", glm::vec4(gizmoCol, 1.0f));
-                
-                renderData.particleSphere->render();
-            }
+    Renderer::submitFloorAndSphere(m_renderQueue, floor, sphere, camera, transformStack, params);
+
+    ShaderLib* shader = ShaderLib::instance();
+    ShaderLib::ProgramWrapper* phongInstanced = (*shader)["PhongInstanced"];
+
+    // Light gizmos (visible position markers): one instanced draw of the particle sphere
+    if (phongInstanced) {
+        if (!renderData.particleSphere) {
+            renderData.particleSphere = FlockingGraphics::GeometryFactory::instance().createSphere(1.0f, 12);
+        }
+        // Re-instance on a new sphere object: a replaced sphere's freed buffer names can
+        // come back from glGenBuffers, so comparing VBOs would miss the swap
+        if (m_gizmoGeometry != renderData.particleSphere) {
+            releaseInstancedMesh(m_gizmoInstances);
+            m_gizmoGeometry = renderData.particleSphere;
+            m_gizmoInstances = instanceGeometry(*m_gizmoGeometry);
+        }
+
+        // Main light: bright yellow, boosted colour to stay bright
+        m_gizmoData.clear();
+        const glm::vec3 gizmoColor(1.5f, 1.3f, 0.0f);
+        InstanceData mainGizmo;
+        mainGizmo.model = glm::scale(glm::translate(glm::mat4(1.0f), lightWorldPos), glm::vec3(3.5f));
+        mainGizmo.color = glm::vec4(gizmoColor * 6.0f, 1.0f);
+        m_gizmoData.push_back(mainGizmo);
+
+        // Additional lights in their own colour
+        for (const auto& lightData : params.lights) {
+            if (!lightData.enabled) continue;
+            glm::vec3 lPos(lightData.position[0], lightData.position[1], lightData.position[2]);
+            glm::vec3 lColor(lightData.diffuse[0], lightData.diffuse[1], lightData.diffuse[2]);
+            InstanceData lightGizmo;
+            lightGizmo.model = glm::scale(glm::translate(glm::mat4(1.0f), lPos),
+                                          glm::vec3(lightData.castsShadow ? 4.0f : 2.5f));
+            lightGizmo.color = glm::vec4(lColor * 4.0f * lightData.intensity, 1.0f);
+            m_gizmoData.push_back(lightGizmo);
         }
+        uploadInstances(m_gizmoInstances, m_gizmoData.data(), static_cast<int>(m_gizmoData.size()));
+
+        // The instance colour scales a white material
+        FlockingShaders::DrawBlock& draw = UniformBlocks::draw();
+        UniformBlocks::setTransforms(glm::mat4(1.0f), view, proj);
+        setVertexDecode(nullptr);
+        draw.posDequantBias.w = 1.0f;  // Normalize
+        draw.material.ambient = glm::vec4(1.0f);
+        draw.material.diffuse = glm::vec4(1.0f);
+        draw.material.specular = glm::vec4(2.5f, 2.5f, 2.0f, 1.0f);
+        draw.material.shininess = 2.0f;
+        const InstancedMesh* gizmos = &m_gizmoInstances;
+        m_renderQueue.submit(RenderQueue::Gizmo, phongInstanced, m_gizmoInstances.center,
+                             [gizmos](CommandBuffer& cmd) { recordInstances(*gizmos, cmd); }, GL_FILL,
+                             UniformBlocks::GizmoFrame);
     }
 
     // Primary meshes (e.g., cloth) and auxiliary meshes
-    if (!m_primaryMeshes.empty() || (!m_genericMeshes.empty() && params.customMeshVisibility)) {
-        ShaderLib* shader = ShaderLib::instance();
+    if (!m_primaryMeshes.empty() || (!m_meshes.empty() && params.customMeshVisibility)) {
         // Select shader: Phong, Silk, or SilkPBR
         std::string shaderName = "Phong";
         if (params.useSilkShader) {
             shaderName = params.usePBRSilk ? "SilkPBR" : "Silk";
         }
         ShaderLib::ProgramWrapper* prog = (*shader)[shaderName];
-        if (prog) {
-            prog->use();
-            glm::mat4 view = camera->getViewMatrix();
-            glm::vec4 lightViewPos = view * glm::vec4(lightWorldPos, 1.0f);
-            prog->setUniform("light.position", lightViewPos);
-            prog->setUniform("light.ambient", glm::vec4(lightAmbient, 1.0f));
-            prog->setUniform("light.diffuse", glm::vec4(lightDiffuse, 1.0f));
-            prog->setUniform("light.specular", glm::vec4(lightSpecular, 1.0f));
-            prog->setUniform("light.constantAttenuation", 1.0f);
-            prog->setUniform("light.linearAttenuation", 0.0f);
-            prog->setUniform("light.quadraticAttenuation", 0.0f);
-            prog->setUniform("viewerPos", camera->getEye());
-            prog->setUniform("Normalize", true);
-
-            GLuint programId = prog->getProgramId();
-            glUniform1i(glGetUniformLocation(programId, "shadowEnabled"), Shadow::isEnabled() ? 1 : 0);
-            glUniform1f(glGetUniformLocation(programId, "shadowBias"), params.shadowBias);
-            glUniform1f(glGetUniformLocation(programId, "shadowSoftness"), params.shadowSoftness);
-            glUniform1f(glGetUniformLocation(programId, "shadowMapSize"), static_cast<float>(Shadow::getMapSize()));
-            glUniform1f(glGetUniformLocation(programId, "shadowStrength"), 1.5f);
-            glUniformMatrix4fv(glGetUniformLocation(programId, "lightSpaceMatrix"), 1, GL_FALSE,
-                               glm::value_ptr(Shadow::getLightSpaceMatrix(0)));
-            glActiveTexture(GL_TEXTURE5);
-            glBindTexture(GL_TEXTURE_2D, Shadow::getShadowMapTexture(0));
-            glUniform1i(glGetUniformLocation(programId, "shadowMap"), 5);
-            
-            // Multi-shadow uniforms for cloth
-            float lightIntensities[Shadow::MAX_SHADOW_LIGHTS] = {1.0f, 1.0f, 1.0f, 1.0f};
-            int numShadowLights = 1;
-            lightIntensities[0] = 1.0f;
-            
-            for (size_t li = 0; li < params.lights.size() && numShadowLights < Shadow::MAX_SHADOW_LIGHTS; ++li) {
-                if (params.lights[li].enabled && params.lights[li].castsShadow) {
-                    lightIntensities[numShadowLights] = params.lights[li].intensity;
-                    numShadowLights++;
-                }
-            }
-            glUniform1i(glGetUniformLocation(programId, "numShadowLights"), numShadowLights);
-            
-            const int SHADOW_TEX_START = 5;
-            for (int s = 0; s < Shadow::MAX_SHADOW_LIGHTS; ++s) {
-                std::string intensityName = "lightIntensities[" + std::to_string(s) + "]";
-                glUniform1f(glGetUniformLocation(programId, intensityName.c_str()), lightIntensities[s]);
-                
-                std::string matName = "lightSpaceMatrices[" + std::to_string(s) + "]";
-                glUniformMatrix4fv(glGetUniformLocation(programId, matName.c_str()), 1, GL_FALSE,
-                                   glm::value_ptr(Shadow::getLightSpaceMatrix(s)));
-                
-                glActiveTexture(GL_TEXTURE0 + SHADOW_TEX_START + s);
-                glBindTexture(GL_TEXTURE_2D, Shadow::getShadowMapTexture(s));
-                std::string samplerName = "shadowMaps[" + std::to_string(s) + "]";
-                glUniform1i(glGetUniformLocation(programId, samplerName.c_str()), SHADOW_TEX_START + s);
-            }
+        ShaderLib::ProgramWrapper* indirectProg = indirect ? (*shader)[shaderName + "MDI"] : nullptr;
+        if (indirectProg) {
+            GLint linked = 0;
+            glGetProgramiv(indirectProg->getProgramId(), GL_LINK_STATUS, &linked);
+            if (!linked) indirectProg = nullptr;
+        }
 
-            prog->setUniform("material.ambient", glm::vec4(0.25f, 0.1f, 0.1f, 1.0f));
-            prog->setUniform("material.diffuse", glm::vec4(0.8f, 0.2f, 0.2f, 1.0f));
-            prog->setUniform("material.specular", glm::vec4(0.5f, 0.4f, 0.4f, 1.0f));
-            prog->setUniform("material.shininess", 32.0f);
-
-            if (params.useSilkShader) {
-                if (params.usePBRSilk) {
-                    // PBR-specific uniforms
-                    prog->setUniform("lightWorldPos", lightWorldPos);  // World-space light for PBR
-                    prog->setUniform("roughness", params.pbrRoughness);
-                    prog->setUniform("metallic", params.pbrMetallic);
-                    prog->setUniform("anisotropy", params.pbrAnisotropy);
-                    prog->setUniform("sheenIntensity", params.sheenIntensity);
-                    prog->setUniform("sheenColor", glm::vec3(params.sheenColor[0], params.sheenColor[1], params.sheenColor[2]));
-                    prog->setUniform("subsurfaceAmount", params.subsurfaceAmount);
-                    prog->setUniform("subsurfaceColor", glm::vec3(params.subsurfaceColor[0], params.subsurfaceColor[1], params.subsurfaceColor[2]));
-                    prog->setUniform("weaveScale", params.weaveScale);
-                } else {
-                    // Classic Silk shader uniforms
-                    prog->setUniform("anisotropyU", params.anisotropyU);
-                    prog->setUniform("anisotropyV", params.anisotropyV);
-                    prog->setUniform("sheenIntensity", params.sheenIntensity);
-                    prog->setUniform("subsurfaceAmount", params.subsurfaceAmount);
-                    prog->setUniform("subsurfaceColor", glm::vec3(0.9f, 0.5f, 0.4f));
-                    prog->setUniform("weaveScale", params.weaveScale);
-                    prog->setUniform("time", static_cast<float>(glfwGetTime()));
-                }
-            }
+        // Per-pass draw state, shared by the regular and multi-draw-indirect programs; lights,
+        // shadows and fabric parameters come from the frame block
+        FlockingShaders::DrawBlock& draw = UniformBlocks::draw();
+        draw.material.ambient = glm::vec4(0.25f, 0.1f, 0.1f, 1.0f);
+        draw.material.diffuse = glm::vec4(0.8f, 0.2f, 0.2f, 1.0f);
+        draw.material.specular = glm::vec4(0.5f, 0.4f, 0.4f, 1.0f);
+        draw.material.shininess = 32.0f;
+        draw.posDequantBias.w = 1.0f;  // Normalize
+        draw.aoGroundColor = glm::vec4(params.aoGroundColor[0], params.aoGroundColor[1], params.aoGroundColor[2],
+                                       params.aoStrength);
+        draw.subsurfaceColor = params.usePBRSilk
+            ? glm::vec4(params.subsurfaceColor[0], params.subsurfaceColor[1], params.subsurfaceColor[2], 0.0f)
+            : glm::vec4(0.9f, 0.5f, 0.4f, 0.0f);
 
-            prog->setUniform("checkerScale", params.useCheckerPattern ? params.checkerScale : 0.0f);
-            prog->setUniform("checkerColor1", glm::vec3(params.checkerColor1[0], params.checkerColor1[1], params.checkerColor1[2]));
-            prog->setUniform("checkerColor2", glm::vec3(params.checkerColor2[0], params.checkerColor2[1], params.checkerColor2[2]));
-
-            prog->setUniform("aoStrength", params.aoStrength);
-            prog->setUniform("aoGroundColor", glm::vec3(params.aoGroundColor[0], params.aoGroundColor[1], params.aoGroundColor[2]));
-
-            // Optional extra light array (SilkPBR supports this; others will ignore unknown uniforms)
-            {
-                const int MAX_EXTRA = 8;
-                int numLights = static_cast<int>(params.lights.size());
-                if (numLights > MAX_EXTRA) numLights = MAX_EXTRA;
-                glm::vec3 lightPositions[MAX_EXTRA]{};
-                glm::vec3 lightColors[MAX_EXTRA]{};
-                float lightIntensitiesExtra[MAX_EXTRA]{};
-                for (int li = 0; li < numLights; ++li) {
-                    lightPositions[li] = glm::vec3(params.lights[li].position[0],
-                                                   params.lights[li].position[1],
-                                                   params.lights[li].position[2]);
-                    lightColors[li] = glm::vec3(params.lights[li].diffuse[0],
-                                                params.lights[li].diffuse[1],
-                                                params.lights[li].diffuse[2]);
-                    lightIntensitiesExtra[li] = params.lights[li].intensity;
+        if (prog) {
+            auto submitMeshList = [&](const std::vector<GpuMesh>& meshes,
+                                      const std::vector<glm::vec3>& colors,
+                                      const IndirectBatch (&batches)[2], GLenum polygonMode) {
+                if (indirectProg) {
+                    // Per-draw models come from the draw buffer
+                    UniformBlocks::setTransforms(glm::mat4(1.0f), view, proj);
+                    setVertexDecode(nullptr);
+                    m_renderQueue.submit(RenderQueue::Opaque, indirectProg, glm::vec3(0.0f),
+                                         [this, &batches](CommandBuffer& cmd) {
+                                             recordIndirectBatches(cmd, batches, false);
+                                         }, polygonMode);
                 }
-
-                GLint numLightsLoc = glGetUniformLocation(programId, "numLights");
-                GLint positionsLoc = glGetUniformLocation(programId, "lightPositions");
-                GLint colorsLoc = glGetUniformLocation(programId, "lightColors");
-                GLint intensityLoc = glGetUniformLocation(programId, "lightIntensitiesExtra");
-                if (numLightsLoc >= 0) glUniform1i(numLightsLoc, numLights);
-                if (positionsLoc >= 0) glUniform3fv(positionsLoc, numLights, glm::value_ptr(lightPositions[0]));
-                if (colorsLoc >= 0) glUniform3fv(colorsLoc, numLights, glm::value_ptr(lightColors[0]));
-                if (intensityLoc >= 0) glUniform1fv(intensityLoc, numLights, lightIntensitiesExtra);
-            }
-
-            glm::mat4 model = glm::mat4(1.0f);
-            glm::mat4 projection = camera->getProjectionMatrix();
-            prog->setUniform("MVP", projection * view * model);
-            prog->setUniform("M", model);
-            prog->setUniform("MV", view * model);
-            prog->setUniform("normalMatrix", glm::mat3(glm::transpose(glm::inverse(view * model))));
-
-            auto renderMeshList = [&](const std::vector<GpuMesh>& meshes,
-                                      const std::vector<glm::vec3>& colors) {
                 for (size_t i = 0; i < meshes.size(); ++i) {
                     const GpuMesh& mesh = meshes[i];
                     if (mesh.VAO == 0 || mesh.triangleCount == 0) continue;
+                    if (indirectProg && mesh.arena) continue;
                     glm::vec3 color = (i < colors.size()) ? colors[i] : glm::vec3(0.8f, 0.2f, 0.2f);
-                    prog->setUniform("material.ambient", glm::vec4(color * 0.3f, 1.0f));
-                    prog->setUniform("material.diffuse", glm::vec4(color, 1.0f));
-                    prog->setUniform("material.specular", glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+                    draw.material.ambient = glm::vec4(color * 0.3f, 1.0f);
+                    draw.material.diffuse = glm::vec4(color, 1.0f);
+                    draw.material.specular = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
                     if (params.useSilkShader) {
-                        prog->setUniform("subsurfaceColor", color * 0.8f);
+                        draw.subsurfaceColor = glm::vec4(color * 0.8f, 0.0f);
                     }
-                    glBindVertexArray(mesh.VAO);
-                    glDrawElements(GL_TRIANGLES, mesh.triangleCount * 3, GL_UNSIGNED_INT, 0);
-                    glBindVertexArray(0);
+                    UniformBlocks::setTransforms(mesh.model, view, proj);
+                    setVertexDecode(mesh.packed ? &mesh : nullptr);
+                    m_renderQueue.submit(RenderQueue::Opaque, prog, meshCenter(mesh),
+                                         [this, &mesh](CommandBuffer& cmd) { recordSceneMesh(mesh, cmd); }, polygonMode);
                 }
             };
 
             if (params.clothVisibility && !m_primaryMeshes.empty()) {
-                if (params.clothWireframe) {
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                }
-                renderMeshList(m_primaryMeshes, primaryColors);
-                if (params.clothWireframe) {
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                }
+                submitMeshList(m_primaryMeshes, primaryColors, m_primaryBatches,
+                               params.clothWireframe ? GL_LINE : GL_FILL);
             }
-
-            if (params.customMeshVisibility && !m_genericMeshes.empty()) {
-                if (params.customMeshWireframe) {
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                }
-                renderMeshList(m_genericMeshes, m_genericColors);
-                if (params.customMeshWireframe) {
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                }
+            if (params.customMeshVisibility && !m_meshes.empty()) {
+                submitMeshList(m_meshes.values(), m_meshColors, m_genericBatches,
+                               params.customMeshWireframe ? GL_LINE : GL_FILL);
             }
+            // Anything drawn outside the queue expects float vertices
+            setVertexDecode(nullptr);
+        }
+    }
+
+    // Instanced props: one instanced draw per mesh, tinted per instance
+    if (phongInstanced && params.customMeshVisibility && !m_instancedMeshes.empty()) {
+        FlockingShaders::DrawBlock& draw = UniformBlocks::draw();
+        UniformBlocks::setTransforms(glm::mat4(1.0f), view, proj);
+        setVertexDecode(nullptr);
+        draw.posDequantBias.w = 1.0f;  // Normalize
+        draw.material.specular = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+        draw.material.shininess = 32.0f;
+        draw.aoGroundColor = glm::vec4(params.aoGroundColor[0], params.aoGroundColor[1], params.aoGroundColor[2],
+                                       params.aoStrength);
+        const GLenum polygonMode = params.customMeshWireframe ? GL_LINE : GL_FILL;
+        for (const InstancedMesh& mesh : m_instancedMeshes.values()) {
+            if (mesh.instanceCount == 0) continue;
+            draw.material.ambient = glm::vec4(mesh.color * 0.3f, 1.0f);
+            draw.material.diffuse = glm::vec4(mesh.color, 1.0f);
+            m_renderQueue.submit(RenderQueue::Opaque, phongInstanced, mesh.center,
+                                 [&mesh](CommandBuffer& cmd) { recordInstances(mesh, cmd); }, polygonMode);
         }
     }
 
-    SSAO::endScenePass();
-    SSAO::renderComposite(camera);
+    // Scene pass, into the SSAO inputs or straight to the backbuffer
+    const bool ssao = SSAO::isEnabled();
+    RenderGraph::Resource sceneColor = backbuffer;
+    RenderGraph::Resource sceneDepth = RenderGraph::kNone;
+    if (ssao) {
+        sceneColor = m_renderGraph.createTexture("scene color", SSAO::sceneColorDesc());
+        sceneDepth = m_renderGraph.createTexture("scene depth", SSAO::sceneDepthDesc());
+    }
+    m_renderGraph.addPass("scene",
+        [&](RenderGraph::Builder& builder) {
+            if (shadowCount > 0) builder.read(shadowMaps);
+            if (dynamicShadowMaps != RenderGraph::kNone) builder.read(dynamicShadowMaps);
+            builder.write(sceneColor);
+            if (sceneDepth != RenderGraph::kNone) builder.write(sceneDepth);
+        },
+        [&](const RenderGraph& graph) {
+            Shadow::setShadowMapArray(shadowCount > 0 ? graph.texture(shadowMaps) : 0);
+            Shadow::setDynamicMapArray(graph.texture(dynamicShadowMaps));
+            glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            GLState::setDepthTest(true);
+
+            // Frame-constant uniforms (camera, lights, shadows) for every lit program
+            UniformBlocks::beginFrame();
+            Renderer::setupLighting(camera, params);
+            m_renderQueue.execute();
+        });
+    if (ssao) SSAO::addPasses(m_renderGraph, camera, sceneColor, sceneDepth, backbuffer);
+
+    if (m_renderGraph.compile()) {
+        m_renderGraph.execute();
+    } else if (shadowCaching) {
+        Shadow::invalidateCache();   // the claimed layers were never drawn
+    }
+
+    // All draws reading this frame's streamed vertices and draw blocks are queued; fence the regions
+    m_primaryStream.endFrame();
+    UniformBlocks::endFrame();
 }
 
 void Engine::cleanup(Renderer::ClothRenderData& renderData) {
+    // Drain the upload thread first so no copy still targets a buffer freed below
+    m_uploads.stop();
+    completeAsyncUploads();
     for (auto& mesh : m_primaryMeshes) {
-        if (mesh.VAO) {
-            glDeleteVertexArrays(1, &mesh.VAO);
-            glDeleteBuffers(1, &mesh.VBO);
-            glDeleteBuffers(1, &mesh.EBO);
-        }
+        destroyGpuMesh(mesh);
     }
     m_primaryMeshes.clear();
-    for (auto& mesh : m_genericMeshes) {
-        if (mesh.VAO) {
-            glDeleteVertexArrays(1, &mesh.VAO);
-            glDeleteBuffers(1, &mesh.VBO);
-            glDeleteBuffers(1, &mesh.EBO);
-        }
+    for (auto& mesh : m_meshes.values()) {
+        destroyGpuMesh(mesh);
+    }
+    m_meshes.clear();
+    m_meshColors.clear();
+    m_syncedHandles.clear();
+    m_syncedSources.clear();
+    m_primarySources.clear();
+    for (InstancedMesh& mesh : m_instancedMeshes.values()) {
+        releaseInstancedMesh(mesh);
+    }
+    m_instancedMeshes.clear();
+    releaseInstancedMesh(m_gizmoInstances);
+    m_gizmoGeometry.reset();
+    m_gizmoData.clear();
+    for (std::vector<GpuMesh>& bucket : m_meshPool) {
+        for (GpuMesh& mesh : bucket) destroyGpuMesh(mesh);
+        bucket.clear();
+    }
+    m_pooledMeshCount = 0;
+    m_primaryStream.destroy();
+    for (int i = 0; i < 2; ++i) {
+        m_primaryBatches[i].destroy();
+        m_genericBatches[i].destroy();
     }
-    m_genericMeshes.clear();
-    m_genericColors.clear();
+    m_interleavedArena.destroy();
+    m_packedArena.destroy();
+    VertexNormals::cleanupGpu();
+    LightClusters::cleanup();
+    m_renderGraph.destroy();
     SSAO::cleanup();
     Shadow::cleanup();
+    UniformBlocks::cleanup();
     Renderer::cleanup(renderData);
 }
 
@@ -0,0 +1,55 @@
+/// @file IndexFormat.cpp
+/// @brief SSE2 range check and narrowing kernels with scalar tails
+
+#include "IndexFormat.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SANDBOX_INDEX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace IndexFormat {
+
+bool fitsUint16(const uint32_t* indices, size_t count) {
+    // OR every index together: the list fits when no bit above 15 is ever set
+    uint32_t bits = 0;
+    size_t i = 0;
+#ifdef SANDBOX_INDEX_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i)));
+        acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i + 4)));
+    }
+    acc = _mm_or_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_or_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    bits = static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+#endif
+    for (; i < count; ++i) bits |= indices[i];
+    return (bits >> 16) == 0;
+}
+
+void narrow(uint16_t* dst, const uint32_t* src, size_t count) {
+    size_t i = 0;
+#ifdef SANDBOX_INDEX_SSE2
+    // SSE2 has no unsigned 32->16 pack: sign-extend the low halves so the signed
+    // saturating pack passes every 16-bit pattern through unchanged
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < count; ++i) dst[i] = static_cast<uint16_t>(src[i]);
+}
+
+size_t narrowPadded(std::vector<uint16_t>& out, const uint32_t* src, size_t count) {
+    const size_t padded = (count + 1) & ~static_cast<size_t>(1);
+    out.resize(padded);
+    narrow(out.data(), src, count);
+    if (padded != count) out[count] = 0;
+    return padded * sizeof(uint16_t);
+}
+
+} // namespace IndexFormat
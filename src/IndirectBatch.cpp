@@ -0,0 +1,65 @@
+/// @file IndirectBatch.cpp
+/// @brief Multi-draw-indirect command/draw-data buffers
+
+#include "IndirectBatch.h"
+#include "GLState.h"
+
+namespace gfx {
+
+bool IndirectBatch::isSupported() {
+    return GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_shader_draw_parameters &&
+           GLAD_GL_ARB_shader_storage_buffer_object;
+}
+
+IndirectBatch::~IndirectBatch() {
+    destroy();
+}
+
+void IndirectBatch::clear() {
+    m_commands.clear();
+    m_drawData.clear();
+}
+
+void IndirectBatch::add(GLuint indexCount, GLuint firstIndex, GLint baseVertex, const BatchDrawData& data) {
+    if (indexCount == 0) return;
+    m_commands.push_back({indexCount, 1u, firstIndex, baseVertex, 0u});
+    m_drawData.push_back(data);
+}
+
+void IndirectBatch::upload() {
+    m_uploadedCount = m_commands.size();
+    if (m_commands.empty()) return;
+    if (!m_commandBuffer) glGenBuffers(1, &m_commandBuffer);
+    if (!m_drawDataBuffer) glGenBuffers(1, &m_drawDataBuffer);
+
+    // Orphan each frame so the driver never stalls on last frame's reads
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand),
+                 m_commands.data(), GL_STREAM_DRAW);
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_drawData.size() * sizeof(BatchDrawData),
+                 m_drawData.data(), GL_STREAM_DRAW);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void IndirectBatch::draw(GLuint vao) const {
+    if (m_uploadedCount == 0) return;
+    GLState::bindVertexArray(vao);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_drawDataBuffer);
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                static_cast<GLsizei>(m_uploadedCount), 0);
+}
+
+void IndirectBatch::destroy() {
+    if (m_commandBuffer) GLState::deleteBuffers(1, &m_commandBuffer);
+    if (m_drawDataBuffer) GLState::deleteBuffers(1, &m_drawDataBuffer);
+    m_commandBuffer = 0;
+    m_drawDataBuffer = 0;
+    m_uploadedCount = 0;
+    clear();
+}
+
+} // namespace gfx
@@ -0,0 +1,382 @@
+/// @file LightClusters.cpp
+/// @brief Froxel light assignment on the CPU or in a compute pass, and its buffers
+
+#include "LightClusters.h"
+#include "GLState.h"
+#include "ParallelFor.h"
+#include "ShaderPathResolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SANDBOX_CLUSTERS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace LightClusters {
+
+namespace {
+
+constexpr GLuint kWorkgroupSize = 64;   // matches local_size_x in LightClusters.comp
+
+// std430 layouts shared with the shaders
+struct GpuLight {
+    glm::vec4 positionRange;    // world xyz, w: range
+    glm::vec4 colorIntensity;   // rgb, a: intensity
+};
+struct GridHeader {
+    float params[4];            // tiles per pixel x/y, depth slice scale and bias
+    uint32_t dims[4];           // clusters x/y/z, light count
+};
+static_assert(sizeof(GpuLight) == 32, "GpuLight must match std430");
+static_assert(sizeof(GridHeader) == 32, "GridHeader must match std430");
+
+struct Aabb {
+    float lo[3];
+    float hi[3];
+};
+
+bool s_gpuTried = false;
+GLuint s_gpuProgram = 0;
+// Uniform locations in s_gpuProgram, looked up once after it links
+GLint s_viewLocation = -1;
+GLint s_invProjectionLocation = -1;
+GLint s_nearPlaneLocation = -1;
+GLint s_farPlaneLocation = -1;
+GLint s_maxLightsLocation = -1;
+GLuint s_lightBuffer = 0;
+GLuint s_gridBuffer = 0;
+GLuint s_indexBuffer = 0;
+size_t s_indexCapacity = 0;     // uints, counter included
+Stats s_stats;
+
+// View-space cluster bounds depend only on the projection
+std::vector<Aabb> s_aabbs;
+glm::mat4 s_aabbProjection{0.0f};
+float s_aabbNear = 0.0f;
+float s_aabbFar = 0.0f;
+
+std::vector<GpuLight> s_lights;
+std::vector<glm::vec4> s_viewLights;            // view xyz, w: range
+std::vector<uint32_t> s_grid;                   // header, then (offset, count) per cluster
+std::vector<uint32_t> s_sliceIndices[CLUSTERS_Z];
+std::vector<uint32_t> s_indices;                // counter, then the lists back to back
+
+float sliceDepth(int slice, float nearPlane, float farPlane) {
+    return nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / CLUSTERS_Z);
+}
+
+void buildAabbs(const glm::mat4& projection, float nearPlane, float farPlane) {
+    s_aabbs.resize(CLUSTER_COUNT);
+    const glm::mat4 inverse = glm::inverse(projection);
+    for (int y = 0; y < CLUSTERS_Y; ++y) {
+        for (int x = 0; x < CLUSTERS_X; ++x) {
+            // Tile corners as view rays scaled to depth 1
+            glm::vec3 rays[4];
+            for (int c = 0; c < 4; ++c) {
+                const float ndcX = -1.0f + 2.0f * static_cast<float>(x + (c & 1)) / CLUSTERS_X;
+                const float ndcY = -1.0f + 2.0f * static_cast<float>(y + (c >> 1)) / CLUSTERS_Y;
+                glm::vec4 p = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                p /= p.w;
+                rays[c] = glm::vec3(p) / -p.z;
+            }
+            for (int z = 0; z < CLUSTERS_Z; ++z) {
+                const float depths[2] = {sliceDepth(z, nearPlane, farPlane), sliceDepth(z + 1, nearPlane, farPlane)};
+                glm::vec3 lo(1e30f);
+                glm::vec3 hi(-1e30f);
+                for (const glm::vec3& ray : rays) {
+                    for (float depth : depths) {
+                        lo = glm::min(lo, ray * depth);
+                        hi = glm::max(hi, ray * depth);
+                    }
+                }
+                Aabb& box = s_aabbs[(z * CLUSTERS_Y + y) * CLUSTERS_X + x];
+                std::memcpy(box.lo, &lo[0], sizeof(box.lo));
+                std::memcpy(box.hi, &hi[0], sizeof(box.hi));
+            }
+        }
+    }
+    s_aabbProjection = projection;
+    s_aabbNear = nearPlane;
+    s_aabbFar = farPlane;
+}
+
+// Sphere/box tests of one depth slice against the lights whose depth range reaches it.
+// Lists are written slice-local; assignCpu() rebases the offsets.
+void assignSlice(int z, float nearPlane, float farPlane, uint32_t* ranges) {
+    thread_local std::vector<float> cx, cy, cz, r2;
+    thread_local std::vector<uint32_t> ids;
+    cx.clear(); cy.clear(); cz.clear(); r2.clear(); ids.clear();
+
+    const float sliceNear = sliceDepth(z, nearPlane, farPlane);
+    const float sliceFar = sliceDepth(z + 1, nearPlane, farPlane);
+    for (size_t i = 0; i < s_viewLights.size(); ++i) {
+        const glm::vec4& light = s_viewLights[i];
+        const float depth = -light.z;
+        if (depth + light.w < sliceNear || depth - light.w > sliceFar) continue;
+        cx.push_back(light.x);
+        cy.push_back(light.y);
+        cz.push_back(light.z);
+        r2.push_back(light.w * light.w);
+        ids.push_back(static_cast<uint32_t>(i));
+    }
+    // Pad to whole SIMD lanes with lights no box can reach
+    while (ids.size() % 4 != 0) {
+        cx.push_back(0.0f); cy.push_back(0.0f); cz.push_back(0.0f); r2.push_back(-1.0f);
+        ids.push_back(0);
+    }
+
+    std::vector<uint32_t>& out = s_sliceIndices[z];
+    out.clear();
+    const int first = z * CLUSTERS_X * CLUSTERS_Y;
+    for (int cluster = first; cluster < first + CLUSTERS_X * CLUSTERS_Y; ++cluster) {
+        const Aabb& box = s_aabbs[cluster];
+        const uint32_t offset = static_cast<uint32_t>(out.size());
+        uint32_t count = 0;
+        for (size_t i = 0; i < ids.size() && count < MAX_LIGHTS_PER_CLUSTER; i += 4) {
+            int mask = 0;
+#ifdef SANDBOX_CLUSTERS_SSE2
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 x = _mm_loadu_ps(&cx[i]);
+            const __m128 y = _mm_loadu_ps(&cy[i]);
+            const __m128 zc = _mm_loadu_ps(&cz[i]);
+            // Distance from each centre to the box, per axis (0 inside)
+            const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.lo[0]), x),
+                                                    _mm_sub_ps(x, _mm_set1_ps(box.hi[0]))), zero);
+            const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.lo[1]), y),
+                                                    _mm_sub_ps(y, _mm_set1_ps(box.hi[1]))), zero);
+            const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.lo[2]), zc),
+                                                    _mm_sub_ps(zc, _mm_set1_ps(box.hi[2]))), zero);
+            const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&r2[i])));
+#else
+            for (int lane = 0; lane < 4; ++lane) {
+                const float c[3] = {cx[i + lane], cy[i + lane], cz[i + lane]};
+                float d2 = 0.0f;
+                for (int a = 0; a < 3; ++a) {
+                    const float d = std::max(std::max(box.lo[a] - c[a], c[a] - box.hi[a]), 0.0f);
+                    d2 += d * d;
+                }
+                if (d2 <= r2[i + lane]) mask |= 1 << lane;
+            }
+#endif
+            for (int lane = 0; lane < 4 && count < MAX_LIGHTS_PER_CLUSTER; ++lane) {
+                if (mask & (1 << lane)) {
+                    out.push_back(ids[i + lane]);
+                    ++count;
+                }
+            }
+        }
+        ranges[cluster * 2] = offset;
+        ranges[cluster * 2 + 1] = count;
+    }
+}
+
+// Enabled lights in input order, for the buffer and in view space for the assignment
+void gatherLights(const std::vector<gfx::ExtraLight>& lights, const glm::mat4& view) {
+    s_lights.clear();
+    s_viewLights.clear();
+    for (const gfx::ExtraLight& light : lights) {
+        if (!light.enabled || light.range <= 0.0f) continue;
+        const glm::vec3 position(light.position[0], light.position[1], light.position[2]);
+        s_lights.push_back(GpuLight{glm::vec4(position, light.range),
+                                    glm::vec4(light.diffuse[0], light.diffuse[1], light.diffuse[2], light.intensity)});
+        s_viewLights.push_back(glm::vec4(glm::vec3(view * glm::vec4(position, 1.0f)), light.range));
+    }
+}
+
+// Assign the gathered lights: (offset, count) per cluster into ranges, the lists
+// appended to indices after its first listBase entries, offsets counted from there
+void assignCpu(const glm::mat4& projection, float nearPlane, float farPlane, uint32_t* ranges,
+               std::vector<uint32_t>& indices, size_t listBase) {
+    if (projection != s_aabbProjection || nearPlane != s_aabbNear || farPlane != s_aabbFar || s_aabbs.empty()) {
+        buildAabbs(projection, nearPlane, farPlane);
+    }
+    Parallel::forRange(CLUSTERS_Z, 1, [&](int begin, int end) {
+        for (int z = begin; z < end; ++z) assignSlice(z, nearPlane, farPlane, ranges);
+    });
+
+    // Concatenate the slice lists and rebase their offsets
+    indices.resize(listBase);
+    for (int z = 0; z < CLUSTERS_Z; ++z) {
+        const uint32_t base = static_cast<uint32_t>(indices.size() - listBase);
+        const int first = z * CLUSTERS_X * CLUSTERS_Y;
+        for (int cluster = first; cluster < first + CLUSTERS_X * CLUSTERS_Y; ++cluster) {
+            ranges[cluster * 2] += base;
+        }
+        indices.insert(indices.end(), s_sliceIndices[z].begin(), s_sliceIndices[z].end());
+    }
+}
+
+GLuint buildProgram(const std::string& source) {
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    const char* src = source.c_str();
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "LightClusters compute compile error: " << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "LightClusters compute link error: " << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ensureIndexCapacity(size_t uints) {
+    if (s_indexCapacity >= uints) return;
+    s_indexCapacity = std::max(uints, s_indexCapacity * 2);
+    GLState::bufferData(s_indexBuffer, static_cast<GLsizeiptr>(s_indexCapacity * sizeof(uint32_t)), nullptr,
+                        GL_DYNAMIC_DRAW);
+}
+
+} // anonymous namespace
+
+bool isSupported() {
+    return GLAD_GL_ARB_shader_storage_buffer_object != 0;
+}
+
+bool gpuAvailable() {
+    if (!s_gpuTried) {
+        s_gpuTried = true;
+        if (!GLAD_GL_ARB_compute_shader || !isSupported()) return false;
+        const std::string source = ShaderPath::loadSource("shaders/LightClusters.comp");
+        if (source.empty()) return false;
+        s_gpuProgram = buildProgram(source);
+        if (!s_gpuProgram) {
+            std::cerr << "LightClusters: compute path unavailable, assigning lights on the CPU" << std::endl;
+            return false;
+        }
+        s_viewLocation = glGetUniformLocation(s_gpuProgram, "view");
+        s_invProjectionLocation = glGetUniformLocation(s_gpuProgram, "invProjection");
+        s_nearPlaneLocation = glGetUniformLocation(s_gpuProgram, "nearPlane");
+        s_farPlaneLocation = glGetUniformLocation(s_gpuProgram, "farPlane");
+        s_maxLightsLocation = glGetUniformLocation(s_gpuProgram, "maxLightsPerCluster");
+    }
+    return s_gpuProgram != 0;
+}
+
+void update(const std::vector<gfx::ExtraLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+            float nearPlane, float farPlane, int width, int height, bool useGpu) {
+    s_stats = Stats{};
+    if (!isSupported() || nearPlane <= 0.0f || farPlane <= nearPlane || width <= 0 || height <= 0) return;
+    if (!s_lightBuffer) {
+        glGenBuffers(1, &s_lightBuffer);
+        glGenBuffers(1, &s_gridBuffer);
+        glGenBuffers(1, &s_indexBuffer);
+        s_grid.assign(8 + CLUSTER_COUNT * 2, 0);
+        GLState::bufferData(s_gridBuffer, static_cast<GLsizeiptr>(s_grid.size() * sizeof(uint32_t)), nullptr,
+                            GL_DYNAMIC_DRAW);
+    }
+
+    gatherLights(lights, view);
+    s_stats.lights = static_cast<int>(s_lights.size());
+
+    // A fragment finds its slice as log(depth) * scale + bias
+    const float logRatio = std::log(farPlane / nearPlane);
+    GridHeader header;
+    header.params[0] = static_cast<float>(CLUSTERS_X) / width;
+    header.params[1] = static_cast<float>(CLUSTERS_Y) / height;
+    header.params[2] = CLUSTERS_Z / logRatio;
+    header.params[3] = -CLUSTERS_Z * std::log(nearPlane) / logRatio;
+    header.dims[0] = CLUSTERS_X;
+    header.dims[1] = CLUSTERS_Y;
+    header.dims[2] = CLUSTERS_Z;
+    header.dims[3] = static_cast<uint32_t>(s_lights.size());
+    std::memcpy(s_grid.data(), &header, sizeof(header));
+
+    // One light at least, so the binding never points at an empty store
+    const GpuLight none{};
+    GLState::bufferData(s_lightBuffer, static_cast<GLsizeiptr>(std::max<size_t>(s_lights.size(), 1) * sizeof(GpuLight)),
+                        s_lights.empty() ? &none : s_lights.data(), GL_STREAM_DRAW);
+
+    if (useGpu && gpuAvailable()) {
+        s_stats.gpu = true;
+        ensureIndexCapacity(1 + static_cast<size_t>(CLUSTER_COUNT) * MAX_LIGHTS_PER_CLUSTER);
+        const uint32_t zero = 0;
+        GLState::bufferSubData(s_indexBuffer, 0, sizeof(zero), &zero);
+        GLState::bufferSubData(s_gridBuffer, 0, sizeof(header), &header);
+        GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, s_lightBuffer);
+        GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, GRID_BINDING, s_gridBuffer);
+        GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, s_indexBuffer);
+
+        GLState::useProgram(s_gpuProgram);
+        glUniformMatrix4fv(s_viewLocation, 1, GL_FALSE, &view[0][0]);
+        const glm::mat4 inverse = glm::inverse(projection);
+        glUniformMatrix4fv(s_invProjectionLocation, 1, GL_FALSE, &inverse[0][0]);
+        glUniform1f(s_nearPlaneLocation, nearPlane);
+        glUniform1f(s_farPlaneLocation, farPlane);
+        glUniform1ui(s_maxLightsLocation, MAX_LIGHTS_PER_CLUSTER);
+        glDispatchCompute((CLUSTER_COUNT + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+        // The lit fragment shaders read the lists
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        GLState::useProgram(0);
+        return;
+    }
+
+    // The lists go behind the counter the compute path appends with
+    assignCpu(projection, nearPlane, farPlane, s_grid.data() + 8, s_indices, 1);
+    for (int cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+        const uint32_t count = s_grid[8 + cluster * 2 + 1];
+        if (count > 0) ++s_stats.occupiedClusters;
+        s_stats.maxPerCluster = std::max(s_stats.maxPerCluster, static_cast<int>(count));
+    }
+    s_indices[0] = static_cast<uint32_t>(s_indices.size() - 1);
+    s_stats.listedLights = static_cast<int>(s_indices[0]);
+
+    ensureIndexCapacity(s_indices.size());
+    GLState::bufferSubData(s_indexBuffer, 0, static_cast<GLsizeiptr>(s_indices.size() * sizeof(uint32_t)),
+                           s_indices.data());
+    GLState::bufferSubData(s_gridBuffer, 0, static_cast<GLsizeiptr>(s_grid.size() * sizeof(uint32_t)), s_grid.data());
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, s_lightBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, GRID_BINDING, s_gridBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, s_indexBuffer);
+}
+
+void assign(const std::vector<gfx::ExtraLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+            float nearPlane, float farPlane, std::vector<uint32_t>& ranges, std::vector<uint32_t>& indices) {
+    ranges.assign(static_cast<size_t>(CLUSTER_COUNT) * 2, 0);
+    indices.clear();
+    if (nearPlane <= 0.0f || farPlane <= nearPlane) return;
+    gatherLights(lights, view);
+    assignCpu(projection, nearPlane, farPlane, ranges.data(), indices, 0);
+}
+
+const Stats& stats() {
+    return s_stats;
+}
+
+void cleanup() {
+    if (s_gpuProgram) glDeleteProgram(s_gpuProgram);
+    if (s_lightBuffer) GLState::deleteBuffers(1, &s_lightBuffer);
+    if (s_gridBuffer) GLState::deleteBuffers(1, &s_gridBuffer);
+    if (s_indexBuffer) GLState::deleteBuffers(1, &s_indexBuffer);
+    s_gpuProgram = s_lightBuffer = s_gridBuffer = s_indexBuffer = 0;
+    s_indexCapacity = 0;
+    s_viewLocation = s_invProjectionLocation = s_nearPlaneLocation = s_farPlaneLocation = s_maxLightsLocation = -1;
+    s_gpuTried = false;
+    s_aabbs.clear();
+    s_grid.clear();
+}
+
+} // namespace LightClusters
@@ -1,6 +1,8 @@
 #include "LightingHelper.h"
 #include "ShadowRenderer.h"
+#include <GLState.h>
 #include <ShaderLib.h>
+#include <ShaderUniforms.h>
 #include <glad/gl.h>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -12,31 +14,28 @@ void setLightUniforms(ShaderLib::ProgramWrapper* prog, const LightParams& light,
     // Transform light position to view space
     glm::vec4 lightViewPos = viewMatrix * glm::vec4(light.position, 1.0f);
     
-    prog->setUniform("light.position", lightViewPos);
-    prog->setUniform("light.ambient", glm::vec4(light.ambient, 1.0f));
-    prog->setUniform("light.diffuse", glm::vec4(light.diffuse, 1.0f));
-    prog->setUniform("light.specular", glm::vec4(light.specular, 1.0f));
-    prog->setUniform("light.constantAttenuation", light.constantAttenuation);
-    prog->setUniform("light.linearAttenuation", light.linearAttenuation);
-    prog->setUniform("light.quadraticAttenuation", light.quadraticAttenuation);
+    prog->set(Uniforms::kLightPosition, lightViewPos);
+    prog->set(Uniforms::kLightAmbient, glm::vec4(light.ambient, 1.0f));
+    prog->set(Uniforms::kLightDiffuse, glm::vec4(light.diffuse, 1.0f));
+    prog->set(Uniforms::kLightSpecular, glm::vec4(light.specular, 1.0f));
+    prog->set(Uniforms::kLightConstantAttenuation, light.constantAttenuation);
+    prog->set(Uniforms::kLightLinearAttenuation, light.linearAttenuation);
+    prog->set(Uniforms::kLightQuadraticAttenuation, light.quadraticAttenuation);
 }
 
 void setShadowUniforms(ShaderLib::ProgramWrapper* prog, const ShadowParams& shadow) {
     if (!prog) return;
     
-    GLuint programId = prog->getProgramId();
+    prog->set(Uniforms::kLightSpaceMatrix, Shadow::getLightSpaceMatrix(0));
+    prog->set(Uniforms::kShadowEnabled, shadow.enabled ? 1 : 0);
+    prog->set(Uniforms::kShadowBias, shadow.bias);
+    prog->set(Uniforms::kShadowSoftness, shadow.softness);
+    prog->set(Uniforms::kShadowStrength, shadow.strength);
+    prog->set(Uniforms::kShadowMapSize, static_cast<float>(shadow.mapSize));
     
-    prog->setUniform("lightSpaceMatrix", Shadow::getLightSpaceMatrix(0));
-    glUniform1i(glGetUniformLocation(programId, "shadowEnabled"), shadow.enabled ? 1 : 0);
-    glUniform1f(glGetUniformLocation(programId, "shadowBias"), shadow.bias);
-    glUniform1f(glGetUniformLocation(programId, "shadowSoftness"), shadow.softness);
-    glUniform1f(glGetUniformLocation(programId, "shadowStrength"), shadow.strength);
-    glUniform1f(glGetUniformLocation(programId, "shadowMapSize"), static_cast<float>(shadow.mapSize));
-    
-    // Bind shadow map to texture unit 5 (avoid conflicts with other textures)
-    glActiveTexture(GL_TEXTURE5);
-    glBindTexture(GL_TEXTURE_2D, Shadow::getShadowMapTexture(0));
-    glUniform1i(glGetUniformLocation(programId, "shadowMap"), 5);
+    // Bind the shadow map array to texture unit 5 (avoid conflicts with other textures)
+    GLState::bindTexture(5, GL_TEXTURE_2D_ARRAY, Shadow::getShadowMapArray());
+    prog->set(Uniforms::kShadowMaps, 5);
 }
 
 void setLightingUniforms(ShaderLib::ProgramWrapper* prog, 
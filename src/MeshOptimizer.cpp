@@ -0,0 +1,382 @@
+/// @file MeshOptimizer.cpp
+/// @brief Tipsify, overdraw cluster sort, fetch/weld remaps and FIFO cache analysis
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace MeshOptimizer {
+
+namespace {
+
+bool indicesInRange(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (indices[i] >= vertexCount) return false;
+    }
+    return true;
+}
+
+// Vertex-to-triangle adjacency in CSR form; triangles with out-of-range indices are left out
+struct Adjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> liveCount;   // not yet emitted triangles per vertex
+};
+
+void buildAdjacency(Adjacency& adj, const uint32_t* indices, size_t triangleCount, size_t vertexCount) {
+    adj.liveCount.assign(vertexCount, 0);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const uint32_t* tri = indices + t * 3;
+        if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount) continue;
+        ++adj.liveCount[tri[0]];
+        ++adj.liveCount[tri[1]];
+        ++adj.liveCount[tri[2]];
+    }
+    adj.offsets.assign(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) adj.offsets[v + 1] = adj.offsets[v] + adj.liveCount[v];
+    adj.triangles.resize(adj.offsets[vertexCount]);
+
+    std::vector<uint32_t> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const uint32_t* tri = indices + t * 3;
+        if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount) continue;
+        for (int k = 0; k < 3; ++k) adj.triangles[fill[tri[k]]++] = static_cast<uint32_t>(t);
+    }
+}
+
+uint32_t hashVertex(const AttributeStream* streams, size_t streamCount, size_t v) {
+    uint32_t h = 2166136261u;
+    for (size_t s = 0; s < streamCount; ++s) {
+        const float* attr = streams[s].data + v * streams[s].stride;
+        for (size_t c = 0; c < streams[s].components; ++c) {
+            uint32_t bits;
+            std::memcpy(&bits, attr + c, sizeof(bits));
+            h = (h ^ bits) * 16777619u;
+        }
+    }
+    return h ^ (h >> 15);
+}
+
+bool sameVertex(const AttributeStream* streams, size_t streamCount, size_t a, size_t b) {
+    for (size_t s = 0; s < streamCount; ++s) {
+        const float* attrA = streams[s].data + a * streams[s].stride;
+        const float* attrB = streams[s].data + b * streams[s].stride;
+        if (std::memcmp(attrA, attrB, streams[s].components * sizeof(float)) != 0) return false;
+    }
+    return true;
+}
+
+// Apply a remap to one attribute array, shrinking it to newCount vertices
+void remapArray(std::vector<float>& values, size_t components, size_t vertexCount, const uint32_t* remap,
+                size_t newCount) {
+    if (values.size() != vertexCount * components) return;
+    std::vector<float> out(newCount * components);
+    remapVertices(out.data(), values.data(), vertexCount, components, remap);
+    values.swap(out);
+}
+
+} // anonymous namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned cacheSize) {
+    VertexCacheStats stats;
+    // FIFO: a vertex stays cached until cacheSize later misses; hits do not refresh it
+    std::vector<uint32_t> insertedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t misses = cacheSize + 1;
+    size_t unique = 0;
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        const uint32_t v = indices[i];
+        if (v >= vertexCount) continue;
+        if (!referenced[v]) {
+            referenced[v] = true;
+            ++unique;
+        }
+        if (misses - insertedAt[v] > cacheSize) {
+            insertedAt[v] = misses++;
+            ++stats.transformed;
+        }
+    }
+
+    const size_t triangleCount = indexCount / 3;
+    stats.acmr = triangleCount ? static_cast<float>(stats.transformed) / triangleCount : 0.0f;
+    stats.atvr = unique ? static_cast<float>(stats.transformed) / unique : 0.0f;
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         unsigned cacheSize) {
+    const size_t triangleCount = indexCount / 3;
+    Adjacency adj;
+    buildAdjacency(adj, indices, triangleCount, vertexCount);
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    deadEnd.reserve(indexCount);
+    candidates.reserve(64);
+
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0;
+    size_t written = 0;
+    const uint32_t none = kUnused;
+
+    auto nextLive = [&]() -> uint32_t {
+        while (cursor < vertexCount) {
+            if (adj.liveCount[cursor] > 0) return static_cast<uint32_t>(cursor);
+            ++cursor;
+        }
+        return none;
+    };
+
+    uint32_t fan = nextLive();
+    while (fan != none) {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adj.offsets[fan]; a < adj.offsets[fan + 1]; ++a) {
+            const uint32_t t = adj.triangles[a];
+            if (emitted[t]) continue;
+            emitted[t] = true;
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t v = indices[t * 3 + k];
+                dst[written++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --adj.liveCount[v];
+                if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+            }
+        }
+
+        // Next fan: the candidate that will still be cached after its remaining
+        // triangles are emitted, oldest first (it is closest to being evicted)
+        uint32_t best = none;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (adj.liveCount[v] == 0) continue;
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * adj.liveCount[v] <= cacheSize) priority = time - cacheTime[v];
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        // Dead end: the most recently touched vertex with work left, then any vertex
+        while (best == none && !deadEnd.empty()) {
+            const uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (adj.liveCount[v] > 0) best = v;
+        }
+        if (best == none) best = nextLive();
+        fan = best;
+    }
+
+    // Triangles that reference missing vertices keep their relative order at the end
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (emitted[t]) continue;
+        dst[written++] = indices[t * 3];
+        dst[written++] = indices[t * 3 + 1];
+        dst[written++] = indices[t * 3 + 2];
+    }
+    for (size_t i = triangleCount * 3; i < indexCount; ++i) dst[i] = indices[i];
+}
+
+void optimizeOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                      const float* positions, size_t vertexCount, size_t positionStride,
+                      unsigned cacheSize) {
+    const size_t triangleCount = indexCount / 3;
+
+    // Split where the simulated cache restarts: reordering whole clusters then costs
+    // no extra misses beyond the one-off warm-up each cluster already pays
+    std::vector<size_t> clusterStart;
+    std::vector<uint32_t> insertedAt(vertexCount, 0);
+    uint32_t misses = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = indices[t * 3 + k];
+            if (v >= vertexCount) continue;
+            if (misses - insertedAt[v] > cacheSize) {
+                insertedAt[v] = misses++;
+                ++triangleMisses;
+            }
+        }
+        if (t == 0 || triangleMisses == 3) clusterStart.push_back(t);
+    }
+    clusterStart.push_back(triangleCount);
+
+    auto position = [&](uint32_t v) { return glm::make_vec3(positions + v * positionStride); };
+
+    // Area-weighted centroid and summed normal per cluster
+    const size_t clusterCount = clusterStart.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+            const uint32_t* tri = indices + t * 3;
+            if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount) continue;
+            const glm::vec3 p0 = position(tri[0]);
+            const glm::vec3 p1 = position(tri[1]);
+            const glm::vec3 p2 = position(tri[2]);
+            const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            const float a = glm::length(n);
+            centroids[c] += (p0 + p1 + p2) * (a / 3.0f);
+            normals[c] += n;
+            area += a;
+        }
+        meshCentroid += centroids[c];
+        meshArea += area;
+        if (area > 0.0f) centroids[c] /= area;
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // Sander et al.: clusters far out along their own normal tend to occlude the rest
+    std::vector<float> sortKey(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        const float len = glm::length(normals[c]);
+        if (len > 0.0f) sortKey[c] = glm::dot(centroids[c] - meshCentroid, normals[c] / len);
+    }
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) order[c] = static_cast<uint32_t>(c);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+    size_t written = 0;
+    for (uint32_t c : order) {
+        const size_t begin = clusterStart[c] * 3;
+        const size_t end = clusterStart[c + 1] * 3;
+        std::copy(indices + begin, indices + end, dst + written);
+        written += end - begin;
+    }
+    for (size_t i = triangleCount * 3; i < indexCount; ++i) dst[i] = indices[i];
+}
+
+void optimizeIndexOrder(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                        const float* positions, size_t vertexCount, size_t positionStride) {
+    std::vector<uint32_t> cacheOrder(indexCount);
+    optimizeVertexCache(cacheOrder.data(), indices, indexCount, vertexCount);
+    optimizeOverdraw(dst, cacheOrder.data(), indexCount, positions, vertexCount, positionStride);
+}
+
+size_t generateWeldRemap(uint32_t* remap, const AttributeStream* streams, size_t streamCount,
+                         size_t vertexCount) {
+    // Open-addressed table of representative vertices, at most half full
+    size_t tableSize = 16;
+    while (tableSize < vertexCount * 2) tableSize <<= 1;
+    std::vector<uint32_t> table(tableSize, kUnused);
+    const size_t mask = tableSize - 1;
+
+    size_t unique = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        size_t slot = hashVertex(streams, streamCount, v) & mask;
+        for (;;) {
+            const uint32_t existing = table[slot];
+            if (existing == kUnused) {
+                table[slot] = static_cast<uint32_t>(v);
+                remap[v] = static_cast<uint32_t>(unique++);
+                break;
+            }
+            if (sameVertex(streams, streamCount, existing, v)) {
+                remap[v] = remap[existing];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    return unique;
+}
+
+size_t generateFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    std::fill(remap, remap + vertexCount, kUnused);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        const uint32_t v = indices[i];
+        if (v < vertexCount && remap[v] == kUnused) remap[v] = next++;
+    }
+    return next;
+}
+
+void remapIndices(uint32_t* dst, const uint32_t* indices, size_t indexCount, const uint32_t* remap) {
+    for (size_t i = 0; i < indexCount; ++i) dst[i] = remap[indices[i]];
+}
+
+void remapVertices(float* dst, const float* src, size_t vertexCount, size_t components,
+                   const uint32_t* remap) {
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] == kUnused) continue;
+        std::memcpy(dst + static_cast<size_t>(remap[v]) * components, src + v * components,
+                    components * sizeof(float));
+    }
+}
+
+void optimize(Mesh& mesh) {
+    size_t vertexCount = mesh.positions.size() / 3;
+    if (vertexCount == 0 || mesh.indices.size() < 3 ||
+        !indicesInRange(mesh.indices.data(), mesh.indices.size(), vertexCount)) {
+        return;
+    }
+    const bool hasNormals = mesh.normals.size() == vertexCount * 3;
+    const bool hasUVs = mesh.uvs.size() == vertexCount * 2;
+    std::vector<uint32_t> remap(vertexCount);
+
+    AttributeStream streams[3];
+    size_t streamCount = 0;
+    streams[streamCount++] = AttributeStream{mesh.positions.data(), 3, 3};
+    if (hasNormals) streams[streamCount++] = AttributeStream{mesh.normals.data(), 3, 3};
+    if (hasUVs) streams[streamCount++] = AttributeStream{mesh.uvs.data(), 2, 2};
+    size_t newCount = generateWeldRemap(remap.data(), streams, streamCount, vertexCount);
+    auto applyRemap = [&]() {
+        remapIndices(mesh.indices.data(), mesh.indices.data(), mesh.indices.size(), remap.data());
+        remapArray(mesh.positions, 3, vertexCount, remap.data(), newCount);
+        remapArray(mesh.normals, 3, vertexCount, remap.data(), newCount);
+        remapArray(mesh.uvs, 2, vertexCount, remap.data(), newCount);
+        vertexCount = newCount;
+    };
+    if (newCount < vertexCount) applyRemap();
+
+    std::vector<uint32_t> ordered(mesh.indices.size());
+    optimizeIndexOrder(ordered.data(), mesh.indices.data(), mesh.indices.size(), mesh.positions.data(),
+                       vertexCount);
+    mesh.indices.swap(ordered);
+
+    remap.resize(vertexCount);
+    newCount = generateFetchRemap(remap.data(), mesh.indices.data(), mesh.indices.size(), vertexCount);
+    applyRemap();
+}
+
+void optimizeInterleaved(std::vector<float>& vertices, size_t floatsPerVertex, std::vector<uint32_t>& indices) {
+    size_t vertexCount = floatsPerVertex ? vertices.size() / floatsPerVertex : 0;
+    if (floatsPerVertex < 3 || vertexCount == 0 || indices.size() < 3 ||
+        !indicesInRange(indices.data(), indices.size(), vertexCount)) {
+        return;
+    }
+    std::vector<uint32_t> remap(vertexCount);
+
+    const AttributeStream stream{vertices.data(), floatsPerVertex, floatsPerVertex};
+    size_t newCount = generateWeldRemap(remap.data(), &stream, 1, vertexCount);
+    auto applyRemap = [&]() {
+        remapIndices(indices.data(), indices.data(), indices.size(), remap.data());
+        remapArray(vertices, floatsPerVertex, vertexCount, remap.data(), newCount);
+        vertexCount = newCount;
+    };
+    if (newCount < vertexCount) applyRemap();
+
+    std::vector<uint32_t> ordered(indices.size());
+    optimizeIndexOrder(ordered.data(), indices.data(), indices.size(), vertices.data(), vertexCount,
+                       floatsPerVertex);
+    indices.swap(ordered);
+
+    remap.resize(vertexCount);
+    newCount = generateFetchRemap(remap.data(), indices.data(), indices.size(), vertexCount);
+    applyRemap();
+}
+
+} // namespace MeshOptimizer
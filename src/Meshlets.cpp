@@ -0,0 +1,314 @@
+/// @file Meshlets.cpp
+/// @brief Greedy meshlet builder, bounds refit and frustum/cone culling
+
+#include "Meshlets.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace Meshlets {
+
+namespace {
+
+constexpr uint32_t kNone = 0xFFFFFFFFu;
+constexpr int kRefitGrain = 256;   // meshlets per worker chunk
+
+bool validTriangle(const uint32_t* tri, size_t vertexCount) {
+    return tri[0] < vertexCount && tri[1] < vertexCount && tri[2] < vertexCount;
+}
+
+void fitBounds(Bounds& out, const Meshlet& meshlet, const uint32_t* vertices, const uint8_t* triangles,
+               const float* positions) {
+    if (meshlet.vertexCount == 0) {
+        out = Bounds{};
+        out.radius = FLT_MAX;
+        return;
+    }
+    const uint32_t* local = vertices + meshlet.firstVertex;
+    auto position = [&](uint32_t v) { return glm::make_vec3(positions + static_cast<size_t>(local[v]) * 3); };
+
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+        const glm::vec3 p = position(i);
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+    out.center = (boundsMin + boundsMax) * 0.5f;
+    float radius2 = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+        const glm::vec3 d = position(i) - out.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    out.radius = std::sqrt(radius2);
+
+    // Cone: mean of the unit face normals, opened to the widest of them. Plain floats:
+    // this loop runs over every triangle each time the cloth moves.
+    float normals[kMaxTriangles * 3];
+    uint32_t normalCount = 0;
+    float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+        const uint8_t* tri = triangles + (static_cast<size_t>(meshlet.firstTriangle) + t) * 3;
+        const float* a = positions + static_cast<size_t>(local[tri[0]]) * 3;
+        const float* b = positions + static_cast<size_t>(local[tri[1]]) * 3;
+        const float* c = positions + static_cast<size_t>(local[tri[2]]) * 3;
+        const float ex = b[0] - a[0], ey = b[1] - a[1], ez = b[2] - a[2];
+        const float fx = c[0] - a[0], fy = c[1] - a[1], fz = c[2] - a[2];
+        const float nx = ey * fz - ez * fy;
+        const float ny = ez * fx - ex * fz;
+        const float nz = ex * fy - ey * fx;
+        const float len2 = nx * nx + ny * ny + nz * nz;
+        if (!(len2 > 0.0f)) continue;
+        const float inv = 1.0f / std::sqrt(len2);
+        float* n = normals + normalCount++ * 3;
+        n[0] = nx * inv;
+        n[1] = ny * inv;
+        n[2] = nz * inv;
+        sx += n[0];
+        sy += n[1];
+        sz += n[2];
+    }
+    const float sumLen = std::sqrt(sx * sx + sy * sy + sz * sz);
+    out.coneCos = -1.0f;
+    out.coneSin = 0.0f;
+    if (normalCount == 0 || sumLen <= 1e-6f) return;
+    sx /= sumLen;
+    sy /= sumLen;
+    sz /= sumLen;
+    float minDot = 1.0f;
+    for (uint32_t i = 0; i < normalCount; ++i) {
+        const float* n = normals + i * 3;
+        minDot = std::min(minDot, sx * n[0] + sy * n[1] + sz * n[2]);
+    }
+    out.coneAxis = glm::vec3(sx, sy, sz);
+    out.coneCos = minDot;
+    out.coneSin = std::sqrt(std::max(0.0f, 1.0f - minDot * minDot));
+}
+
+bool sphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius) {
+    for (const glm::vec4& plane : frustum.planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+// True when every triangle faces away from eye. Normals lie within the cone's half angle
+// t of the axis and points within the sphere; with f the angle between axis and the
+// view vector v, all of them are back-facing when cos(f + t) * |v| >= radius.
+bool coneBackfacing(const Bounds& bounds, const glm::vec3& eye) {
+    if (bounds.coneCos <= 0.0f) return false;
+    const glm::vec3 v = bounds.center - eye;
+    const float distance = glm::length(v);
+    if (distance <= bounds.radius) return false;
+    const float cosF = glm::dot(v, bounds.coneAxis) / distance;
+    const float sinF = std::sqrt(std::max(0.0f, 1.0f - cosF * cosF));
+    return (cosF * bounds.coneCos - sinF * bounds.coneSin) * distance >= bounds.radius;
+}
+
+} // anonymous namespace
+
+void ClusterSet::clear() {
+    meshlets.clear();
+    vertices.clear();
+    triangles.clear();
+    bounds.clear();
+    sourcePositions = nullptr;
+    positionsVersion = 0;
+}
+
+void build(ClusterSet& set, uint32_t* ordered, const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    set.clear();
+    const size_t triangleCount = indexCount / 3;
+
+    // Vertex-to-triangle adjacency (CSR) over valid triangles
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const uint32_t* tri = indices + t * 3;
+        if (!validTriangle(tri, vertexCount)) continue;
+        ++offsets[tri[0] + 1];
+        ++offsets[tri[1] + 1];
+        ++offsets[tri[2] + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(offsets[vertexCount]);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const uint32_t* tri = indices + t * 3;
+            if (!validTriangle(tri, vertexCount)) continue;
+            for (int k = 0; k < 3; ++k) adjacency[fill[tri[k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> vertexOwner(vertexCount, kNone);      // meshlet currently holding the vertex
+    std::vector<uint8_t> vertexLocal(vertexCount, 0);           // its offset in that meshlet
+    std::vector<uint32_t> candidateOwner(triangleCount, kNone); // meshlet that queued the triangle
+    std::vector<uint32_t> candidates;
+    size_t written = 0;
+    size_t cursor = 0;
+    Meshlet current;
+
+    auto newVertices = [&](uint32_t t, uint32_t id) {
+        const uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+        return static_cast<uint32_t>(vertexOwner[a] != id) +
+               static_cast<uint32_t>(vertexOwner[b] != id && b != a) +
+               static_cast<uint32_t>(vertexOwner[c] != id && c != a && c != b);
+    };
+    auto finish = [&]() {
+        if (current.triangleCount > 0) set.meshlets.push_back(current);
+        current = Meshlet{};
+        current.firstIndex = static_cast<uint32_t>(written);
+        current.firstVertex = static_cast<uint32_t>(set.vertices.size());
+        current.firstTriangle = static_cast<uint32_t>(set.triangles.size() / 3);
+        // One leftover neighbour seeds the next meshlet right next to this one
+        uint32_t seed = kNone;
+        for (uint32_t t : candidates) {
+            if (!emitted[t]) {
+                seed = t;
+                break;
+            }
+        }
+        candidates.clear();
+        if (seed != kNone) {
+            candidateOwner[seed] = static_cast<uint32_t>(set.meshlets.size());
+            candidates.push_back(seed);
+        }
+    };
+
+    for (;;) {
+        const uint32_t id = static_cast<uint32_t>(set.meshlets.size());
+
+        // Best queued neighbour: fewest new vertices keeps the meshlet compact
+        uint32_t best = kNone;
+        uint32_t bestNew = 4;
+        for (size_t c = 0; c < candidates.size();) {
+            const uint32_t t = candidates[c];
+            if (emitted[t]) {
+                candidates[c] = candidates.back();
+                candidates.pop_back();
+                continue;
+            }
+            const uint32_t added = newVertices(t, id);
+            if (added < bestNew) {
+                bestNew = added;
+                best = t;
+                if (added == 0) break;
+            }
+            ++c;
+        }
+
+        if (current.triangleCount >= kMaxTriangles ||
+            (best != kNone && current.vertexCount + bestNew > kMaxVertices) ||
+            (best == kNone && current.triangleCount > 0)) {
+            finish();
+            continue;
+        }
+        if (best == kNone) {
+            while (cursor < triangleCount &&
+                   (emitted[cursor] || !validTriangle(indices + cursor * 3, vertexCount))) {
+                ++cursor;
+            }
+            if (cursor == triangleCount) break;
+            best = static_cast<uint32_t>(cursor);
+        }
+
+        emitted[best] = true;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = indices[best * 3 + k];
+            ordered[written++] = v;
+            if (vertexOwner[v] != id) {
+                vertexOwner[v] = id;
+                vertexLocal[v] = static_cast<uint8_t>(current.vertexCount++);
+                set.vertices.push_back(v);
+                for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a) {
+                    const uint32_t n = adjacency[a];
+                    if (emitted[n] || candidateOwner[n] == id) continue;
+                    candidateOwner[n] = id;
+                    candidates.push_back(n);
+                }
+            }
+            set.triangles.push_back(vertexLocal[v]);
+        }
+        ++current.triangleCount;
+    }
+    finish();
+
+    // Triangles referencing missing vertices keep drawing as before, in one unculled run
+    Meshlet invalid;
+    invalid.firstIndex = static_cast<uint32_t>(written);
+    invalid.firstVertex = static_cast<uint32_t>(set.vertices.size());
+    invalid.firstTriangle = static_cast<uint32_t>(set.triangles.size() / 3);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (emitted[t]) continue;
+        for (int k = 0; k < 3; ++k) ordered[written++] = indices[t * 3 + k];
+        ++invalid.triangleCount;
+    }
+    if (invalid.triangleCount > 0) set.meshlets.push_back(invalid);
+    for (size_t i = triangleCount * 3; i < indexCount; ++i) ordered[i] = indices[i];
+
+    set.bounds.resize(set.meshlets.size());
+}
+
+void refit(ClusterSet& set, const float* positions, size_t vertexCount, uint64_t positionsVersion) {
+    if (positionsVersion != 0 && positionsVersion == set.positionsVersion && positions == set.sourcePositions) {
+        return;
+    }
+    (void)vertexCount;   // build() already set out-of-range triangles aside
+    set.sourcePositions = positions;
+    set.positionsVersion = positionsVersion;
+    set.bounds.resize(set.meshlets.size());
+
+    const Meshlet* meshlets = set.meshlets.data();
+    const uint32_t* vertices = set.vertices.data();
+    const uint8_t* triangles = set.triangles.data();
+    Bounds* bounds = set.bounds.data();
+    Parallel::forRange(static_cast<int>(set.meshlets.size()), kRefitGrain, [&](int begin, int end) {
+        for (int m = begin; m < end; ++m) fitBounds(bounds[m], meshlets[m], vertices, triangles, positions);
+    });
+}
+
+Frustum extractFrustum(const glm::mat4& m) {
+    // Gribb/Hartmann: combinations of the matrix rows (glm is column-major)
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+    for (glm::vec4& plane : frustum.planes) {
+        const float len = glm::length(glm::vec3(plane));
+        if (len > 0.0f) plane /= len;
+    }
+    return frustum;
+}
+
+size_t cull(const ClusterSet& set, const Frustum& frustum, const glm::vec3* eye, std::vector<IndexRange>& out) {
+    size_t kept = 0;
+    uint32_t rangeEnd = kNone;
+    for (size_t m = 0; m < set.meshlets.size(); ++m) {
+        const Meshlet& meshlet = set.meshlets[m];
+        const Bounds& bounds = set.bounds[m];
+        if (!sphereInFrustum(frustum, bounds.center, bounds.radius)) continue;
+        if (eye && coneBackfacing(bounds, *eye)) continue;
+
+        const uint32_t count = meshlet.triangleCount * 3;
+        if (rangeEnd == meshlet.firstIndex && !out.empty()) {
+            out.back().count += count;
+        } else {
+            out.push_back(IndexRange{meshlet.firstIndex, count});
+        }
+        rangeEnd = meshlet.firstIndex + count;
+        kept += meshlet.triangleCount;
+    }
+    return kept;
+}
+
+} // namespace Meshlets
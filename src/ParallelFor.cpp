@@ -0,0 +1,145 @@
+/// @file ParallelFor.cpp
+/// @brief Persistent worker pool behind Parallel::forRange
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+namespace {
+
+class WorkerPool {
+public:
+    ~WorkerPool() { stop(); }
+
+    int size() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        startLocked();
+        return static_cast<int>(m_threads.size());
+    }
+
+    void run(int count, int chunk, const std::function<void(int, int)>& fn) {
+        std::lock_guard<std::mutex> submit(m_submitMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            startLocked();
+            m_fn = &fn;
+            m_count = count;
+            m_chunk = chunk;
+            m_next.store(0, std::memory_order_relaxed);
+            m_active = static_cast<int>(m_threads.size());
+            ++m_generation;
+        }
+        m_wake.notify_all();
+        runChunks();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_active == 0; });
+        m_fn = nullptr;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> submit(m_submitMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& t : m_threads) t.join();
+        m_threads.clear();
+        m_stop = false;
+        m_started = false;
+    }
+
+private:
+    void startLocked() {
+        if (m_started) return;
+        m_started = true;
+        // Leave one core for the GL thread, which always takes chunks itself
+        unsigned hw = std::thread::hardware_concurrency();
+        int workers = hw > 1 ? std::min(static_cast<int>(hw) - 1, 7) : 0;
+        for (int i = 0; i < workers; ++i) {
+            m_threads.emplace_back([this, seen = m_generation] { workerLoop(seen); });
+        }
+    }
+
+    void workerLoop(uint64_t seen) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_stop) return;
+            seen = m_generation;
+            lock.unlock();
+            runChunks();
+            lock.lock();
+            if (--m_active == 0) m_done.notify_one();
+        }
+    }
+
+    void runChunks() {
+        for (;;) {
+            int begin = m_next.fetch_add(m_chunk, std::memory_order_relaxed);
+            if (begin >= m_count) return;
+            (*m_fn)(begin, std::min(begin + m_chunk, m_count));
+        }
+    }
+
+    std::mutex m_submitMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::vector<std::thread> m_threads;
+    const std::function<void(int, int)>* m_fn = nullptr;
+    std::atomic<int> m_next{0};
+    int m_count = 0;
+    int m_chunk = 1;
+    int m_active = 0;
+    uint64_t m_generation = 0;
+    bool m_started = false;
+    bool m_stop = false;
+};
+
+WorkerPool& pool() {
+    static WorkerPool instance;
+    return instance;
+}
+
+} // anonymous namespace
+
+int workerCount() {
+    return pool().size();
+}
+
+void forRange(int count, int minChunk, const std::function<void(int, int)>& fn) {
+    if (count <= 0) return;
+    minChunk = std::max(minChunk, 1);
+    if (count <= minChunk) {
+        fn(0, count);
+        return;
+    }
+
+    const int workers = workerCount();
+    if (workers == 0) {
+        fn(0, count);
+        return;
+    }
+
+    // A few chunks per thread so uneven cores still balance, but never below minChunk
+    const int threads = workers + 1;
+    int chunk = (count + threads * 4 - 1) / (threads * 4);
+    chunk = std::max(chunk, minChunk);
+    pool().run(count, chunk, fn);
+}
+
+void shutdown() {
+    pool().stop();
+}
+
+} // namespace Parallel
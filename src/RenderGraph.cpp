@@ -0,0 +1,481 @@
+/// @file RenderGraph.cpp
+/// @brief Pass culling, transient target placement and execution
+
+#include "RenderGraph.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+namespace gfx {
+
+namespace {
+    // Frames a pooled texture or framebuffer may sit unused before it is freed; toggling a
+    // pass off and on again within this window costs no reallocation
+    constexpr int kIdleFramesBeforeRelease = 3;
+    constexpr int kMaxColorAttachments = 4;
+    constexpr int kDepthSlot = kMaxColorAttachments;
+
+    bool isDepthFormat(GLenum format) {
+        switch (format) {
+            case GL_DEPTH_COMPONENT16:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32:
+            case GL_DEPTH_COMPONENT32F:
+            case GL_DEPTH24_STENCIL8:
+            case GL_DEPTH32F_STENCIL8:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    GLenum textureTarget(GLsizei layers) {
+        return layers > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    }
+
+    bool hasStencil(GLenum format) {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    // Client format and type that glTexImage2D accepts for a sized internal format
+    void transferFormat(GLenum internalFormat, GLenum& format, GLenum& type) {
+        switch (internalFormat) {
+            case GL_R8: format = GL_RED; type = GL_UNSIGNED_BYTE; return;
+            case GL_R16F:
+            case GL_R32F: format = GL_RED; type = GL_FLOAT; return;
+            case GL_RG8: format = GL_RG; type = GL_UNSIGNED_BYTE; return;
+            case GL_RG16F:
+            case GL_RG32F: format = GL_RG; type = GL_FLOAT; return;
+            case GL_RGB8: format = GL_RGB; type = GL_UNSIGNED_BYTE; return;
+            case GL_RGB16F:
+            case GL_RGB32F:
+            case GL_R11F_G11F_B10F: format = GL_RGB; type = GL_FLOAT; return;
+            case GL_RGBA16F:
+            case GL_RGBA32F: format = GL_RGBA; type = GL_FLOAT; return;
+            case GL_DEPTH_COMPONENT16:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32:
+            case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; return;
+            case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; return;
+            case GL_DEPTH32F_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; return;
+            default: format = GL_RGBA; type = GL_UNSIGNED_BYTE; return;
+        }
+    }
+
+    size_t bytesPerTexel(GLenum format) {
+        switch (format) {
+            case GL_R8: return 1;
+            case GL_R16F:
+            case GL_RG8:
+            case GL_DEPTH_COMPONENT16: return 2;
+            case GL_RGB8: return 3;
+            case GL_RGB16F: return 6;
+            case GL_RGBA16F:
+            case GL_RG32F:
+            case GL_DEPTH32F_STENCIL8: return 8;
+            case GL_RGB32F: return 12;
+            case GL_RGBA32F: return 16;
+            default: return 4;
+        }
+    }
+}
+
+void RenderGraph::Builder::read(Resource resource) {
+    m_graph.use(m_pass, resource, Read);
+}
+
+void RenderGraph::Builder::write(Resource resource) {
+    m_graph.use(m_pass, resource, Attachment);
+}
+
+void RenderGraph::Builder::writeLayer(Resource resource, int layer) {
+    m_graph.use(m_pass, resource, Attachment, layer);
+}
+
+void RenderGraph::Builder::writeStorage(Resource resource) {
+    m_graph.use(m_pass, resource, Storage);
+}
+
+void RenderGraph::setBackbufferSize(GLsizei width, GLsizei height) {
+    m_backbufferWidth = width;
+    m_backbufferHeight = height;
+}
+
+void RenderGraph::reset() {
+    releaseIdle();
+    m_passes.clear();
+    m_resources.clear();
+    ResourceNode backbuffer;
+    backbuffer.name = "backbuffer";
+    m_resources.push_back(std::move(backbuffer));
+    m_backbuffer = 0;
+    m_compiled = false;
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const char* name, const TextureDesc& desc) {
+    if (m_resources.empty()) reset();
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    m_resources.push_back(std::move(node));
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const char* name, GLuint texture, const TextureDesc& desc) {
+    const Resource resource = createTexture(name, desc);
+    m_resources[resource].imported = texture;
+    return resource;
+}
+
+void RenderGraph::addPass(const char* name, const SetupFn& setup, ExecuteFn execute) {
+    if (m_resources.empty()) reset();
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    m_passes.push_back(std::move(pass));
+    Builder builder(*this, m_passes.size() - 1);
+    if (setup) setup(builder);
+}
+
+void RenderGraph::use(size_t pass, Resource resource, Access access, int layer) {
+    if (resource < 0 || resource >= static_cast<Resource>(m_resources.size())) {
+        std::cerr << "RenderGraph: pass '" << m_passes[pass].name << "' uses an unknown resource" << std::endl;
+        return;
+    }
+    if (resource == m_backbuffer) {
+        if (access != Attachment) {
+            std::cerr << "RenderGraph: pass '" << m_passes[pass].name
+                      << "' can only render to the backbuffer" << std::endl;
+            return;
+        }
+        m_passes[pass].writesBackbuffer = true;
+    }
+    if (layer >= 0 && layer >= m_resources[resource].desc.layers) {
+        std::cerr << "RenderGraph: pass '" << m_passes[pass].name << "' writes layer " << layer << " of '"
+                  << m_resources[resource].name << "', which does not have it" << std::endl;
+        return;
+    }
+    m_passes[pass].uses.push_back(Use{resource, access, layer});
+}
+
+bool RenderGraph::compile() {
+    m_stats = Stats{};
+    m_stats.passes = static_cast<int>(m_passes.size());
+    m_compiled = false;
+
+    bool valid = true;
+    for (Pass& pass : m_passes) {
+        int colors = 0;
+        int depths = 0;
+        for (const Use& use : pass.uses) {
+            if (use.access != Attachment || use.resource == m_backbuffer) continue;
+            const TextureDesc& desc = m_resources[use.resource].desc;
+            if (isDepthFormat(desc.format)) {
+                ++depths;
+            } else {
+                ++colors;
+            }
+            for (const Use& other : pass.uses) {
+                if (other.resource == use.resource && other.access == Read) {
+                    std::cerr << "RenderGraph: pass '" << pass.name << "' samples its own target '"
+                              << m_resources[use.resource].name << "'" << std::endl;
+                    valid = false;
+                }
+            }
+        }
+        if (colors > kMaxColorAttachments || depths > 1 || (pass.writesBackbuffer && colors + depths > 0)) {
+            std::cerr << "RenderGraph: pass '" << pass.name << "' has an unsupported attachment set" << std::endl;
+            valid = false;
+        }
+    }
+    if (!valid) return false;
+
+    // Cull: walk back from the backbuffer, keeping passes that write something still needed
+    m_resources[m_backbuffer].needed = true;
+    for (size_t i = m_passes.size(); i-- > 0;) {
+        Pass& pass = m_passes[i];
+        for (const Use& use : pass.uses) {
+            if (use.access != Read && m_resources[use.resource].needed) pass.alive = true;
+        }
+        if (!pass.alive) {
+            ++m_stats.culledPasses;
+            continue;
+        }
+        for (const Use& use : pass.uses) {
+            if (use.access == Read) m_resources[use.resource].needed = true;
+        }
+    }
+
+    // Lifetimes and barriers, in execution order
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+        Pass& pass = m_passes[i];
+        if (!pass.alive) continue;
+        for (const Use& use : pass.uses) {
+            if (use.resource == m_backbuffer) continue;
+            ResourceNode& node = m_resources[use.resource];
+            if (node.firstPass < 0) {
+                if (use.access == Read && !node.imported) {
+                    std::cerr << "RenderGraph: pass '" << pass.name << "' reads '" << node.name
+                              << "' before anything writes it" << std::endl;
+                    return false;
+                }
+                node.firstPass = static_cast<int>(i);
+            }
+            node.lastPass = static_cast<int>(i);
+
+            // Image stores are incoherent with every later access until a barrier
+            if (node.storageWritten) {
+                switch (use.access) {
+                    case Read: pass.barrier |= GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT; break;
+                    case Attachment: pass.barrier |= GL_FRAMEBUFFER_BARRIER_BIT; break;
+                    case Storage: pass.barrier |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT; break;
+                }
+            }
+            node.storageWritten = use.access == Storage;
+        }
+        if (pass.barrier) ++m_stats.barriers;
+    }
+
+    // Place transient targets: a texture is free again once its last target's final pass ran
+    for (PooledTexture& texture : m_textures) texture.busyUntil = -1;
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+        if (!m_passes[i].alive) continue;
+        for (const Use& use : m_passes[i].uses) {
+            ResourceNode& node = m_resources[use.resource];
+            if (use.resource == m_backbuffer || node.imported || node.texture >= 0) continue;
+            node.texture = acquireTexture(node.desc, node.firstPass, node.lastPass);
+            ++m_stats.transientTargets;
+        }
+    }
+
+    for (Pass& pass : m_passes) {
+        if (!pass.alive || pass.writesBackbuffer) continue;
+        AttachmentSlot attachments[5];
+        int colors = 0;
+        for (const Use& use : pass.uses) {
+            if (use.access != Attachment) continue;
+            const ResourceNode& node = m_resources[use.resource];
+            AttachmentSlot& attachment = attachments[isDepthFormat(node.desc.format) ? kDepthSlot : colors++];
+            attachment.texture = node.imported ? node.imported : m_textures[node.texture].name;
+            attachment.layer = use.layer;
+            attachment.array = node.desc.layers > 0;
+            attachment.format = node.desc.format;
+        }
+        pass.framebuffer = (colors > 0 || attachments[kDepthSlot].texture) ? acquireFramebuffer(attachments) : 0;
+    }
+
+    for (const PooledTexture& texture : m_textures) {
+        ++m_stats.textures;
+        m_stats.textureBytes += static_cast<size_t>(texture.width) * texture.height * std::max<GLsizei>(texture.layers, 1) *
+                                bytesPerTexel(texture.format);
+    }
+    m_compiled = true;
+    return true;
+}
+
+int RenderGraph::acquireTexture(const TextureDesc& desc, int firstPass, int lastPass) {
+    for (size_t t = 0; t < m_textures.size(); ++t) {
+        PooledTexture& texture = m_textures[t];
+        if (texture.width != desc.width || texture.height != desc.height || texture.format != desc.format ||
+            texture.layers != desc.layers) continue;
+        if (texture.busyUntil >= firstPass) continue;
+        if (texture.usedThisFrame) ++m_stats.aliasedTargets;
+        texture.busyUntil = lastPass;
+        texture.usedThisFrame = true;
+        texture.idleFrames = 0;
+        return static_cast<int>(t);
+    }
+
+    PooledTexture texture;
+    texture.width = desc.width;
+    texture.height = desc.height;
+    texture.format = desc.format;
+    texture.layers = desc.layers;
+    texture.busyUntil = lastPass;
+    texture.usedThisFrame = true;
+    GLenum format = GL_RGBA;
+    GLenum type = GL_UNSIGNED_BYTE;
+    transferFormat(desc.format, format, type);
+    const GLenum target = textureTarget(desc.layers);
+    glGenTextures(1, &texture.name);
+    GLState::bindTexture(0, target, texture.name);
+    if (desc.layers > 0) {
+        glTexImage3D(target, 0, static_cast<GLint>(desc.format), desc.width, desc.height, desc.layers, 0, format, type,
+                     nullptr);
+    } else {
+        glTexImage2D(target, 0, static_cast<GLint>(desc.format), desc.width, desc.height, 0, format, type, nullptr);
+    }
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+    m_textures.push_back(texture);
+    return static_cast<int>(m_textures.size() - 1);
+}
+
+GLuint RenderGraph::acquireFramebuffer(const AttachmentSlot (&attachments)[5]) {
+    auto same = [](const AttachmentSlot& a, const AttachmentSlot& b) { return a.texture == b.texture && a.layer == b.layer; };
+    for (CachedFramebuffer& framebuffer : m_framebuffers) {
+        if (std::equal(std::begin(attachments), std::end(attachments), framebuffer.attachments, same)) {
+            framebuffer.usedThisFrame = true;
+            framebuffer.idleFrames = 0;
+            return framebuffer.name;
+        }
+    }
+
+    CachedFramebuffer framebuffer;
+    std::copy(std::begin(attachments), std::end(attachments), framebuffer.attachments);
+    framebuffer.usedThisFrame = true;
+    glGenFramebuffers(1, &framebuffer.name);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, framebuffer.name);
+
+    // Whole arrays attach layered, single layers through glFramebufferTextureLayer
+    auto attach = [](GLenum point, const AttachmentSlot& attachment) {
+        if (!attachment.array) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, point, GL_TEXTURE_2D, attachment.texture, 0);
+        } else if (attachment.layer >= 0) {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, point, attachment.texture, 0, attachment.layer);
+        } else {
+            glFramebufferTexture(GL_FRAMEBUFFER, point, attachment.texture, 0);
+        }
+    };
+
+    GLenum drawBuffers[kMaxColorAttachments];
+    GLsizei colors = 0;
+    for (int c = 0; c < kMaxColorAttachments && attachments[c].texture; ++c) {
+        attach(GL_COLOR_ATTACHMENT0 + c, attachments[c]);
+        drawBuffers[colors++] = GL_COLOR_ATTACHMENT0 + c;
+    }
+    const AttachmentSlot& depth = attachments[kDepthSlot];
+    if (depth.texture) attach(hasStencil(depth.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, depth);
+    if (colors > 0) {
+        glDrawBuffers(colors, drawBuffers);
+    } else {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "RenderGraph: framebuffer not complete" << std::endl;
+    }
+    m_framebuffers.push_back(framebuffer);
+    return framebuffer.name;
+}
+
+void RenderGraph::applySampling(PooledTexture& texture, const TextureDesc& desc) {
+    if (texture.filter == desc.filter && texture.wrap == desc.wrap && texture.depthCompare == desc.depthCompare) return;
+    const GLenum target = textureTarget(texture.layers);
+    GLState::bindTexture(0, target, texture.name);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(desc.filter));
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(desc.filter));
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, static_cast<GLint>(desc.wrap));
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, static_cast<GLint>(desc.wrap));
+    if (desc.wrap == GL_CLAMP_TO_BORDER) {
+        const float white[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, white);
+    }
+    if (isDepthFormat(texture.format)) {
+        glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, desc.depthCompare ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE);
+        glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    texture.filter = desc.filter;
+    texture.wrap = desc.wrap;
+    texture.depthCompare = desc.depthCompare;
+}
+
+void RenderGraph::execute() {
+    if (!m_compiled) return;
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+        const Pass& pass = m_passes[i];
+        if (!pass.alive) continue;
+
+        if (pass.barrier && glMemoryBarrier) glMemoryBarrier(pass.barrier);
+        GLsizei width = 0;
+        GLsizei height = 0;
+        for (const Use& use : pass.uses) {
+            if (use.resource == m_backbuffer) continue;
+            const ResourceNode& node = m_resources[use.resource];
+            // The target just took over its texture: give it its own sampling state
+            if (node.firstPass == static_cast<int>(i) && !node.imported) {
+                applySampling(m_textures[node.texture], node.desc);
+            }
+            if (use.access == Attachment) {
+                width = node.desc.width;
+                height = node.desc.height;
+            }
+        }
+        if (pass.writesBackbuffer) {
+            GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, m_backbufferWidth, m_backbufferHeight);
+        } else if (pass.framebuffer) {
+            GLState::bindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+            glViewport(0, 0, width, height);
+        }
+        if (pass.execute) pass.execute(*this);
+    }
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_backbufferWidth, m_backbufferHeight);
+}
+
+GLuint RenderGraph::texture(Resource resource) const {
+    if (resource < 0 || resource >= static_cast<Resource>(m_resources.size())) return 0;
+    const ResourceNode& node = m_resources[resource];
+    if (node.imported) return node.imported;
+    return node.texture >= 0 ? m_textures[node.texture].name : 0;
+}
+
+void RenderGraph::releaseFramebuffersOf(GLuint texture) {
+    // Framebuffers keep deleted textures alive while attached, so they go first
+    for (size_t f = 0; f < m_framebuffers.size();) {
+        const AttachmentSlot* attachments = m_framebuffers[f].attachments;
+        if (std::any_of(attachments, attachments + 5,
+                        [texture](const AttachmentSlot& attachment) { return attachment.texture == texture; })) {
+            GLState::deleteFramebuffers(1, &m_framebuffers[f].name);
+            m_framebuffers.erase(m_framebuffers.begin() + static_cast<std::ptrdiff_t>(f));
+        } else {
+            ++f;
+        }
+    }
+}
+
+void RenderGraph::forgetTexture(GLuint texture) {
+    if (texture) releaseFramebuffersOf(texture);
+}
+
+void RenderGraph::releaseIdle() {
+    for (size_t t = 0; t < m_textures.size();) {
+        PooledTexture& texture = m_textures[t];
+        const bool used = texture.usedThisFrame;
+        texture.usedThisFrame = false;
+        if (used || ++texture.idleFrames <= kIdleFramesBeforeRelease) {
+            ++t;
+            continue;
+        }
+        releaseFramebuffersOf(texture.name);
+        GLState::deleteTextures(1, &texture.name);
+        m_textures.erase(m_textures.begin() + static_cast<std::ptrdiff_t>(t));
+    }
+    for (size_t f = 0; f < m_framebuffers.size();) {
+        CachedFramebuffer& framebuffer = m_framebuffers[f];
+        const bool used = framebuffer.usedThisFrame;
+        framebuffer.usedThisFrame = false;
+        if (used || ++framebuffer.idleFrames <= kIdleFramesBeforeRelease) {
+            ++f;
+            continue;
+        }
+        GLState::deleteFramebuffers(1, &framebuffer.name);
+        m_framebuffers.erase(m_framebuffers.begin() + static_cast<std::ptrdiff_t>(f));
+    }
+}
+
+void RenderGraph::destroy() {
+    for (CachedFramebuffer& framebuffer : m_framebuffers) GLState::deleteFramebuffers(1, &framebuffer.name);
+    for (PooledTexture& texture : m_textures) GLState::deleteTextures(1, &texture.name);
+    m_framebuffers.clear();
+    m_textures.clear();
+    m_passes.clear();
+    m_resources.clear();
+    m_backbuffer = kNone;
+    m_compiled = false;
+}
+
+} // namespace gfx
@@ -0,0 +1,114 @@
+/// @file RenderQueue.cpp
+/// @brief Sort-key render queue implementation
+
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "ParallelFor.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace gfx {
+
+namespace {
+    constexpr int kDepthBits = 24;
+    constexpr int kMaterialBits = 20;
+    constexpr uint64_t kDepthMax = (1ull << kDepthBits) - 1;
+    constexpr uint64_t kMaterialMask = (1ull << kMaterialBits) - 1;
+    // Below this many items per buffer, recording is cheaper than waking a worker
+    constexpr size_t kItemsPerChunk = 32;
+
+    // FNV-1a over the material fields, so equal materials share their key bits
+    uint32_t materialHash(const FlockingShaders::MaterialBlock& material) {
+        unsigned char bytes[sizeof(material)];
+        std::memcpy(bytes, &material, sizeof(material));
+        uint32_t hash = 2166136261u;
+        for (unsigned char b : bytes) {
+            hash = (hash ^ b) * 16777619u;
+        }
+        return hash;
+    }
+
+    uint64_t makeKey(RenderQueue::Pass pass, GLuint program, uint32_t state, float depth, uint32_t material) {
+        const uint64_t quantized = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * kDepthMax);
+        return (static_cast<uint64_t>(pass & 0xf) << 60) |
+               (static_cast<uint64_t>(program & 0xfff) << 48) |
+               (static_cast<uint64_t>(state & 0xf) << 44) |
+               (quantized << kMaterialBits) |
+               (material & kMaterialMask);
+    }
+}
+
+void RenderQueue::begin(const glm::mat4& view, float farPlane) {
+    m_items.clear();
+    m_entries.clear();
+    m_view = view;
+    m_invFar = farPlane > 0.0f ? 1.0f / farPlane : 0.0f;
+}
+
+void RenderQueue::submit(Pass pass, ShaderLib::ProgramWrapper* program, const glm::vec3& worldCenter, DrawFn draw,
+                         GLenum polygonMode, UniformBlocks::FrameSlot frame) {
+    if (!program || !draw) return;
+    const FlockingShaders::DrawBlock& block = UniformBlocks::draw();
+    const float depth = -(m_view * glm::vec4(worldCenter, 1.0f)).z * m_invFar;
+    const uint32_t state = static_cast<uint32_t>(frame) << 1 | (polygonMode == GL_FILL ? 0u : 1u);
+    m_entries.push_back(SortEntry{makeKey(pass, program->getProgramId(), state, depth, materialHash(block.material)),
+                                  static_cast<uint32_t>(m_items.size())});
+    m_items.push_back(Item{program, polygonMode, frame, block, std::move(draw)});
+}
+
+void RenderQueue::record(size_t first, size_t last, CommandBuffer& out) const {
+    // Each buffer starts from unknown state; the replay-side caches drop repeats across buffers
+    const Item* previous = nullptr;
+    for (size_t i = first; i < last; ++i) {
+        const Item& item = m_items[m_entries[i].item];
+        if (!previous || item.program != previous->program) out.useProgram(item.program);
+        if (!previous || item.frame != previous->frame) out.bindFrame(item.frame);
+        if (!previous || item.polygonMode != previous->polygonMode) out.polygonMode(item.polygonMode);
+        out.writeDrawBlock(&item.block);
+        item.draw(out);
+        previous = &item;
+    }
+}
+
+void RenderQueue::execute() {
+    m_stats = Stats{};
+    m_stats.items = m_items.size();
+    if (m_items.empty()) return;
+    // Stable, so equal keys keep submission order
+    radixSortByKey(m_entries, m_scratch);
+
+    const Item* previous = nullptr;
+    for (const SortEntry& entry : m_entries) {
+        const Item& item = m_items[entry.item];
+        if (!previous || item.program != previous->program) ++m_stats.programChanges;
+        if (previous && item.frame != previous->frame) ++m_stats.stateChanges;
+        if (previous && item.polygonMode != previous->polygonMode) ++m_stats.stateChanges;
+        previous = &item;
+    }
+
+    // Contiguous runs of sorted items, one buffer each, so replaying them in order keeps the sort
+    const size_t count = m_entries.size();
+    const size_t chunks = std::min((count + kItemsPerChunk - 1) / kItemsPerChunk,
+                                   static_cast<size_t>(Parallel::workerCount() + 1));
+    if (m_buffers.size() < chunks) m_buffers.resize(chunks);
+    Parallel::forRange(static_cast<int>(chunks), 1, [&](int begin, int end) {
+        for (int c = begin; c < end; ++c) {
+            CommandBuffer& buffer = m_buffers[c];
+            buffer.clear();
+            record(count * c / chunks, count * (c + 1) / chunks, buffer);
+        }
+    });
+
+    for (size_t c = 0; c < chunks; ++c) {
+        m_buffers[c].replay();
+        m_stats.commandBytes += m_buffers[c].bytes();
+    }
+    m_stats.recordChunks = static_cast<int>(chunks);
+    GLState::polygonMode(GL_FILL);
+    UniformBlocks::bindFrame(UniformBlocks::SceneFrame);
+}
+
+} // namespace gfx
@@ -5,7 +5,9 @@
 #include "ShadowRenderer.h"
 
 #include <Camera.h>
+#include <GLState.h>
 #include <ShaderLib.h>
+#include <UniformBlocks.h>
 #include <TransformStack.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -14,208 +16,142 @@
 namespace Renderer {
 
 void initGL() {
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glDisable(GL_CULL_FACE);
+    GLState::setDepthTest(true);
+    GLState::depthFunc(GL_LESS);
+    GLState::setCullFace(false);
     glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
 }
 
 void setupLighting(Camera* camera, const gfx::RenderSettings& params) {
-    ShaderLib* shader = ShaderLib::instance();
+    using FlockingShaders::FRAME_EXTRA_LIGHTS;
+    using FlockingShaders::FRAME_SHADOW_LIGHTS;
+    using FlockingShaders::FRAME_SHADOW_LAYERS;
+    using FlockingShaders::FRAME_CASCADES;
+    static_assert(FRAME_SHADOW_LIGHTS == Shadow::MAX_SHADOW_LIGHTS, "frame block shadow slots");
+    static_assert(FRAME_SHADOW_LAYERS == Shadow::MAX_SHADOW_LAYERS, "frame block shadow layers");
+    static_assert(FRAME_CASCADES == Shadow::MAX_CASCADES, "frame block cascade splits");
+
     glm::vec3 lightWorldPos(params.lightPosition[0],
                             params.lightPosition[1],
                             params.lightPosition[2]);
-    glm::vec4 lightViewPos = camera->getViewMatrix() * glm::vec4(lightWorldPos, 1.0f);
-    glm::vec3 camPos = camera->getEye();
-    
-    // Setup for Phong shader (must already be bound via use())
-    ShaderLib::ProgramWrapper* phong = (*shader)["Phong"];
-    if (phong) {
-        phong->use();  // Ensure shader is active before setting uniforms
-        phong->setUniform("light.position", lightViewPos);
-        phong->setUniform("light.ambient", glm::vec4(params.lightAmbient[0], params.lightAmbient[1], params.lightAmbient[2], 1.0f));
-        phong->setUniform("light.diffuse", glm::vec4(params.lightDiffuse[0], params.lightDiffuse[1], params.lightDiffuse[2], 1.0f));
-        phong->setUniform("light.specular", glm::vec4(params.lightSpecular[0], params.lightSpecular[1], params.lightSpecular[2], 1.0f));
-        phong->setUniform("light.constantAttenuation", 1.0f);
-        phong->setUniform("light.linearAttenuation", 0.0f);
-        phong->setUniform("light.quadraticAttenuation", 0.0f);
-        phong->setUniform("viewerPos", camPos);
-        phong->setUniform("Normalize", true);
-        
-        // Shadow uniforms
-        GLuint programId = phong->getProgramId();
-        struct ShadowUniformCache {
-            GLuint programId = 0;
-            bool initialized = false;
-            GLint shadowEnabled = -1;
-            GLint shadowBias = -1;
-            GLint shadowSoftness = -1;
-            GLint shadowMapSize = -1;
-            GLint shadowStrength = -1;
-            GLint lightSpaceMatrix = -1;
-            GLint shadowMap = -1;
-            GLint numShadowLights = -1;
-            GLint lightIntensities[Shadow::MAX_SHADOW_LIGHTS] = {-1, -1, -1, -1};
-            GLint lightSpaceMatrices[Shadow::MAX_SHADOW_LIGHTS] = {-1, -1, -1, -1};
-            GLint shadowMaps[Shadow::MAX_SHADOW_LIGHTS] = {-1, -1, -1, -1};
-        };
-        static ShadowUniformCache cache;
-        if (!cache.initialized || cache.programId != programId) {
-            cache.programId = programId;
-            cache.shadowEnabled = glGetUniformLocation(programId, "shadowEnabled");
-            cache.shadowBias = glGetUniformLocation(programId, "shadowBias");
-            cache.shadowSoftness = glGetUniformLocation(programId, "shadowSoftness");
-            cache.shadowMapSize = glGetUniformLocation(programId, "shadowMapSize");
-            cache.shadowStrength = glGetUniformLocation(programId, "shadowStrength");
-            cache.lightSpaceMatrix = glGetUniformLocation(programId, "lightSpaceMatrix");
-            cache.shadowMap = glGetUniformLocation(programId, "shadowMap");
-            cache.numShadowLights = glGetUniformLocation(programId, "numShadowLights");
-            for (int i = 0; i < Shadow::MAX_SHADOW_LIGHTS; ++i) {
-                std::string idx = std::to_string(i);
-                cache.lightIntensities[i] = glGetUniformLocation(programId, ("lightIntensities[" + idx + "]").c_str());
-                cache.lightSpaceMatrices[i] = glGetUniformLocation(programId, ("lightSpaceMatrices[" + idx + "]").c_str());
-                cache.shadowMaps[i] = glGetUniformLocation(programId, ("shadowMaps[" + idx + "]").c_str());
-            }
-            cache.initialized = true;
-        }
+    const glm::mat4 view = camera->getViewMatrix();
+    const glm::vec3 camPos = camera->getEye();
 
-        if (cache.shadowEnabled != -1) glUniform1i(cache.shadowEnabled, Shadow::isEnabled() ? 1 : 0);
-        if (cache.shadowBias != -1) glUniform1f(cache.shadowBias, params.shadowBias);
-        if (cache.shadowSoftness != -1) glUniform1f(cache.shadowSoftness, params.shadowSoftness);
-        if (cache.shadowMapSize != -1) glUniform1f(cache.shadowMapSize, static_cast<float>(Shadow::getMapSize()));
-        if (cache.shadowStrength != -1) glUniform1f(cache.shadowStrength, 1.5f);
-        if (cache.lightSpaceMatrix != -1) {
-            glUniformMatrix4fv(cache.lightSpaceMatrix, 1, GL_FALSE,
-                               glm::value_ptr(Shadow::getLightSpaceMatrix(0)));
-        }
-        
-        // Bind shadow map to texture unit 5 (legacy single shadow)
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, Shadow::getShadowMapTexture(0));
-        if (cache.shadowMap != -1) glUniform1i(cache.shadowMap, 5);
-        
-        // Multi-shadow support: count shadow-casting lights and pass intensities
-        float lightIntensities[Shadow::MAX_SHADOW_LIGHTS] = {1.0f, 1.0f, 1.0f, 1.0f};
-        int numShadowLights = 1;  // Main light always counts
-        lightIntensities[0] = 1.0f;  // Main light intensity
-        
-        for (size_t i = 0; i < params.lights.size() && numShadowLights < Shadow::MAX_SHADOW_LIGHTS; ++i) {
-            if (params.lights[i].enabled && params.lights[i].castsShadow) {
-                lightIntensities[numShadowLights] = params.lights[i].intensity;
-                numShadowLights++;
-            }
-        }
-        if (cache.numShadowLights != -1) glUniform1i(cache.numShadowLights, numShadowLights);
-        
-        // Pass light intensities and bind all shadow maps
-        const int SHADOW_TEX_START = 5;
-        for (int s = 0; s < Shadow::MAX_SHADOW_LIGHTS; ++s) {
-            if (cache.lightIntensities[s] != -1) glUniform1f(cache.lightIntensities[s], lightIntensities[s]);
-            if (cache.lightSpaceMatrices[s] != -1) {
-                glUniformMatrix4fv(cache.lightSpaceMatrices[s], 1, GL_FALSE,
-                                   glm::value_ptr(Shadow::getLightSpaceMatrix(s)));
-            }
-
-            glActiveTexture(GL_TEXTURE0 + SHADOW_TEX_START + s);
-            glBindTexture(GL_TEXTURE_2D, Shadow::getShadowMapTexture(s));
-            if (cache.shadowMaps[s] != -1) glUniform1i(cache.shadowMaps[s], SHADOW_TEX_START + s);
+    FlockingShaders::FrameBlock& frame = UniformBlocks::frame();
+    frame.camera.position = camPos;
+    frame.camera.nearPlane = camera->getNear();
+    frame.camera.direction = glm::normalize(camera->getLook() - camPos);
+    frame.camera.farPlane = camera->getFar();
+    frame.camera.viewMatrix = view;
+    frame.camera.projMatrix = camera->getProjectionMatrix();
+
+    frame.light.position = view * glm::vec4(lightWorldPos, 1.0f);
+    frame.light.ambient = glm::vec4(params.lightAmbient[0], params.lightAmbient[1], params.lightAmbient[2], 1.0f);
+    frame.light.diffuse = glm::vec4(params.lightDiffuse[0], params.lightDiffuse[1], params.lightDiffuse[2], 1.0f);
+    frame.light.specular = glm::vec4(params.lightSpecular[0], params.lightSpecular[1], params.lightSpecular[2], 1.0f);
+    frame.light.constantAttenuation = 1.0f;
+    frame.light.linearAttenuation = 0.0f;
+    frame.light.quadraticAttenuation = 0.0f;
+    frame.light.spotCosCutoff = 0.0f;
+    frame.lightWorldPos = glm::vec4(lightWorldPos, 1.0f);
+
+    // Shadows: the main light always counts, then shadow-casting extra lights
+    float lightIntensities[FRAME_SHADOW_LIGHTS] = {1.0f, 1.0f, 1.0f, 1.0f};
+    int numShadowLights = 1;
+    for (size_t i = 0; i < params.lights.size() && numShadowLights < FRAME_SHADOW_LIGHTS; ++i) {
+        if (params.lights[i].enabled && params.lights[i].castsShadow) {
+            lightIntensities[numShadowLights] = params.lights[i].intensity;
+            numShadowLights++;
         }
     }
+    // Array layers: the main light's cascades, then the extra shadow lights
+    for (int s = 0; s < FRAME_SHADOW_LAYERS; ++s) {
+        frame.lightSpaceMatrices[s] = Shadow::getLightSpaceMatrix(s);
+    }
+    for (int c = 0; c < FRAME_CASCADES; ++c) {
+        frame.cascadeSplits[c] = Shadow::getCascadeSplit(c);
+    }
+    frame.shadowLayout = glm::ivec4(Shadow::activeCascades(), 0, 0, 0);
+    frame.lightIntensities = glm::vec4(lightIntensities[0], lightIntensities[1],
+                                       lightIntensities[2], lightIntensities[3]);
+    frame.shadowParams = glm::vec4(params.shadowBias, params.shadowSoftness,
+                                   static_cast<float>(Shadow::getMapSize()), 1.5f);
 
-    // Extra light array (Phong shader has these uniforms; others will ignore)
-    {
-        const int MAX_LIGHTS = 8;
-        int numLights = static_cast<int>(std::min<size_t>(params.lights.size(), MAX_LIGHTS));
-        glm::vec3 positions[MAX_LIGHTS]{};
-        glm::vec3 colors[MAX_LIGHTS]{};
-        float intensities[MAX_LIGHTS]{};
-        for (int i = 0; i < numLights; ++i) {
-            positions[i] = glm::vec3(params.lights[i].position[0],
-                                     params.lights[i].position[1],
-                                     params.lights[i].position[2]);
-            colors[i] = glm::vec3(params.lights[i].diffuse[0],
-                                  params.lights[i].diffuse[1],
-                                  params.lights[i].diffuse[2]);
-            intensities[i] = params.lights[i].intensity;
+    // Extra light array (no shadows): the first few, for shaders built without SSBOs; the
+    // rest of the pipeline reads every light from LightClusters
+    const int numLights = static_cast<int>(std::min<size_t>(params.lights.size(), FRAME_EXTRA_LIGHTS));
+    for (int i = 0; i < FRAME_EXTRA_LIGHTS; ++i) {
+        if (i < numLights) {
+            const auto& light = params.lights[i];
+            frame.extraLightPositions[i] = glm::vec4(light.position[0], light.position[1], light.position[2], light.range);
+            frame.extraLightColors[i] = glm::vec4(light.diffuse[0], light.diffuse[1], light.diffuse[2], light.intensity);
+        } else {
+            frame.extraLightPositions[i] = glm::vec4(0.0f);
+            frame.extraLightColors[i] = glm::vec4(0.0f);
         }
-
-        GLint numLoc = glGetUniformLocation(phong->getProgramId(), "numLights");
-        GLint posLoc = glGetUniformLocation(phong->getProgramId(), "lightPositions");
-        GLint colLoc = glGetUniformLocation(phong->getProgramId(), "lightColors");
-        GLint intenLoc = glGetUniformLocation(phong->getProgramId(), "lightIntensitiesExtra");
-        if (numLoc >= 0) glUniform1i(numLoc, numLights);
-        if (posLoc >= 0 && numLights > 0) glUniform3fv(posLoc, numLights, glm::value_ptr(positions[0]));
-        if (colLoc >= 0 && numLights > 0) glUniform3fv(colLoc, numLights, glm::value_ptr(colors[0]));
-        if (intenLoc >= 0 && numLights > 0) glUniform1fv(intenLoc, numLights, intensities);
     }
+    frame.lightCounts = glm::ivec4(Shadow::isEnabled() ? 1 : 0, numShadowLights, numLights,
+                                   Shadow::getDynamicMapArray() != 0 ? 1 : 0);
+
+    // Surface pattern and fabric shading
+    frame.checkerColor1 = glm::vec4(params.checkerColor1[0], params.checkerColor1[1], params.checkerColor1[2],
+                                    params.useCheckerPattern ? params.checkerScale : 0.0f);
+    frame.checkerColor2 = glm::vec4(params.checkerColor2[0], params.checkerColor2[1], params.checkerColor2[2], 0.0f);
+    frame.fabricParams = glm::vec4(params.pbrRoughness, params.pbrMetallic, params.pbrAnisotropy, params.sheenIntensity);
+    frame.fabricParams2 = glm::vec4(params.anisotropyU, params.anisotropyV, params.weaveScale,
+                                    static_cast<float>(glfwGetTime()));
+    frame.sheenColor = glm::vec4(params.sheenColor[0], params.sheenColor[1], params.sheenColor[2],
+                                 params.subsurfaceAmount);
+
+    // Light gizmos: overpowered white light so the markers stay visible, unshadowed
+    FlockingShaders::FrameBlock& gizmo = UniformBlocks::frame(UniformBlocks::GizmoFrame);
+    gizmo = frame;
+    gizmo.light.ambient = gizmo.light.diffuse = gizmo.light.specular = glm::vec4(6.0f, 6.0f, 6.0f, 1.0f);
+    gizmo.lightCounts.x = 0;
+
+    UniformBlocks::uploadFrame();
+
+    // Shadow maps: one depth array at unit 5, a layer per shadow light (layer 0 doubles
+    // as the legacy single map). With the static/dynamic split the per-frame casters sit
+    // in a second array at unit 6.
+    const int SHADOW_TEX_UNIT = 5;
+    const int DYNAMIC_SHADOW_TEX_UNIT = 6;
+    GLState::bindTexture(SHADOW_TEX_UNIT, GL_TEXTURE_2D_ARRAY, Shadow::getShadowMapArray());
+    GLState::bindTexture(DYNAMIC_SHADOW_TEX_UNIT, GL_TEXTURE_2D_ARRAY, Shadow::getDynamicMapArray());
 }
 
 void loadMatricesToShader(const TransformStack& stack, Camera* camera) {
-    ShaderLib* shader = ShaderLib::instance();
-    glm::mat4 M = stack.getCurrentTransform();
-    glm::mat4 V = camera->getViewMatrix();
-    glm::mat4 P = camera->getProjectionMatrix();
-    glm::mat4 MV = V * M;
-    glm::mat4 MVP = P * MV;
-    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
-    
-    auto wrapper = (*shader)["Phong"];
-    wrapper->setUniform("MVP", MVP);
-    wrapper->setUniform("MV", MV);
-    wrapper->setUniform("M", M);
-    wrapper->setUniform("normalMatrix", normalMatrix);
+    UniformBlocks::setTransforms(stack.getCurrentTransform(), camera->getViewMatrix(),
+                                 camera->getProjectionMatrix());
+    UniformBlocks::commitDraw();
 }
 
-void loadMatricesToShader(const std::string& shaderName, const TransformStack& stack, Camera* camera) {
-    ShaderLib* shader = ShaderLib::instance();
-    glm::mat4 M = stack.getCurrentTransform();
-    glm::mat4 V = camera->getViewMatrix();
-    glm::mat4 P = camera->getProjectionMatrix();
-    glm::mat4 MV = V * M;
-    glm::mat4 MVP = P * MV;
-    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
-    
-    auto wrapper = (*shader)[shaderName];
-    if (wrapper) {
-        wrapper->setUniform("MVP", MVP);
-        wrapper->setUniform("MV", MV);
-        wrapper->setUniform("M", M);
-        wrapper->setUniform("normalMatrix", normalMatrix);
-    }
+void loadMatricesToShader(const std::string& /*shaderName*/, const TransformStack& stack, Camera* camera) {
+    loadMatricesToShader(stack, camera);
 }
 
-void renderFloorAndSphere(Floor* floor, SphereObstacle* sphere,
+void submitFloorAndSphere(gfx::RenderQueue& queue, Floor* floor, SphereObstacle* sphere,
                           Camera* camera, TransformStack& transformStack,
                           const gfx::RenderSettings& params) {
-    ShaderLib* shader = ShaderLib::instance();
-    ShaderLib::ProgramWrapper* phong = (*shader)["Phong"];
-    if (!phong) return;
-    phong->use();
     transformStack.setGlobal(glm::mat4(1.0f));
+    // Unpacked vertices, Normalize on; floor and sphere stage their own material
+    FlockingShaders::DrawBlock& draw = UniformBlocks::draw();
+    draw.posDequantScale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    draw.posDequantBias = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
     
-    setupLighting(camera, params);
-    
-    // Render floor
     if (params.floorVisibility && floor) {
-        transformStack.pushTransform();
-        loadMatricesToShader(transformStack, camera);
-        floor->draw("Phong", transformStack, camera);
-        transformStack.popTransform();
+        floor->submit(queue, "Phong", transformStack, camera);
     }
     
-    // Render sphere
     if (params.sphereVisibility && sphere) {
-        transformStack.pushTransform();
-        loadMatricesToShader(transformStack, camera);
-        sphere->draw("Phong", transformStack, camera);
-        transformStack.popTransform();
+        sphere->submit(queue, "Phong", transformStack, camera);
     }
 }
 
 void cleanup(ClothRenderData& renderData) {
     if (renderData.VAO != 0) {
-        glDeleteVertexArrays(1, &renderData.VAO);
-        glDeleteBuffers(1, &renderData.VBO);
+        GLState::deleteVertexArrays(1, &renderData.VAO);
+        GLState::deleteBuffers(1, &renderData.VBO);
         renderData.VAO = 0;
         renderData.VBO = 0;
     }
@@ -3,6 +3,7 @@
 
 #include "SSAORenderer.h"
 #include "ShaderPathResolver.h"
+#include "GLState.h"
 #include <glad/gl.h>
 #include <Camera.h>
 #include <glm/gtc/matrix_transform.hpp>
@@ -31,17 +32,6 @@ namespace {
     GLuint s_blurProgram = 0;
     GLuint s_compositeProgram = 0;
     
-    // Framebuffers
-    GLuint s_sceneFBO = 0;
-    GLuint s_sceneColorTex = 0;
-    GLuint s_sceneDepthTex = 0;
-    
-    GLuint s_ssaoFBO = 0;
-    GLuint s_ssaoColorTex = 0;
-    
-    GLuint s_ssaoBlurFBO = 0;
-    GLuint s_ssaoBlurTex = 0;
-    
     // Noise texture for random rotation
     GLuint s_noiseTex = 0;
     
@@ -153,7 +143,7 @@ namespace {
         }
         
         glGenTextures(1, &s_noiseTex);
-        glBindTexture(GL_TEXTURE_2D, s_noiseTex);
+        GLState::bindTexture(0, GL_TEXTURE_2D, s_noiseTex);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 4, 4, 0, GL_RGB, GL_FLOAT, noise.data());
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -175,8 +165,8 @@ namespace {
         
         glGenVertexArrays(1, &s_quadVAO);
         glGenBuffers(1, &s_quadVBO);
-        glBindVertexArray(s_quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, s_quadVBO);
+        GLState::bindVertexArray(s_quadVAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, s_quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
         
         glEnableVertexAttribArray(0);
@@ -184,73 +174,12 @@ namespace {
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
         
-        glBindVertexArray(0);
-    }
-    
-    void createFramebuffers(int width, int height) {
-        // Scene FBO with color and depth
-        glGenFramebuffers(1, &s_sceneFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, s_sceneFBO);
-        
-        // Color texture
-        glGenTextures(1, &s_sceneColorTex);
-        glBindTexture(GL_TEXTURE_2D, s_sceneColorTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s_sceneColorTex, 0);
-        
-        // Depth texture (for SSAO sampling)
-        glGenTextures(1, &s_sceneDepthTex);
-        glBindTexture(GL_TEXTURE_2D, s_sceneDepthTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, s_sceneDepthTex, 0);
-        
-        // SSAO FBO (single channel)
-        glGenFramebuffers(1, &s_ssaoFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, s_ssaoFBO);
-        
-        glGenTextures(1, &s_ssaoColorTex);
-        glBindTexture(GL_TEXTURE_2D, s_ssaoColorTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s_ssaoColorTex, 0);
-        
-        // SSAO Blur FBO
-        glGenFramebuffers(1, &s_ssaoBlurFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, s_ssaoBlurFBO);
-        
-        glGenTextures(1, &s_ssaoBlurTex);
-        glBindTexture(GL_TEXTURE_2D, s_ssaoBlurTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s_ssaoBlurTex, 0);
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    }
-    
-    void deleteFramebuffers() {
-        if (s_sceneFBO) { glDeleteFramebuffers(1, &s_sceneFBO); s_sceneFBO = 0; }
-        if (s_sceneColorTex) { glDeleteTextures(1, &s_sceneColorTex); s_sceneColorTex = 0; }
-        if (s_sceneDepthTex) { glDeleteTextures(1, &s_sceneDepthTex); s_sceneDepthTex = 0; }
-        if (s_ssaoFBO) { glDeleteFramebuffers(1, &s_ssaoFBO); s_ssaoFBO = 0; }
-        if (s_ssaoColorTex) { glDeleteTextures(1, &s_ssaoColorTex); s_ssaoColorTex = 0; }
-        if (s_ssaoBlurFBO) { glDeleteFramebuffers(1, &s_ssaoBlurFBO); s_ssaoBlurFBO = 0; }
-        if (s_ssaoBlurTex) { glDeleteTextures(1, &s_ssaoBlurTex); s_ssaoBlurTex = 0; }
+        GLState::bindVertexArray(0);
     }
     
     void renderQuad() {
-        glBindVertexArray(s_quadVAO);
+        GLState::bindVertexArray(s_quadVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
     }
 }
 
@@ -274,141 +203,142 @@ bool init(int width, int height) {
     generateKernel();
     generateNoiseTexture();
     createQuad();
-    createFramebuffers(width, height);
     
     s_initialized = true;
     return true;
 }
 
 void cleanup() {
-    deleteFramebuffers();
-    
     if (s_ssaoProgram) { glDeleteProgram(s_ssaoProgram); s_ssaoProgram = 0; }
     if (s_blurProgram) { glDeleteProgram(s_blurProgram); s_blurProgram = 0; }
     if (s_compositeProgram) { glDeleteProgram(s_compositeProgram); s_compositeProgram = 0; }
-    if (s_noiseTex) { glDeleteTextures(1, &s_noiseTex); s_noiseTex = 0; }
-    if (s_quadVAO) { glDeleteVertexArrays(1, &s_quadVAO); s_quadVAO = 0; }
-    if (s_quadVBO) { glDeleteBuffers(1, &s_quadVBO); s_quadVBO = 0; }
+    if (s_noiseTex) { GLState::deleteTextures(1, &s_noiseTex); s_noiseTex = 0; }
+    if (s_quadVAO) { GLState::deleteVertexArrays(1, &s_quadVAO); s_quadVAO = 0; }
+    if (s_quadVBO) { GLState::deleteBuffers(1, &s_quadVBO); s_quadVBO = 0; }
     
     s_kernel.clear();
     s_initialized = false;
 }
 
 void resize(int width, int height) {
-    if (width == s_width && height == s_height) return;
-    
+    // Targets are render graph transients sized from these each frame
     s_width = width;
     s_height = height;
-    
-    deleteFramebuffers();
-    createFramebuffers(width, height);
 }
 
-void beginScenePass() {
-    if (!s_initialized || !s_enabled) {
-        // When disabled, render directly to default framebuffer
-        return;
-    }
-    
-    // Bind scene FBO - scene will be rendered here
-    glBindFramebuffer(GL_FRAMEBUFFER, s_sceneFBO);
+gfx::TextureDesc sceneColorDesc() {
+    gfx::TextureDesc desc;
+    desc.width = s_width;
+    desc.height = s_height;
+    desc.format = GL_RGB16F;
+    desc.filter = GL_LINEAR;
+    return desc;
 }
 
-void endScenePass() {
-    if (!s_initialized || !s_enabled) {
-        // Nothing to do when disabled
-        return;
-    }
-    
-    // Unbind scene FBO, SSAO passes will happen in renderComposite
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+gfx::TextureDesc sceneDepthDesc() {
+    gfx::TextureDesc desc;
+    desc.width = s_width;
+    desc.height = s_height;
+    desc.format = GL_DEPTH_COMPONENT32F;
+    return desc;
 }
 
-void renderComposite(Camera* camera) {
+void addPasses(gfx::RenderGraph& graph, Camera* camera, gfx::RenderGraph::Resource sceneColor,
+               gfx::RenderGraph::Resource sceneDepth, gfx::RenderGraph::Resource output) {
     if (!s_initialized) return;
     
-    if (!s_enabled) {
-        // SSAO disabled - just blit scene to screen
-        return;
-    }
-    
-    glm::mat4 proj = camera->getProjectionMatrix();
-    glm::mat4 invProj = glm::inverse(proj);
-    
-    // Disable depth test for fullscreen passes
-    glDisable(GL_DEPTH_TEST);
+    gfx::TextureDesc occlusionDesc;
+    occlusionDesc.width = s_width;
+    occlusionDesc.height = s_height;
+    occlusionDesc.format = GL_R8;
     
     // Pass 1: SSAO calculation
-    glBindFramebuffer(GL_FRAMEBUFFER, s_ssaoFBO);
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    if (s_ssaoProgram) {
-        glUseProgram(s_ssaoProgram);
-        
-        // Bind depth texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, s_sceneDepthTex);
-        glUniform1i(glGetUniformLocation(s_ssaoProgram, "depthTexture"), 0);
-        
-        // Bind noise texture
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, s_noiseTex);
-        glUniform1i(glGetUniformLocation(s_ssaoProgram, "noiseTexture"), 1);
-        
-        // Upload kernel samples
-        for (int i = 0; i < 64 && i < (int)s_kernel.size(); ++i) {
-            char name[32];
-            snprintf(name, sizeof(name), "samples[%d]", i);
-            glUniform3fv(glGetUniformLocation(s_ssaoProgram, name), 1, glm::value_ptr(s_kernel[i]));
-        }
-        
-        glUniformMatrix4fv(glGetUniformLocation(s_ssaoProgram, "projection"), 1, GL_FALSE, glm::value_ptr(proj));
-        glUniformMatrix4fv(glGetUniformLocation(s_ssaoProgram, "invProjection"), 1, GL_FALSE, glm::value_ptr(invProj));
-        glUniform2f(glGetUniformLocation(s_ssaoProgram, "screenSize"), (float)s_width, (float)s_height);
-        glUniform1f(glGetUniformLocation(s_ssaoProgram, "radius"), s_radius);
-        glUniform1f(glGetUniformLocation(s_ssaoProgram, "bias"), s_bias);
-        glUniform1f(glGetUniformLocation(s_ssaoProgram, "intensity"), s_intensity);
-        
-        renderQuad();
-    }
+    const gfx::RenderGraph::Resource occlusion = graph.createTexture("ssao", occlusionDesc);
+    graph.addPass("ssao",
+        [&](gfx::RenderGraph::Builder& builder) {
+            builder.read(sceneDepth);
+            builder.write(occlusion);
+        },
+        [camera, sceneDepth](const gfx::RenderGraph& g) {
+            glm::mat4 proj = camera->getProjectionMatrix();
+            glm::mat4 invProj = glm::inverse(proj);
+            
+            // Disable depth test for fullscreen passes
+            GLState::setDepthTest(false);
+            glClear(GL_COLOR_BUFFER_BIT);
+            GLState::useProgram(s_ssaoProgram);
+            
+            // Bind depth texture
+            GLState::bindTexture(0, GL_TEXTURE_2D, g.texture(sceneDepth));
+            glUniform1i(glGetUniformLocation(s_ssaoProgram, "depthTexture"), 0);
+            
+            // Bind noise texture
+            GLState::bindTexture(1, GL_TEXTURE_2D, s_noiseTex);
+            glUniform1i(glGetUniformLocation(s_ssaoProgram, "noiseTexture"), 1);
+            
+            // Upload kernel samples
+            for (int i = 0; i < 64 && i < (int)s_kernel.size(); ++i) {
+                char name[32];
+                snprintf(name, sizeof(name), "samples[%d]", i);
+                glUniform3fv(glGetUniformLocation(s_ssaoProgram, name), 1, glm::value_ptr(s_kernel[i]));
+            }
+            
+            glUniformMatrix4fv(glGetUniformLocation(s_ssaoProgram, "projection"), 1, GL_FALSE, glm::value_ptr(proj));
+            glUniformMatrix4fv(glGetUniformLocation(s_ssaoProgram, "invProjection"), 1, GL_FALSE, glm::value_ptr(invProj));
+            glUniform2f(glGetUniformLocation(s_ssaoProgram, "screenSize"), (float)s_width, (float)s_height);
+            glUniform1f(glGetUniformLocation(s_ssaoProgram, "radius"), s_radius);
+            glUniform1f(glGetUniformLocation(s_ssaoProgram, "bias"), s_bias);
+            glUniform1f(glGetUniformLocation(s_ssaoProgram, "intensity"), s_intensity);
+            
+            renderQuad();
+        });
     
     // Pass 2: Blur SSAO
-    glBindFramebuffer(GL_FRAMEBUFFER, s_ssaoBlurFBO);
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    if (s_blurProgram) {
-        glUseProgram(s_blurProgram);
-        
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, s_ssaoColorTex);
-        glUniform1i(glGetUniformLocation(s_blurProgram, "ssaoTexture"), 0);
-        glUniform2f(glGetUniformLocation(s_blurProgram, "texelSize"), 1.0f / s_width, 1.0f / s_height);
-        
-        renderQuad();
-    }
-    
-    // Pass 3: Composite scene with SSAO
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    if (s_compositeProgram) {
-        glUseProgram(s_compositeProgram);
-        
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, s_sceneColorTex);
-        glUniform1i(glGetUniformLocation(s_compositeProgram, "sceneTexture"), 0);
-        
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, s_ssaoBlurTex);
-        glUniform1i(glGetUniformLocation(s_compositeProgram, "ssaoTexture"), 1);
-        
-        glUniform1f(glGetUniformLocation(s_compositeProgram, "ssaoStrength"), s_intensity > 0.0f ? 1.0f : 0.0f);
-        
-        renderQuad();
-    }
-    
-    // Re-enable depth test for next frame
-    glEnable(GL_DEPTH_TEST);
+    const gfx::RenderGraph::Resource blurred = graph.createTexture("ssao blurred", occlusionDesc);
+    graph.addPass("ssao blur",
+        [&](gfx::RenderGraph::Builder& builder) {
+            builder.read(occlusion);
+            builder.write(blurred);
+        },
+        [occlusion](const gfx::RenderGraph& g) {
+            GLState::setDepthTest(false);
+            glClear(GL_COLOR_BUFFER_BIT);
+            GLState::useProgram(s_blurProgram);
+            
+            GLState::bindTexture(0, GL_TEXTURE_2D, g.texture(occlusion));
+            glUniform1i(glGetUniformLocation(s_blurProgram, "ssaoTexture"), 0);
+            glUniform2f(glGetUniformLocation(s_blurProgram, "texelSize"), 1.0f / s_width, 1.0f / s_height);
+            
+            renderQuad();
+        });
+    
+    // Pass 3: Composite scene with SSAO. At zero intensity the occlusion is not read,
+    // so the two passes above are culled.
+    const bool applyOcclusion = s_intensity > 0.0f;
+    graph.addPass("ssao composite",
+        [&](gfx::RenderGraph::Builder& builder) {
+            builder.read(sceneColor);
+            if (applyOcclusion) builder.read(blurred);
+            builder.write(output);
+        },
+        [sceneColor, blurred, applyOcclusion](const gfx::RenderGraph& g) {
+            GLState::setDepthTest(false);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            GLState::useProgram(s_compositeProgram);
+            
+            GLState::bindTexture(0, GL_TEXTURE_2D, g.texture(sceneColor));
+            glUniform1i(glGetUniformLocation(s_compositeProgram, "sceneTexture"), 0);
+            
+            GLState::bindTexture(1, GL_TEXTURE_2D, applyOcclusion ? g.texture(blurred) : 0);
+            glUniform1i(glGetUniformLocation(s_compositeProgram, "ssaoTexture"), 1);
+            
+            glUniform1f(glGetUniformLocation(s_compositeProgram, "ssaoStrength"), applyOcclusion ? 1.0f : 0.0f);
+            
+            renderQuad();
+            
+            // Re-enable depth test for next frame
+            GLState::setDepthTest(true);
+        });
 }
 
 void setRadius(float radius) { s_radius = radius; }
@@ -416,7 +346,7 @@ void setBias(float bias) { s_bias = bias; }
 void setIntensity(float intensity) { s_intensity = intensity; }
 void setEnabled(bool enabled) { s_enabled = enabled; }
 
-bool isEnabled() { return s_enabled; }
+bool isEnabled() { return s_enabled && s_initialized; }
 float getRadius() { return s_radius; }
 float getBias() { return s_bias; }
 float getIntensity() { return s_intensity; }
@@ -5,6 +5,9 @@
 
 #include <glad/gl.h>
 #include "ShaderLib.h"
+#include "GLState.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -32,6 +35,42 @@ static std::string getExecutableDir() {
 // Static singleton instance pointer
 ShaderLib* ShaderLib::s_instance = nullptr;
 
+namespace {
+ShaderLib::UniformStats s_uniformStats;
+
+size_t kindFloats(ShaderLib::UniformKind kind) {
+    switch (kind) {
+        case ShaderLib::UniformKind::Vec2: return 2;
+        case ShaderLib::UniformKind::Vec3: return 3;
+        case ShaderLib::UniformKind::Vec4: return 4;
+        case ShaderLib::UniformKind::Mat3: return 9;
+        case ShaderLib::UniformKind::Mat4: return 16;
+        default: return 1;
+    }
+}
+
+ShaderLib::UniformKind kindOf(GLenum type) {
+    switch (type) {
+        case GL_FLOAT: return ShaderLib::UniformKind::Float;
+        case GL_FLOAT_VEC2: return ShaderLib::UniformKind::Vec2;
+        case GL_FLOAT_VEC3: return ShaderLib::UniformKind::Vec3;
+        case GL_FLOAT_VEC4: return ShaderLib::UniformKind::Vec4;
+        case GL_FLOAT_MAT3: return ShaderLib::UniformKind::Mat3;
+        case GL_FLOAT_MAT4: return ShaderLib::UniformKind::Mat4;
+        case GL_UNSIGNED_INT: return ShaderLib::UniformKind::UInt;
+        default: return ShaderLib::UniformKind::Int;  // int, bool, samplers
+    }
+}
+} // namespace
+
+const ShaderLib::UniformStats& ShaderLib::uniformStats() {
+    return s_uniformStats;
+}
+
+void ShaderLib::resetUniformStats() {
+    s_uniformStats = UniformStats{};
+}
+
 ShaderLib* ShaderLib::instance() {
     if (!s_instance) {
         s_instance = new ShaderLib();
@@ -75,6 +114,31 @@ void ShaderLib::loadShaderSource(const std::string& name, const std::string& fil
     }
 }
 
+void ShaderLib::loadShaderSource(const std::string& name, const std::string& filename, const std::string& defines) {
+    std::string source;
+    if (loadShaderFromFile(filename, source)) {
+        m_shaderSources[name] = injectDefines(source, defines);
+    } else {
+        std::cerr << "Failed to load shader source: " << filename << std::endl;
+    }
+}
+
+std::string ShaderLib::injectDefines(const std::string& source, const std::string& defines) {
+    if (defines.empty()) return source;
+    std::string patched = source;
+    size_t pos = patched.find("#version");
+    if (pos == std::string::npos) {
+        return defines + patched;
+    }
+    size_t lineEnd = patched.find('\n', pos);
+    if (lineEnd == std::string::npos) {
+        patched += '\n';
+        lineEnd = patched.size() - 1;
+    }
+    patched.insert(lineEnd + 1, defines);
+    return patched;
+}
+
 void ShaderLib::compileShader(const std::string& name) {
     auto shaderIt = m_shaders.find(name);
     auto sourceIt = m_shaderSources.find(name);
@@ -123,6 +187,9 @@ void ShaderLib::linkProgramObject(const std::string& name) {
         glLinkProgram(programIt->second);
         if (!checkProgramLinking(programIt->second, name)) {
             std::cerr << "Failed to link program: " << name << std::endl;
+        } else {
+            auto wrapperIt = m_wrappers.find(name);
+            if (wrapperIt != m_wrappers.end()) wrapperIt->second->reflect();
         }
     } else {
         std::cerr << "Shader program not found: " << name << std::endl;
@@ -132,7 +199,7 @@ void ShaderLib::linkProgramObject(const std::string& name) {
 void ShaderLib::use(const std::string& name) {
     auto programIt = m_programs.find(name);
     if (programIt != m_programs.end()) {
-        glUseProgram(programIt->second);
+        GLState::useProgram(programIt->second);
         m_currentShader = name;
         auto wrapperIt = m_wrappers.find(name);
         if (wrapperIt != m_wrappers.end()) {
@@ -147,53 +214,164 @@ void ShaderLib::use(const std::string& name) {
 ShaderLib::ProgramWrapper::ProgramWrapper(unsigned int programId) : m_programId(programId) {}
 
 void ShaderLib::ProgramWrapper::use() {
-    glUseProgram(m_programId);
+    GLState::useProgram(m_programId);
+}
+
+void ShaderLib::ProgramWrapper::reflect() {
+    m_entries.clear();
+    m_slots.clear();
+
+    GLint uniformCount = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> nameBuffer(std::max(maxLength, 1));
+
+    for (GLint i = 0; i < uniformCount; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_programId, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()),
+                           &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+        // Arrays of basic types are reported as "name[0]"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            name.resize(name.size() - 3);
+        }
+        const GLint location = glGetUniformLocation(m_programId, name.c_str());
+        if (location < 0) continue;  // uniform block member
+
+        Entry entry;
+        entry.hash = hashUniformName(name.c_str());
+        entry.firstSlot = static_cast<uint32_t>(m_slots.size());
+        entry.count = static_cast<uint32_t>(std::max(size, 1));
+        entry.kind = kindOf(type);
+
+        // Start from the values the program holds (zero or the GLSL initializer), so a
+        // first set to the same value is already skipped
+        for (uint32_t e = 0; e < entry.count; ++e) {
+            Slot slot;
+            slot.location = e == 0 ? location
+                : glGetUniformLocation(m_programId, (name + "[" + std::to_string(e) + "]").c_str());
+            if (slot.location >= 0) {
+                if (entry.kind == UniformKind::Int) {
+                    GLint value = 0;
+                    glGetUniformiv(m_programId, slot.location, &value);
+                    std::memcpy(slot.value, &value, sizeof(value));
+                } else if (entry.kind == UniformKind::UInt) {
+                    GLuint value = 0;
+                    glGetUniformuiv(m_programId, slot.location, &value);
+                    std::memcpy(slot.value, &value, sizeof(value));
+                } else {
+                    glGetUniformfv(m_programId, slot.location, slot.value);
+                }
+            }
+            slot.known = true;
+            m_slots.push_back(slot);
+        }
+        m_entries.push_back(entry);
+
+        if (entry.count > 1) {
+            for (uint32_t e = 0; e < entry.count; ++e) {
+                Entry element = entry;
+                element.hash = hashUniformName((name + "[" + std::to_string(e) + "]").c_str());
+                element.firstSlot = entry.firstSlot + e;
+                element.count = 1;
+                m_entries.push_back(element);
+            }
+        }
+    }
+
+    std::sort(m_entries.begin(), m_entries.end(),
+              [](const Entry& a, const Entry& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < m_entries.size(); ++i) {
+        if (m_entries[i].hash == m_entries[i - 1].hash) {
+            std::cerr << "Uniform name hash collision in program " << m_programId << std::endl;
+        }
+    }
 }
 
-int ShaderLib::ProgramWrapper::getUniformLocation(const std::string& name) {
-    return glGetUniformLocation(m_programId, name.c_str());
+void ShaderLib::ProgramWrapper::invalidateUniforms() {
+    for (Slot& slot : m_slots) slot.known = false;
 }
 
-void ShaderLib::ProgramWrapper::setUniform(const std::string& name, const glm::mat4& value) {
-    int location = getUniformLocation(name);
-    if (location != -1) {
-        glUniformMatrix4fv(location, 1, false, glm::value_ptr(value));
+const ShaderLib::ProgramWrapper::Entry* ShaderLib::ProgramWrapper::find(uint32_t hash) const {
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), hash,
+                               [](const Entry& entry, uint32_t h) { return entry.hash < h; });
+    return (it != m_entries.end() && it->hash == hash) ? &*it : nullptr;
+}
+
+void ShaderLib::ProgramWrapper::store(uint32_t hash, UniformKind kind, const void* data, int first, int count) {
+    if (count == 0) return;
+    const Entry* entry = find(hash);
+    if (!entry || first < 0 || count < 0 || static_cast<uint32_t>(first) >= entry->count) {
+        ++s_uniformStats.unresolved;
+        return;
+    }
+    if (entry->kind != kind) {
+        if (!entry->warned) {
+            std::cerr << "Uniform set with the wrong type in program " << m_programId << std::endl;
+            entry->warned = true;
+        }
+        ++s_uniformStats.unresolved;
+        return;
+    }
+    count = std::min(count, static_cast<int>(entry->count) - first);
+
+    const size_t bytes = kindFloats(kind) * sizeof(float);
+    const char* src = static_cast<const char*>(data);
+    Slot* slots = &m_slots[entry->firstSlot + first];
+    bool changed = false;
+    for (int e = 0; e < count; ++e) {
+        Slot& slot = slots[e];
+        if (slot.known && std::memcmp(slot.value, src + e * bytes, bytes) == 0) continue;
+        std::memcpy(slot.value, src + e * bytes, bytes);
+        slot.known = true;
+        changed = true;
     }
+    if (!changed) {
+        ++s_uniformStats.skipped;
+        return;
+    }
+
+    const GLint location = slots[0].location;
+    if (location < 0) return;
+    const float* floats = static_cast<const float*>(data);
+    switch (kind) {
+        case UniformKind::Float: glUniform1fv(location, count, floats); break;
+        case UniformKind::Vec2: glUniform2fv(location, count, floats); break;
+        case UniformKind::Vec3: glUniform3fv(location, count, floats); break;
+        case UniformKind::Vec4: glUniform4fv(location, count, floats); break;
+        case UniformKind::Mat3: glUniformMatrix3fv(location, count, GL_FALSE, floats); break;
+        case UniformKind::Mat4: glUniformMatrix4fv(location, count, GL_FALSE, floats); break;
+        case UniformKind::Int: glUniform1iv(location, count, static_cast<const GLint*>(data)); break;
+        case UniformKind::UInt: glUniform1uiv(location, count, static_cast<const GLuint*>(data)); break;
+    }
+    ++s_uniformStats.uploads;
+}
+
+void ShaderLib::ProgramWrapper::setUniform(const std::string& name, const glm::mat4& value) {
+    store(hashUniformName(name.c_str()), UniformKind::Mat4, glm::value_ptr(value), 0, 1);
 }
 
 void ShaderLib::ProgramWrapper::setUniform(const std::string& name, const glm::mat3& value) {
-    int location = getUniformLocation(name);
-    if (location != -1) {
-        glUniformMatrix3fv(location, 1, false, glm::value_ptr(value));
-    }
+    store(hashUniformName(name.c_str()), UniformKind::Mat3, glm::value_ptr(value), 0, 1);
 }
 
 void ShaderLib::ProgramWrapper::setUniform(const std::string& name, const glm::vec4& value) {
-    int location = getUniformLocation(name);
-    if (location != -1) {
-        glUniform4f(location, value.x, value.y, value.z, value.w);
-    }
+    store(hashUniformName(name.c_str()), UniformKind::Vec4, glm::value_ptr(value), 0, 1);
 }
 
 void ShaderLib::ProgramWrapper::setUniform(const std::string& name, const glm::vec3& value) {
-    int location = getUniformLocation(name);
-    if (location != -1) {
-        glUniform3f(location, value.x, value.y, value.z);
-    }
+    store(hashUniformName(name.c_str()), UniformKind::Vec3, glm::value_ptr(value), 0, 1);
 }
 
 void ShaderLib::ProgramWrapper::setUniform(const std::string& name, float value) {
-    int location = getUniformLocation(name);
-    if (location != -1) {
-        glUniform1f(location, value);
-    }
+    store(hashUniformName(name.c_str()), UniformKind::Float, &value, 0, 1);
 }
 
 void ShaderLib::ProgramWrapper::setUniform(const std::string& name, int value) {
-    int location = getUniformLocation(name);
-    if (location != -1) {
-        glUniform1i(location, value);
-    }
+    store(hashUniformName(name.c_str()), UniformKind::Int, &value, 0, 1);
 }
 
 // Legacy setShaderParam functions for backward compatibility
@@ -328,33 +506,66 @@ ShaderLib::ProgramWrapper* ShaderLib::operator[](const std::string& name) {
         return m_wrappers["SilkPBR"].get();
     }
     
-    // Auto-create PhongInstanced shader for instanced particle rendering
+    // Instanced Phong (Engine::createInstancedMesh): Phong sources compiled with
+    // SANDBOX_INSTANCED, model matrix and colour per instance
     if (name == "PhongInstanced") {
+        const std::string defines = "#define SANDBOX_INSTANCED 1\n";
         createShaderProgram("PhongInstanced");
         
         attachShader("PhongInstancedVertex", VERTEX);
-        loadShaderSource("PhongInstancedVertex", "shaders/PhongInstanced.vs");
+        loadShaderSource("PhongInstancedVertex", "shaders/Phong.vs", defines);
         compileShader("PhongInstancedVertex");
         
-        // Reuse Phong fragment shader
         attachShader("PhongInstancedFragment", FRAGMENT);
-        loadShaderSource("PhongInstancedFragment", "shaders/Phong.fs");
+        loadShaderSource("PhongInstancedFragment", "shaders/Phong.fs", defines);
         compileShader("PhongInstancedFragment");
         
         attachShaderToProgram("PhongInstanced", "PhongInstancedVertex");
         attachShaderToProgram("PhongInstanced", "PhongInstancedFragment");
         
-        // Standard attributes + instanced position at location 3
+        // Standard attributes, then the instance stream: matrix columns at 3..6, colour at 7
         bindAttribute("PhongInstanced", 0, "inVert");
         bindAttribute("PhongInstanced", 1, "inUV");
         bindAttribute("PhongInstanced", 2, "inNormal");
-        bindAttribute("PhongInstanced", 3, "instancePos");
+        bindAttribute("PhongInstanced", 3, "instanceModel");
+        bindAttribute("PhongInstanced", 7, "instanceColor");
         
         linkProgramObject("PhongInstanced");
         
         return m_wrappers["PhongInstanced"].get();
     }
     
+    // Multi-draw-indirect variants ("PhongMDI", "SilkMDI", "SilkPBRMDI"): same sources
+    // compiled with SANDBOX_MDI, reading per-draw data from an SSBO by gl_DrawIDARB
+    const std::string mdiSuffix = "MDI";
+    if (name.size() > mdiSuffix.size() &&
+        name.compare(name.size() - mdiSuffix.size(), mdiSuffix.size(), mdiSuffix) == 0) {
+        std::string base = name.substr(0, name.size() - mdiSuffix.size());
+        if (base == "Phong" || base == "Silk" || base == "SilkPBR") {
+            const std::string defines = "#define SANDBOX_MDI 1\n";
+            createShaderProgram(name);
+            
+            attachShader(name + "Vertex", VERTEX);
+            loadShaderSource(name + "Vertex", "shaders/" + base + ".vs", defines);
+            compileShader(name + "Vertex");
+            
+            attachShader(name + "Fragment", FRAGMENT);
+            loadShaderSource(name + "Fragment", "shaders/" + base + ".fs", defines);
+            compileShader(name + "Fragment");
+            
+            attachShaderToProgram(name, name + "Vertex");
+            attachShaderToProgram(name, name + "Fragment");
+            
+            bindAttribute(name, 0, "inVert");
+            bindAttribute(name, 1, "inUV");
+            bindAttribute(name, 2, "inNormal");
+            
+            linkProgramObject(name);
+            
+            return m_wrappers[name].get();
+        }
+    }
+    
     std::cerr << "Shader program not found: " << name << std::endl;
     return nullptr;
 }
@@ -400,6 +611,44 @@ bool ShaderLib::checkProgramLinking(unsigned int programId, const std::string& n
 }
 
 bool ShaderLib::loadShaderFromFile(const std::string& filename, std::string& source) {
+    return readShaderFile(filename, source) && expandIncludes(source, filename, 0);
+}
+
+bool ShaderLib::expandIncludes(std::string& source, const std::string& filename, int depth) {
+    static const std::string directive = "#include \"";
+    size_t lineStart = 0;
+    int lineNumber = 1;
+    while (lineStart < source.size()) {
+        size_t lineEnd = source.find('\n', lineStart);
+        if (lineEnd == std::string::npos) lineEnd = source.size();
+        if (source.compare(lineStart, directive.size(), directive) == 0) {
+            const size_t nameEnd = source.find('"', lineStart + directive.size());
+            if (nameEnd == std::string::npos || nameEnd > lineEnd) {
+                std::cerr << "Malformed #include in " << filename << ":" << lineNumber << std::endl;
+                return false;
+            }
+            const std::string name = source.substr(lineStart + directive.size(), nameEnd - lineStart - directive.size());
+            std::string included;
+            if (depth >= 4) {
+                std::cerr << "Shader includes nested too deeply: " << name << " in " << filename << std::endl;
+                return false;
+            }
+            if (!readShaderFile(name, included) || !expandIncludes(included, name, depth + 1)) return false;
+            if (included.empty() || included.back() != '\n') included += '\n';
+            // Compile errors past the include keep the including file's line numbers
+            included += "#line " + std::to_string(lineNumber + 1) + "\n";
+            const size_t replaced = std::min(lineEnd + 1, source.size()) - lineStart;
+            source.replace(lineStart, replaced, included);
+            lineStart += included.size();
+        } else {
+            lineStart = lineEnd + 1;
+        }
+        ++lineNumber;
+    }
+    return true;
+}
+
+bool ShaderLib::readShaderFile(const std::string& filename, std::string& source) {
     std::string exeDir = getExecutableDir();
     std::vector<std::string> possiblePaths = {
         exeDir + filename,
@@ -445,9 +694,9 @@ bool ShaderLib::loadShaderFromFile(const std::string& filename, std::string& sou
 unsigned int ShaderLib::createUBO(const std::string& name, size_t size) {
     unsigned int ubo;
     glGenBuffers(1, &ubo);
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
     glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
     m_ubos[name] = ubo;
     return ubo;
 }
@@ -455,7 +704,7 @@ unsigned int ShaderLib::createUBO(const std::string& name, size_t size) {
 void ShaderLib::bindUBOToBindingPoint(const std::string& uboName, unsigned int bindingPoint) {
     auto it = m_ubos.find(uboName);
     if (it != m_ubos.end()) {
-        glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, it->second);
+        GLState::bindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, it->second);
     }
 }
 
@@ -466,9 +715,7 @@ void ShaderLib::updateUBO(const std::string& name, const void* data, size_t size
         return;
     }
     
-    glBindBuffer(GL_UNIFORM_BUFFER, it->second);
-    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::bufferSubData(it->second, offset, size, data);
 }
 
 void ShaderLib::bindUniformBlockToBindingPoint(const std::string& programName, const std::string& blockName, unsigned int bindingPoint) {
@@ -490,6 +737,6 @@ void ShaderLib::deleteUBO(const std::string& name) {
         return;
     }
     
-    glDeleteBuffers(1, &it->second);
+    GLState::deleteBuffers(1, &it->second);
     m_ubos.erase(it);
 }
@@ -3,14 +3,21 @@
 
 #include "ShadowRenderer.h"
 #include <glad/gl.h>
+#include <GLState.h>
 #include <Light.h>
+#include <ShaderLib.h>
+#include <ShaderUniforms.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -21,27 +28,68 @@ namespace {
     // State
     bool s_initialized = false;
     bool s_enabled = true;
-    int s_shadowMapSize = 4096;
+    int s_shadowMapSize = 2048;
     
     // Parameters
     float s_softness = 1.0f;
     float s_bias = 0.005f;
     
-    // Multi-shadow map FBOs and textures
-    GLuint s_shadowFBOs[MAX_SHADOW_LIGHTS] = {0};
-    GLuint s_shadowMapTexs[MAX_SHADOW_LIGHTS] = {0};
+    // This frame's shadow map array, one layer per light (the render graph owns it, or it
+    // is the cache), and the dynamic-caster array of a split cache
+    GLuint s_shadowMapArray = 0;
+    GLuint s_dynamicMapArray = 0;
     
-    // Shader program
-    GLuint s_shadowProgram = 0;
+    // Cache: persistent array, and per layer the light and caster keys it was drawn with
+    bool s_caching = true;
+    bool s_dynamicSplit = false;
+    GLuint s_cacheArray = 0;
+    uint64_t s_lightKeys[MAX_SHADOW_LAYERS] = {};
+    uint64_t s_cachedLightKeys[MAX_SHADOW_LAYERS] = {};
+    uint64_t s_cachedCasterKeys[MAX_SHADOW_LAYERS] = {};
+    bool s_cachedValid[MAX_SHADOW_LAYERS] = {};
+    CacheStats s_cacheStats;
+    
+    // A shadow program and its uniform table (set once per caster, so redundant sets are
+    // skipped). Variants other than the standard program are built on first use.
+    struct Variant {
+        GLuint program = 0;
+        bool tried = false;
+        std::unique_ptr<ShaderLib::ProgramWrapper> uniforms;
+    };
+    Variant s_standard;
+    Variant s_indirect;          // SANDBOX_MDI: multi-draw-indirect casters
+    Variant s_instanced;         // SANDBOX_INSTANCED: instanced casters
+    Variant s_layered;           // SANDBOX_LAYERED: every light in one submission
+    Variant s_layeredInstanced;  // SANDBOX_LAYERED + SANDBOX_INSTANCED
     
     // Light space matrices for each shadow map
-    glm::mat4 s_lightSpaceMatrices[MAX_SHADOW_LIGHTS];
+    glm::mat4 s_lightSpaceMatrices[MAX_SHADOW_LAYERS];
+    
+    // Cascades of the main light: settings, and the view depth each one ends at
+    int s_cascadeCount = MAX_CASCADES;
+    float s_cascadeLambda = 0.75f;
+    float s_cascadeDistance = 200.0f;
+    int s_activeCascades = 0;
+    float s_cascadeSplits[MAX_CASCADES] = {};
     
     // Current shadow light index
     int s_currentLightIndex = 0;
     
-    // Previous viewport
-    GLint s_prevViewport[4];
+    // Layered rendering: requested by the engine, and active between
+    // beginLayeredShadowPass and endShadowPass
+    bool s_layeredRendering = true;
+    bool s_layeredPass = false;
+    int s_layerCount = 0;
+    
+    // FNV-1a over raw bytes
+    uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
     
     std::string getExecutableDir() {
 #ifdef _WIN32
@@ -101,11 +149,13 @@ namespace {
         return shader;
     }
     
-    GLuint linkProgram(GLuint vs, GLuint fs) {
+    GLuint linkProgram(GLuint vs, GLuint fs, GLuint gs = 0) {
         GLuint program = glCreateProgram();
         glAttachShader(program, vs);
         glAttachShader(program, fs);
+        if (gs) glAttachShader(program, gs);
         glBindAttribLocation(program, 0, "inVert");
+        glBindAttribLocation(program, 3, "instanceModel");
         glLinkProgram(program);
         
         GLint success;
@@ -120,56 +170,79 @@ namespace {
         return program;
     }
     
-    GLuint createProgram(const std::string& vsFile, const std::string& fsFile) {
+    GLuint createProgram(const std::string& vsFile, const std::string& fsFile,
+                         const std::string& vsDefines = "", const std::string& gsFile = "") {
         std::string vsSource = loadShaderSource(vsFile);
         std::string fsSource = loadShaderSource(fsFile);
-        if (vsSource.empty() || fsSource.empty()) return 0;
+        std::string gsSource = gsFile.empty() ? std::string() : loadShaderSource(gsFile);
+        if (vsSource.empty() || fsSource.empty() || (!gsFile.empty() && gsSource.empty())) return 0;
+        if (!vsDefines.empty()) {
+            // Variants use SSBOs/draw parameters, which need a 4.x shading language
+            const std::string baseVersion = "#version 150";
+            size_t pos = vsSource.find(baseVersion);
+            if (pos != std::string::npos) vsSource.replace(pos, baseVersion.size(), "#version 420 core");
+            vsSource = ShaderLib::injectDefines(vsSource, vsDefines);
+        }
         
         GLuint vs = compileShader(GL_VERTEX_SHADER, vsSource);
         GLuint fs = compileShader(GL_FRAGMENT_SHADER, fsSource);
-        if (!vs || !fs) {
+        GLuint gs = gsSource.empty() ? 0 : compileShader(GL_GEOMETRY_SHADER, gsSource);
+        if (!vs || !fs || (!gsSource.empty() && !gs)) {
             if (vs) glDeleteShader(vs);
             if (fs) glDeleteShader(fs);
+            if (gs) glDeleteShader(gs);
             return 0;
         }
         
-        GLuint prog = linkProgram(vs, fs);
+        GLuint prog = linkProgram(vs, fs, gs);
         glDeleteShader(vs);
         glDeleteShader(fs);
+        if (gs) glDeleteShader(gs);
         return prog;
     }
     
-    bool createShadowMap(int index) {
-        glGenFramebuffers(1, &s_shadowFBOs[index]);
-        glBindFramebuffer(GL_FRAMEBUFFER, s_shadowFBOs[index]);
-        
-        glGenTextures(1, &s_shadowMapTexs[index]);
-        glBindTexture(GL_TEXTURE_2D, s_shadowMapTexs[index]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F,
-                     s_shadowMapSize, s_shadowMapSize, 0,
-                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        
-        float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-        
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, s_shadowMapTexs[index], 0);
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
-        
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            std::cerr << "Shadow: Framebuffer " << index << " not complete" << std::endl;
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            return false;
+    bool buildVariant(Variant& variant, const std::string& vsDefines, const std::string& gsFile = "") {
+        if (!variant.tried) {
+            variant.tried = true;
+            variant.program = createProgram("shaders/Shadow.vs", "shaders/Shadow.fs", vsDefines, gsFile);
+            if (variant.program) {
+                variant.uniforms = std::make_unique<ShaderLib::ProgramWrapper>(variant.program);
+                variant.uniforms->reflect();
+            }
+        }
+        return variant.program != 0;
+    }
+    
+    void releaseVariant(Variant& variant) {
+        if (variant.program) glDeleteProgram(variant.program);
+        variant = Variant{};
+    }
+    
+    // gl_Layer is writable from the vertex shader with either extension; otherwise a
+    // pass-through geometry shader routes each triangle to its layer
+    bool vertexShaderLayer() {
+        return GLAD_GL_ARB_shader_viewport_layer_array || GLAD_GL_AMD_vertex_shader_layer;
+    }
+    
+    bool buildLayeredVariant(Variant& variant, bool instanced) {
+        std::string defines = "#define SANDBOX_LAYERED 1\n";
+        if (vertexShaderLayer()) defines += "#define SANDBOX_VS_LAYER 1\n";
+        if (instanced) defines += "#define SANDBOX_INSTANCED 1\n";
+        return buildVariant(variant, defines, vertexShaderLayer() ? "" : "shaders/Shadow.gs");
+    }
+    
+    // Program that plain (non-instanced) casters draw with in the current pass
+    Variant& currentStandard() {
+        return s_layeredPass ? s_layered : s_standard;
+    }
+    
+    void setLightSpace(Variant& variant) {
+        if (s_layeredPass) {
+            variant.uniforms->setArray(Uniforms::kLightSpaceMatrices, s_lightSpaceMatrices, s_layerCount);
+            variant.uniforms->set(Uniforms::kShadowLayerCount, s_layerCount);
+        } else {
+            variant.uniforms->set(Uniforms::kLightSpaceMatrix, s_lightSpaceMatrices[s_currentLightIndex]);
         }
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        return true;
     }
 }
 
@@ -179,50 +252,39 @@ bool init(int shadowMapSize) {
     s_shadowMapSize = shadowMapSize;
     
     // Create shadow shader
-    s_shadowProgram = createProgram("shaders/Shadow.vs", "shaders/Shadow.fs");
-    if (!s_shadowProgram) {
+    if (!buildVariant(s_standard, "")) {
         std::cerr << "Shadow: Failed to create shader, shadows disabled" << std::endl;
         s_enabled = false;
         return false;
     }
     
-    // Create shadow maps for all lights
-    for (int i = 0; i < MAX_SHADOW_LIGHTS; ++i) {
-        if (!createShadowMap(i)) {
-            cleanup();
-            return false;
-        }
-        s_lightSpaceMatrices[i] = glm::mat4(1.0f);
-    }
+    // Shadow maps are a render graph target, allocated only while shadow passes run
+    s_shadowMapArray = 0;
+    for (int i = 0; i < MAX_SHADOW_LAYERS; ++i) s_lightSpaceMatrices[i] = glm::mat4(1.0f);
     
     s_initialized = true;
-    std::cout << "Multi-shadow mapping initialized (" << MAX_SHADOW_LIGHTS << " maps @ " 
-              << s_shadowMapSize << "x" << s_shadowMapSize << ")" << std::endl;
+    std::cout << "Multi-shadow mapping initialized (" << MAX_CASCADES << " cascades + "
+              << MAX_SHADOW_LIGHTS - 1 << " lights @ " << s_shadowMapSize << "x" << s_shadowMapSize << ")" << std::endl;
     return true;
 }
 
 void cleanup() {
-    for (int i = 0; i < MAX_SHADOW_LIGHTS; ++i) {
-        if (s_shadowFBOs[i]) { glDeleteFramebuffers(1, &s_shadowFBOs[i]); s_shadowFBOs[i] = 0; }
-        if (s_shadowMapTexs[i]) { glDeleteTextures(1, &s_shadowMapTexs[i]); s_shadowMapTexs[i] = 0; }
-    }
-    if (s_shadowProgram) { glDeleteProgram(s_shadowProgram); s_shadowProgram = 0; }
+    s_shadowMapArray = 0;
+    s_dynamicMapArray = 0;
+    if (s_cacheArray) GLState::deleteTextures(1, &s_cacheArray);
+    s_cacheArray = 0;
+    invalidateCache();
+    releaseVariant(s_standard);
+    releaseVariant(s_indirect);
+    releaseVariant(s_instanced);
+    releaseVariant(s_layered);
+    releaseVariant(s_layeredInstanced);
+    s_layeredPass = false;
     s_initialized = false;
 }
 
-void beginShadowPass(int lightIndex, Light* light, const glm::vec3& sceneCenter, float sceneRadius) {
-    if (!s_initialized || !s_enabled || !light) return;
-    if (lightIndex < 0 || lightIndex >= MAX_SHADOW_LIGHTS) return;
-    
-    s_currentLightIndex = lightIndex;
-    
-    glGetIntegerv(GL_VIEWPORT, s_prevViewport);
-    glBindFramebuffer(GL_FRAMEBUFFER, s_shadowFBOs[lightIndex]);
-    glViewport(0, 0, s_shadowMapSize, s_shadowMapSize);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
-    glCullFace(GL_FRONT);
-    
+void setupShadowLight(int lightIndex, Light* light, const glm::vec3& sceneCenter, float sceneRadius) {
+    if (!light || lightIndex < 0 || lightIndex >= MAX_SHADOW_LAYERS) return;
     glm::vec3 lightPos = light->getPosition();
     float orthoSize = sceneRadius * 1.5f;
     glm::mat4 lightProjection = glm::ortho(-orthoSize, orthoSize, -orthoSize, orthoSize,
@@ -230,39 +292,307 @@ void beginShadowPass(int lightIndex, Light* light, const glm::vec3& sceneCenter,
     glm::mat4 lightView = glm::lookAt(lightPos, sceneCenter, glm::vec3(0.0f, 1.0f, 0.0f));
     
     s_lightSpaceMatrices[lightIndex] = lightProjection * lightView;
+    // The matrix captures everything about the light that moves its shadow
+    s_lightKeys[lightIndex] = hashBytes(&s_lightSpaceMatrices[lightIndex], sizeof(glm::mat4));
+}
+
+int setupCascades(Light* light, const glm::vec3& target, const glm::mat4& view, const glm::mat4& projection,
+                  float nearPlane, float farPlane, const glm::vec3& casterMin, const glm::vec3& casterMax) {
+    s_activeCascades = 0;
+    if (!light) return 0;
+    const glm::vec3 lightPos = light->getPosition();
+    if (glm::length(target - lightPos) < 1e-4f) return 0;
+    const glm::vec3 direction = glm::normalize(target - lightPos);
+    const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    // Rotation only: a fixed basis per light direction keeps the texel grid in place
+    const glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+    // Caster box in light space (the light looks down -z)
+    const bool hasCasters = casterMin.x <= casterMax.x && casterMin.y <= casterMax.y && casterMin.z <= casterMax.z;
+    glm::vec3 castersLo(std::numeric_limits<float>::max());
+    glm::vec3 castersHi(-std::numeric_limits<float>::max());
+    if (hasCasters) {
+        for (int c = 0; c < 8; ++c) {
+            const glm::vec3 corner((c & 1) ? casterMax.x : casterMin.x, (c & 2) ? casterMax.y : casterMin.y,
+                                   (c & 4) ? casterMax.z : casterMin.z);
+            const glm::vec3 p(lightRotation * glm::vec4(corner, 1.0f));
+            castersLo = glm::min(castersLo, p);
+            castersHi = glm::max(castersHi, p);
+        }
+    }
+
+    // View frustum corners in world space: near plane, then far plane
+    const glm::mat4 invViewProj = glm::inverse(projection * view);
+    glm::vec3 nearCorners[4], farCorners[4];
+    for (int c = 0; c < 4; ++c) {
+        const glm::vec2 ndc((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f);
+        const glm::vec4 n = invViewProj * glm::vec4(ndc, -1.0f, 1.0f);
+        const glm::vec4 f = invViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+        nearCorners[c] = glm::vec3(n) / n.w;
+        farCorners[c] = glm::vec3(f) / f.w;
+    }
+
+    // Practical split: blend of logarithmic and uniform distances
+    const int count = s_cascadeCount;
+    const float range = std::min(farPlane, std::max(s_cascadeDistance, nearPlane + 1e-3f));
+    const float size = static_cast<float>(s_shadowMapSize);
+    float sliceNear = nearPlane;
+    for (int i = 0; i < count; ++i) {
+        const float t = static_cast<float>(i + 1) / static_cast<float>(count);
+        const float logSplit = nearPlane * std::pow(range / nearPlane, t);
+        const float uniformSplit = nearPlane + (range - nearPlane) * t;
+        const float sliceFar = s_cascadeLambda * logSplit + (1.0f - s_cascadeLambda) * uniformSplit;
+        s_cascadeSplits[i] = sliceFar;
+
+        // View depth is linear along each corner ray, so the slice corners interpolate
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int c = 0; c < 4; ++c) {
+            const float a = (sliceNear - nearPlane) / (farPlane - nearPlane);
+            const float b = (sliceFar - nearPlane) / (farPlane - nearPlane);
+            corners[c] = glm::mix(nearCorners[c], farCorners[c], a);
+            corners[c + 4] = glm::mix(nearCorners[c], farCorners[c], b);
+            center += corners[c] + corners[c + 4];
+        }
+        center /= 8.0f;
+        // Bounding sphere: its size does not change as the camera turns. Rounded up so
+        // float noise does not resize the texels either.
+        float radius = 0.0f;
+        for (const glm::vec3& corner : corners) radius = std::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        const glm::vec3 sphere(lightRotation * glm::vec4(center, 1.0f));
+        glm::vec2 boxCenter(sphere);
+        float halfSize = radius;
+        float zNear = sphere.z + radius;   // light-space z, nearest to the light
+        const float zFar = sphere.z - radius;
+        if (hasCasters) {
+            // Receivers outside the casters' footprint are lit anyway
+            const glm::vec2 casterHalf = (glm::vec2(castersHi) - glm::vec2(castersLo)) * 0.5f;
+            const float casterSize = std::max(casterHalf.x, casterHalf.y);
+            if (casterSize < halfSize) {
+                boxCenter = (glm::vec2(castersHi) + glm::vec2(castersLo)) * 0.5f;
+                halfSize = std::max(std::ceil(casterSize * 16.0f) / 16.0f, 1.0f / 16.0f);
+            }
+            // Reach back to the nearest caster, no further
+            zNear = std::max(castersHi.z, zFar + 1e-3f);
+        }
+
+        // Snap the window to whole texels so static shadows stay put
+        const float texel = 2.0f * halfSize / size;
+        boxCenter = glm::floor(boxCenter / texel) * texel;
+        const glm::mat4 lightProjection = glm::ortho(boxCenter.x - halfSize, boxCenter.x + halfSize,
+                                                     boxCenter.y - halfSize, boxCenter.y + halfSize,
+                                                     -zNear, -zFar);
+        s_lightSpaceMatrices[i] = lightProjection * lightRotation;
+        s_lightKeys[i] = hashBytes(&s_lightSpaceMatrices[i], sizeof(glm::mat4));
+        sliceNear = sliceFar;
+    }
+    s_activeCascades = count;
+    return count;
+}
+
+void setCascadeCount(int count) { s_cascadeCount = std::clamp(count, 1, MAX_CASCADES); }
+int getCascadeCount() { return s_cascadeCount; }
+void setCascadeSplitLambda(float lambda) { s_cascadeLambda = std::clamp(lambda, 0.0f, 1.0f); }
+float getCascadeSplitLambda() { return s_cascadeLambda; }
+void setCascadeDistance(float distance) { s_cascadeDistance = std::max(distance, 1.0f); }
+float getCascadeDistance() { return s_cascadeDistance; }
+int activeCascades() { return s_activeCascades; }
+
+float getCascadeSplit(int cascade) {
+    if (cascade < 0 || cascade >= s_activeCascades) return 0.0f;
+    return s_cascadeSplits[cascade];
+}
+
+void beginShadowPass(int lightIndex) {
+    if (!s_initialized || !s_enabled) return;
+    if (lightIndex < 0 || lightIndex >= MAX_SHADOW_LAYERS) return;
+    
+    s_currentLightIndex = lightIndex;
+    s_layeredPass = false;
+    
+    glClear(GL_DEPTH_BUFFER_BIT);
+    GLState::setDepthTest(true);
+    GLState::cullFace(GL_FRONT);
+    
+    GLState::useProgram(s_standard.program);
+    setLightSpace(s_standard);
+}
+
+bool beginLayeredShadowPass(int lightCount) {
+    if (!s_initialized || !s_enabled || !hasLayeredProgram()) return false;
+    if (lightCount <= 0 || lightCount > MAX_SHADOW_LAYERS) return false;
+    
+    s_layeredPass = true;
+    s_layerCount = lightCount;
     
-    glUseProgram(s_shadowProgram);
-    glUniformMatrix4fv(glGetUniformLocation(s_shadowProgram, "lightSpaceMatrix"),
-                       1, GL_FALSE, glm::value_ptr(s_lightSpaceMatrices[lightIndex]));
+    // The array is attached layered, so this clears every layer
+    glClear(GL_DEPTH_BUFFER_BIT);
+    GLState::setDepthTest(true);
+    GLState::cullFace(GL_FRONT);
+    
+    GLState::useProgram(s_layered.program);
+    setLightSpace(s_layered);
+    return true;
 }
 
 void endShadowPass() {
     if (!s_initialized || !s_enabled) return;
-    glCullFace(GL_BACK);
-    glViewport(s_prevViewport[0], s_prevViewport[1], s_prevViewport[2], s_prevViewport[3]);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    s_layeredPass = false;
+    GLState::cullFace(GL_BACK);
+}
+
+void setLayeredRendering(bool enabled) { s_layeredRendering = enabled; }
+bool isLayeredRendering() { return s_layeredRendering; }
+
+bool hasLayeredProgram(bool instanced) {
+    if (!s_initialized || !s_enabled) return false;
+    return instanced ? buildLayeredVariant(s_layeredInstanced, true) : buildLayeredVariant(s_layered, false);
+}
+
+bool layersFromVertexShader() {
+    return vertexShaderLayer();
 }
 
 glm::mat4 getLightSpaceMatrix(int lightIndex) {
-    if (lightIndex >= 0 && lightIndex < MAX_SHADOW_LIGHTS)
+    if (lightIndex >= 0 && lightIndex < MAX_SHADOW_LAYERS)
         return s_lightSpaceMatrices[lightIndex];
     return glm::mat4(1.0f);
 }
 
-unsigned int getShadowMapTexture(int lightIndex) {
-    if (lightIndex >= 0 && lightIndex < MAX_SHADOW_LIGHTS)
-        return s_shadowMapTexs[lightIndex];
-    return 0;
+unsigned int getShadowMapArray() {
+    return s_shadowMapArray;
+}
+
+void setShadowMapArray(unsigned int texture) {
+    s_shadowMapArray = texture;
+}
+
+gfx::TextureDesc mapDesc(int layers) {
+    gfx::TextureDesc desc;
+    desc.width = s_shadowMapSize;
+    desc.height = s_shadowMapSize;
+    desc.format = GL_DEPTH_COMPONENT32F;
+    desc.layers = layers;
+    desc.filter = GL_LINEAR;
+    desc.wrap = GL_CLAMP_TO_BORDER;
+    desc.depthCompare = true;
+    return desc;
+}
+
+void setCaching(bool enabled) {
+    if (!enabled) invalidateCache();
+    s_caching = enabled;
+}
+bool isCaching() { return s_caching; }
+
+void setDynamicSplit(bool enabled) {
+    // The cached layers hold a different caster set on each side of the split
+    if (enabled != s_dynamicSplit) invalidateCache();
+    s_dynamicSplit = enabled;
+}
+bool isDynamicSplit() { return s_dynamicSplit; }
+
+unsigned int cacheArray() {
+    if (s_cacheArray) return s_cacheArray;
+    const gfx::TextureDesc desc = mapDesc(MAX_SHADOW_LAYERS);
+    glGenTextures(1, &s_cacheArray);
+    GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, s_cacheArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, static_cast<GLint>(desc.format), desc.width, desc.height, desc.layers, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(desc.filter));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(desc.filter));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, static_cast<GLint>(desc.wrap));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, static_cast<GLint>(desc.wrap));
+    const float white[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, white);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    invalidateCache();
+    return s_cacheArray;
+}
+
+bool claimStaleLayer(int lightIndex, uint64_t casterKey) {
+    if (lightIndex < 0 || lightIndex >= MAX_SHADOW_LAYERS) return false;
+    if (s_cachedValid[lightIndex] && s_cachedLightKeys[lightIndex] == s_lightKeys[lightIndex] &&
+        s_cachedCasterKeys[lightIndex] == casterKey) {
+        ++s_cacheStats.reused;
+        return false;
+    }
+    s_cachedValid[lightIndex] = true;
+    s_cachedLightKeys[lightIndex] = s_lightKeys[lightIndex];
+    s_cachedCasterKeys[lightIndex] = casterKey;
+    ++s_cacheStats.redrawn;
+    return true;
+}
+
+void invalidateCache(int firstLayer) {
+    for (int i = std::max(firstLayer, 0); i < MAX_SHADOW_LAYERS; ++i) s_cachedValid[i] = false;
+}
+
+const CacheStats& cacheStats() { return s_cacheStats; }
+void resetCacheStats() { s_cacheStats = CacheStats{}; }
+
+unsigned int getDynamicMapArray() {
+    return s_dynamicMapArray;
+}
+
+void setDynamicMapArray(unsigned int texture) {
+    s_dynamicMapArray = texture;
 }
 
 GLuint getShadowProgram() {
-    return s_shadowProgram;
+    return s_standard.program;
 }
 
 void setModelMatrix(const glm::mat4& model) {
-    if (s_shadowProgram) {
-        glUniformMatrix4fv(glGetUniformLocation(s_shadowProgram, "model"),
-                           1, GL_FALSE, glm::value_ptr(model));
+    Variant& variant = currentStandard();
+    if (variant.uniforms) variant.uniforms->set(Uniforms::kModel, model);
+}
+
+bool hasIndirectProgram() {
+    if (!s_initialized || !s_enabled) return false;
+    return buildVariant(s_indirect, "#define SANDBOX_MDI 1\n");
+}
+
+bool useIndirectProgram(const glm::mat4& model) {
+    // Layered passes draw whole meshes instanced per layer instead
+    if (s_layeredPass || !hasIndirectProgram()) return false;
+
+    GLState::useProgram(s_indirect.program);
+    setLightSpace(s_indirect);
+    s_indirect.uniforms->set(Uniforms::kModel, model);
+    return true;
+}
+
+bool hasInstancedProgram() {
+    if (!s_initialized || !s_enabled) return false;
+    if (s_layeredPass) return buildLayeredVariant(s_layeredInstanced, true);
+    return buildVariant(s_instanced, "#define SANDBOX_INSTANCED 1\n");
+}
+
+bool useInstancedProgram(const glm::mat4& model) {
+    if (!hasInstancedProgram()) return false;
+
+    Variant& variant = s_layeredPass ? s_layeredInstanced : s_instanced;
+    GLState::useProgram(variant.program);
+    setLightSpace(variant);
+    variant.uniforms->set(Uniforms::kModel, model);
+    return true;
+}
+
+void useStandardProgram() {
+    Variant& variant = currentStandard();
+    if (variant.program) GLState::useProgram(variant.program);
+}
+
+void setPositionDecode(const glm::vec3& scale, const glm::vec3& bias) {
+    Variant& variant = currentStandard();
+    if (variant.uniforms) {
+        variant.uniforms->set(Uniforms::kPosDequantScale, scale);
+        variant.uniforms->set(Uniforms::kPosDequantBias, bias);
     }
 }
 
@@ -1,13 +1,25 @@
 #include "SphereObstacle.h"
+#include "IndexFormat.h"
 #include "Renderer.h"
+#include <GLState.h>
 #include <GeometryFactory.h>
 #include <Material.h>
 #include <Matrix.h>
+#include <RenderQueue.h>
 #include <ShaderLib.h>
+#include <UniformBlocks.h>
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <cmath>
 
+namespace {
+// Undeformed sphere shared by every obstacle; first call needs the GL context
+const std::shared_ptr<FlockingGraphics::Geometry>& standardSphere() {
+  static auto sphereGeometry = FlockingGraphics::GeometryFactory::instance().createSphere(1.0f, 40);
+  return sphereGeometry;
+}
+}
+
 // Simple 3D noise using sin combinations (similar to cloth turbulence)
 float SphereObstacle::noiseFunction(float x, float y, float z) const {
     float t = m_deformationTime * m_deformationSpeed;
@@ -41,6 +53,7 @@ void SphereObstacle::generateDeformedSphere() {
     m_deformedVertices.clear();
     m_deformedNormals.clear();
     m_indices.clear();
+    ++m_shapeVersion;
     
     // Generate vertices
     for (int i = 0; i <= stacks; ++i) {
@@ -124,13 +137,8 @@ void SphereObstacle::updateDeformation(float deltaTime) {
         
         // Update GPU buffers
         if (m_bufferInitialized) {
-            glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, m_deformedVertices.size() * sizeof(float), m_deformedVertices.data());
-            
-            glBindBuffer(GL_ARRAY_BUFFER, m_nbo);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, m_deformedNormals.size() * sizeof(float), m_deformedNormals.data());
-            
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            GLState::bufferSubData(m_vbo, 0, m_deformedVertices.size() * sizeof(float), m_deformedVertices.data());
+            GLState::bufferSubData(m_nbo, 0, m_deformedNormals.size() * sizeof(float), m_deformedNormals.data());
         }
     }
 }
@@ -150,38 +158,38 @@ SphereObstacle::SphereObstacle() {
   m_deformationOctaves = 3;
   m_sphereSegments = 40;
   m_bufferInitialized = false;
+  m_shapeVersion = 0;
   m_vao = m_vbo = m_nbo = m_ebo = 0;
+  m_indexType = GL_UNSIGNED_INT;
   
   // Generate initial sphere
   generateDeformedSphere();
 }
 
-void SphereObstacle::draw(const std::string &_shaderName,
-                          TransformStack &_transform, Camera *_cam) const {
+void SphereObstacle::submit(gfx::RenderQueue &_queue, const std::string &_shaderName,
+                            TransformStack &_transform, Camera *_cam) const {
   ShaderLib *shader = ShaderLib::instance();
   auto wrapper = (*shader)[_shaderName];
   if (!wrapper) return;
-  wrapper->use();
+  FlockingShaders::DrawBlock& block = UniformBlocks::draw();
 
   // Set sphere material - brighter ambient for visibility
-  wrapper->setUniform("material.ambient", glm::vec4(m_colour.m_r * 0.5f, m_colour.m_g * 0.5f, m_colour.m_b * 0.5f, 1.0f));
-  wrapper->setUniform("material.diffuse", glm::vec4(m_colour.m_r, m_colour.m_g, m_colour.m_b, 1.0f));
-  wrapper->setUniform("material.specular", glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
-  wrapper->setUniform("material.shininess", 64.0f);
+  block.material.ambient = glm::vec4(m_colour.m_r * 0.5f, m_colour.m_g * 0.5f, m_colour.m_b * 0.5f, 1.0f);
+  block.material.diffuse = glm::vec4(m_colour.m_r, m_colour.m_g, m_colour.m_b, 1.0f);
+  block.material.specular = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
+  block.material.shininess = 64.0f;
   
   // Subtle AO for sphere - just hemisphere darkening
-  wrapper->setUniform("aoStrength", 0.3f);
-  wrapper->setUniform("aoGroundColor", glm::vec3(0.5f, 0.45f, 0.4f));
-
-  glPolygonMode(GL_FRONT_AND_BACK, m_sphereWireframe ? GL_LINE : GL_FILL);
+  block.aoGroundColor = glm::vec4(0.5f, 0.45f, 0.4f, 0.3f);
 
   _transform.pushTransform();
   _transform.setPosition(m_obstPosition);
   _transform.setScale(m_obstRadius, m_obstRadius, m_obstRadius);
-  Renderer::loadMatricesToShader(_shaderName, _transform, _cam);
+  UniformBlocks::setTransforms(_transform.getCurrentTransform(), _cam->getViewMatrix(), _cam->getProjectionMatrix());
+  _transform.popTransform();
 
   if (m_deformationEnabled && !m_deformedVertices.empty()) {
-    // Use custom deformed sphere
+    // Create the deformed sphere buffers on first use; recordGeometryOnly draws from them
     SphereObstacle* nonConstThis = const_cast<SphereObstacle*>(this);
     
     if (!m_bufferInitialized) {
@@ -191,55 +199,74 @@ void SphereObstacle::draw(const std::string &_shaderName,
       glGenBuffers(1, &nonConstThis->m_ebo);
       nonConstThis->m_bufferInitialized = true;
       
-      glBindVertexArray(m_vao);
+      GLState::bindVertexArray(m_vao);
       
       // Vertex buffer
-      glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+      GLState::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
       glBufferData(GL_ARRAY_BUFFER, m_deformedVertices.size() * sizeof(float), m_deformedVertices.data(), GL_DYNAMIC_DRAW);
       glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
       glEnableVertexAttribArray(0);
       
       // Normal buffer
-      glBindBuffer(GL_ARRAY_BUFFER, m_nbo);
+      GLState::bindBuffer(GL_ARRAY_BUFFER, m_nbo);
       glBufferData(GL_ARRAY_BUFFER, m_deformedNormals.size() * sizeof(float), m_deformedNormals.data(), GL_DYNAMIC_DRAW);
       glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
       glEnableVertexAttribArray(2);
       
       // Index buffer
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), m_indices.data(), GL_STATIC_DRAW);
+      GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+      if (IndexFormat::fitsUint16(m_indices.data(), m_indices.size())) {
+        std::vector<uint16_t> narrowed;
+        const size_t bytes = IndexFormat::narrowPadded(narrowed, m_indices.data(), m_indices.size());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, narrowed.data(), GL_STATIC_DRAW);
+        nonConstThis->m_indexType = GL_UNSIGNED_SHORT;
+      } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), m_indices.data(), GL_STATIC_DRAW);
+        nonConstThis->m_indexType = GL_UNSIGNED_INT;
+      }
       
-      glBindVertexArray(0);
+      GLState::bindVertexArray(0);
     }
-    
-    glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
   } else {
-    // Use standard sphere geometry
-    static auto sphereGeometry =
-        FlockingGraphics::GeometryFactory::instance().createSphere(1.0f, 40);
-    if (sphereGeometry)
-      sphereGeometry->render();
+    // Created here so recording workers never build GL objects
+    standardSphere();
   }
-  
-  _transform.popTransform();
+
+  _queue.submit(gfx::RenderQueue::Opaque, wrapper,
+                glm::vec3(m_obstPosition.m_x, m_obstPosition.m_y, m_obstPosition.m_z),
+                [this](gfx::CommandBuffer& cmd) { recordGeometryOnly(cmd); }, m_sphereWireframe ? GL_LINE : GL_FILL);
 }
 
-void SphereObstacle::renderGeometryOnly() const {
+void SphereObstacle::renderGeometryOnly(int _instances) const {
   // Render sphere geometry without any shader setup (for shadow pass)
   if (m_deformationEnabled && !m_deformedVertices.empty() && m_bufferInitialized) {
-    glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    GLState::bindVertexArray(m_vao);
+    if (_instances > 1)
+      glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), m_indexType, nullptr,
+                              _instances);
+    else
+      glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), m_indexType, nullptr);
   } else {
-    static auto sphereGeometry =
-        FlockingGraphics::GeometryFactory::instance().createSphere(1.0f, 40);
-    if (sphereGeometry)
-      sphereGeometry->render();
+    if (const auto& sphereGeometry = standardSphere())
+      sphereGeometry->render(_instances);
   }
 }
 
+void SphereObstacle::recordGeometryOnly(gfx::CommandBuffer &_cmd) const {
+  if (m_deformationEnabled && !m_deformedVertices.empty() && m_bufferInitialized) {
+    _cmd.bindVertexArray(m_vao);
+    _cmd.drawElements(static_cast<GLsizei>(m_indices.size()), m_indexType, nullptr);
+  } else {
+    if (const auto& sphereGeometry = standardSphere())
+      sphereGeometry->record(_cmd);
+  }
+}
+
+uint64_t SphereObstacle::shapeVersion() const {
+  const bool deformed = m_deformationEnabled && !m_deformedVertices.empty() && m_bufferInitialized;
+  return deformed ? m_shapeVersion : 0;
+}
+
 Vector SphereObstacle::getPosition() { return m_obstPosition; }
 
 float SphereObstacle::getRadius() { return m_obstRadius; }
@@ -250,9 +277,9 @@ void SphereObstacle::setObstacleWireframe(bool setEnable) {
 
 SphereObstacle::~SphereObstacle() {
   if (m_bufferInitialized) {
-    glDeleteVertexArrays(1, &m_vao);
-    glDeleteBuffers(1, &m_vbo);
-    glDeleteBuffers(1, &m_nbo);
-    glDeleteBuffers(1, &m_ebo);
+    GLState::deleteVertexArrays(1, &m_vao);
+    GLState::deleteBuffers(1, &m_vbo);
+    GLState::deleteBuffers(1, &m_nbo);
+    GLState::deleteBuffers(1, &m_ebo);
   }
 }
@@ -0,0 +1,106 @@
+/// @file StreamRingBuffer.cpp
+/// @brief Persistently mapped ring buffer implementation
+
+#include "StreamRingBuffer.h"
+#include "GLState.h"
+#include <iostream>
+
+namespace gfx {
+
+bool StreamRingBuffer::isSupported() {
+    return GLAD_GL_ARB_buffer_storage != 0;
+}
+
+StreamRingBuffer::~StreamRingBuffer() {
+    destroy();
+}
+
+bool StreamRingBuffer::create(GLenum target, size_t regionBytes) {
+    destroy();
+    if (!isSupported() || regionBytes == 0) return false;
+
+    m_target = target;
+    m_regionBytes = regionBytes;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const size_t totalBytes = m_regionBytes * REGION_COUNT;
+
+    glGenBuffers(1, &m_buffer);
+    GLState::bindBuffer(m_target, m_buffer);
+    glBufferStorage(m_target, static_cast<GLsizeiptr>(totalBytes), nullptr, flags);
+    m_mapped = static_cast<unsigned char*>(
+        glMapBufferRange(m_target, 0, static_cast<GLsizeiptr>(totalBytes), flags));
+    GLState::bindBuffer(m_target, 0);
+
+    if (!m_mapped) {
+        std::cerr << "StreamRingBuffer: persistent mapping failed, falling back" << std::endl;
+        GLState::deleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        m_regionBytes = 0;
+        return false;
+    }
+
+    m_region = REGION_COUNT - 1;
+    m_regionUsed = 0;
+    m_inFrame = false;
+    return true;
+}
+
+void StreamRingBuffer::destroy() {
+    if (!m_buffer) return;
+    for (int i = 0; i < REGION_COUNT; ++i) {
+        waitForRegion(i);
+    }
+    GLState::bindBuffer(m_target, m_buffer);
+    glUnmapBuffer(m_target);
+    GLState::bindBuffer(m_target, 0);
+    GLState::deleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+    m_mapped = nullptr;
+    m_regionBytes = 0;
+    m_regionUsed = 0;
+    m_inFrame = false;
+}
+
+void StreamRingBuffer::waitForRegion(int region) {
+    GLsync& fence = m_fences[region];
+    if (!fence) return;
+    // Poll first, then flush and block; a stall here means the CPU is >2 frames ahead
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamRingBuffer::beginFrame() {
+    if (!m_buffer) return;
+    if (m_inFrame) endFrame();
+    m_region = (m_region + 1) % REGION_COUNT;
+    waitForRegion(m_region);
+    m_regionUsed = 0;
+    m_inFrame = true;
+}
+
+void StreamRingBuffer::endFrame() {
+    if (!m_buffer || !m_inFrame) return;
+    if (m_fences[m_region]) glDeleteSync(m_fences[m_region]);
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_inFrame = false;
+}
+
+void* StreamRingBuffer::allocate(size_t bytes, size_t alignment, size_t& outOffset) {
+    if (!m_buffer || !m_inFrame) return nullptr;
+    if (alignment == 0) alignment = 1;
+
+    const size_t regionBase = static_cast<size_t>(m_region) * m_regionBytes;
+    size_t absolute = regionBase + m_regionUsed;
+    absolute = (absolute + alignment - 1) / alignment * alignment;
+    if (absolute + bytes > regionBase + m_regionBytes) return nullptr;
+
+    m_regionUsed = absolute + bytes - regionBase;
+    outOffset = absolute;
+    return m_mapped + absolute;
+}
+
+} // namespace gfx
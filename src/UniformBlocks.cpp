@@ -0,0 +1,141 @@
+/// @file UniformBlocks.cpp
+/// @brief Per-frame and per-draw uniform buffer implementation
+
+#include "UniformBlocks.h"
+#include "GLState.h"
+#include "StreamRingBuffer.h"
+
+#include <glad/gl.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace UniformBlocks {
+
+using FlockingShaders::DrawBlock;
+using FlockingShaders::FrameBlock;
+
+namespace {
+    // 2048 draw blocks per frame at a 256-byte offset alignment; beyond that draws fall
+    // back to updating a single block in place
+    constexpr size_t DRAW_REGION_BYTES = 1 << 20;
+
+    bool s_initialized = false;
+    size_t s_alignment = 256;
+
+    GLuint s_frameUBO = 0;
+    size_t s_frameStride = 0;
+    FrameBlock s_frames[FRAME_SLOT_COUNT] = {};
+    std::vector<unsigned char> s_frameStaging;
+
+    gfx::StreamRingBuffer s_drawRing;
+    GLuint s_drawFallbackUBO = 0;
+    DrawBlock s_draw;
+    DrawBlock s_boundDraw;
+    bool s_drawBound = false;
+
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool init() {
+    if (s_initialized) return true;
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    s_alignment = static_cast<size_t>(std::max(alignment, 16));
+
+    s_frameStride = alignUp(sizeof(FrameBlock), s_alignment);
+    s_frameStaging.assign(s_frameStride * FRAME_SLOT_COUNT, 0);
+    glGenBuffers(1, &s_frameUBO);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, s_frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(s_frameStaging.size()), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &s_drawFallbackUBO);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, s_drawFallbackUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(DrawBlock), nullptr, GL_STREAM_DRAW);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    if (!s_drawRing.create(GL_UNIFORM_BUFFER, DRAW_REGION_BYTES)) {
+        std::cout << "UniformBlocks: no persistent mapping, per-draw blocks use buffer updates" << std::endl;
+    }
+
+    s_draw = DrawBlock{};
+    s_drawBound = false;
+    s_initialized = true;
+    return true;
+}
+
+void cleanup() {
+    s_drawRing.destroy();
+    if (s_frameUBO) { GLState::deleteBuffers(1, &s_frameUBO); s_frameUBO = 0; }
+    if (s_drawFallbackUBO) { GLState::deleteBuffers(1, &s_drawFallbackUBO); s_drawFallbackUBO = 0; }
+    s_frameStaging.clear();
+    s_drawBound = false;
+    s_initialized = false;
+}
+
+void beginFrame() {
+    s_drawRing.beginFrame();
+    // The last bound block lives in the previous region, which this frame's fence won't cover
+    s_drawBound = false;
+}
+
+void endFrame() {
+    s_drawRing.endFrame();
+}
+
+FrameBlock& frame(FrameSlot slot) {
+    return s_frames[slot];
+}
+
+void uploadFrame() {
+    if (!s_initialized) return;
+    for (int slot = 0; slot < FRAME_SLOT_COUNT; ++slot) {
+        std::memcpy(s_frameStaging.data() + slot * s_frameStride, &s_frames[slot], sizeof(FrameBlock));
+    }
+    GLState::bufferSubData(s_frameUBO, 0, static_cast<GLsizeiptr>(s_frameStaging.size()), s_frameStaging.data());
+    bindFrame(SceneFrame);
+}
+
+void bindFrame(FrameSlot slot) {
+    if (!s_initialized) return;
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, FlockingShaders::FRAME_BINDING_POINT, s_frameUBO,
+                      static_cast<GLintptr>(slot * s_frameStride), sizeof(FrameBlock));
+}
+
+DrawBlock& draw() {
+    return s_draw;
+}
+
+void setTransforms(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection) {
+    const glm::mat4 modelView = view * model;
+    s_draw.M = model;
+    s_draw.MV = modelView;
+    s_draw.MVP = projection * modelView;
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelView)));
+    for (int c = 0; c < 3; ++c) s_draw.normalMatrix[c] = glm::vec4(normalMatrix[c], 0.0f);
+}
+
+void commitDraw() {
+    if (!s_initialized) return;
+    if (s_drawBound && std::memcmp(&s_draw, &s_boundDraw, sizeof(DrawBlock)) == 0) return;
+
+    size_t offset = 0;
+    void* dst = s_drawRing.allocate(sizeof(DrawBlock), s_alignment, offset);
+    if (dst) {
+        std::memcpy(dst, &s_draw, sizeof(DrawBlock));
+        GLState::bindBufferRange(GL_UNIFORM_BUFFER, FlockingShaders::DRAW_BINDING_POINT, s_drawRing.buffer(),
+                                   static_cast<GLintptr>(offset), sizeof(DrawBlock));
+    } else {
+        GLState::bufferSubData(s_drawFallbackUBO, 0, sizeof(DrawBlock), &s_draw);
+        GLState::bindBufferRange(GL_UNIFORM_BUFFER, FlockingShaders::DRAW_BINDING_POINT, s_drawFallbackUBO,
+                                   0, sizeof(DrawBlock));
+    }
+    s_boundDraw = s_draw;
+    s_drawBound = true;
+}
+
+} // namespace UniformBlocks
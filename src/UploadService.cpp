@@ -0,0 +1,215 @@
+/// @file UploadService.cpp
+/// @brief Shared-context upload worker implementation
+
+#include "UploadService.h"
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <iostream>
+
+namespace gfx {
+
+namespace {
+constexpr size_t kStagingAlignment = 16;
+
+bool fenceSignalled(GLsync fence) {
+    const GLenum result = glClientWaitSync(fence, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+} // namespace
+
+UploadService::~UploadService() {
+    stop();
+}
+
+bool UploadService::start(GLFWwindow* shareWith) {
+    if (m_window) return true;
+    if (!shareWith) {
+        std::cerr << "UploadService: no context to share with" << std::endl;
+        return false;
+    }
+
+    // Match the render context so both can share objects; only visibility differs
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glfwGetWindowAttrib(shareWith, GLFW_CONTEXT_VERSION_MAJOR));
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glfwGetWindowAttrib(shareWith, GLFW_CONTEXT_VERSION_MINOR));
+    glfwWindowHint(GLFW_OPENGL_PROFILE, glfwGetWindowAttrib(shareWith, GLFW_OPENGL_PROFILE));
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, glfwGetWindowAttrib(shareWith, GLFW_OPENGL_FORWARD_COMPAT));
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    m_window = glfwCreateWindow(1, 1, "SandboxGE uploads", nullptr, shareWith);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!m_window) {
+        std::cerr << "UploadService: failed to create shared upload context" << std::endl;
+        return false;
+    }
+
+    m_stopping = false;
+    m_worker = std::thread(&UploadService::workerLoop, this);
+    return true;
+}
+
+void UploadService::stop() {
+    if (!m_window) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    if (m_worker.joinable()) m_worker.join();
+
+    // The worker ran glFinish before exiting, so every remaining fence has signalled
+    poll();
+    glfwDestroyWindow(m_window);
+    m_window = nullptr;
+}
+
+UploadService::Ticket UploadService::submit(std::vector<Copy> copies) {
+    Ticket ticket = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_window || m_stopping) return 0;
+        ticket = m_nextTicket++;
+        m_jobs.push_back(Job{ticket, std::move(copies)});
+    }
+    m_wake.notify_one();
+    return ticket;
+}
+
+UploadService::Ticket UploadService::submit(GLuint buffer, size_t offset, const void* data, size_t bytes) {
+    std::vector<Copy> copies(1);
+    copies[0].buffer = buffer;
+    copies[0].offset = offset;
+    const unsigned char* src = static_cast<const unsigned char*>(data);
+    copies[0].bytes.assign(src, src + bytes);
+    return submit(std::move(copies));
+}
+
+void UploadService::poll() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_finished.empty()) {
+        Finished& done = m_finished.front();
+        if (!fenceSignalled(done.fence)) break;
+        glDeleteSync(done.fence);
+        m_completed.store(done.ticket);
+        m_finished.pop_front();
+    }
+}
+
+size_t UploadService::pendingJobs() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<size_t>(m_nextTicket - 1 - m_completed.load());
+}
+
+void UploadService::workerLoop() {
+    // GL entry points were loaded by the render thread; the shared context comes from the
+    // same driver and pixel format, so the same pointers are valid here.
+    glfwMakeContextCurrent(m_window);
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty()) break;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        runJob(job);
+    }
+
+    glFinish();
+    for (Staging& staging : m_staging) {
+        if (staging.fence) glDeleteSync(staging.fence);
+        glDeleteBuffers(1, &staging.buffer);
+    }
+    m_staging.clear();
+    glfwMakeContextCurrent(nullptr);
+}
+
+void UploadService::runJob(Job& job) {
+    size_t totalBytes = 0;
+    for (const Copy& copy : job.copies) {
+        totalBytes = (totalBytes + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+        totalBytes += copy.bytes.size();
+    }
+
+    if (totalBytes > 0) {
+        Staging& staging = acquireStaging(totalBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, staging.buffer);
+        unsigned char* mapped = static_cast<unsigned char*>(
+            glMapBufferRange(GL_COPY_READ_BUFFER, 0, static_cast<GLsizeiptr>(totalBytes),
+                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+        size_t offset = 0;
+        for (const Copy& copy : job.copies) {
+            offset = (offset + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+            if (mapped) {
+                std::memcpy(mapped + offset, copy.bytes.data(), copy.bytes.size());
+            } else {
+                glBufferSubData(GL_COPY_READ_BUFFER, static_cast<GLintptr>(offset),
+                                static_cast<GLsizeiptr>(copy.bytes.size()), copy.bytes.data());
+            }
+            offset += copy.bytes.size();
+        }
+        if (mapped) glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+        offset = 0;
+        for (const Copy& copy : job.copies) {
+            offset = (offset + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+            if (!copy.bytes.empty()) {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, copy.buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                    static_cast<GLintptr>(offset), static_cast<GLintptr>(copy.offset),
+                                    static_cast<GLsizeiptr>(copy.bytes.size()));
+            }
+            offset += copy.bytes.size();
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // Flush so the fence reaches the GPU; the render context cannot flush it for us
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_finished.push_back(Finished{job.ticket, fence});
+}
+
+UploadService::Staging& UploadService::acquireStaging(size_t bytes) {
+    // Prefer an idle buffer that is already big enough, then any idle one
+    Staging* idle = nullptr;
+    for (Staging& staging : m_staging) {
+        if (staging.fence && fenceSignalled(staging.fence)) {
+            glDeleteSync(staging.fence);
+            staging.fence = nullptr;
+        }
+        if (staging.fence) continue;
+        if (staging.capacity >= bytes) return staging;
+        if (!idle) idle = &staging;
+    }
+
+    if (!idle && m_staging.size() < MAX_STAGING_BUFFERS) {
+        m_staging.push_back(Staging{});
+        idle = &m_staging.back();
+        glGenBuffers(1, &idle->buffer);
+    }
+    if (!idle) {
+        // Every staging buffer is still being read: wait for one of the copies
+        idle = &m_staging.front();
+        glClientWaitSync(idle->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(idle->fence);
+        idle->fence = nullptr;
+        if (idle->capacity >= bytes) return *idle;
+    }
+
+    // Grow to the next power of two so steady-state jobs stop reallocating
+    size_t capacity = 1u << 16;
+    while (capacity < bytes) capacity <<= 1;
+    glBindBuffer(GL_COPY_READ_BUFFER, idle->buffer);
+    glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(capacity), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    idle->capacity = capacity;
+    return *idle;
+}
+
+} // namespace gfx
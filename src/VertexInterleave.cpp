@@ -0,0 +1,180 @@
+/// @file VertexInterleave.cpp
+/// @brief Scalar, SSE2 and AVX2 interleave kernels with runtime selection
+
+#include "VertexInterleave.h"
+#include "ParallelFor.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SANDBOX_INTERLEAVE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SANDBOX_TARGET_AVX2
+#else
+#define SANDBOX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace VertexInterleave {
+
+namespace {
+
+// Vertices per worker chunk; below this the thread handoff costs more than it saves
+constexpr int kParallelGrain = 32768;
+
+std::atomic<int> g_activePath{-1};
+
+void interleaveScalar(float* dst, const float* p, const float* n, const float* uv, int count) {
+    if (uv) {
+        for (int j = 0; j < count; ++j) {
+            float* v = dst + j * 8;
+            v[0] = p[j * 3 + 0];
+            v[1] = p[j * 3 + 1];
+            v[2] = p[j * 3 + 2];
+            v[3] = n[j * 3 + 0];
+            v[4] = n[j * 3 + 1];
+            v[5] = n[j * 3 + 2];
+            v[6] = uv[j * 2 + 0];
+            v[7] = uv[j * 2 + 1];
+        }
+    } else {
+        for (int j = 0; j < count; ++j) {
+            float* v = dst + j * 8;
+            v[0] = p[j * 3 + 0];
+            v[1] = p[j * 3 + 1];
+            v[2] = p[j * 3 + 2];
+            v[3] = n[j * 3 + 0];
+            v[4] = n[j * 3 + 1];
+            v[5] = n[j * 3 + 2];
+            v[6] = 0.0f;
+            v[7] = 0.0f;
+        }
+    }
+}
+
+#ifdef SANDBOX_INTERLEAVE_X86
+
+// One vertex per iteration as two 16-byte stores. The 4-wide loads overrun each
+// vertex by one float, so the last vertex goes through the scalar tail.
+void interleaveSSE2(float* dst, const float* p, const float* n, const float* uv, int count) {
+    int j = 0;
+    for (; j + 1 < count; ++j) {
+        __m128 pos = _mm_loadu_ps(p + j * 3);   // x y z x'
+        __m128 nrm = _mm_loadu_ps(n + j * 3);   // nx ny nz nx'
+        __m128 tex = uv ? _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(uv + j * 2)))
+                        : _mm_setzero_ps();     // u v 0 0
+        __m128 zn = _mm_shuffle_ps(pos, nrm, _MM_SHUFFLE(0, 0, 2, 2));    // z z nx nx
+        __m128 lo = _mm_shuffle_ps(pos, zn, _MM_SHUFFLE(2, 0, 1, 0));     // x y z nx
+        __m128 hi = _mm_shuffle_ps(nrm, tex, _MM_SHUFFLE(1, 0, 2, 1));    // ny nz u v
+        _mm_storeu_ps(dst + j * 8, lo);
+        _mm_storeu_ps(dst + j * 8 + 4, hi);
+    }
+    interleaveScalar(dst + j * 8, p + j * 3, n + j * 3, uv ? uv + j * 2 : nullptr, count - j);
+}
+
+// Two vertices per iteration as two 32-byte stores, built with cross-lane permutes.
+// The 8-wide loads cover 2 vertices plus 2 floats, so stop 3 vertices from the end.
+SANDBOX_TARGET_AVX2
+void interleaveAVX2(float* dst, const float* p, const float* n, const float* uv, int count) {
+    const __m256i posIdx0 = _mm256_setr_epi32(0, 1, 2, 0, 0, 0, 0, 0);
+    const __m256i nrmIdx0 = _mm256_setr_epi32(0, 0, 0, 0, 1, 2, 0, 0);
+    const __m256i uvIdx0 = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 0, 1);
+    const __m256i posIdx1 = _mm256_setr_epi32(3, 4, 5, 0, 0, 0, 0, 0);
+    const __m256i nrmIdx1 = _mm256_setr_epi32(0, 0, 0, 3, 4, 5, 0, 0);
+    const __m256i uvIdx1 = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 2, 3);
+
+    int j = 0;
+    for (; j + 3 <= count; j += 2) {
+        __m256 pos = _mm256_loadu_ps(p + j * 3);
+        __m256 nrm = _mm256_loadu_ps(n + j * 3);
+        __m256 tex = uv ? _mm256_castps128_ps256(_mm_loadu_ps(uv + j * 2)) : _mm256_setzero_ps();
+
+        __m256 v0 = _mm256_permutevar8x32_ps(pos, posIdx0);
+        v0 = _mm256_blend_ps(v0, _mm256_permutevar8x32_ps(nrm, nrmIdx0), 0x38);
+        v0 = _mm256_blend_ps(v0, _mm256_permutevar8x32_ps(tex, uvIdx0), 0xC0);
+
+        __m256 v1 = _mm256_permutevar8x32_ps(pos, posIdx1);
+        v1 = _mm256_blend_ps(v1, _mm256_permutevar8x32_ps(nrm, nrmIdx1), 0x38);
+        v1 = _mm256_blend_ps(v1, _mm256_permutevar8x32_ps(tex, uvIdx1), 0xC0);
+
+        _mm256_storeu_ps(dst + j * 8, v0);
+        _mm256_storeu_ps(dst + j * 8 + 8, v1);
+    }
+    interleaveSSE2(dst + j * 8, p + j * 3, n + j * 3, uv ? uv + j * 2 : nullptr, count - j);
+}
+
+bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;  // OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // SANDBOX_INTERLEAVE_X86
+
+Path detectPath() {
+#ifdef SANDBOX_INTERLEAVE_X86
+    return cpuHasAVX2() ? Path::AVX2 : Path::SSE2;
+#else
+    return Path::Scalar;
+#endif
+}
+
+} // anonymous namespace
+
+Path bestPath() {
+    static const Path best = detectPath();
+    return best;
+}
+
+Path activePath() {
+    int path = g_activePath.load(std::memory_order_relaxed);
+    return path < 0 ? bestPath() : static_cast<Path>(path);
+}
+
+void setActivePath(Path path) {
+    if (static_cast<int>(path) > static_cast<int>(bestPath())) path = bestPath();
+    g_activePath.store(static_cast<int>(path), std::memory_order_relaxed);
+}
+
+const char* pathName(Path path) {
+    switch (path) {
+        case Path::SSE2: return "SSE2";
+        case Path::AVX2: return "AVX2";
+        default: return "Scalar";
+    }
+}
+
+void interleaveWith(Path path, float* dst, const float* positions, const float* normals,
+                    const float* uvs, int count) {
+    if (count <= 0) return;
+    if (static_cast<int>(path) > static_cast<int>(bestPath())) path = bestPath();
+    switch (path) {
+#ifdef SANDBOX_INTERLEAVE_X86
+        case Path::AVX2: interleaveAVX2(dst, positions, normals, uvs, count); break;
+        case Path::SSE2: interleaveSSE2(dst, positions, normals, uvs, count); break;
+#endif
+        default: interleaveScalar(dst, positions, normals, uvs, count); break;
+    }
+}
+
+void interleave(float* dst, const float* positions, const float* normals, const float* uvs, int count) {
+    const Path path = activePath();
+    Parallel::forRange(count, kParallelGrain, [&](int begin, int end) {
+        interleaveWith(path, dst + begin * 8, positions + begin * 3, normals + begin * 3,
+                       uvs ? uvs + begin * 2 : nullptr, end - begin);
+    });
+}
+
+} // namespace VertexInterleave
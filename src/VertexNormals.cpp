@@ -0,0 +1,306 @@
+/// @file VertexNormals.cpp
+/// @brief CPU kernels and compute dispatch for generated vertex normals
+
+#include "VertexNormals.h"
+#include "GLState.h"
+#include "ParallelFor.h"
+#include "ShaderPathResolver.h"
+
+#include <ShaderLib.h>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SANDBOX_NORMALS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace VertexNormals {
+
+namespace {
+
+// Faces/vertices per worker chunk
+constexpr int kParallelGrain = 16384;
+constexpr GLuint kWorkgroupSize = 256;   // matches local_size_x in VertexNormals.comp
+
+// Face normals and per-vertex sums use 4 floats each so the SSE path loads/stores whole lanes
+void faceNormals(float* faces, const float* positions, int vertexCount,
+                 const uint32_t* indices, int begin, int end) {
+    for (int t = begin; t < end; ++t) {
+        const uint32_t i0 = indices[t * 3];
+        const uint32_t i1 = indices[t * 3 + 1];
+        const uint32_t i2 = indices[t * 3 + 2];
+        float* out = faces + t * 4;
+        const uint32_t count = static_cast<uint32_t>(vertexCount);
+        if (i0 >= count || i1 >= count || i2 >= count) {
+            out[0] = out[1] = out[2] = out[3] = 0.0f;
+            continue;
+        }
+        const float* p0 = positions + i0 * 3;
+        const float* p1 = positions + i1 * 3;
+        const float* p2 = positions + i2 * 3;
+#ifdef SANDBOX_NORMALS_SSE2
+        const __m128 a = _mm_setr_ps(p0[0], p0[1], p0[2], 0.0f);
+        const __m128 e1 = _mm_sub_ps(_mm_setr_ps(p1[0], p1[1], p1[2], 0.0f), a);
+        const __m128 e2 = _mm_sub_ps(_mm_setr_ps(p2[0], p2[1], p2[2], 0.0f), a);
+        // cross = e1.yzx * e2.zxy - e1.zxy * e2.yzx (w stays 0)
+        const __m128 lhs = _mm_mul_ps(_mm_shuffle_ps(e1, e1, _MM_SHUFFLE(3, 0, 2, 1)),
+                                      _mm_shuffle_ps(e2, e2, _MM_SHUFFLE(3, 1, 0, 2)));
+        const __m128 rhs = _mm_mul_ps(_mm_shuffle_ps(e1, e1, _MM_SHUFFLE(3, 1, 0, 2)),
+                                      _mm_shuffle_ps(e2, e2, _MM_SHUFFLE(3, 0, 2, 1)));
+        _mm_storeu_ps(out, _mm_sub_ps(lhs, rhs));
+#else
+        const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        out[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        out[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        out[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        out[3] = 0.0f;
+#endif
+    }
+}
+
+// Serial: a streaming add over the index list, cheaper than building adjacency per call
+void scatterFaces(float* sums, const float* faces, const uint32_t* indices, int vertexCount,
+                  int triangleCount) {
+    std::fill(sums, sums + static_cast<size_t>(vertexCount) * 4, 0.0f);
+    const uint32_t count = static_cast<uint32_t>(vertexCount);
+    for (int t = 0; t < triangleCount; ++t) {
+        const float* face = faces + t * 4;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = indices[t * 3 + k];
+            if (v >= count) continue;
+            float* sum = sums + static_cast<size_t>(v) * 4;
+#ifdef SANDBOX_NORMALS_SSE2
+            _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), _mm_loadu_ps(face)));
+#else
+            sum[0] += face[0];
+            sum[1] += face[1];
+            sum[2] += face[2];
+#endif
+        }
+    }
+}
+
+void normalizeSums(float* normals, const float* sums, int begin, int end) {
+    for (int v = begin; v < end; ++v) {
+        const float* s = sums + static_cast<size_t>(v) * 4;
+        float* n = normals + static_cast<size_t>(v) * 3;
+        const float len2 = s[0] * s[0] + s[1] * s[1] + s[2] * s[2];
+        if (len2 > 0.0f) {
+            const float inv = 1.0f / std::sqrt(len2);
+            n[0] = s[0] * inv;
+            n[1] = s[1] * inv;
+            n[2] = s[2] * inv;
+        } else {
+            n[0] = 0.0f;
+            n[1] = 1.0f;
+            n[2] = 0.0f;
+        }
+    }
+}
+
+// GPU state
+bool g_gpuTried = false;
+GLuint g_scatterProgram = 0;
+GLuint g_resolveProgram = 0;
+GLuint g_accumBuffer = 0;
+size_t g_accumVertices = 0;
+
+// Uniform locations of one compute program, looked up once after it links
+struct ViewUniforms {
+    GLint positionBase = -1;
+    GLint positionStride = -1;
+    GLint normalBase = -1;
+    GLint normalStride = -1;
+    GLint firstIndex = -1;
+    GLint shortIndices = -1;
+    GLint itemCount = -1;
+    GLint vertexCount = -1;
+    GLint fixedScale = -1;
+
+    void locate(GLuint program) {
+        positionBase = glGetUniformLocation(program, "positionBase");
+        positionStride = glGetUniformLocation(program, "positionStride");
+        normalBase = glGetUniformLocation(program, "normalBase");
+        normalStride = glGetUniformLocation(program, "normalStride");
+        firstIndex = glGetUniformLocation(program, "firstIndex");
+        shortIndices = glGetUniformLocation(program, "shortIndices");
+        itemCount = glGetUniformLocation(program, "itemCount");
+        vertexCount = glGetUniformLocation(program, "vertexCount");
+        fixedScale = glGetUniformLocation(program, "fixedScale");
+    }
+};
+ViewUniforms g_scatterUniforms;
+ViewUniforms g_resolveUniforms;
+
+GLuint buildProgram(const std::string& source) {
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    const char* src = source.c_str();
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "VertexNormals compute compile error: " << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "VertexNormals compute link error: " << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ensureAccumulator(int vertexCount) {
+    const size_t vertices = static_cast<size_t>(vertexCount);
+    if (g_accumBuffer && vertices <= g_accumVertices) return;
+    // Grow with headroom; the resolve pass keeps every used entry zeroed afterwards
+    g_accumVertices = std::max(vertices + vertices / 2, g_accumVertices * 2);
+    const std::vector<int32_t> zeros(g_accumVertices * 3, 0);
+    if (!g_accumBuffer) glGenBuffers(1, &g_accumBuffer);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, g_accumBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(zeros.size() * sizeof(int32_t)),
+                 zeros.data(), GL_DYNAMIC_COPY);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void setViewUniforms(const ViewUniforms& uniforms, const GpuMeshView& view, GLuint itemCount) {
+    glUniform1ui(uniforms.positionBase, view.positionBase);
+    glUniform1ui(uniforms.positionStride, view.positionStride);
+    glUniform1ui(uniforms.normalBase, view.normalBase);
+    glUniform1ui(uniforms.normalStride, view.normalStride);
+    glUniform1ui(uniforms.firstIndex, view.firstIndex);
+    glUniform1ui(uniforms.shortIndices, view.shortIndices ? 1u : 0u);
+    glUniform1ui(uniforms.itemCount, itemCount);
+    glUniform1ui(uniforms.vertexCount, static_cast<GLuint>(view.vertexCount));
+    glUniform1f(uniforms.fixedScale, view.fixedScale);
+}
+
+} // anonymous namespace
+
+void compute(float* normals, const float* positions, int vertexCount,
+             const uint32_t* indices, int indexCount) {
+    if (vertexCount <= 0) return;
+    thread_local std::vector<float> faces;
+    thread_local std::vector<float> sums;
+
+    const int triangleCount = indices ? indexCount / 3 : 0;
+    faces.resize(static_cast<size_t>(triangleCount) * 4);
+    sums.resize(static_cast<size_t>(vertexCount) * 4);
+
+    float* faceData = faces.data();
+    float* sumData = sums.data();
+    Parallel::forRange(triangleCount, kParallelGrain, [&](int begin, int end) {
+        faceNormals(faceData, positions, vertexCount, indices, begin, end);
+    });
+    scatterFaces(sumData, faceData, indices, vertexCount, triangleCount);
+    Parallel::forRange(vertexCount, kParallelGrain, [&](int begin, int end) {
+        normalizeSums(normals, sumData, begin, end);
+    });
+}
+
+float fixedPointScale(const float* positions, int vertexCount, const uint32_t* indices, int indexCount) {
+    const int triangleCount = indices ? indexCount / 3 : 0;
+    const int step = std::max(1, triangleCount / 64);
+    const uint32_t count = static_cast<uint32_t>(std::max(vertexCount, 0));
+    double total = 0.0;
+    int samples = 0;
+    for (int t = 0; t < triangleCount; t += step) {
+        const uint32_t* tri = indices + t * 3;
+        if (tri[0] >= count || tri[1] >= count || tri[2] >= count) continue;
+        const glm::vec3 a = glm::make_vec3(positions + tri[0] * 3);
+        const glm::vec3 c = glm::cross(glm::make_vec3(positions + tri[1] * 3) - a,
+                                       glm::make_vec3(positions + tri[2] * 3) - a);
+        total += glm::length(c);
+        ++samples;
+    }
+    const double mean = samples ? total / samples : 0.0;
+    return mean > 0.0 ? static_cast<float>(65536.0 / mean) : 1.0f;
+}
+
+bool gpuAvailable() {
+    if (!g_gpuTried) {
+        g_gpuTried = true;
+        if (!GLAD_GL_ARB_compute_shader || !GLAD_GL_ARB_shader_storage_buffer_object ||
+            !GLAD_GL_ARB_shader_image_load_store) {
+            return false;
+        }
+        const std::string source = ShaderPath::loadSource("shaders/VertexNormals.comp");
+        if (source.empty()) return false;
+        g_scatterProgram = buildProgram(source);
+        g_resolveProgram = buildProgram(ShaderLib::injectDefines(source, "#define NORMALS_RESOLVE 1\n"));
+        if (!g_scatterProgram || !g_resolveProgram) {
+            std::cerr << "VertexNormals: compute path unavailable, using CPU normals" << std::endl;
+            if (g_scatterProgram) glDeleteProgram(g_scatterProgram);
+            if (g_resolveProgram) glDeleteProgram(g_resolveProgram);
+            g_scatterProgram = g_resolveProgram = 0;
+        } else {
+            g_scatterUniforms.locate(g_scatterProgram);
+            g_resolveUniforms.locate(g_resolveProgram);
+        }
+    }
+    return g_scatterProgram != 0 && g_resolveProgram != 0;
+}
+
+void computeGpu(const GpuMeshView& view) {
+    const GLuint triangleCount = static_cast<GLuint>(view.indexCount / 3);
+    if (view.vertexCount <= 0 || !gpuAvailable()) return;
+    ensureAccumulator(view.vertexCount);
+
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, view.positionBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, view.normalBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, view.indexBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, g_accumBuffer);
+
+    if (triangleCount > 0) {
+        GLState::useProgram(g_scatterProgram);
+        setViewUniforms(g_scatterUniforms, view, triangleCount);
+        glDispatchCompute((triangleCount + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    const GLuint vertexCount = static_cast<GLuint>(view.vertexCount);
+    GLState::useProgram(g_resolveProgram);
+    setViewUniforms(g_resolveUniforms, view, vertexCount);
+    glDispatchCompute((vertexCount + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+    // The next mesh's scatter reuses the accumulator the resolve just cleared
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    GLState::useProgram(0);
+}
+
+void finishGpu() {
+    if (!g_scatterProgram) return;
+    // Vertex fetch, and buffer copies/updates that read or overwrite the same slots
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void cleanupGpu() {
+    if (g_scatterProgram) glDeleteProgram(g_scatterProgram);
+    if (g_resolveProgram) glDeleteProgram(g_resolveProgram);
+    if (g_accumBuffer) GLState::deleteBuffers(1, &g_accumBuffer);
+    g_scatterProgram = g_resolveProgram = g_accumBuffer = 0;
+    g_accumVertices = 0;
+    g_scatterUniforms = ViewUniforms{};
+    g_resolveUniforms = ViewUniforms{};
+    g_gpuTried = false;
+}
+
+} // namespace VertexNormals
@@ -0,0 +1,100 @@
+/// @file VertexPacking.cpp
+/// @brief Encode kernels for the packed vertex format
+
+#include "VertexPacking.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+namespace VertexPacking {
+
+namespace {
+
+constexpr int kParallelGrain = 32768;
+
+uint16_t quantizeUnorm16(float v, float minV, float invExtent) {
+    float t = (v - minV) * invExtent;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    return static_cast<uint16_t>(t * 65535.0f + 0.5f);
+}
+
+int16_t quantizeSnorm16(float v) {
+    v = std::min(std::max(v, -1.0f), 1.0f);
+    return static_cast<int16_t>(std::lround(v * 32767.0f));
+}
+
+} // anonymous namespace
+
+void computeBounds(const float* positions, int count, glm::vec3& outMin, glm::vec3& outMax) {
+    if (count <= 0) {
+        outMin = outMax = glm::vec3(0.0f);
+        return;
+    }
+    glm::vec3 lo(positions[0], positions[1], positions[2]);
+    glm::vec3 hi = lo;
+    for (int i = 1; i < count; ++i) {
+        const float* p = positions + i * 3;
+        lo.x = std::min(lo.x, p[0]); hi.x = std::max(hi.x, p[0]);
+        lo.y = std::min(lo.y, p[1]); hi.y = std::max(hi.y, p[1]);
+        lo.z = std::min(lo.z, p[2]); hi.z = std::max(hi.z, p[2]);
+    }
+    outMin = lo;
+    outMax = hi;
+}
+
+glm::vec3 dequantScale(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    return boundsMax - boundsMin;
+}
+
+void encodeOctNormal(const float* n, int16_t out[2]) {
+    float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+    if (l1 <= 0.0f) {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
+    float x = n[0] / l1;
+    float y = n[1] / l1;
+    if (n[2] < 0.0f) {
+        // Fold the lower hemisphere over the diagonals
+        float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    out[0] = quantizeSnorm16(x);
+    out[1] = quantizeSnorm16(y);
+}
+
+void pack(PackedVertex* dst, const float* positions, const float* normals, const float* uvs, int count,
+          const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    const glm::vec3 extent = boundsMax - boundsMin;
+    // Flat axes quantize to 0 and decode back to the bound exactly
+    const glm::vec3 invExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                              extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                              extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+    Parallel::forRange(count, kParallelGrain, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const float* p = positions + i * 3;
+            PackedVertex v;
+            v.position[0] = quantizeUnorm16(p[0], boundsMin.x, invExtent.x);
+            v.position[1] = quantizeUnorm16(p[1], boundsMin.y, invExtent.y);
+            v.position[2] = quantizeUnorm16(p[2], boundsMin.z, invExtent.z);
+            v.position[3] = 0;
+            encodeOctNormal(normals + i * 3, v.normal);
+            if (uvs) {
+                v.uv[0] = glm::packHalf1x16(uvs[i * 2 + 0]);
+                v.uv[1] = glm::packHalf1x16(uvs[i * 2 + 1]);
+            } else {
+                v.uv[0] = 0;
+                v.uv[1] = 0;
+            }
+            dst[i] = v;
+        }
+    });
+}
+
+} // namespace VertexPacking
@@ -0,0 +1,23 @@
+#pragma once
+/// @file TestCheck.h
+/// @brief Minimal checks for the CPU tests: a failed CHECK prints its location and is
+/// counted, and main returns TEST_RESULT() so ctest sees the failure.
+
+#include <cstdio>
+
+namespace TestCheck {
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+} // namespace TestCheck
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);  \
+            ++TestCheck::failures();                                                            \
+        }                                                                                       \
+    } while (0)
+
+#define TEST_RESULT() (TestCheck::failures() == 0 ? 0 : 1)
@@ -0,0 +1,59 @@
+#pragma once
+/// @file TestContext.h
+/// @brief Hidden GL 4.3 core context for the tests that drive the engine. Tests exit
+/// with TestContext::SKIP when it cannot be created, which CTest reports as skipped.
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include <GLState.h>
+
+#include <cstdio>
+
+class TestContext {
+public:
+    static constexpr int SKIP = 77;
+
+    explicit TestContext(const char* name) : m_name(name) {
+        if (!glfwInit()) {
+            std::printf("%s: skipped (no GLFW)\n", name);
+            return;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        m_window = glfwCreateWindow(64, 64, name, nullptr, nullptr);
+        if (!m_window) {
+            std::printf("%s: skipped (no GL 4.3 context)\n", name);
+            return;
+        }
+        glfwMakeContextCurrent(m_window);
+        if (!gladLoadGL(glfwGetProcAddress)) {
+            std::printf("%s: skipped (GL functions failed to load)\n", name);
+            return;
+        }
+        GLState::init();
+        m_ready = true;
+    }
+
+    ~TestContext() {
+        if (m_window) glfwDestroyWindow(m_window);
+        glfwTerminate();
+    }
+
+    TestContext(const TestContext&) = delete;
+    TestContext& operator=(const TestContext&) = delete;
+
+    bool ready() const { return m_ready; }
+    /// Report a missing feature and return the skip code
+    int skip(const char* reason) const {
+        std::printf("%s: skipped (%s)\n", m_name, reason);
+        return SKIP;
+    }
+
+private:
+    const char* m_name;
+    GLFWwindow* m_window = nullptr;
+    bool m_ready = false;
+};
@@ -0,0 +1,82 @@
+/// @file index_format_test.cpp
+/// @brief IndexFormat range detection and 16-bit narrowing against a scalar reference,
+/// across SIMD block and tail counts, including indices at the 16-bit boundary.
+
+#include "TestCheck.h"
+
+#include <IndexFormat.h>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+const size_t kCounts[] = {0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 1000, 1001};
+
+std::vector<uint32_t> randomIndices(size_t count, uint32_t limit, std::mt19937& rng) {
+    std::uniform_int_distribution<uint32_t> dist(0, limit);
+    std::vector<uint32_t> indices(count);
+    for (uint32_t& i : indices) i = dist(rng);
+    return indices;
+}
+
+void testFitsUint16(std::mt19937& rng) {
+    for (size_t count : kCounts) {
+        std::vector<uint32_t> indices = randomIndices(count, 0xFFFFu, rng);
+        CHECK(IndexFormat::fitsUint16(indices.data(), count));
+        if (count == 0) continue;
+
+        // One wide index anywhere (SIMD block or scalar tail) rejects the list
+        for (size_t at : {size_t(0), count / 2, count - 1}) {
+            const uint32_t saved = indices[at];
+            indices[at] = 0x10000u;
+            CHECK(!IndexFormat::fitsUint16(indices.data(), count));
+            indices[at] = 0xFFFFFFFFu;
+            CHECK(!IndexFormat::fitsUint16(indices.data(), count));
+            indices[at] = saved;
+        }
+    }
+}
+
+void testNarrow(std::mt19937& rng) {
+    for (size_t count : kCounts) {
+        std::vector<uint32_t> indices = randomIndices(count, 0xFFFFu, rng);
+        // Values with bit 15 set exercise the sign-extending pack
+        if (count > 0) indices[0] = 0xFFFFu;
+        if (count > 1) indices[count - 1] = 0x8000u;
+        if (count > 2) indices[count / 2] = 0x7FFFu;
+
+        // One guard element past the end must stay untouched
+        std::vector<uint16_t> out(count + 1, 0xABCDu);
+        IndexFormat::narrow(out.data(), indices.data(), count);
+        for (size_t i = 0; i < count; ++i) CHECK(out[i] == static_cast<uint16_t>(indices[i]));
+        CHECK(out[count] == 0xABCDu);
+    }
+}
+
+void testNarrowPadded(std::mt19937& rng) {
+    for (size_t count : kCounts) {
+        const std::vector<uint32_t> indices = randomIndices(count, 0xFFFFu, rng);
+        std::vector<uint16_t> out(3, 0xABCDu);
+        const size_t bytes = IndexFormat::narrowPadded(out, indices.data(), count);
+
+        const size_t padded = count + (count & 1);
+        CHECK(bytes == padded * sizeof(uint16_t));
+        CHECK(bytes % 4 == 0);
+        CHECK(out.size() == padded);
+        for (size_t i = 0; i < count; ++i) CHECK(out[i] == static_cast<uint16_t>(indices[i]));
+        if (padded != count) CHECK(out[count] == 0);
+    }
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(11);
+    testFitsUint16(rng);
+    testNarrow(rng);
+    testNarrowPadded(rng);
+    if (TEST_RESULT() == 0) std::printf("index format: ok\n");
+    return TEST_RESULT();
+}
@@ -0,0 +1,166 @@
+/// @file light_clusters_test.cpp
+/// @brief CPU light assignment: every light reaching a point is listed in the point's
+/// cluster, lights out of view are listed nowhere, indices follow the enabled lights,
+/// and lists stop at MAX_LIGHTS_PER_CLUSTER.
+
+#include "TestCheck.h"
+
+#include <LightClusters.h>
+#include <ParallelFor.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace LightClusters;
+
+namespace {
+
+constexpr float kNear = 0.1f;
+constexpr float kFar = 200.0f;
+
+struct View {
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, kNear, kFar);
+};
+
+gfx::ExtraLight makeLight(const glm::vec3& position, float range, bool enabled = true) {
+    gfx::ExtraLight light;
+    light.enabled = enabled;
+    light.position[0] = position.x;
+    light.position[1] = position.y;
+    light.position[2] = position.z;
+    light.range = range;
+    return light;
+}
+
+// Cluster a world point falls in, as the lit shaders find it; -1 outside the view
+int clusterOf(const View& v, const glm::vec3& world) {
+    const glm::vec4 viewPos = v.view * glm::vec4(world, 1.0f);
+    const float depth = -viewPos.z;
+    if (depth <= kNear || depth >= kFar) return -1;
+    const glm::vec4 clip = v.projection * viewPos;
+    const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+    if (std::fabs(ndc.x) >= 1.0f || std::fabs(ndc.y) >= 1.0f) return -1;
+    const int x = std::min(static_cast<int>((ndc.x * 0.5f + 0.5f) * CLUSTERS_X), CLUSTERS_X - 1);
+    const int y = std::min(static_cast<int>((ndc.y * 0.5f + 0.5f) * CLUSTERS_Y), CLUSTERS_Y - 1);
+    const int z = std::min(static_cast<int>(std::log(depth / kNear) / std::log(kFar / kNear) * CLUSTERS_Z),
+                           CLUSTERS_Z - 1);
+    return (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+}
+
+bool listed(const std::vector<uint32_t>& ranges, const std::vector<uint32_t>& indices, int cluster, uint32_t light) {
+    const uint32_t offset = ranges[cluster * 2];
+    const uint32_t count = ranges[cluster * 2 + 1];
+    return std::find(indices.begin() + offset, indices.begin() + offset + count, light) != indices.begin() + offset + count;
+}
+
+void testEveryReachingLightIsListed() {
+    const View v;
+    std::mt19937 rng(20);
+    std::uniform_real_distribution<float> coord(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> range(0.5f, 12.0f);
+    std::vector<gfx::ExtraLight> lights;
+    for (int i = 0; i < 60; ++i) lights.push_back(makeLight(glm::vec3(coord(rng), coord(rng) * 0.3f, coord(rng)), range(rng)));
+
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices;
+    assign(lights, v.view, v.projection, kNear, kFar, ranges, indices);
+    CHECK(ranges.size() == static_cast<size_t>(CLUSTER_COUNT) * 2);
+
+    // Lists are well formed and never exceed the cap
+    for (int cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+        CHECK(ranges[cluster * 2] + ranges[cluster * 2 + 1] <= indices.size());
+        CHECK(ranges[cluster * 2 + 1] <= static_cast<uint32_t>(MAX_LIGHTS_PER_CLUSTER));
+    }
+    for (uint32_t light : indices) CHECK(light < lights.size());
+
+    // Points inside a light's sphere (with a margin against cluster boundaries)
+    int checkedPoints = 0;
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (uint32_t l = 0; l < lights.size(); ++l) {
+        const glm::vec3 center(lights[l].position[0], lights[l].position[1], lights[l].position[2]);
+        for (int s = 0; s < 40; ++s) {
+            glm::vec3 offset(unit(rng), unit(rng), unit(rng));
+            if (glm::length(offset) > 1.0f) continue;
+            const glm::vec3 point = center + offset * lights[l].range * 0.99f;
+            const int cluster = clusterOf(v, point);
+            if (cluster < 0) continue;
+            CHECK(listed(ranges, indices, cluster, l));
+            ++checkedPoints;
+        }
+    }
+    CHECK(checkedPoints > 100);
+}
+
+void testOutOfViewLightsAreNotListed() {
+    const View v;
+    std::vector<gfx::ExtraLight> lights = {
+        makeLight(glm::vec3(0.0f, 5.0f, 60.0f), 10.0f),     // behind the camera
+        makeLight(glm::vec3(0.0f, 0.0f, 0.0f), 2.0f),       // in view
+        makeLight(glm::vec3(0.0f, 0.0f, -400.0f), 50.0f),   // beyond the far plane
+        makeLight(glm::vec3(300.0f, 0.0f, 0.0f), 5.0f),     // far to the side
+    };
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices;
+    assign(lights, v.view, v.projection, kNear, kFar, ranges, indices);
+    CHECK(!indices.empty());
+    for (uint32_t light : indices) CHECK(light == 1);
+    CHECK(listed(ranges, indices, clusterOf(v, glm::vec3(0.0f)), 1));
+}
+
+void testIndicesFollowEnabledLights() {
+    const View v;
+    // Disabled and zero-range lights are skipped, so the visible light is entry 1
+    std::vector<gfx::ExtraLight> lights = {
+        makeLight(glm::vec3(0.0f, 0.0f, 0.0f), 3.0f, false),
+        makeLight(glm::vec3(300.0f, 0.0f, 0.0f), 1.0f),
+        makeLight(glm::vec3(0.0f, 0.0f, 0.0f), 0.0f),
+        makeLight(glm::vec3(0.0f, 0.0f, 0.0f), 3.0f),
+    };
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices;
+    assign(lights, v.view, v.projection, kNear, kFar, ranges, indices);
+    CHECK(!indices.empty());
+    for (uint32_t light : indices) CHECK(light == 1);
+}
+
+void testListCap() {
+    const View v;
+    std::vector<gfx::ExtraLight> lights(MAX_LIGHTS_PER_CLUSTER + 40, makeLight(glm::vec3(0.0f), 4.0f));
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices;
+    assign(lights, v.view, v.projection, kNear, kFar, ranges, indices);
+    const int cluster = clusterOf(v, glm::vec3(0.0f));
+    CHECK(ranges[cluster * 2 + 1] == static_cast<uint32_t>(MAX_LIGHTS_PER_CLUSTER));
+    // The first lights win
+    CHECK(listed(ranges, indices, cluster, 0));
+    CHECK(!listed(ranges, indices, cluster, MAX_LIGHTS_PER_CLUSTER));
+}
+
+void testBadPlanes() {
+    const View v;
+    std::vector<gfx::ExtraLight> lights = {makeLight(glm::vec3(0.0f), 4.0f)};
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices = {7};
+    assign(lights, v.view, v.projection, kNear, kNear, ranges, indices);
+    CHECK(indices.empty());
+    CHECK(std::all_of(ranges.begin(), ranges.end(), [](uint32_t r) { return r == 0; }));
+}
+
+} // namespace
+
+int main() {
+    testEveryReachingLightIsListed();
+    testOutOfViewLightsAreNotListed();
+    testIndicesFollowEnabledLights();
+    testListCap();
+    testBadPlanes();
+    Parallel::shutdown();
+    if (TEST_RESULT() == 0) std::printf("light clusters: ok\n");
+    return TEST_RESULT();
+}
@@ -0,0 +1,213 @@
+/// @file meshlets_test.cpp
+/// @brief Meshlet building, bounds refit and culling: the meshlet order is a permutation
+/// of the triangles, spheres hold their vertices, and cone culling only ever drops
+/// triangles that face away from the eye.
+
+#include "TestCheck.h"
+
+#include <Meshlets.h>
+#include <ParallelFor.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Surface {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    size_t vertexCount = 0;
+};
+
+// Height field facing +Y; amplitude 0 gives a flat sheet whose meshlet cones are tight
+Surface makeSurface(int side, float amplitude) {
+    Surface surface;
+    for (int z = 0; z < side; ++z) {
+        for (int x = 0; x < side; ++x) {
+            const float fx = static_cast<float>(x);
+            const float fz = static_cast<float>(z);
+            surface.positions.push_back(fx);
+            surface.positions.push_back(amplitude * std::sin(fx * 0.3f) * std::cos(fz * 0.25f));
+            surface.positions.push_back(fz);
+        }
+    }
+    for (int z = 0; z + 1 < side; ++z) {
+        for (int x = 0; x + 1 < side; ++x) {
+            const uint32_t i = static_cast<uint32_t>(z * side + x);
+            const uint32_t s = static_cast<uint32_t>(side);
+            surface.indices.insert(surface.indices.end(), {i, i + s, i + 1, i + 1, i + s, i + s + 1});
+        }
+    }
+    surface.vertexCount = static_cast<size_t>(side) * side;
+    return surface;
+}
+
+glm::vec3 position(const Surface& surface, uint32_t v) {
+    return glm::vec3(surface.positions[v * 3], surface.positions[v * 3 + 1], surface.positions[v * 3 + 2]);
+}
+
+// Everything fits inside, whatever the eye, so only the cone test can drop meshlets
+Meshlets::Frustum everything() {
+    return Meshlets::extractFrustum(glm::ortho(-1e4f, 1e4f, -1e4f, 1e4f, -1e4f, 1e4f));
+}
+
+std::vector<uint32_t> buildOrdered(Meshlets::ClusterSet& set, const Surface& surface) {
+    std::vector<uint32_t> ordered(surface.indices.size());
+    Meshlets::build(set, ordered.data(), surface.indices.data(), surface.indices.size(), surface.vertexCount);
+    Meshlets::refit(set, surface.positions.data(), surface.vertexCount, 1);
+    return ordered;
+}
+
+// Triangles of the ordered index list covered by the culled ranges
+std::vector<bool> keptTriangles(const std::vector<Meshlets::IndexRange>& ranges, size_t triangleCount) {
+    std::vector<bool> kept(triangleCount, false);
+    for (const Meshlets::IndexRange& range : ranges) {
+        for (uint32_t i = range.firstIndex; i < range.firstIndex + range.count; i += 3) kept[i / 3] = true;
+    }
+    return kept;
+}
+
+void testBuild() {
+    const Surface surface = makeSurface(80, 3.0f);
+    Meshlets::ClusterSet set;
+    const std::vector<uint32_t> ordered = buildOrdered(set, surface);
+    CHECK(!set.empty());
+    CHECK(set.bounds.size() == set.meshlets.size());
+
+    // Same triangles (corners kept in order) in a different sequence
+    auto triangles = [](const std::vector<uint32_t>& indices) {
+        std::vector<std::array<uint32_t, 3>> out;
+        for (size_t i = 0; i < indices.size(); i += 3) out.push_back({indices[i], indices[i + 1], indices[i + 2]});
+        std::sort(out.begin(), out.end());
+        return out;
+    };
+    CHECK(triangles(ordered) == triangles(surface.indices));
+
+    // Meshlets tile the ordered list within their limits, and spheres hold their vertices
+    uint32_t nextIndex = 0;
+    for (size_t m = 0; m < set.meshlets.size(); ++m) {
+        const Meshlets::Meshlet& meshlet = set.meshlets[m];
+        const Meshlets::Bounds& bounds = set.bounds[m];
+        CHECK(meshlet.firstIndex == nextIndex);
+        nextIndex += meshlet.triangleCount * 3;
+        CHECK(meshlet.triangleCount <= Meshlets::kMaxTriangles);
+        CHECK(meshlet.vertexCount <= Meshlets::kMaxVertices);
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i) {
+            const glm::vec3 p = position(surface, ordered[meshlet.firstIndex + i]);
+            CHECK(glm::length(p - bounds.center) <= bounds.radius * 1.0001f + 1e-5f);
+        }
+    }
+    CHECK(nextIndex == ordered.size());
+}
+
+void testFlatSheetCones() {
+    const Surface surface = makeSurface(80, 0.0f);
+    Meshlets::ClusterSet set;
+    const std::vector<uint32_t> ordered = buildOrdered(set, surface);
+    const size_t triangleCount = ordered.size() / 3;
+
+    for (const Meshlets::Bounds& bounds : set.bounds) {
+        CHECK(bounds.coneAxis.y > 0.9999f);
+        CHECK(bounds.coneCos > 0.9999f);
+    }
+
+    const Meshlets::Frustum frustum = everything();
+    std::vector<Meshlets::IndexRange> ranges;
+    const glm::vec3 above(40.0f, 50.0f, 40.0f);
+    CHECK(Meshlets::cull(set, frustum, &above, ranges) == triangleCount);
+    // Front-facing neighbours merge into one range
+    CHECK(ranges.size() == 1);
+
+    ranges.clear();
+    const glm::vec3 below(40.0f, -50.0f, 40.0f);
+    CHECK(Meshlets::cull(set, frustum, &below, ranges) == 0);
+    CHECK(ranges.empty());
+
+    // Without an eye there is no backface test
+    CHECK(Meshlets::cull(set, frustum, nullptr, ranges) == triangleCount);
+}
+
+void testConeCullingIsConservative() {
+    const Surface surface = makeSurface(80, 3.0f);
+    Meshlets::ClusterSet set;
+    const std::vector<uint32_t> ordered = buildOrdered(set, surface);
+    const size_t triangleCount = ordered.size() / 3;
+    const Meshlets::Frustum frustum = everything();
+
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> coord(-150.0f, 230.0f);
+    size_t culledTotal = 0;
+    for (int trial = 0; trial < 64; ++trial) {
+        const glm::vec3 eye(coord(rng), coord(rng) * 0.5f, coord(rng));
+        std::vector<Meshlets::IndexRange> ranges;
+        const size_t kept = Meshlets::cull(set, frustum, &eye, ranges);
+        const std::vector<bool> keptMask = keptTriangles(ranges, triangleCount);
+        CHECK(static_cast<size_t>(std::count(keptMask.begin(), keptMask.end(), true)) == kept);
+
+        // Every dropped triangle faces away from the eye
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (keptMask[t]) continue;
+            ++culledTotal;
+            const glm::vec3 a = position(surface, ordered[t * 3]);
+            const glm::vec3 n = glm::cross(position(surface, ordered[t * 3 + 1]) - a,
+                                           position(surface, ordered[t * 3 + 2]) - a);
+            CHECK(glm::dot(n, eye - a) <= 0.0f);
+        }
+    }
+    // The eyes below the sheet must actually cull something
+    CHECK(culledTotal > 0);
+}
+
+void testFrustumCulling() {
+    const Surface surface = makeSurface(80, 3.0f);
+    Meshlets::ClusterSet set;
+    buildOrdered(set, surface);
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 500.0f);
+    std::vector<Meshlets::IndexRange> ranges;
+
+    // Looking away from the sheet
+    const glm::mat4 away = glm::lookAt(glm::vec3(40.0f, 20.0f, -10.0f), glm::vec3(40.0f, 20.0f, -100.0f),
+                                       glm::vec3(0.0f, 1.0f, 0.0f));
+    CHECK(Meshlets::cull(set, Meshlets::extractFrustum(projection * away), nullptr, ranges) == 0);
+
+    // Looking at one corner keeps some meshlets but not all
+    const glm::mat4 corner = glm::lookAt(glm::vec3(5.0f, 10.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f),
+                                         glm::vec3(0.0f, 1.0f, 0.0f));
+    const size_t kept = Meshlets::cull(set, Meshlets::extractFrustum(projection * corner), nullptr, ranges);
+    CHECK(kept > 0);
+    CHECK(kept < surface.indices.size() / 3);
+}
+
+void testRefitTracksVersion() {
+    Surface surface = makeSurface(40, 0.0f);
+    Meshlets::ClusterSet set;
+    buildOrdered(set, surface);
+    const glm::vec3 axis = set.bounds[0].coneAxis;
+
+    // Flip the sheet upside down: same array and version means the fit is kept
+    for (size_t v = 0; v < surface.vertexCount; ++v) surface.positions[v * 3 + 2] *= -1.0f;
+    Meshlets::refit(set, surface.positions.data(), surface.vertexCount, 1);
+    CHECK(set.bounds[0].coneAxis == axis);
+
+    Meshlets::refit(set, surface.positions.data(), surface.vertexCount, 2);
+    CHECK(set.bounds[0].coneAxis.y < -0.9999f);
+}
+
+} // namespace
+
+int main() {
+    testBuild();
+    testFlatSheetCones();
+    testConeCullingIsConservative();
+    testFrustumCulling();
+    testRefitTracksVersion();
+    Parallel::shutdown();
+    if (TEST_RESULT() == 0) std::printf("meshlets: ok\n");
+    return TEST_RESULT();
+}
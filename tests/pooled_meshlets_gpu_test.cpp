@@ -0,0 +1,101 @@
+/// @file pooled_meshlets_gpu_test.cpp
+/// @brief Meshes keep their meshlets when they move into or out of the pooled geometry
+/// arenas: each storage switch must rebuild the clusters, so the next frame still culls
+/// the mesh per meshlet.
+
+#include "TestCheck.h"
+#include "TestContext.h"
+
+#include <Camera.h>
+#include <GraphicsEngine.h>
+#include <TransformStack.h>
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// Flat sheet well above the 4096-triangle meshlet threshold
+struct Sheet {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<uint32_t> indices;
+    gfx::MeshSource source;
+
+    explicit Sheet(int side) {
+        for (int z = 0; z < side; ++z) {
+            for (int x = 0; x < side; ++x) {
+                positions.insert(positions.end(), {static_cast<float>(x), 0.0f, static_cast<float>(z)});
+                normals.insert(normals.end(), {0.0f, 1.0f, 0.0f});
+            }
+        }
+        for (int z = 0; z + 1 < side; ++z) {
+            for (int x = 0; x + 1 < side; ++x) {
+                const uint32_t i = static_cast<uint32_t>(z * side + x);
+                const uint32_t s = static_cast<uint32_t>(side);
+                indices.insert(indices.end(), {i, i + s, i + 1, i + 1, i + s, i + s + 1});
+            }
+        }
+        source.positions = positions.data();
+        source.normals = normals.data();
+        source.indices = indices.data();
+        source.vertexCount = side * side;
+        source.indexCount = static_cast<int>(indices.size());
+        source.positionsVersion = source.normalsVersion = source.indicesVersion = 1;
+    }
+};
+
+// Meshlets tested while drawing one frame
+size_t meshletsTested(gfx::Engine& engine) {
+    Camera camera(glm::vec3(40.0f, 30.0f, -20.0f), glm::vec3(40.0f, 0.0f, 40.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                  Camera::PERSPECTIVE);
+    camera.setShape(60.0f, 1.0f, 0.1f, 500.0f);
+    Renderer::ClothRenderData renderData;
+    gfx::RenderSettings settings;
+    TransformStack transforms;
+
+    engine.resetMeshletStats();
+    engine.renderScene(&camera, nullptr, nullptr, renderData, {}, settings, transforms);
+    return engine.meshletStats().meshletsTested;
+}
+
+void testStorageSwitchesKeepMeshlets(gfx::Engine& engine) {
+    const Sheet sheet(80);
+    engine.setMeshletCulling(true);
+
+    // Created straight into the arena
+    engine.setPooledGeometry(true);
+    const gfx::MeshHandle handle = engine.createMesh(sheet.source);
+    CHECK(meshletsTested(engine) > 0);
+
+    // Unchanged source, but the mesh leaves the arena for private buffers
+    engine.setPooledGeometry(false);
+    engine.updateMesh(handle, sheet.source);
+    CHECK(meshletsTested(engine) > 0);
+
+    // And enters it again
+    engine.setPooledGeometry(true);
+    engine.updateMesh(handle, sheet.source);
+    CHECK(meshletsTested(engine) > 0);
+
+    // Into the packed-format arena
+    engine.setVertexCompression(true);
+    engine.updateMesh(handle, sheet.source);
+    CHECK(meshletsTested(engine) > 0);
+
+    engine.destroyMesh(handle);
+}
+
+} // namespace
+
+int main() {
+    TestContext context("pooled meshlets gpu");
+    if (!context.ready()) return TestContext::SKIP;
+
+    gfx::Engine engine;
+    engine.initialize(64, 64);
+    testStorageSwitchesKeepMeshlets(engine);
+
+    if (TEST_RESULT() == 0) std::printf("pooled meshlets gpu: ok\n");
+    return TEST_RESULT();
+}
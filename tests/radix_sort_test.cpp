@@ -0,0 +1,96 @@
+/// @file radix_sort_test.cpp
+/// @brief radixSortByKey, which orders the render queue: keys end up ascending and
+/// equal keys keep submission order, matching std::stable_sort on every key shape the
+/// queue produces (few distinct keys, differences only in high or low digits, full range).
+
+#include "TestCheck.h"
+
+#include <RadixSort.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using gfx::radixSortByKey;
+
+namespace {
+
+struct Entry {
+    uint64_t key;
+    uint32_t item;   // submission order
+};
+
+bool sameOrder(const std::vector<Entry>& a, const std::vector<Entry>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].key != b[i].key || a[i].item != b[i].item) return false;
+    }
+    return true;
+}
+
+template <typename MakeKey>
+void checkAgainstStableSort(size_t count, MakeKey makeKey) {
+    std::vector<Entry> entries(count);
+    for (size_t i = 0; i < count; ++i) entries[i] = Entry{makeKey(i), static_cast<uint32_t>(i)};
+
+    std::vector<Entry> expected = entries;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const Entry& a, const Entry& b) { return a.key < b.key; });
+
+    std::vector<Entry> scratch;
+    radixSortByKey(entries, scratch);
+    CHECK(sameOrder(entries, expected));
+}
+
+void testEmptyAndSingle() {
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+    radixSortByKey(entries, scratch);
+    CHECK(entries.empty());
+
+    entries.push_back(Entry{42, 0});
+    radixSortByKey(entries, scratch);
+    CHECK(entries.size() == 1 && entries[0].key == 42 && entries[0].item == 0);
+}
+
+void testStability() {
+    std::mt19937_64 rng(17);
+    const size_t counts[] = {2, 3, 17, 256, 1000, 4099};
+    for (size_t count : counts) {
+        // Few distinct keys: long runs of equal keys must keep submission order
+        checkAgainstStableSort(count, [&](size_t) { return rng() % 5; });
+        // Keys differing only in the pass nibble (top digit)
+        checkAgainstStableSort(count, [&](size_t) { return (rng() % 3) << 60; });
+        // Program and material bits, with repeats, as the queue builds them
+        checkAgainstStableSort(count, [&](size_t) {
+            return ((rng() % 4) << 48) | ((rng() % 8) << 20) | (rng() % 3);
+        });
+        // Full 64-bit range, including the top bit
+        checkAgainstStableSort(count, [&](size_t) { return rng(); });
+        // All equal: nothing moves
+        checkAgainstStableSort(count, [](size_t) { return 0x1234ull << 44; });
+        // Already sorted and reversed
+        checkAgainstStableSort(count, [](size_t i) { return static_cast<uint64_t>(i) << 20; });
+        checkAgainstStableSort(count, [count](size_t i) { return static_cast<uint64_t>(count - i) << 36; });
+    }
+}
+
+void testScratchReuse() {
+    // A larger scratch left from an earlier frame must not leak into the result
+    std::vector<Entry> scratch(64, Entry{~0ull, 999});
+    std::vector<Entry> entries = {{3, 0}, {1, 1}, {3, 2}, {0, 3}, {1, 4}};
+    radixSortByKey(entries, scratch);
+    const std::vector<Entry> expected = {{0, 3}, {1, 1}, {1, 4}, {3, 0}, {3, 2}};
+    CHECK(sameOrder(entries, expected));
+}
+
+} // namespace
+
+int main() {
+    testEmptyAndSingle();
+    testStability();
+    testScratchReuse();
+    if (TEST_RESULT() == 0) std::printf("radix sort: ok\n");
+    return TEST_RESULT();
+}
@@ -0,0 +1,112 @@
+/// @file range_allocator_test.cpp
+/// @brief RangeAllocator first-fit placement, coalescing of neighbouring free ranges on
+/// release, and growth appending to (and merging with) the free tail.
+
+#include "TestCheck.h"
+
+#include <GeometryArena.h>
+
+#include <cstdio>
+
+using gfx::RangeAllocator;
+
+namespace {
+
+void testFirstFit() {
+    RangeAllocator alloc;
+    alloc.reset(100);
+    CHECK(alloc.allocate(10) == 0);
+    CHECK(alloc.allocate(20) == 10);
+    CHECK(alloc.allocate(30) == 30);
+    CHECK(alloc.freeTotal() == 40);
+    CHECK(alloc.largestFree() == 40);
+    CHECK(alloc.allocate(41) == RangeAllocator::INVALID);
+    CHECK(alloc.allocate(0) == 0);
+    CHECK(alloc.freeTotal() == 40);
+
+    // A hole at the front is reused before the tail
+    alloc.release(0, 10);
+    CHECK(alloc.allocate(4) == 0);
+    CHECK(alloc.allocate(8) == 60);
+    CHECK(alloc.allocate(6) == 4);
+}
+
+void testCoalescing() {
+    RangeAllocator alloc;
+    alloc.reset(60);
+    size_t a = alloc.allocate(10);
+    size_t b = alloc.allocate(10);
+    size_t c = alloc.allocate(10);
+    size_t d = alloc.allocate(10);
+    CHECK(alloc.largestFree() == 20);
+
+    // Non-adjacent holes stay separate
+    alloc.release(a, 10);
+    alloc.release(c, 10);
+    CHECK(alloc.freeTotal() == 40);
+    CHECK(alloc.largestFree() == 20);
+    CHECK(alloc.allocate(15) == 40);
+    alloc.release(40, 15);
+
+    // Releasing b merges with both a (before) and c (after)
+    alloc.release(b, 10);
+    CHECK(alloc.largestFree() == 30);
+    CHECK(alloc.allocate(30) == 0);
+    alloc.release(0, 30);
+
+    // Releasing d joins the front run to the tail: one range covers everything
+    alloc.release(d, 10);
+    CHECK(alloc.freeTotal() == 60);
+    CHECK(alloc.largestFree() == 60);
+    CHECK(alloc.allocate(60) == 0);
+    CHECK(alloc.freeTotal() == 0);
+    CHECK(alloc.largestFree() == 0);
+}
+
+void testReleaseOrder() {
+    // Release in every order of three neighbours; the result is always one range
+    const size_t orders[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+    for (const auto& order : orders) {
+        RangeAllocator alloc;
+        alloc.reset(30);
+        size_t offsets[3];
+        for (size_t& offset : offsets) offset = alloc.allocate(10);
+        for (size_t i : order) alloc.release(offsets[i], 10);
+        CHECK(alloc.freeTotal() == 30);
+        CHECK(alloc.largestFree() == 30);
+    }
+}
+
+void testGrow() {
+    RangeAllocator alloc;
+    alloc.reset(16);
+    CHECK(alloc.allocate(12) == 0);
+    CHECK(alloc.allocate(8) == RangeAllocator::INVALID);
+
+    // The new space merges with the 4 free units at the old end
+    alloc.grow(32);
+    CHECK(alloc.capacity() == 32);
+    CHECK(alloc.freeTotal() == 20);
+    CHECK(alloc.largestFree() == 20);
+    CHECK(alloc.allocate(20) == 12);
+
+    // Shrinking is ignored
+    alloc.grow(8);
+    CHECK(alloc.capacity() == 32);
+    CHECK(alloc.freeTotal() == 0);
+
+    // Growing a full allocator appends a fresh range
+    alloc.grow(40);
+    CHECK(alloc.allocate(8) == 32);
+}
+
+} // namespace
+
+int main() {
+    testFirstFit();
+    testCoalescing();
+    testReleaseOrder();
+    testGrow();
+    if (TEST_RESULT() == 0) std::printf("range allocator: ok\n");
+    return TEST_RESULT();
+}
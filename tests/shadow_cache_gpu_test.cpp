@@ -0,0 +1,111 @@
+/// @file shadow_cache_gpu_test.cpp
+/// @brief With the dynamic split, cloth moving within its allowance must not move the
+/// main light's cascades, so every cached layer is reused; leaving it refits them.
+
+#include "TestCheck.h"
+#include "TestContext.h"
+
+#include <Camera.h>
+#include <GraphicsEngine.h>
+#include <ShadowRenderer.h>
+#include <TransformStack.h>
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// Flat sheet of side x side vertices, spacing 1, lifted to height y
+struct Sheet {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<uint32_t> indices;
+    gfx::MeshSource source;
+
+    Sheet(int side, float x0, float y, float z0) {
+        for (int z = 0; z < side; ++z) {
+            for (int x = 0; x < side; ++x) {
+                positions.insert(positions.end(), {x0 + static_cast<float>(x), y, z0 + static_cast<float>(z)});
+                normals.insert(normals.end(), {0.0f, 1.0f, 0.0f});
+            }
+        }
+        for (int z = 0; z + 1 < side; ++z) {
+            for (int x = 0; x + 1 < side; ++x) {
+                const uint32_t i = static_cast<uint32_t>(z * side + x);
+                const uint32_t s = static_cast<uint32_t>(side);
+                indices.insert(indices.end(), {i, i + s, i + 1, i + 1, i + s, i + s + 1});
+            }
+        }
+        source.positions = positions.data();
+        source.normals = normals.data();
+        source.indices = indices.data();
+        source.vertexCount = side * side;
+        source.indexCount = static_cast<int>(indices.size());
+        source.positionsVersion = source.normalsVersion = source.indicesVersion = 1;
+    }
+
+    void lift(float dy) {
+        for (size_t i = 1; i < positions.size(); i += 3) positions[i] += dy;
+        ++source.positionsVersion;
+    }
+};
+
+// Sync the cloth, draw one frame and return the main array's cache claims
+Shadow::CacheStats renderFrame(gfx::Engine& engine, Sheet& cloth) {
+    std::vector<glm::vec3> colors{glm::vec3(0.8f)};
+    engine.syncPrimaryMeshes({cloth.source}, colors);
+
+    Camera camera(glm::vec3(30.0f, 40.0f, -30.0f), glm::vec3(30.0f, 0.0f, 30.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                  Camera::PERSPECTIVE);
+    camera.setShape(60.0f, 1.0f, 0.1f, 500.0f);
+    Renderer::ClothRenderData renderData;
+    gfx::RenderSettings settings;
+    TransformStack transforms;
+    engine.renderScene(&camera, nullptr, nullptr, renderData, colors, settings, transforms);
+    return Shadow::cacheStats();
+}
+
+void testClothMotionKeepsCachedCascades(gfx::Engine& engine) {
+    Shadow::setCaching(true);
+    Shadow::setDynamicSplit(true);
+
+    const Sheet ground(61, 0.0f, 0.0f, 0.0f);
+    const gfx::MeshHandle handle = engine.createMesh(ground.source);
+    Sheet cloth(11, 25.0f, 15.0f, 25.0f);
+
+    // The cache array is created while the first frame executes, so it settles on the second
+    renderFrame(engine, cloth);
+    const Shadow::CacheStats first = renderFrame(engine, cloth);
+    CHECK(first.redrawn > 0);
+
+    // The cloth is the caster nearest the light, so it sets how far back the cascades
+    // reach. Small steps stay inside the allowance: same cascades, nothing redrawn.
+    for (int frame = 0; frame < 4; ++frame) {
+        cloth.lift(0.05f);
+        const Shadow::CacheStats stats = renderFrame(engine, cloth);
+        CHECK(stats.redrawn == 0);
+        CHECK(stats.reused == first.redrawn);
+    }
+
+    // Far outside it the fit follows the cloth
+    cloth.lift(20.0f);
+    CHECK(renderFrame(engine, cloth).redrawn > 0);
+
+    engine.destroyMesh(handle);
+    Shadow::setDynamicSplit(false);
+}
+
+} // namespace
+
+int main() {
+    TestContext context("shadow cache gpu");
+    if (!context.ready()) return TestContext::SKIP;
+
+    gfx::Engine engine;
+    engine.initialize(64, 64);
+    if (!Shadow::isEnabled()) return context.skip("no shadow maps");
+    testClothMotionKeepsCachedCascades(engine);
+
+    if (TEST_RESULT() == 0) std::printf("shadow cache gpu: ok\n");
+    return TEST_RESULT();
+}
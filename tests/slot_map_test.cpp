@@ -0,0 +1,111 @@
+/// @file slot_map_test.cpp
+/// @brief SlotMap generations: erased and cleared handles stop resolving even after their
+/// slot is reused, and surviving handles follow their value when erase compacts the array.
+
+#include "TestCheck.h"
+
+#include <SlotMap.h>
+
+#include <cstdio>
+#include <string>
+
+using gfx::SlotMap;
+
+namespace {
+
+void testDefaultHandle() {
+    SlotMap<int> map;
+    SlotMap<int>::Handle none;
+    CHECK(!map.contains(none));
+    map.insert(1);
+    // Generations start at 1, so a zeroed handle to slot 0 never resolves
+    CHECK(!map.contains(SlotMap<int>::Handle{0, 0}));
+    CHECK(map.get(none) == nullptr);
+}
+
+void testEraseBumpsGeneration() {
+    SlotMap<std::string> map;
+    auto a = map.insert("a");
+    auto b = map.insert("b");
+    auto c = map.insert("c");
+    CHECK(map.size() == 3);
+
+    CHECK(map.erase(a) == "a");
+    CHECK(!map.contains(a));
+    CHECK(map.get(a) == nullptr);
+    CHECK(map.denseIndex(a) == SlotMap<std::string>::INVALID_INDEX);
+
+    // c moved into a's dense position; both survivors still resolve to their values
+    CHECK(map.size() == 2);
+    CHECK(map.denseIndex(c) == 0);
+    CHECK(*map.get(b) == "b");
+    CHECK(*map.get(c) == "c");
+    CHECK(map.handleAt(0) == c);
+    CHECK(map.handleAt(1) == b);
+
+    // The freed slot is reused under a new generation; the stale handle stays dead
+    auto d = map.insert("d");
+    CHECK(d.index == a.index);
+    CHECK(d.generation == a.generation + 1);
+    CHECK(d != a);
+    CHECK(!map.contains(a));
+    CHECK(*map.get(d) == "d");
+    CHECK(map.values().back() == "d");
+}
+
+void testEraseLast() {
+    SlotMap<int> map;
+    auto a = map.insert(10);
+    auto b = map.insert(20);
+    CHECK(map.erase(b) == 20);
+    CHECK(map.denseIndex(a) == 0);
+    CHECK(*map.get(a) == 10);
+    CHECK(map.erase(a) == 10);
+    CHECK(map.empty());
+}
+
+void testClear() {
+    SlotMap<int> map;
+    auto a = map.insert(1);
+    auto b = map.insert(2);
+    map.clear();
+    CHECK(map.empty());
+    CHECK(!map.contains(a));
+    CHECK(!map.contains(b));
+
+    auto c = map.insert(3);
+    auto d = map.insert(4);
+    CHECK(!map.contains(a));
+    CHECK(!map.contains(b));
+    CHECK(*map.get(c) == 3);
+    CHECK(*map.get(d) == 4);
+}
+
+void testChurn() {
+    // Repeated insert/erase on one slot keeps advancing its generation
+    SlotMap<int> map;
+    auto first = map.insert(0);
+    auto handle = first;
+    for (int i = 1; i <= 100; ++i) {
+        map.erase(handle);
+        auto next = map.insert(i);
+        CHECK(next.index == first.index);
+        CHECK(next.generation == handle.generation + 1);
+        CHECK(!map.contains(handle));
+        handle = next;
+    }
+    CHECK(!map.contains(first));
+    CHECK(*map.get(handle) == 100);
+}
+
+} // namespace
+
+int main() {
+    testDefaultHandle();
+    testEraseBumpsGeneration();
+    testEraseLast();
+    testClear();
+    testChurn();
+    if (TEST_RESULT() == 0) std::printf("slot map: ok\n");
+    return TEST_RESULT();
+}
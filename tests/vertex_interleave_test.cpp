@@ -0,0 +1,127 @@
+/// @file vertex_interleave_test.cpp
+/// @brief Every interleave path this CPU supports must match the scalar reference byte
+/// for byte, on odd and tail counts, with and without UVs, and must not write past the
+/// last vertex. Also covers the threaded interleave() and Parallel::forRange.
+
+#include "TestCheck.h"
+
+#include <ParallelFor.h>
+#include <VertexInterleave.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kGuardFloats = 16;
+constexpr uint32_t kSentinel = 0xCDCDCDCDu;
+
+std::vector<float> randomFloats(size_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    std::vector<float> values(count);
+    for (float& v : values) v = dist(rng);
+    return values;
+}
+
+// Destination with a sentinel-filled guard band behind the count * 8 floats
+std::vector<float> guardedDestination(int count) {
+    std::vector<float> dst(static_cast<size_t>(count) * 8 + kGuardFloats);
+    std::memset(dst.data(), 0xCD, dst.size() * sizeof(float));
+    return dst;
+}
+
+bool guardIntact(const std::vector<float>& dst, int count) {
+    for (size_t i = static_cast<size_t>(count) * 8; i < dst.size(); ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, &dst[i], sizeof(bits));
+        if (bits != kSentinel) return false;
+    }
+    return true;
+}
+
+void testPathsMatchScalar() {
+    using VertexInterleave::Path;
+    const int counts[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 127, 1001};
+    const Path best = VertexInterleave::bestPath();
+    std::mt19937 rng(7);
+    for (int count : counts) {
+        const std::vector<float> positions = randomFloats(static_cast<size_t>(count) * 3, rng);
+        const std::vector<float> normals = randomFloats(static_cast<size_t>(count) * 3, rng);
+        const std::vector<float> uvs = randomFloats(static_cast<size_t>(count) * 2, rng);
+        for (int withUVs = 0; withUVs < 2; ++withUVs) {
+            const float* uv = withUVs ? uvs.data() : nullptr;
+            std::vector<float> reference = guardedDestination(count);
+            VertexInterleave::interleaveWith(Path::Scalar, reference.data(), positions.data(), normals.data(), uv,
+                                             count);
+            CHECK(guardIntact(reference, count));
+            for (int p = static_cast<int>(Path::SSE2); p <= static_cast<int>(best); ++p) {
+                std::vector<float> out = guardedDestination(count);
+                VertexInterleave::interleaveWith(static_cast<Path>(p), out.data(), positions.data(), normals.data(),
+                                                 uv, count);
+                if (std::memcmp(out.data(), reference.data(), out.size() * sizeof(float)) != 0) {
+                    std::fprintf(stderr, "%s path differs (count %d, uvs %d)\n",
+                                 VertexInterleave::pathName(static_cast<Path>(p)), count, withUVs);
+                    CHECK(false);
+                }
+            }
+        }
+    }
+}
+
+void testScalarLayout() {
+    const float positions[] = {1, 2, 3};
+    const float normals[] = {4, 5, 6};
+    const float uvs[] = {7, 8};
+    float out[8];
+    VertexInterleave::interleaveWith(VertexInterleave::Path::Scalar, out, positions, normals, uvs, 1);
+    for (int i = 0; i < 8; ++i) CHECK(out[i] == static_cast<float>(i + 1));
+    VertexInterleave::interleaveWith(VertexInterleave::Path::Scalar, out, positions, normals, nullptr, 1);
+    CHECK(out[6] == 0.0f && out[7] == 0.0f);
+}
+
+void testThreadedMatchesScalar() {
+    // Large enough to be split across workers, with a ragged last chunk
+    const int count = 3 * 32768 + 13;
+    std::mt19937 rng(11);
+    const std::vector<float> positions = randomFloats(static_cast<size_t>(count) * 3, rng);
+    const std::vector<float> normals = randomFloats(static_cast<size_t>(count) * 3, rng);
+    const std::vector<float> uvs = randomFloats(static_cast<size_t>(count) * 2, rng);
+    std::vector<float> reference = guardedDestination(count);
+    std::vector<float> out = guardedDestination(count);
+    VertexInterleave::interleaveWith(VertexInterleave::Path::Scalar, reference.data(), positions.data(),
+                                     normals.data(), uvs.data(), count);
+    VertexInterleave::interleave(out.data(), positions.data(), normals.data(), uvs.data(), count);
+    CHECK(std::memcmp(out.data(), reference.data(), out.size() * sizeof(float)) == 0);
+}
+
+void testForRangeCoversOnce() {
+    const int sizes[] = {0, 1, 5, 1000, 100003};
+    for (int size : sizes) {
+        std::vector<std::atomic<int>> visits(static_cast<size_t>(size));
+        for (auto& v : visits) v = 0;
+        Parallel::forRange(size, 64, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) ++visits[static_cast<size_t>(i)];
+        });
+        bool once = true;
+        for (const auto& v : visits) once = once && v == 1;
+        CHECK(once);
+    }
+}
+
+} // namespace
+
+int main() {
+    testScalarLayout();
+    testPathsMatchScalar();
+    testThreadedMatchesScalar();
+    testForRangeCoversOnce();
+    Parallel::shutdown();
+    if (TEST_RESULT() == 0) {
+        std::printf("vertex interleave: ok (best path %s)\n",
+                    VertexInterleave::pathName(VertexInterleave::bestPath()));
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,258 @@
+/// @file vertex_normals_gpu_test.cpp
+/// @brief The compute-shader normals must match VertexNormals::compute on the engine's
+/// interleaved layout, with 32- and 16-bit indices. Also checks that a mesh with
+/// generated normals ignores dirty ranges and uploads all its vertices, and that layout
+/// switches re-upload each mesh with its own generated normals.
+
+#include "TestCheck.h"
+#include "TestContext.h"
+
+#include <GraphicsEngine.h>
+#include <IndexFormat.h>
+#include <VertexNormals.h>
+#include <VertexPacking.h>
+
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Grid {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    int vertexCount = 0;
+};
+
+// Wavy height field with uneven spacing, so faces differ in size and orientation
+Grid makeGrid(int side) {
+    Grid grid;
+    for (int z = 0; z < side; ++z) {
+        for (int x = 0; x < side; ++x) {
+            const float fx = static_cast<float>(x) + 0.3f * std::sin(static_cast<float>(z));
+            const float fz = static_cast<float>(z) * 1.1f;
+            grid.positions.push_back(fx);
+            grid.positions.push_back(std::sin(fx * 0.7f) * std::cos(fz * 0.4f) * 2.0f);
+            grid.positions.push_back(fz);
+        }
+    }
+    for (int z = 0; z + 1 < side; ++z) {
+        for (int x = 0; x + 1 < side; ++x) {
+            const uint32_t i = static_cast<uint32_t>(z * side + x);
+            const uint32_t s = static_cast<uint32_t>(side);
+            grid.indices.insert(grid.indices.end(), {i, i + s, i + 1, i + 1, i + s, i + s + 1});
+        }
+    }
+    grid.vertexCount = side * side;
+    return grid;
+}
+
+GLuint makeBuffer(const void* data, size_t bytes) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(bytes), data, GL_DYNAMIC_DRAW);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+
+// Normals written by the compute pass into the interleaved (8-float) layout the engine uses
+std::vector<float> gpuNormals(const Grid& grid, bool shortIndices) {
+    std::vector<float> vertices(static_cast<size_t>(grid.vertexCount) * 8, 0.0f);
+    for (int v = 0; v < grid.vertexCount; ++v) {
+        for (int c = 0; c < 3; ++c) vertices[v * 8 + c] = grid.positions[v * 3 + c];
+    }
+    const GLuint vbo = makeBuffer(vertices.data(), vertices.size() * sizeof(float));
+
+    const size_t indexCount = grid.indices.size();
+    GLuint ebo = 0;
+    if (shortIndices) {
+        std::vector<uint16_t> narrow;
+        const size_t bytes = IndexFormat::narrowPadded(narrow, grid.indices.data(), indexCount);
+        ebo = makeBuffer(narrow.data(), bytes);
+    } else {
+        ebo = makeBuffer(grid.indices.data(), indexCount * sizeof(uint32_t));
+    }
+
+    VertexNormals::GpuMeshView view;
+    view.positionBuffer = view.normalBuffer = vbo;
+    view.positionStride = view.normalStride = 8;
+    view.normalBase = 3;
+    view.indexBuffer = ebo;
+    view.shortIndices = shortIndices;
+    view.indexCount = static_cast<int>(indexCount);
+    view.vertexCount = grid.vertexCount;
+    view.fixedScale = VertexNormals::fixedPointScale(grid.positions.data(), grid.vertexCount,
+                                                     grid.indices.data(), view.indexCount);
+    VertexNormals::computeGpu(view);
+    VertexNormals::finishGpu();
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(vertices.size() * sizeof(float)),
+                       vertices.data());
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    // Through GLState, so the next mesh's reused buffer names are bound again
+    GLState::deleteBuffers(1, &vbo);
+    GLState::deleteBuffers(1, &ebo);
+
+    std::vector<float> normals(static_cast<size_t>(grid.vertexCount) * 3);
+    for (int v = 0; v < grid.vertexCount; ++v) {
+        for (int c = 0; c < 3; ++c) normals[v * 3 + c] = vertices[v * 8 + 3 + c];
+    }
+    return normals;
+}
+
+void testGpuMatchesCpu(int side, bool shortIndices) {
+    const Grid grid = makeGrid(side);
+    std::vector<float> expected(grid.positions.size());
+    VertexNormals::compute(expected.data(), grid.positions.data(), grid.vertexCount,
+                           grid.indices.data(), static_cast<int>(grid.indices.size()));
+    const std::vector<float> actual = gpuNormals(grid, shortIndices);
+
+    // The GPU sums fixed-point face normals, so allow for rounding
+    float maxError = 0.0f;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        maxError = std::fmax(maxError, std::fabs(expected[i] - actual[i]));
+    }
+    CHECK(maxError < 1e-3f);
+    if (maxError >= 1e-3f) {
+        std::fprintf(stderr, "side %d, short %d: max error %g\n", side, shortIndices ? 1 : 0, maxError);
+    }
+}
+
+// A dirty range names the vertices whose positions moved, but generated normals also
+// change on their neighbours, so the engine must upload every vertex
+void testGeneratedNormalsUploadWholeMesh(gfx::Engine& engine, bool gpu) {
+    const Grid grid = makeGrid(16);
+    std::vector<float> positions = grid.positions;
+    std::vector<float> normals(positions.size(), 0.0f);
+
+    gfx::MeshSource src;
+    src.positions = positions.data();
+    src.indices = grid.indices.data();
+    src.vertexCount = grid.vertexCount;
+    src.indexCount = static_cast<int>(grid.indices.size());
+    src.positionsVersion = 1;
+    src.indicesVersion = 1;
+
+    engine.setGpuNormals(gpu);
+    const gfx::MeshHandle handle = engine.createMesh(src);
+
+    positions[40 * 3 + 1] += 0.5f;
+    const gfx::VertexRange moved{40, 41};
+    src.positionsVersion = 2;
+    src.dirtyRanges = &moved;
+    src.dirtyRangeCount = 1;
+    engine.resetUploadStats();
+    engine.updateMesh(handle, src);
+    CHECK(engine.uploadStats().vertexBytes == static_cast<size_t>(grid.vertexCount) * 8 * sizeof(float));
+
+    // Caller-provided normals keep the partial upload
+    src.normals = normals.data();
+    src.normalsVersion = 1;
+    engine.updateMesh(handle, src);
+    positions[40 * 3 + 1] -= 0.5f;
+    src.positionsVersion = 3;
+    engine.resetUploadStats();
+    engine.updateMesh(handle, src);
+    CHECK(engine.uploadStats().vertexBytes == 8 * sizeof(float));
+
+    engine.destroyMesh(handle);
+}
+
+// Octahedral snorm16 pair back to a unit vector (inverse of VertexPacking::encodeOctNormal)
+glm::vec3 decodeOctNormal(const int16_t encoded[2]) {
+    float x = std::fmax(static_cast<float>(encoded[0]) / 32767.0f, -1.0f);
+    float y = std::fmax(static_cast<float>(encoded[1]) / 32767.0f, -1.0f);
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f) {
+        const float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    return glm::normalize(glm::vec3(x, y, z));
+}
+
+// Worst angle cosine between the mesh's packed normals and the CPU reference
+float packedNormalMatch(const gfx::Engine& engine, gfx::MeshHandle handle, const Grid& grid) {
+    const gfx::GpuMesh* mesh = engine.mesh(handle);
+    if (!mesh || !mesh->packed || mesh->arena) return -1.0f;
+    std::vector<VertexPacking::PackedVertex> packed(static_cast<size_t>(grid.vertexCount));
+    GLState::bindBuffer(GL_ARRAY_BUFFER, mesh->VBO);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(packed.size() * sizeof(packed[0])),
+                       packed.data());
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::vector<float> expected(grid.positions.size());
+    VertexNormals::compute(expected.data(), grid.positions.data(), grid.vertexCount,
+                           grid.indices.data(), static_cast<int>(grid.indices.size()));
+    float worst = 1.0f;
+    for (int v = 0; v < grid.vertexCount; ++v) {
+        const glm::vec3 reference(expected[v * 3], expected[v * 3 + 1], expected[v * 3 + 2]);
+        worst = std::fmin(worst, glm::dot(decodeOctNormal(packed[v].normal), reference));
+    }
+    return worst;
+}
+
+// Turning compression on re-uploads unchanged, normal-less meshes in the packed layout.
+// Each must pack its own generated normals, not whatever the last mesh generated (or
+// nothing, when the compute pass made them before).
+void testCompressionKeepsGeneratedNormals(gfx::Engine& engine, bool gpu) {
+    Grid grids[2] = {makeGrid(12), makeGrid(20)};
+    // Stand the second grid up so its normals point elsewhere
+    for (size_t i = 0; i < grids[1].positions.size(); i += 3) {
+        std::swap(grids[1].positions[i + 1], grids[1].positions[i + 2]);
+    }
+
+    engine.setVertexCompression(false);
+    engine.setGpuNormals(gpu);
+    gfx::MeshHandle handles[2];
+    gfx::MeshSource sources[2];
+    for (int m = 0; m < 2; ++m) {
+        sources[m].positions = grids[m].positions.data();
+        sources[m].indices = grids[m].indices.data();
+        sources[m].vertexCount = grids[m].vertexCount;
+        sources[m].indexCount = static_cast<int>(grids[m].indices.size());
+        sources[m].positionsVersion = sources[m].indicesVersion = 1;
+        handles[m] = engine.createMesh(sources[m]);
+    }
+    // A second sync records the generated normals' version, so only the layout changes below
+    for (int m = 0; m < 2; ++m) engine.updateMesh(handles[m], sources[m]);
+
+    engine.setVertexCompression(true);
+    for (int m = 0; m < 2; ++m) engine.updateMesh(handles[m], sources[m]);
+    for (int m = 0; m < 2; ++m) {
+        const float match = packedNormalMatch(engine, handles[m], grids[m]);
+        CHECK(match > 0.999f);
+        if (match <= 0.999f) std::fprintf(stderr, "gpu %d, mesh %d: worst cosine %g\n", gpu ? 1 : 0, m, match);
+    }
+
+    for (gfx::MeshHandle handle : handles) engine.destroyMesh(handle);
+    engine.setVertexCompression(false);
+}
+
+} // namespace
+
+int main() {
+    TestContext context("vertex normals gpu");
+    if (!context.ready()) return TestContext::SKIP;
+    if (!VertexNormals::gpuAvailable()) return context.skip("no compute shaders");
+
+    testGpuMatchesCpu(2, false);
+    testGpuMatchesCpu(33, false);
+    testGpuMatchesCpu(33, true);
+    testGpuMatchesCpu(120, false);
+
+    gfx::Engine engine;
+    engine.initialize(64, 64);
+    testGeneratedNormalsUploadWholeMesh(engine, false);
+    testGeneratedNormalsUploadWholeMesh(engine, true);
+    testCompressionKeepsGeneratedNormals(engine, false);
+    testCompressionKeepsGeneratedNormals(engine, true);
+    VertexNormals::cleanupGpu();
+
+    if (TEST_RESULT() == 0) std::printf("vertex normals gpu: ok\n");
+    return TEST_RESULT();
+}